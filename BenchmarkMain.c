@@ -0,0 +1,51 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NF_Benchmark.h"
+
+// Command line: benchmark results.json [--samples n] [--corpus] [--frames n] [rom ...]
+//
+// Runs the microbenchmarks of the core, the same suite as the emulator's --benchmark, with a frame benchmark for every
+// ROM given (or nestest.nes), and writes the results to a JSON file. Nothing but the core is linked in, so the numbers
+// are the same with or without a display. Exits with 1 if a benchmark could not run or the compositor check failed
+//
+// --samples:	Samples taken of each microbenchmark
+// --corpus:	Run the corpus benchmark instead, like the emulator's --benchmark-corpus: every ROM given, then every ROM
+//				under the directory in the NF_ROM_CORPUS environment variable, for a number of frames each with fixed input
+// --frames:	Frames the corpus benchmark runs each title for
+
+// ROMs that can be given at once
+#define MAX_ROM_ARGUMENTS 64
+
+int main(int argc, char* args[]) {
+    if (argc < 2) {
+        printf("Usage: %s results.json [--samples n] [--corpus] [--frames n] [rom ...]\n", args[0]);
+        return 1;
+    }
+    const char* json_path = args[1];
+    const char* rom_paths[MAX_ROM_ARGUMENTS];
+    int rom_count = 0;
+    int sample_count = NF_BENCHMARK_DEFAULT_SAMPLES;
+    bool corpus = false;
+    uint32_t frame_count = NF_CORPUS_DEFAULT_FRAMES;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(args[i], "--samples") == 0 && i + 1 < argc) { sample_count = atoi(args[++i]); }
+        else if (strcmp(args[i], "--corpus") == 0) { corpus = true; }
+        else if (strcmp(args[i], "--frames") == 0 && i + 1 < argc) { frame_count = (uint32_t)atoi(args[++i]); }
+        else if (rom_count < MAX_ROM_ARGUMENTS) { rom_paths[rom_count++] = args[i]; }
+    }
+    if (rom_count == 0) { rom_paths[rom_count++] = "nestest.nes"; }
+
+    FILE* json = fopen(json_path, "w");
+    if (json == NULL) {
+        printf("Error: Could not open %s for writing.\n", json_path);
+        return 1;
+    }
+    bool ok = corpus ? NF_Benchmark_runCorpus(rom_paths, rom_count, getenv("NF_ROM_CORPUS"), frame_count, json) :
+        NF_Benchmark_runSuite(rom_paths, rom_count, sample_count, json);
+    ok = (fclose(json) == 0) && ok;
+    if (ok) { printf("Results written to %s.\n", json_path); }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include "CF_Audio.h"
+#include "NF_Resampler.h"
+#include <SDL.h>
+#include <stdio.h>
+
+#define CF_AUDIO_RING_SIZE 16384
+#define CF_AUDIO_DEVICE_BUFFER 1024
+
+SDL_AudioDeviceID audioDevice = 0;
+struct NF_AudioRing* audioRing = NULL;
+struct NF_Resampler audioResampler;
+int audioSampleRate = 0;
+int16_t lastSample = 0;
+int16_t audioScratch[CF_AUDIO_DEVICE_BUFFER];
+
+// Owned by the audio thread. Other threads only look at it with the device locked
+struct CF_AudioStats audioStats;
+
+static uint32_t latencyToSamples(int latency_ms) {
+	uint32_t samples = (uint32_t)((int64_t)audioSampleRate * latency_ms / 1000);
+	if (samples < CF_AUDIO_DEVICE_BUFFER) { samples = CF_AUDIO_DEVICE_BUFFER; }
+	if (samples > CF_AUDIO_RING_SIZE / 2) { samples = CF_AUDIO_RING_SIZE / 2; }
+	return samples;
+}
+
+// Pull from the ring until the resampler has count more input samples, or the ring runs dry
+static void fillResampler(uint32_t count) {
+	while (count > 0) {
+		uint32_t chunk = count < CF_AUDIO_DEVICE_BUFFER ? count : CF_AUDIO_DEVICE_BUFFER;
+		uint32_t got = NF_AudioRing_read(audioRing, audioScratch, chunk);
+		NF_Resampler_write(&audioResampler, audioScratch, got);
+		if (got < chunk) { return; }
+		count -= got;
+	}
+}
+
+// Runs on SDL's audio thread. The playback ratio is proportional to how far the buffered audio is from the target,
+// so it settles where the ring is drained exactly as fast as it is filled. If the emulator has fallen behind anyway,
+// the gap is filled by holding the last sample, which is much less audible than dropping to zero
+static void audioCallback(void* userdata, Uint8* stream, int len) {
+	int16_t* out = (int16_t*)stream;
+	uint32_t wanted = (uint32_t)len / sizeof(int16_t);
+
+	double buffered = NF_AudioRing_available(audioRing) + NF_Resampler_pending(&audioResampler);
+	double error = (buffered - audioStats.target) / audioStats.target;
+	if (error > 1) { error = 1; }
+	if (error < -1) { error = -1; }
+	double ratio = 1.0 + error * CF_AUDIO_MAX_RATE_ADJUST;
+
+	fillResampler(NF_Resampler_inputNeeded(&audioResampler, wanted, ratio));
+	uint32_t got = NF_Resampler_read(&audioResampler, out, wanted, ratio);
+	if (got > 0) { lastSample = out[got - 1]; }
+	if (got < wanted) { audioStats.underruns++; }
+	for (uint32_t i = got; i < wanted; i++) { out[i] = lastSample; }
+
+	audioStats.buffered = (uint32_t)buffered;
+	if (audioStats.buffered < audioStats.min_buffered) { audioStats.min_buffered = audioStats.buffered; }
+	if (audioStats.buffered > audioStats.max_buffered) { audioStats.max_buffered = audioStats.buffered; }
+	audioStats.ratio = ratio;
+}
+
+struct NF_AudioRing* CF_initAudio(int sample_rate, int latency_ms) {
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+		printf("Error: SDL audio could not be initialized.\n");
+		return NULL;
+	}
+	audioRing = NF_AudioRing_create(CF_AUDIO_RING_SIZE);
+	if (audioRing == NULL) { return NULL; }
+
+	SDL_AudioSpec wanted, obtained;
+	SDL_zero(wanted);
+	wanted.freq = sample_rate;
+	wanted.format = AUDIO_S16SYS;
+	wanted.channels = 1;
+	wanted.samples = CF_AUDIO_DEVICE_BUFFER;
+	wanted.callback = audioCallback;
+	audioDevice = SDL_OpenAudioDevice(NULL, 0, &wanted, &obtained, 0);
+	if (audioDevice == 0) {
+		printf("Error: Audio device could not be opened. SDL Error: %s\n", SDL_GetError());
+		NF_AudioRing_free(audioRing);
+		audioRing = NULL;
+		return NULL;
+	}
+
+	audioSampleRate = sample_rate;
+	NF_Resampler_init(&audioResampler);
+	SDL_zero(audioStats);
+	audioStats.target = latencyToSamples(latency_ms);
+	audioStats.min_buffered = UINT32_MAX;
+	audioStats.ratio = 1.0;
+	SDL_PauseAudioDevice(audioDevice, 0);
+	return audioRing;
+}
+
+void CF_setAudioLatency(int latency_ms) {
+	if (audioDevice == 0) { return; }
+	SDL_LockAudioDevice(audioDevice);
+	audioStats.target = latencyToSamples(latency_ms);
+	SDL_UnlockAudioDevice(audioDevice);
+}
+
+bool CF_getAudioStats(struct CF_AudioStats* stats) {
+	if (audioDevice == 0) { return false; }
+	SDL_LockAudioDevice(audioDevice);
+	*stats = audioStats;
+	audioStats.min_buffered = UINT32_MAX;
+	audioStats.max_buffered = 0;
+	SDL_UnlockAudioDevice(audioDevice);
+	if (stats->min_buffered == UINT32_MAX) { stats->min_buffered = stats->buffered; }
+	if (stats->max_buffered < stats->min_buffered) { stats->max_buffered = stats->buffered; }
+	stats->latency_ms = stats->buffered * 1000.0f / audioSampleRate;
+	stats->dropped = audioRing->dropped;
+	return true;
+}
+
+bool CF_waitForAudio() {
+	if (audioDevice == 0) { return false; }
+	// The target is read without locking the device. A stale value for one frame does no harm
+	while (NF_AudioRing_available(audioRing) > audioStats.target) { SDL_Delay(1); }
+	return true;
+}
+
+void CF_exitAudio() {
+	if (audioDevice != 0) { SDL_CloseAudioDevice(audioDevice); }
+	audioDevice = 0;
+	NF_AudioRing_free(audioRing);
+	audioRing = NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef CF_H_AUDIO
+#define CF_H_AUDIO
+
+#include "NF_AudioRing.h"
+#include <stdbool.h>
+
+// Audio is played from a ring the APU fills. The emulator and the sound card each run off their own clock, so the
+// ring would slowly fill up or run dry no matter how the emulator is paced. To stop that, the audio callback plays
+// the ring slightly faster or slower (by at most CF_AUDIO_MAX_RATE_ADJUST) depending on how far the amount of
+// buffered audio is from the target latency. The change in pitch is far too small to hear.
+
+#define CF_AUDIO_MAX_RATE_ADJUST 0.005
+
+// How the audio output is doing. Sample counts are at the device sample rate
+struct CF_AudioStats {
+	uint32_t buffered;				// Samples waiting to be played, as of the last callback
+	uint32_t min_buffered;			// Lowest and highest value of buffered since the last call to CF_getAudioStats
+	uint32_t max_buffered;
+	uint32_t target;				// The value buffered is being steered towards
+	float latency_ms;				// buffered, in milliseconds
+	double ratio;					// Ring samples consumed per sample played, as of the last callback
+	uint32_t underruns;				// Callbacks that ran out of samples and had to fill the gap
+	uint32_t dropped;				// Samples the emulator made that did not fit in the ring
+};
+
+// Call once to open the default audio device, aiming to keep latency_ms of audio buffered. Returns the ring that the
+// device plays from, which should be handed to the APU with NF_APU_setOutput, or NULL if audio could not be started
+struct NF_AudioRing* CF_initAudio(int sample_rate, int latency_ms);
+
+// Change the target latency
+void CF_setAudioLatency(int latency_ms);
+
+// Fill in stats. Resets min_buffered and max_buffered. Returns false if audio is not running
+bool CF_getAudioStats(struct CF_AudioStats* stats);
+
+// Audio paced timing: wait until the amount of buffered audio has dropped to the target latency. Calling this once per
+// frame makes the emulator run at the speed of the sound card. Returns false at once if audio is not running, in which
+// case the caller has to pace itself some other way
+bool CF_waitForAudio();
+
+// Call once before the program is terminated to close the audio device
+void CF_exitAudio();
+
+#endif
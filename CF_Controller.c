@@ -1,9 +1,10 @@
 #include "CF_Controller.h"
+#include "NF_Controller.h"
 #include "string.h"
 #include <stdio.h>
 
-
-unsigned short mapped_buttons[255] = { 0 };
+// Scancodes are stored as the button number plus one, so that keys which were never mapped (0) do nothing
+unsigned short mapped_buttons[SDL_NUM_SCANCODES] = { 0 };
 bool buttonsPressed[CF_NUMBER_OF_BUTTONS] = { 0 };
 bool buttonsHeld[CF_NUMBER_OF_BUTTONS] = { 0 };
 bool buttonsReleased[CF_NUMBER_OF_BUTTONS] = { 0 };
@@ -14,13 +15,16 @@ void CF_clearControllerInput() {
 }
 
 void CF_receiveControllerInput(SDL_Event e) {
+	if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) { return; }
+	if (e.key.keysym.scancode >= SDL_NUM_SCANCODES || mapped_buttons[e.key.keysym.scancode] == 0) { return; }
+	int button = mapped_buttons[e.key.keysym.scancode] - 1;
 	if (e.type == SDL_KEYDOWN && e.key.repeat==0) {
-		buttonsPressed[mapped_buttons[e.key.keysym.scancode]] = true;
-		buttonsHeld[mapped_buttons[e.key.keysym.scancode]] = true;
+		buttonsPressed[button] = true;
+		buttonsHeld[button] = true;
 	}
 	else if (e.type == SDL_KEYUP) {
-		buttonsHeld[mapped_buttons[e.key.keysym.scancode]] = false;
-		buttonsReleased[mapped_buttons[e.key.keysym.scancode]] = true;
+		buttonsHeld[button] = false;
+		buttonsReleased[button] = true;
 	}
 }
 
@@ -28,4 +32,15 @@ bool* CF_getButtonsPressed() { return buttonsPressed; }
 bool* CF_getButtonsHeld() { return buttonsHeld; }
 bool* CF_getButtonsReleased() { return buttonsReleased; }
 
-void CF_mapButton(unsigned short from_Scancode, unsigned short to_Button) { mapped_buttons[from_Scancode] = to_Button; }
\ No newline at end of file
+uint8_t CF_getControllerState() {
+	static const uint8_t bits[CF_NUMBER_OF_BUTTONS] = { NF_BUTTON_UP, NF_BUTTON_RIGHT, NF_BUTTON_DOWN, NF_BUTTON_LEFT, NF_BUTTON_A, NF_BUTTON_B, NF_BUTTON_SELECT, NF_BUTTON_START };
+	uint8_t state = 0;
+	for (int i = 0; i < CF_NUMBER_OF_BUTTONS; i++) {
+		if (buttonsHeld[i]) { state |= bits[i]; }
+	}
+	return state;
+}
+
+void CF_mapButton(unsigned short from_Scancode, CF_BUTTON to_Button) {
+	if (from_Scancode < SDL_NUM_SCANCODES) { mapped_buttons[from_Scancode] = to_Button + 1; }
+}
\ No newline at end of file
@@ -2,15 +2,19 @@
 #define CF_H_CONTROLLER
 #include <SDL.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // An array to represent the virtual control pad 
 typedef enum { CF_UP, CF_RIGHT, CF_DOWN, CF_LEFT, CF_A, CF_B, CF_SELECT, CF_START, CF_NUMBER_OF_BUTTONS } CF_BUTTON;
 
-// The following three functions return
+// The following three functions return arrays indexed by CF_BUTTON, for buttons pressed this frame, held, and released this frame
 bool* CF_getButtonsPressed();
 bool* CF_getButtonsHeld();
 bool* CF_getButtonsReleased();
 
+// The held buttons as a mask of NF_BUTTON bits, which is what the emulated controller ports take
+uint8_t CF_getControllerState();
+
 // Map an SDL Scancode to one of the buttons on the virtual controller
 void CF_mapButton(unsigned short from_Scancode, CF_BUTTON to_Button);
 
@@ -0,0 +1,213 @@
+#include "CF_Video.h"
+#include "NF_NTSC.h"
+#include "NF_Palette.h"
+#include "NF_Scaler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SDL_Renderer* videoRenderer = NULL;
+SDL_Texture* videoTexture = NULL;
+CF_VIDEO_FILTER videoFilter = CF_FILTER_NONE;
+uint32_t videoColors[CF_VIDEO_COLORS];
+struct NF_NTSC* videoNTSC = NULL;
+struct NF_Scaler* videoScaler = NULL;
+int videoScale = 1;
+
+// A copy of what is in the texture, and the hashes of the frame lines it was drawn from. Only the lines of a frame
+// that differ from those are drawn again and uploaded. The NTSC filter redraws everything, since its artifacts move
+// on every frame
+uint32_t* videoPixels = NULL;
+uint64_t videoHashes[NF_FRAME_HEIGHT];
+bool videoHashesValid = false;
+
+static bool isScaler(CF_VIDEO_FILTER filter) { return filter == CF_FILTER_SCALE || filter == CF_FILTER_HQ || filter == CF_FILTER_XBR; }
+
+static NF_SCALER_TYPE scalerType(CF_VIDEO_FILTER filter) {
+	switch (filter) {
+	case CF_FILTER_HQ: return NF_SCALER_HQ;
+	case CF_FILTER_XBR: return NF_SCALER_XBR;
+	default: return NF_SCALER_SCALE;
+	}
+}
+
+bool CF_findVideoFilter(const char* name, CF_VIDEO_FILTER* filter, int* scale) {
+	*scale = 1;
+	if (strcmp(name, "none") == 0) { *filter = CF_FILTER_NONE; return true; }
+	if (strcmp(name, "ntsc") == 0) { *filter = CF_FILTER_NTSC; return true; }
+	const CF_VIDEO_FILTER scalers[3] = { CF_FILTER_SCALE, CF_FILTER_HQ, CF_FILTER_XBR };
+	for (int i = 0; i < 3; i++) {
+		for (int factor = NF_SCALER_MIN_FACTOR; factor <= NF_SCALER_MAX_FACTOR; factor++) {
+			char scaler_name[16];
+			snprintf(scaler_name, sizeof(scaler_name), "%s%dx", NF_Scaler_name(scalerType(scalers[i])), factor);
+			if (strcmp(name, scaler_name) == 0) {
+				*filter = scalers[i];
+				*scale = factor;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void CF_getVideoSize(CF_VIDEO_FILTER filter, int scale, int* width, int* height) {
+	switch (filter) {
+	case CF_FILTER_NTSC:
+		// Lines are doubled so that the picture keeps its shape
+		*width = NF_NTSC_OUTPUT_WIDTH;
+		*height = NF_FRAME_HEIGHT * 2;
+		break;
+	case CF_FILTER_SCALE:
+	case CF_FILTER_HQ:
+	case CF_FILTER_XBR:
+		*width = NF_FRAME_WIDTH * scale;
+		*height = NF_FRAME_HEIGHT * scale;
+		break;
+	default:
+		*width = NF_FRAME_WIDTH;
+		*height = NF_FRAME_HEIGHT;
+		break;
+	}
+}
+
+bool CF_initVideo(SDL_Window* window, CF_VIDEO_FILTER filter, int scale) {
+	int texture_width = NF_FRAME_WIDTH;
+	int texture_height = NF_FRAME_HEIGHT;
+	NF_getColorTable(videoColors);
+	if (filter == CF_FILTER_NTSC) {
+		videoNTSC = NF_NTSC_create(0);
+		if (videoNTSC == NULL) { return false; }
+		texture_width = NF_NTSC_OUTPUT_WIDTH;
+	}
+	else if (isScaler(filter)) {
+		videoScaler = NF_Scaler_create(scalerType(filter), scale, videoColors, 0);
+		if (videoScaler == NULL) { return false; }
+		texture_width = NF_FRAME_WIDTH * scale;
+		texture_height = NF_FRAME_HEIGHT * scale;
+		videoScale = scale;
+	}
+	videoFilter = filter;
+	if (filter != CF_FILTER_NTSC) {
+		videoPixels = malloc((size_t)texture_width * texture_height * sizeof(uint32_t));
+		if (videoPixels == NULL) {
+			printf("Error: Could not allocate video buffer. Out of memory?\n");
+			CF_exitVideo();
+			return false;
+		}
+		videoHashesValid = false;
+	}
+
+	videoRenderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	if (videoRenderer == NULL) {
+		printf("Error: SDL_Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	videoTexture = SDL_CreateTexture(videoRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, texture_width, texture_height);
+	if (videoTexture == NULL) {
+		printf("Error: SDL_Texture could not be created! SDL Error: %s\n", SDL_GetError());
+		CF_exitVideo();
+		return false;
+	}
+	return true;
+}
+
+void CF_drawFrame(const struct NF_Frame* frame) {
+	if (videoFilter == CF_FILTER_NTSC) {
+		void* pixels;
+		int pitch;
+		if (SDL_LockTexture(videoTexture, NULL, &pixels, &pitch) != 0) { return; }
+
+		// On the real thing a dot is skipped every other frame, which moves the artifacts back and forth
+		NF_NTSC_filter(videoNTSC, frame, (uint32_t*)pixels, pitch, (int)(frame->number & 1));
+		SDL_UnlockTexture(videoTexture);
+		return;
+	}
+
+	// The frames taken are not always consecutive, so the lines that changed are found from the hashes rather than
+	// from the frame's own bitmap
+	uint32_t dirty[NF_FRAME_DIRTY_WORDS];
+	if (!videoHashesValid) {
+		memcpy(videoHashes, frame->line_hashes, sizeof(videoHashes));
+		memset(dirty, 0xFF, sizeof(dirty));
+		videoHashesValid = true;
+	}
+	else if (NF_Frame_delta(frame, videoHashes, dirty) == 0) { return; }
+
+	int width = NF_FRAME_WIDTH * videoScale;
+	size_t pitch = (size_t)width * sizeof(uint32_t);
+	if (videoScaler != NULL) { NF_Scaler_scale(videoScaler, frame, dirty, videoPixels, pitch); }
+	else {
+		for (int line = 0, count; NF_Frame_nextDirtyRun(dirty, &line, &count); line += count) {
+			for (int y = line; y < line + count; y++) {
+				uint32_t* row = videoPixels + (size_t)y * width;
+				for (int x = 0; x < NF_FRAME_WIDTH; x++) { row[x] = videoColors[frame->pixels[y][x] & (CF_VIDEO_COLORS - 1)]; }
+			}
+		}
+	}
+	for (int line = 0, count; NF_Frame_nextDirtyRun(dirty, &line, &count); line += count) {
+		SDL_Rect rect = { 0, line * videoScale, width, count * videoScale };
+		SDL_UpdateTexture(videoTexture, &rect, videoPixels + (size_t)line * videoScale * width, (int)pitch);
+	}
+}
+
+void CF_presentVideo() {
+	SDL_RenderClear(videoRenderer);
+	SDL_RenderCopy(videoRenderer, videoTexture, NULL, NULL);
+	SDL_RenderPresent(videoRenderer);
+}
+
+void CF_exitVideo() {
+	if (videoTexture != NULL) { SDL_DestroyTexture(videoTexture); }
+	if (videoRenderer != NULL) { SDL_DestroyRenderer(videoRenderer); }
+	videoTexture = NULL;
+	videoRenderer = NULL;
+	NF_NTSC_free(videoNTSC);
+	videoNTSC = NULL;
+	NF_Scaler_free(videoScaler);
+	videoScaler = NULL;
+	free(videoPixels);
+	videoPixels = NULL;
+}
+
+// Print the average time per frame, and how many output pixels that is per second
+static void printBenchmark(const char* name, uint64_t ticks, int repeats, int width, int height) {
+	double ms = (double)ticks * 1000.0 / (double)SDL_GetPerformanceFrequency() / repeats;
+	printf("%-10s %4dx%-4d %8.3f ms/frame %9.1f Mpixels/s\n", name, width, height, ms, ms > 0 ? width * height / (ms * 1000.0) : 0.0);
+}
+
+void CF_benchmarkVideoFilters(const struct NF_Frame* frame, int repeats) {
+	if (repeats < 1) { repeats = 1; }
+	uint32_t* output = malloc((size_t)NF_FRAME_WIDTH * NF_SCALER_MAX_FACTOR * NF_FRAME_HEIGHT * NF_SCALER_MAX_FACTOR * sizeof(uint32_t));
+	if (output == NULL) {
+		printf("Error: Could not allocate benchmark output. Out of memory?\n");
+		return;
+	}
+	NF_getColorTable(videoColors);
+	printf("Timing %d frames per filter on %d processors\n", repeats, NF_getProcessorCount());
+
+	// Each filter runs once before it is timed, so that its tables and threads are warmed up
+	struct NF_NTSC* ntsc = NF_NTSC_create(0);
+	if (ntsc != NULL) {
+		size_t pitch = NF_NTSC_OUTPUT_WIDTH * sizeof(uint32_t);
+		NF_NTSC_filter(ntsc, frame, output, pitch, 0);
+		uint64_t start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < repeats; i++) { NF_NTSC_filter(ntsc, frame, output, pitch, i & 1); }
+		printBenchmark("ntsc", SDL_GetPerformanceCounter() - start, repeats, NF_NTSC_OUTPUT_WIDTH, NF_FRAME_HEIGHT);
+		NF_NTSC_free(ntsc);
+	}
+	for (int type = 0; type < NF_SCALER_TYPES; type++) {
+		for (int factor = NF_SCALER_MIN_FACTOR; factor <= NF_SCALER_MAX_FACTOR; factor++) {
+			struct NF_Scaler* scaler = NF_Scaler_create((NF_SCALER_TYPE)type, factor, videoColors, 0);
+			if (scaler == NULL) { continue; }
+			size_t pitch = (size_t)NF_FRAME_WIDTH * factor * sizeof(uint32_t);
+			NF_Scaler_scale(scaler, frame, NULL, output, pitch);
+			uint64_t start = SDL_GetPerformanceCounter();
+			for (int i = 0; i < repeats; i++) { NF_Scaler_scale(scaler, frame, NULL, output, pitch); }
+			char name[16];
+			snprintf(name, sizeof(name), "%s%dx", NF_Scaler_name((NF_SCALER_TYPE)type), factor);
+			printBenchmark(name, SDL_GetPerformanceCounter() - start, repeats, NF_FRAME_WIDTH * factor, NF_FRAME_HEIGHT * factor);
+			NF_Scaler_free(scaler);
+		}
+	}
+	free(output);
+}
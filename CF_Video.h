@@ -0,0 +1,45 @@
+#ifndef CF_H_VIDEO
+#define CF_H_VIDEO
+
+#include "NF_Frame.h"
+#include <SDL.h>
+#include <stdbool.h>
+
+// Shows the frames the PPU draws. Each frame is turned into RGB through a table holding every combination of palette
+// color and color emphasis, or through a filter, copied into a streaming texture, and stretched over the window by
+// the renderer. The pixel art scalers make the frame a whole number of times bigger on the CPU, so that the renderer
+// has little or no stretching left to do.
+
+#define CF_VIDEO_COLORS 512				// 64 palette colors times 8 combinations of emphasis bits
+
+typedef enum {
+	CF_FILTER_NONE,						// Plain palette colors, 256x240
+	CF_FILTER_NTSC,						// Composite video artifacts (see NF_NTSC.h), 602x240
+	CF_FILTER_SCALE,					// Pixel art scalers (see NF_Scaler.h), 256x240 times the scale
+	CF_FILTER_HQ,
+	CF_FILTER_XBR
+} CF_VIDEO_FILTER;
+
+// Look up a filter by name: "none", "ntsc", or a scaler and its scale such as "scale2x", "hq3x" or "xbr4x". scale is
+// set to 1 for filters other than the scalers. Returns false if there is no such filter
+bool CF_findVideoFilter(const char* name, CF_VIDEO_FILTER* filter, int* scale);
+
+// The window size that shows a filter's output at the right aspect ratio and at least its own resolution
+void CF_getVideoSize(CF_VIDEO_FILTER filter, int scale, int* width, int* height);
+
+// Call once, after the window is created, to create the renderer and the texture. Returns false if either fails
+bool CF_initVideo(SDL_Window* window, CF_VIDEO_FILTER filter, int scale);
+
+// Convert a frame and upload it to the texture. The frame is not needed once this returns
+void CF_drawFrame(const struct NF_Frame* frame);
+
+// Put the last frame drawn on screen. Waits for vertical sync if the renderer uses it
+void CF_presentVideo();
+
+// Call once before the window is closed
+void CF_exitVideo();
+
+// Time every filter, and every scaler at every scale, on one frame, and print how long each takes. Needs no window
+void CF_benchmarkVideoFilters(const struct NF_Frame* frame, int repeats);
+
+#endif
@@ -1,3 +1,9 @@
+# The emulator can check itself against goodlog.txt without writing a log, and stops at the first difference:
+#   Emulator nestest.nes --nestest goodlog.txt
+#
+# This script compares a log.txt made some other way, such as by another emulator or from a trace file with
+#   Emulator --trace-text trace log.txt
+
 MAX_LINE = 5003
 GROUND_TRUTH_LOG = "goodlog.txt"
 TEST_LOG = "log.txt"
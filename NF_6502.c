@@ -1,15 +1,14 @@
 #include "NF_6502.h"
 #include "NF_Bus.h"
 #include "NF_PPU.h"
-#include "NF_Debugger.h"
+#include "NF_Probes.h"
+#include "NF_Profiler.h"
+#include "NF_Trace.h"
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-// Debug log
-FILE* myLog;
-
 // It is important to be able to convert an opcode (in range 0x00 to 0xff) to an opcode and an addressing mode.
 // To aid in this, we have two arrays, one which contains the opcodes, and one which contains the address modes.
 // This is the compromise between code that is readable, code that runs fast (accessible in constant time), and code that does not use
@@ -85,10 +84,7 @@ uint8_t cyclesArray[256] =
 // Initialize the CPU-> This must be called once before trying to use it
 struct Processor* NF_6502_initProcessor() {
 
-	// If debugging is enabled, open a file for logging
-	if (DEBUG_ENABLED) { myLog = fopen("log.txt", "w"); }
-
-	struct Processor* newcpu = malloc(sizeof(struct Processor));
+	struct Processor* newcpu = calloc(1, sizeof(struct Processor));
 	if (newcpu == NULL) {
 		printf("Error: Could not create 6502 Processor object. Out of memory?\n");
 		return 0;
@@ -102,6 +98,7 @@ struct Processor* NF_6502_initProcessor() {
 	newcpu->P = 0b00100100;
 	newcpu->cycles = 0;
 	newcpu->page_crossed = false;
+	newcpu->total_cycles = 7;
 	return newcpu;
 
 }
@@ -117,6 +114,22 @@ uint8_t NF_6502_getFlag(struct Processor* CPU, FLAG_6502 flag) {
 	return (CPU->P & flag);
 }
 
+// Stores and jumps never read the memory their operand points at, and reading it here would set off the side effects
+// of registers like PPUDATA. The value there is still peeked at, for the trace
+static uint8_t readOperand(struct Processor* CPU) {
+	NF_CDL_SET_ACCESS(CPU->bus, NF_CDL_DATA);
+	switch (CPU->opcode) {
+	case OP_STA:
+	case OP_STX:
+	case OP_STY:
+	case OP_JMP:
+	case OP_JSR:
+		return NF_peekMemory(CPU->bus, CPU->fetched_address);
+	default:
+		return NF_readMemory(CPU->bus, CPU->fetched_address);
+	}
+}
+
 // Each opcode instruction is between 1 and 3 bytes. The first byte tells what the instruction is.
 // Calling this function will then use the current address mode to store some data from the other bytes.
 // What this data is, and where it is located will depend on the instruction. It could either be a literal,
@@ -149,17 +162,17 @@ void NF_fetchData(struct Processor* CPU) {
 		break;
 	case AM_ZPG:
 		CPU->fetched_address = 0x00FF & NF_readMemory(CPU->bus, CPU->PC);
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		CPU->PC++;
 		break;
 	case AM_ZPX:
 		CPU->fetched_address = 0x00FF & (NF_readMemory(CPU->bus, CPU->PC) + CPU->X);
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		CPU->PC++;
 		break;
 	case AM_ZPY:
 		CPU->fetched_address = 0x00FF & (NF_readMemory(CPU->bus, CPU->PC) + CPU->Y);
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		CPU->PC++;
 		break;
 	case AM_ABS:
@@ -168,7 +181,7 @@ void NF_fetchData(struct Processor* CPU) {
 		hi = NF_readMemory(CPU->bus, CPU->PC);
 		CPU->PC++;
 		CPU->fetched_address = (hi << 8) | lo;
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		break;
 	case AM_ABX:
 		lo = NF_readMemory(CPU->bus, CPU->PC);
@@ -176,7 +189,7 @@ void NF_fetchData(struct Processor* CPU) {
 		hi = NF_readMemory(CPU->bus, CPU->PC);
 		CPU->PC++;
 		CPU->fetched_address = ((hi << 8) | lo) + CPU->X;
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		if ((CPU->fetched_address & 0xFF00) != (hi << 8)) { CPU->page_crossed = true; }
 		break;
 	case AM_ABY:
@@ -185,7 +198,7 @@ void NF_fetchData(struct Processor* CPU) {
 		hi = NF_readMemory(CPU->bus, CPU->PC);
 		CPU->PC++;
 		CPU->fetched_address = ((hi << 8) | lo) + CPU->Y;
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		if ((CPU->fetched_address & 0xFF00) != (hi << 8)) { CPU->page_crossed = true; }
 		break;
 	case AM_IND:
@@ -194,11 +207,12 @@ void NF_fetchData(struct Processor* CPU) {
 		hi = NF_readMemory(CPU->bus, CPU->PC);
 		CPU->PC++;
 		tmp = (hi << 8) | lo;
+		NF_CDL_SET_ACCESS(CPU->bus, NF_CDL_DATA);
 		// The 6502 has a bug where if the hi byte crosses a page boundary above the lo byte, instead the hi
 		// byte will be pulled from 00 of the same page. It wraps around to it.
 		if (lo == 0x00FF) { CPU->fetched_address = ((NF_readMemory(CPU->bus, tmp & 0xFF00) << 8) | NF_readMemory(CPU->bus, tmp)); }
 		else { CPU->fetched_address = ((NF_readMemory(CPU->bus, tmp + 1) << 8) | NF_readMemory(CPU->bus, tmp)); }
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		break;
 	case AM_INX:
 		tmp = NF_readMemory(CPU->bus, CPU->PC) + CPU->X;
@@ -206,7 +220,7 @@ void NF_fetchData(struct Processor* CPU) {
 		lo = NF_readMemory(CPU->bus, tmp & 0x00FF);
 		hi = NF_readMemory(CPU->bus, (tmp + 1) & 0x00FF);
 		CPU->fetched_address = (hi << 8) | lo;
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		if ((CPU->fetched_address & 0xFF00) != (hi << 8)) { CPU->page_crossed = true; }
 		break;
 	case AM_INY:
@@ -215,21 +229,13 @@ void NF_fetchData(struct Processor* CPU) {
 		lo = NF_readMemory(CPU->bus, tmp & 0x00FF);
 		hi = NF_readMemory(CPU->bus, (tmp + 1) & 0x00FF);
 		CPU->fetched_address = ((hi << 8) | lo) + CPU->Y;
-		CPU->fetched = NF_readMemory(CPU->bus, CPU->fetched_address);
+		CPU->fetched = readOperand(CPU);
 		if ((CPU->fetched_address & 0xFF00) != (hi << 8)) { CPU->page_crossed = true; }
 		break;
 	case AM_XXX:
-		if (DEBUG_ENABLED) {
-			fflush(myLog);
-			fclose(myLog);
-		}
 		//printf("Error: An illegal addressing mode was used. No value fetched.\n");
 		break;
 	default:
-		if (DEBUG_ENABLED) {
-			fflush(myLog);
-			fclose(myLog);
-		}
 		//printf("Error: A valid addressing mode was not passed. No value fetched.\n");
 		break;
 	}
@@ -605,10 +611,6 @@ void NF_executeInstruction(struct Processor* CPU) {
 		break;
 	case OP_XXX:
 	default:
-		if (DEBUG_ENABLED) {
-			fflush(myLog);
-			fclose(myLog);
-		}
 		//printf("Error: Illegal opcodes was found. This is not supported.\n");
 		break;
 	}
@@ -635,6 +637,10 @@ void NF_6502_reset(struct Processor* CPU) {
 void NF_6502_irq(struct Processor* CPU) {
 	// The interrupt will only be handled if they are not disabled
 	if (NF_6502_getFlag(CPU, FLAG_I) == 0) {
+		CPU->bus->counters.irqs++;
+#if NF_PROFILER_ENABLED
+		if (CPU->bus->profiler != NULL) { NF_Profiler_interrupt(CPU->bus->profiler, CPU, NF_PROFILE_IRQ); }
+#endif
 		NF_writeMemory(CPU->bus, NF_6502_STACK_LOCATION + CPU->SP, (CPU->PC >> 8) & 0x00FF);
 		CPU->SP--;
 		NF_writeMemory(CPU->bus, NF_6502_STACK_LOCATION + CPU->SP, CPU->PC & 0x00FF);
@@ -655,6 +661,11 @@ void NF_6502_irq(struct Processor* CPU) {
 // Non-maskable interrupt signal handling
 void NF_6502_nmi(struct Processor* CPU) {
 	// The same as irq, except this one cannot be ignored because of the I flag
+	CPU->bus->counters.nmis++;
+	NF_PROBE2(nmi, CPU->bus->frame_count, CPU->bus->cpu_cycle);
+#if NF_PROFILER_ENABLED
+	if (CPU->bus->profiler != NULL) { NF_Profiler_interrupt(CPU->bus->profiler, CPU, NF_PROFILE_NMI); }
+#endif
 	NF_writeMemory(CPU->bus, NF_6502_STACK_LOCATION + CPU->SP, (CPU->PC >> 8) & 0x00FF);
 	CPU->SP--;
 	NF_writeMemory(CPU->bus, NF_6502_STACK_LOCATION + CPU->SP, CPU->PC & 0x00FF);
@@ -671,29 +682,45 @@ void NF_6502_nmi(struct Processor* CPU) {
 }
 
 
-int total_cycles = 7;
 void NF_6502_tickClock(struct Processor* CPU) {
 
+	// OAM DMA holds the CPU off the bus
+	if (CPU->cycles == 0 && CPU->stall_cycles > 0) {
+		CPU->stall_cycles--;
+		return;
+	}
+
+	// The IRQ line is level triggered, so it is checked between instructions for as long as something holds it
+	if (CPU->cycles == 0 && CPU->bus->irq_lines != 0 && NF_6502_getFlag(CPU, FLAG_I) == 0) {
+		NF_6502_irq(CPU);
+	}
+
 	if (CPU->cycles == 0) {
 		// Fetch the opcode and prepare to execute the next instruction
 		CPU->last_pc = CPU->PC;
+#if NF_PROFILER_ENABLED
+		if (CPU->bus->profiler != NULL) { NF_Profiler_startInstruction(CPU->bus->profiler, CPU); }
+#endif
 		CPU->page_crossed = false;
+		NF_CDL_SET_ACCESS(CPU->bus, NF_CDL_FETCH_OPCODE);
 		uint8_t fetchedOpcode = NF_readMemory(CPU->bus, CPU->PC);
 		CPU->opcode = charToOpcodeArray[fetchedOpcode];
 		CPU->addr_mode = charToAddressModeArray[fetchedOpcode];
 		CPU->PC++;
 
+		// Every read of the operand is from PC, and fetching switches to data reads once it has the address
+		NF_CDL_SET_ACCESS(CPU->bus, NF_CDL_FETCH_OPERAND);
 		NF_fetchData(CPU);
+		NF_CDL_SET_ACCESS(CPU->bus, NF_CDL_DATA);
 
-		if (DEBUG_ENABLED) { printToDebugFile(myLog, CPU); }
+		if (CPU->bus->tracer != NULL) { NF_Tracer_recordInstruction(CPU->bus->tracer, CPU, fetchedOpcode); }
 
 		// Get the number of cycles for the fetched opcode and execute it
 		CPU->cycles = cyclesArray[fetchedOpcode];
 		NF_executeInstruction(CPU);
 
-		if (DEBUG_ENABLED) { fprintf(myLog, "%d\n", total_cycles); }
-
-		total_cycles += CPU->cycles;
+		CPU->total_cycles += CPU->cycles;
+		CPU->bus->counters.instructions++;
 
 	}
 
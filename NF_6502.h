@@ -52,6 +52,7 @@ struct Processor {
 
 	// Variables that will help in emulating its functionality
 	uint8_t cycles;					// Number of cycles needed to finish performing the operation being executed
+	uint16_t stall_cycles;			// Cycles the CPU is halted for by OAM DMA, once the current instruction is done
 	OPCODE_6502 opcode;			    // Opcode currently being executed
 	ADDRESS_MODE_6502 addr_mode;    // Address mode being used by the current opcode
 	uint8_t fetched;
@@ -61,6 +62,7 @@ struct Processor {
 
 	// Debugger values
 	uint16_t last_pc;
+	uint64_t total_cycles;			// Cycles taken by every instruction started so far, as printed in the nestest log
 
 };
 
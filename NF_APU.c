@@ -0,0 +1,544 @@
+#include "NF_APU.h"
+#include "NF_Bus.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Contribution of one step of each channel to the output. The real mixer is not linear, but these slopes (taken
+// at the origin of the nonlinear curves) are within a few percent of it over the levels games use
+#define PULSE_WEIGHT 0.00752f
+#define TRIANGLE_WEIGHT 0.00851f
+#define NOISE_WEIGHT 0.00494f
+#define DMC_WEIGHT 0.00335f
+#define OUTPUT_GAIN 30000.0f
+
+// The NES filters its output with a high-pass at around 37Hz (among others), which also takes out the DC offset
+#define HIGHPASS_FREQUENCY 37.0
+
+static const uint8_t lengthTable[32] = {
+	10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+	12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const uint8_t dutyTable[4][8] = {
+	{ 0, 1, 0, 0, 0, 0, 0, 0 },		// 12.5%
+	{ 0, 1, 1, 0, 0, 0, 0, 0 },		// 25%
+	{ 0, 1, 1, 1, 1, 0, 0, 0 },		// 50%
+	{ 1, 0, 0, 1, 1, 1, 1, 1 }		// 25% negated
+};
+
+static const uint8_t triangleTable[32] = {
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+// Timer periods in CPU cycles (NTSC)
+static const uint16_t noisePeriodTable[16] = { 4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068 };
+static const uint16_t dmcRateTable[16] = { 428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54 };
+
+// Frame counter steps, in CPU cycles from the start of the sequence. The last entry is the length of the sequence
+static const uint32_t fourStepSequence[5] = { 7457, 14913, 22371, 29829, 29830 };
+static const uint32_t fiveStepSequence[6] = { 7457, 14913, 22371, 29829, 37281, 37282 };
+
+// Band-limited step kernels, one per sub-sample phase. Each is the derivative of a band-limited step, so adding it
+// to the buffer and integrating afterwards produces the step
+static float blipKernel[APU_BLIP_PHASES][APU_BLIP_TAPS];
+static bool blipKernelReady = false;
+
+static void buildBlipKernel() {
+	const double pi = 3.14159265358979323846;
+	const double cutoff = 0.45;			// As a fraction of the output sample rate, just under Nyquist
+	for (int phase = 0; phase < APU_BLIP_PHASES; phase++) {
+		double taps[APU_BLIP_TAPS];
+		double sum = 0;
+		for (int i = 0; i < APU_BLIP_TAPS; i++) {
+			double x = i - (APU_BLIP_TAPS / 2 - 1) - (double)phase / APU_BLIP_PHASES;
+			double sinc = (x == 0) ? 2 * cutoff : sin(2 * pi * cutoff * x) / (pi * x);
+			double window = 0.42 + 0.5 * cos(2 * pi * x / APU_BLIP_TAPS) + 0.08 * cos(4 * pi * x / APU_BLIP_TAPS);
+			taps[i] = sinc * window;
+			sum += taps[i];
+		}
+		// Every kernel has to add up to exactly one, or steps would leave the integrated output slightly off
+		for (int i = 0; i < APU_BLIP_TAPS; i++) { blipKernel[phase][i] = (float)(taps[i] / sum); }
+	}
+	blipKernelReady = true;
+}
+
+// Constructor
+struct NF_APU* NF_initAPU() {
+	struct NF_APU* apu = calloc(1, sizeof(struct NF_APU));
+	if (apu == NULL) {
+		printf("Error: Could not create APU object. Out of memory?\n");
+		return NULL;
+	}
+	if (!blipKernelReady) { buildBlipKernel(); }
+
+	apu->pulse[0].ones_complement = true;
+	apu->noise.shift_register = 1;
+	apu->noise.timer_period = noisePeriodTable[0];
+	apu->dmc.timer_period = dmcRateTable[0];
+	apu->dmc.bits_remaining = 8;
+	apu->dmc.silent = true;
+	apu->dmc.sample_address = 0xC000;
+	apu->dmc.sample_length = 1;
+	apu->next_frame_step = fourStepSequence[0];
+	return apu;
+}
+
+void NF_APU_setOutput(struct NF_APU* apu, struct NF_AudioRing* output, uint32_t sample_rate) {
+	apu->output = output;
+	if (output == NULL || sample_rate == 0) {
+		apu->output = NULL;
+		return;
+	}
+	apu->sample_rate = sample_rate;
+	apu->samples_per_cycle = ((uint64_t)sample_rate << 32) / APU_CPU_CLOCK_NTSC;
+	apu->max_buffer_cycles = ((uint64_t)(APU_BLIP_BUFFER_SIZE - APU_BLIP_TAPS - 1) << 32) / apu->samples_per_cycle;
+	apu->highpass_coefficient = (float)(1.0 - 2 * 3.14159265358979323846 * HIGHPASS_FREQUENCY / sample_rate);
+	apu->buffer_start_cycle = apu->cycle;
+	apu->buffer_start_position = 0;
+	memset(apu->buffer, 0, sizeof(apu->buffer));
+	apu->integrator = 0;
+	apu->highpass_in = 0;
+	apu->highpass_out = 0;
+}
+
+// Add a band-limited step of the given size at a CPU cycle
+static void addDelta(struct NF_APU* apu, uint64_t cycle, float delta) {
+	uint64_t position = (cycle - apu->buffer_start_cycle) * apu->samples_per_cycle + apu->buffer_start_position;
+	uint32_t index = (uint32_t)(position >> 32);
+	if (index >= APU_BLIP_BUFFER_SIZE) { return; }
+	const float* kernel = blipKernel[(position >> (32 - APU_BLIP_PHASE_BITS)) & (APU_BLIP_PHASES - 1)];
+	float* out = apu->buffer + index;
+	for (int i = 0; i < APU_BLIP_TAPS; i++) { out[i] += kernel[i] * delta; }
+}
+
+static void setLevel(struct NF_APU* apu, int* level, int new_level, float weight, uint64_t cycle) {
+	if (new_level == *level) { return; }
+	if (apu->output != NULL) { addDelta(apu, cycle, (float)(new_level - *level) * weight); }
+	*level = new_level;
+}
+
+// Turn every buffered sample before a CPU cycle into output, and send it to the ring
+static void flushSamples(struct NF_APU* apu, uint64_t cycle) {
+	uint64_t end_position = (cycle - apu->buffer_start_cycle) * apu->samples_per_cycle + apu->buffer_start_position;
+	uint32_t count = (uint32_t)(end_position >> 32);
+	if (count > APU_BLIP_BUFFER_SIZE) { count = APU_BLIP_BUFFER_SIZE; }
+
+	float integrator = apu->integrator;
+	float highpass_in = apu->highpass_in;
+	float highpass_out = apu->highpass_out;
+	for (uint32_t i = 0; i < count; i++) {
+		integrator += apu->buffer[i];
+		highpass_out = integrator - highpass_in + apu->highpass_coefficient * highpass_out;
+		highpass_in = integrator;
+		float sample = highpass_out * OUTPUT_GAIN;
+		if (sample > 32767.0f) { sample = 32767.0f; }
+		if (sample < -32768.0f) { sample = -32768.0f; }
+		apu->samples[i] = (int16_t)sample;
+	}
+	apu->integrator = integrator;
+	apu->highpass_in = highpass_in;
+	apu->highpass_out = highpass_out;
+
+	// The tails of the most recent steps hang over the end, and become the start of the next batch
+	memmove(apu->buffer, apu->buffer + count, APU_BLIP_TAPS * sizeof(float));
+	memset(apu->buffer + APU_BLIP_TAPS, 0, count * sizeof(float));
+	apu->buffer_start_cycle = cycle;
+	apu->buffer_start_position = end_position & 0xFFFFFFFF;
+
+	NF_AudioRing_write(apu->output, apu->samples, count);
+}
+
+static void updateIRQ(struct NF_APU* apu) {
+	NF_setIRQLine(apu->bus, NF_IRQ_APU_FRAME, apu->frame_irq);
+	NF_setIRQLine(apu->bus, NF_IRQ_APU_DMC, apu->dmc_irq);
+}
+
+// Pulse
+
+static int sweepTarget(const struct NF_APU_Pulse* p) {
+	int change = p->timer_period >> p->sweep_shift;
+	if (!p->sweep_negate) { return p->timer_period + change; }
+	int target = p->timer_period - change - (p->ones_complement ? 1 : 0);
+	return target < 0 ? 0 : target;
+}
+
+static bool pulseMuted(const struct NF_APU_Pulse* p) {
+	return p->length == 0 || p->timer_period < 8 || sweepTarget(p) > 0x7FF;
+}
+
+static int envelopeVolume(const struct NF_APU_Envelope* e) { return e->constant ? e->period : e->decay; }
+
+static int pulseOutput(const struct NF_APU_Pulse* p) {
+	if (pulseMuted(p) || !dutyTable[p->duty][p->sequence_step]) { return 0; }
+	return envelopeVolume(&p->envelope);
+}
+
+static void runPulse(struct NF_APU* apu, struct NF_APU_Pulse* p, uint64_t end) {
+	if (p->next_tick >= end) { return; }
+	uint64_t period = ((uint64_t)p->timer_period + 1) * 2;
+
+	// A silent channel keeps its sequencer moving, but there is no need to visit every step
+	if (pulseMuted(p) || envelopeVolume(&p->envelope) == 0) {
+		uint64_t ticks = (end - p->next_tick + period - 1) / period;
+		p->sequence_step = (uint8_t)((p->sequence_step + ticks) & 7);
+		p->next_tick += ticks * period;
+		setLevel(apu, &p->level, 0, PULSE_WEIGHT, p->next_tick - period);
+		return;
+	}
+	while (p->next_tick < end) {
+		p->sequence_step = (p->sequence_step + 1) & 7;
+		setLevel(apu, &p->level, pulseOutput(p), PULSE_WEIGHT, p->next_tick);
+		p->next_tick += period;
+	}
+}
+
+// Triangle
+
+static void runTriangle(struct NF_APU* apu, struct NF_APU_Triangle* t, uint64_t end) {
+	if (t->next_tick >= end) { return; }
+	uint64_t period = (uint64_t)t->timer_period + 1;
+
+	// The sequencer stops (holding its level) when either counter is zero. Periods below 2 are ultrasonic, and
+	// games use them to silence the channel, so they are treated the same way to avoid popping
+	if (t->length == 0 || t->linear_counter == 0 || t->timer_period < 2) {
+		t->next_tick += ((end - t->next_tick + period - 1) / period) * period;
+		return;
+	}
+	while (t->next_tick < end) {
+		t->sequence_step = (t->sequence_step + 1) & 31;
+		setLevel(apu, &t->level, triangleTable[t->sequence_step], TRIANGLE_WEIGHT, t->next_tick);
+		t->next_tick += period;
+	}
+}
+
+// Noise
+
+static int noiseOutput(const struct NF_APU_Noise* n) {
+	if (n->length == 0 || (n->shift_register & 1)) { return 0; }
+	return envelopeVolume(&n->envelope);
+}
+
+static void runNoise(struct NF_APU* apu, struct NF_APU_Noise* n, uint64_t end) {
+	int tap = n->mode ? 6 : 1;
+	while (n->next_tick < end) {
+		uint16_t feedback = (n->shift_register ^ (n->shift_register >> tap)) & 1;
+		n->shift_register = (n->shift_register >> 1) | (feedback << 14);
+		setLevel(apu, &n->level, noiseOutput(n), NOISE_WEIGHT, n->next_tick);
+		n->next_tick += n->timer_period;
+	}
+}
+
+// DMC
+
+// Refill the sample buffer from memory if it is empty and there is sample left to play
+static void fetchDMCSample(struct NF_APU* apu) {
+	struct NF_APU_DMC* d = &apu->dmc;
+	if (d->sample_buffer_full || d->bytes_remaining == 0) { return; }
+
+	// Logged as sample data, whatever the CPU was reading for when the DMC took the bus
+	uint8_t log_access = apu->bus->log_access;
+	apu->bus->log_access = NF_CDL_PCM;
+	d->sample_buffer = NF_readMemory(apu->bus, d->current_address);
+	apu->bus->log_access = log_access;
+	d->sample_buffer_full = true;
+	d->current_address = (d->current_address == 0xFFFF) ? 0x8000 : d->current_address + 1;
+	d->bytes_remaining--;
+	if (d->bytes_remaining == 0) {
+		if (d->loop) {
+			d->current_address = d->sample_address;
+			d->bytes_remaining = d->sample_length;
+		}
+		else if (d->irq_enabled) {
+			apu->dmc_irq = true;
+			updateIRQ(apu);
+		}
+	}
+}
+
+static void runDMC(struct NF_APU* apu, struct NF_APU_DMC* d, uint64_t end) {
+	while (d->next_tick < end) {
+		if (!d->silent) {
+			if (d->shift_register & 1) { if (d->output_level <= 125) { d->output_level += 2; } }
+			else { if (d->output_level >= 2) { d->output_level -= 2; } }
+			setLevel(apu, &d->level, d->output_level, DMC_WEIGHT, d->next_tick);
+		}
+		d->shift_register >>= 1;
+		if (--d->bits_remaining == 0) {
+			d->bits_remaining = 8;
+			d->silent = !d->sample_buffer_full;
+			if (d->sample_buffer_full) {
+				d->shift_register = d->sample_buffer;
+				d->sample_buffer_full = false;
+				fetchDMCSample(apu);
+			}
+		}
+		d->next_tick += d->timer_period;
+	}
+}
+
+// Frame counter
+
+static void clockEnvelope(struct NF_APU_Envelope* e) {
+	if (e->start) {
+		e->start = false;
+		e->decay = 15;
+		e->divider = e->period;
+	}
+	else if (e->divider == 0) {
+		e->divider = e->period;
+		if (e->decay > 0) { e->decay--; }
+		else if (e->loop) { e->decay = 15; }
+	}
+	else { e->divider--; }
+}
+
+static void clockQuarterFrame(struct NF_APU* apu) {
+	clockEnvelope(&apu->pulse[0].envelope);
+	clockEnvelope(&apu->pulse[1].envelope);
+	clockEnvelope(&apu->noise.envelope);
+
+	struct NF_APU_Triangle* t = &apu->triangle;
+	if (t->linear_reload) { t->linear_counter = t->linear_reload_value; }
+	else if (t->linear_counter > 0) { t->linear_counter--; }
+	if (!t->control) { t->linear_reload = false; }
+}
+
+static void clockHalfFrame(struct NF_APU* apu) {
+	for (int i = 0; i < 2; i++) {
+		struct NF_APU_Pulse* p = &apu->pulse[i];
+		if (p->length > 0 && !p->envelope.loop) { p->length--; }
+
+		int target = sweepTarget(p);
+		if (p->sweep_divider == 0 && p->sweep_enabled && p->sweep_shift > 0 && p->timer_period >= 8 && target <= 0x7FF) {
+			p->timer_period = (uint16_t)target;
+		}
+		if (p->sweep_divider == 0 || p->sweep_reload) {
+			p->sweep_divider = p->sweep_period;
+			p->sweep_reload = false;
+		}
+		else { p->sweep_divider--; }
+	}
+	if (apu->triangle.length > 0 && !apu->triangle.control) { apu->triangle.length--; }
+	if (apu->noise.length > 0 && !apu->noise.envelope.loop) { apu->noise.length--; }
+}
+
+// Envelopes, length counters and register writes change levels outside of the timers
+static void updateLevels(struct NF_APU* apu) {
+	setLevel(apu, &apu->pulse[0].level, pulseOutput(&apu->pulse[0]), PULSE_WEIGHT, apu->cycle);
+	setLevel(apu, &apu->pulse[1].level, pulseOutput(&apu->pulse[1]), PULSE_WEIGHT, apu->cycle);
+	setLevel(apu, &apu->noise.level, noiseOutput(&apu->noise), NOISE_WEIGHT, apu->cycle);
+	setLevel(apu, &apu->dmc.level, apu->dmc.output_level, DMC_WEIGHT, apu->cycle);
+}
+
+static void clockFrameCounter(struct NF_APU* apu) {
+	const uint32_t* sequence = apu->five_step_mode ? fiveStepSequence : fourStepSequence;
+	uint8_t steps = apu->five_step_mode ? 5 : 4;
+	uint8_t step = apu->frame_step;
+
+	if (apu->five_step_mode) {
+		if (step != 3) { clockQuarterFrame(apu); }
+		if (step == 1 || step == 4) { clockHalfFrame(apu); }
+	}
+	else {
+		clockQuarterFrame(apu);
+		if (step == 1 || step == 3) { clockHalfFrame(apu); }
+		if (step == 3 && !apu->irq_inhibit) {
+			apu->frame_irq = true;
+			updateIRQ(apu);
+		}
+	}
+	updateLevels(apu);
+
+	if (++step == steps) {
+		step = 0;
+		apu->frame_start += sequence[steps];
+	}
+	apu->frame_step = step;
+	apu->next_frame_step = apu->frame_start + sequence[step];
+}
+
+// Run the channels up to a CPU cycle, stopping at every frame counter step on the way
+static void catchUp(struct NF_APU* apu, uint64_t target) {
+	while (apu->cycle < target || apu->cycle == apu->next_frame_step) {
+		uint64_t end = target;
+		if (end > apu->next_frame_step) { end = apu->next_frame_step; }
+		bool buffer_full = apu->output != NULL && end - apu->buffer_start_cycle >= apu->max_buffer_cycles;
+		if (buffer_full) { end = apu->buffer_start_cycle + apu->max_buffer_cycles; }
+
+		runPulse(apu, &apu->pulse[0], end);
+		runPulse(apu, &apu->pulse[1], end);
+		runTriangle(apu, &apu->triangle, end);
+		runNoise(apu, &apu->noise, end);
+		runDMC(apu, &apu->dmc, end);
+		apu->cycle = end;
+
+		if (apu->cycle == apu->next_frame_step) { clockFrameCounter(apu); }
+		if (buffer_full) { flushSamples(apu, apu->cycle); }
+	}
+}
+
+// Ask the bus to wake the APU up at the next point where it might raise an IRQ: the next frame counter step, or the
+// moment the DMC reads the last byte of its sample
+static void scheduleNextEvent(struct NF_APU* apu) {
+	uint64_t next = apu->next_frame_step;
+	struct NF_APU_DMC* d = &apu->dmc;
+	if (d->irq_enabled && !d->loop && d->bytes_remaining > 0 && d->sample_buffer_full) {
+		uint64_t next_fetch = d->next_tick + (uint64_t)(d->bits_remaining - 1) * d->timer_period;
+		uint64_t last_fetch = next_fetch + (uint64_t)(d->bytes_remaining - 1) * 8 * d->timer_period;
+		if (last_fetch + 1 < next) { next = last_fetch + 1; }
+	}
+	NF_scheduleEvent(apu->bus, NF_EVENT_APU, next);
+}
+
+void NF_APU_runUntil(struct NF_APU* apu, uint64_t cpu_cycle) {
+	catchUp(apu, cpu_cycle);
+	scheduleNextEvent(apu);
+}
+
+void NF_APU_runEvent(struct NF_APU* apu, uint64_t cpu_cycle) {
+	NF_APU_runUntil(apu, cpu_cycle);
+}
+
+void NF_APU_endFrame(struct NF_APU* apu, uint64_t cpu_cycle) {
+	catchUp(apu, cpu_cycle);
+	if (apu->output != NULL) { flushSamples(apu, apu->cycle); }
+	scheduleNextEvent(apu);
+}
+
+static void writeEnvelope(struct NF_APU_Envelope* e, uint8_t value) {
+	e->loop = (value & 0x20) != 0;
+	e->constant = (value & 0x10) != 0;
+	e->period = value & 0x0F;
+}
+
+void NF_APU_writeRegister(struct NF_APU* apu, uint16_t address, uint8_t value, uint64_t cpu_cycle) {
+	catchUp(apu, cpu_cycle);
+
+	if (address <= 0x4007) {
+		struct NF_APU_Pulse* p = &apu->pulse[(address >> 2) & 1];
+		switch (address & 3) {
+		case 0:
+			p->duty = value >> 6;
+			writeEnvelope(&p->envelope, value);
+			break;
+		case 1:
+			p->sweep_enabled = (value & 0x80) != 0;
+			p->sweep_period = (value >> 4) & 0x07;
+			p->sweep_negate = (value & 0x08) != 0;
+			p->sweep_shift = value & 0x07;
+			p->sweep_reload = true;
+			break;
+		case 2:
+			p->timer_period = (p->timer_period & 0x700) | value;
+			break;
+		case 3:
+			p->timer_period = (p->timer_period & 0x0FF) | ((value & 0x07) << 8);
+			if (apu->channel_enables & (1 << ((address >> 2) & 1))) { p->length = lengthTable[value >> 3]; }
+			p->sequence_step = 0;
+			p->envelope.start = true;
+			break;
+		}
+	}
+	else {
+		switch (address) {
+		case 0x4008:
+			apu->triangle.control = (value & 0x80) != 0;
+			apu->triangle.linear_reload_value = value & 0x7F;
+			break;
+		case 0x400A:
+			apu->triangle.timer_period = (apu->triangle.timer_period & 0x700) | value;
+			break;
+		case 0x400B:
+			apu->triangle.timer_period = (apu->triangle.timer_period & 0x0FF) | ((value & 0x07) << 8);
+			if (apu->channel_enables & 0x04) { apu->triangle.length = lengthTable[value >> 3]; }
+			apu->triangle.linear_reload = true;
+			break;
+		case 0x400C:
+			writeEnvelope(&apu->noise.envelope, value);
+			break;
+		case 0x400E:
+			apu->noise.mode = (value & 0x80) != 0;
+			apu->noise.timer_period = noisePeriodTable[value & 0x0F];
+			break;
+		case 0x400F:
+			if (apu->channel_enables & 0x08) { apu->noise.length = lengthTable[value >> 3]; }
+			apu->noise.envelope.start = true;
+			break;
+		case 0x4010:
+			apu->dmc.irq_enabled = (value & 0x80) != 0;
+			apu->dmc.loop = (value & 0x40) != 0;
+			apu->dmc.timer_period = dmcRateTable[value & 0x0F];
+			if (!apu->dmc.irq_enabled) { apu->dmc_irq = false; }
+			break;
+		case 0x4011:
+			apu->dmc.output_level = value & 0x7F;
+			break;
+		case 0x4012:
+			apu->dmc.sample_address = 0xC000 | (value << 6);
+			break;
+		case 0x4013:
+			apu->dmc.sample_length = (value << 4) + 1;
+			break;
+		case 0x4015:
+			apu->channel_enables = value;
+			if (!(value & 0x01)) { apu->pulse[0].length = 0; }
+			if (!(value & 0x02)) { apu->pulse[1].length = 0; }
+			if (!(value & 0x04)) { apu->triangle.length = 0; }
+			if (!(value & 0x08)) { apu->noise.length = 0; }
+			if (!(value & 0x10)) { apu->dmc.bytes_remaining = 0; }
+			else if (apu->dmc.bytes_remaining == 0) {
+				apu->dmc.current_address = apu->dmc.sample_address;
+				apu->dmc.bytes_remaining = apu->dmc.sample_length;
+			}
+			apu->dmc_irq = false;
+			fetchDMCSample(apu);
+			break;
+		case 0x4017:
+			// The sequence restarts 3 or 4 CPU cycles after the write, depending on where in the APU cycle it lands.
+			// Five step mode also clocks everything once straight away
+			apu->five_step_mode = (value & 0x80) != 0;
+			apu->irq_inhibit = (value & 0x40) != 0;
+			if (apu->irq_inhibit) { apu->frame_irq = false; }
+			apu->frame_step = 0;
+			apu->frame_start = cpu_cycle + ((cpu_cycle & 1) ? 4 : 3);
+			apu->next_frame_step = apu->frame_start + fourStepSequence[0];
+			if (apu->five_step_mode) {
+				clockQuarterFrame(apu);
+				clockHalfFrame(apu);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	updateLevels(apu);
+	updateIRQ(apu);
+	scheduleNextEvent(apu);
+}
+
+uint8_t NF_APU_peekStatus(const struct NF_APU* apu) {
+	uint8_t status = 0;
+	if (apu->pulse[0].length > 0) { status |= 0x01; }
+	if (apu->pulse[1].length > 0) { status |= 0x02; }
+	if (apu->triangle.length > 0) { status |= 0x04; }
+	if (apu->noise.length > 0) { status |= 0x08; }
+	if (apu->dmc.bytes_remaining > 0) { status |= 0x10; }
+	if (apu->frame_irq) { status |= 0x40; }
+	if (apu->dmc_irq) { status |= 0x80; }
+	return status;
+}
+
+uint8_t NF_APU_readStatus(struct NF_APU* apu, uint64_t cpu_cycle) {
+	catchUp(apu, cpu_cycle);
+	uint8_t status = NF_APU_peekStatus(apu);
+
+	// Reading the status acknowledges the frame interrupt
+	apu->frame_irq = false;
+	updateIRQ(apu);
+	scheduleNextEvent(apu);
+	return status;
+}
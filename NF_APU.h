@@ -0,0 +1,159 @@
+#ifndef NF_H_APU
+#define NF_H_APU
+#include "NF_AudioRing.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// The APU lives at $4000-$4017 in the CPU address space:
+//
+// $4000-$4003: Pulse 1 (duty/envelope, sweep, timer low, length/timer high)
+// $4004-$4007: Pulse 2
+// $4008-$400B: Triangle (linear counter, unused, timer low, length/timer high)
+// $400C-$400F: Noise (envelope, unused, mode/period, length)
+// $4010-$4013: DMC (flags/rate, direct load, sample address, sample length)
+// $4015: Channel enables (write), channel and IRQ status (read)
+// $4017: Frame counter mode and IRQ inhibit (write)
+//
+// Rather than being ticked along with the CPU, the APU is run in catch-up style: it remembers the CPU cycle it
+// has been emulated up to, and only runs forward when something needs its state (a register access, an event from
+// the bus scheduler, or the end of a frame). Channels jump straight from one timer expiry to the next.
+//
+// Output is band-limited. Every time a channel's level changes, a band-limited step (a windowed sinc kernel picked
+// for the sub-sample position of the change) is added to a buffer at the host sample rate, and the buffer is
+// integrated when samples are read out. That costs a few multiply-adds per level change, rather than per CPU cycle.
+
+#define APU_CPU_CLOCK_NTSC 1789773
+#define APU_BLIP_TAPS 16					// Length of the band-limited step kernel, in output samples
+#define APU_BLIP_PHASE_BITS 6
+#define APU_BLIP_PHASES (1 << APU_BLIP_PHASE_BITS)	// Number of sub-sample positions the kernel is computed for
+#define APU_BLIP_BUFFER_SIZE 4096			// Output samples that can pile up between two reads
+
+struct NF_APU_Envelope {
+	bool start;
+	bool loop;								// Also the length counter halt flag
+	bool constant;
+	uint8_t period;							// Also the constant volume
+	uint8_t divider;
+	uint8_t decay;
+};
+
+struct NF_APU_Pulse {
+	uint8_t duty;
+	uint8_t sequence_step;
+	uint16_t timer_period;					// The 11 bit period from the registers
+	uint64_t next_tick;						// CPU cycle at which the sequencer next moves
+	uint8_t length;
+	struct NF_APU_Envelope envelope;
+	bool sweep_enabled;
+	bool sweep_negate;
+	bool sweep_reload;
+	uint8_t sweep_period;
+	uint8_t sweep_shift;
+	uint8_t sweep_divider;
+	bool ones_complement;					// Pulse 1 negates with ones' complement, pulse 2 with two's complement
+	int level;								// Level last sent to the mixer
+};
+
+struct NF_APU_Triangle {
+	uint8_t sequence_step;
+	uint16_t timer_period;
+	uint64_t next_tick;
+	uint8_t length;
+	bool control;							// Also the length counter halt flag
+	uint8_t linear_reload_value;
+	uint8_t linear_counter;
+	bool linear_reload;
+	int level;
+};
+
+struct NF_APU_Noise {
+	bool mode;
+	uint16_t shift_register;
+	uint16_t timer_period;					// In CPU cycles
+	uint64_t next_tick;
+	uint8_t length;
+	struct NF_APU_Envelope envelope;
+	int level;
+};
+
+struct NF_APU_DMC {
+	bool irq_enabled;
+	bool loop;
+	uint16_t timer_period;					// In CPU cycles
+	uint64_t next_tick;
+	uint8_t output_level;
+	uint16_t sample_address;
+	uint16_t sample_length;
+	uint16_t current_address;
+	uint16_t bytes_remaining;
+	uint8_t sample_buffer;
+	bool sample_buffer_full;
+	uint8_t shift_register;
+	uint8_t bits_remaining;
+	bool silent;
+	int level;
+};
+
+struct NF_APU {
+	struct NES_Console* bus;
+
+	struct NF_APU_Pulse pulse[2];
+	struct NF_APU_Triangle triangle;
+	struct NF_APU_Noise noise;
+	struct NF_APU_DMC dmc;
+	uint8_t channel_enables;				// Last value written to $4015
+
+	// Frame counter
+	bool five_step_mode;
+	bool irq_inhibit;
+	bool frame_irq;
+	bool dmc_irq;
+	uint8_t frame_step;						// Index of the next step in the sequence
+	uint64_t frame_start;					// CPU cycle at which the current sequence started
+	uint64_t next_frame_step;				// CPU cycle of the next step
+
+	uint64_t cycle;							// The APU has been run up to (but not including) this CPU cycle
+
+	// Everything above this point is emulation state, which is what savestates hold. Everything below is output, which
+	// is restarted after a savestate is loaded
+
+	// Band-limited synthesis. Positions are in output samples, as 32.32 fixed point
+	struct NF_AudioRing* output;			// NULL if nobody is listening, in which case no samples are made
+	uint32_t sample_rate;
+	uint64_t samples_per_cycle;				// 32.32 fixed point
+	uint64_t max_buffer_cycles;				// CPU cycles that fit in the buffer before it has to be read out
+	uint64_t buffer_start_cycle;			// CPU cycle that lines up with buffer_start_position
+	uint64_t buffer_start_position;			// Fraction of a sample between the start of the buffer and buffer_start_cycle
+	float buffer[APU_BLIP_BUFFER_SIZE + APU_BLIP_TAPS];
+	float integrator;
+	float highpass_coefficient;
+	float highpass_in;
+	float highpass_out;
+	int16_t samples[APU_BLIP_BUFFER_SIZE];	// Scratch space for samples on their way to the ring
+};
+
+// Constructor
+struct NF_APU* NF_initAPU();
+
+// Send the APU's output into a ring at the given sample rate. Pass NULL to stop making samples. Calling it again with
+// the same ring restarts synthesis from the current cycle, which is what is needed after loading a savestate
+void NF_APU_setOutput(struct NF_APU* apu, struct NF_AudioRing* output, uint32_t sample_rate);
+
+// Emulate the APU up to (but not including) a CPU cycle
+void NF_APU_runUntil(struct NF_APU* apu, uint64_t cpu_cycle);
+
+// Register access from the CPU, at the given CPU cycle
+void NF_APU_writeRegister(struct NF_APU* apu, uint16_t address, uint8_t value, uint64_t cpu_cycle);
+uint8_t NF_APU_readStatus(struct NF_APU* apu, uint64_t cpu_cycle);
+
+// The status a read of $4015 would return, without acknowledging the frame interrupt. The APU is not run up to the
+// present for this, so the status is as of the last time it ran
+uint8_t NF_APU_peekStatus(const struct NF_APU* apu);
+
+// Called by the bus scheduler when the APU's event comes due, which is whenever it may need to raise an IRQ
+void NF_APU_runEvent(struct NF_APU* apu, uint64_t cpu_cycle);
+
+// Run up to a CPU cycle and send every finished sample to the output ring. Called once per frame
+void NF_APU_endFrame(struct NF_APU* apu, uint64_t cpu_cycle);
+
+#endif
@@ -0,0 +1,67 @@
+#include "NF_AudioRing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct NF_AudioRing* NF_AudioRing_create(uint32_t capacity) {
+	struct NF_AudioRing* ring = calloc(1, sizeof(struct NF_AudioRing));
+	if (ring == NULL) {
+		printf("Error: Could not create audio ring. Out of memory?\n");
+		return NULL;
+	}
+	ring->capacity = 1;
+	while (ring->capacity < capacity) { ring->capacity <<= 1; }
+	ring->mask = ring->capacity - 1;
+	ring->samples = calloc(ring->capacity, sizeof(int16_t));
+	if (ring->samples == NULL) {
+		printf("Error: Could not create audio ring buffer. Out of memory?\n");
+		free(ring);
+		return NULL;
+	}
+	return ring;
+}
+
+void NF_AudioRing_free(struct NF_AudioRing* ring) {
+	if (ring == NULL) { return; }
+	free(ring->samples);
+	free(ring);
+}
+
+uint32_t NF_AudioRing_write(struct NF_AudioRing* ring, const int16_t* samples, uint32_t count) {
+	uint32_t write = ring->write_index;
+	uint32_t used = write - NF_atomicLoadAcquire(&ring->read_index);
+	uint32_t space = ring->capacity - used;
+	if (count > space) {
+		ring->dropped += count - space;
+		count = space;
+	}
+
+	// The free space may wrap around the end of the buffer, in which case it is written in two pieces
+	uint32_t start = write & ring->mask;
+	uint32_t first = ring->capacity - start;
+	if (first > count) { first = count; }
+	memcpy(ring->samples + start, samples, first * sizeof(int16_t));
+	memcpy(ring->samples, samples + first, (count - first) * sizeof(int16_t));
+
+	NF_atomicStoreRelease(&ring->write_index, write + count);
+	return count;
+}
+
+uint32_t NF_AudioRing_read(struct NF_AudioRing* ring, int16_t* samples, uint32_t count) {
+	uint32_t read = ring->read_index;
+	uint32_t available = NF_atomicLoadAcquire(&ring->write_index) - read;
+	if (count > available) { count = available; }
+
+	uint32_t start = read & ring->mask;
+	uint32_t first = ring->capacity - start;
+	if (first > count) { first = count; }
+	memcpy(samples, ring->samples + start, first * sizeof(int16_t));
+	memcpy(samples + first, ring->samples, (count - first) * sizeof(int16_t));
+
+	NF_atomicStoreRelease(&ring->read_index, read + count);
+	return count;
+}
+
+uint32_t NF_AudioRing_available(struct NF_AudioRing* ring) {
+	return NF_atomicLoadAcquire(&ring->write_index) - NF_atomicLoadAcquire(&ring->read_index);
+}
@@ -0,0 +1,39 @@
+#ifndef NF_H_AUDIORING
+#define NF_H_AUDIORING
+#include "NF_Platform.h"
+#include <stdint.h>
+
+// A single producer, single consumer ring of audio samples. The emulator writes into it and the audio callback
+// (which runs on a thread of its own) reads from it, and neither side ever waits on the other. Each index is only
+// written by one side, and they sit on separate cache lines so the two threads do not fight over them.
+
+struct NF_AudioRing {
+	int16_t* samples;
+	uint32_t capacity;					// Always a power of two
+	uint32_t mask;
+
+	volatile uint32_t write_index;		// Only written by the producer. Counts up forever, wrapping at 2^32
+	uint8_t pad0[NF_CACHE_LINE_SIZE - sizeof(uint32_t)];
+	volatile uint32_t read_index;		// Only written by the consumer
+	uint8_t pad1[NF_CACHE_LINE_SIZE - sizeof(uint32_t)];
+
+	// Statistics, only written by the producer
+	volatile uint32_t dropped;			// Samples the producer threw away because the ring was full
+};
+
+// Create a ring holding at least capacity samples
+struct NF_AudioRing* NF_AudioRing_create(uint32_t capacity);
+void NF_AudioRing_free(struct NF_AudioRing* ring);
+
+// Producer side. Writes as many samples as fit and returns how many that was
+uint32_t NF_AudioRing_write(struct NF_AudioRing* ring, const int16_t* samples, uint32_t count);
+
+// Consumer side. Reads up to count samples and returns how many were read. Reading fewer than asked for is not an
+// underrun in itself, since consumers often ask for more than they need. An underrun is when the consumer has to play
+// something the emulator did not make, so the consumer counts them where it fills the gap (see CF_AudioStats)
+uint32_t NF_AudioRing_read(struct NF_AudioRing* ring, int16_t* samples, uint32_t count);
+
+// Number of samples waiting to be read. Either side may call this
+uint32_t NF_AudioRing_available(struct NF_AudioRing* ring);
+
+#endif
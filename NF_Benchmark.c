@@ -0,0 +1,471 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_Benchmark.h"
+#include "NF_6502.h"
+#include "NF_Bus.h"
+#include "NF_Cartridge.h"
+#include "NF_Compositor.h"
+#include "NF_Frame.h"
+#include "NF_Hash.h"
+#include "NF_Movie.h"
+#include "NF_PPU.h"
+#include "NF_Platform.h"
+#include "NF_RomCatalog.h"
+#include "NF_ThreadPool.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sizing a benchmark stops growing the iteration count here, however quick the work is
+#define MAX_ITERATIONS (1ULL << 40)
+
+// Layout of the made up cartridge's 16KB of PRG ROM, seen at both $8000 and $C000. The instruction being timed fills
+// the start of it over and over, followed by a jump back to the start
+#define BENCH_PRG_SIZE 0x4000
+#define BENCH_CHR_SIZE 0x2000
+#define BENCH_CODE_END 0x3FE0
+#define BENCH_SUBROUTINE 0x3FF0			// An RTS, at $BFF0
+#define BENCH_INTERRUPT 0x3FF1			// An RTI, which the NMI and IRQ vectors point at
+#define BENCH_VECTORS 0x3FFA
+
+// Input of the corpus benchmark for titles without a movie: nothing while the game starts up, then Start for a few
+// frames every ten seconds to get past title screens and menus, with a direction and A or B that change every quarter
+// second in between
+#define SCRIPT_FIRST_FRAME 120
+#define SCRIPT_START_INTERVAL 600
+#define SCRIPT_START_FRAMES 6
+#define SCRIPT_STEP_FRAMES 15
+
+// The instructions timed by the CPU benchmarks. Index registers are 1, every zero page pointer points at $0202,
+// and Z is clear, so branches to the next instruction with BNE are always taken and with BEQ never are
+struct CPUPattern {
+	const char* name;
+	uint8_t bytes[4];
+	int length;
+};
+
+static const struct CPUPattern cpuPatterns[] = {
+	{ "implied", { 0xE8 }, 1 },							// INX
+	{ "accumulator", { 0x0A }, 1 },						// ASL A
+	{ "immediate", { 0x69, 0x01 }, 2 },					// ADC #$01
+	{ "zero_page", { 0xA5, 0x10 }, 2 },					// LDA $10
+	{ "zero_page_x", { 0xB5, 0x10 }, 2 },				// LDA $10,X
+	{ "absolute", { 0xAD, 0x00, 0x02 }, 3 },			// LDA $0200
+	{ "absolute_x", { 0xBD, 0x00, 0x02 }, 3 },			// LDA $0200,X
+	{ "indirect_x", { 0xA1, 0x10 }, 2 },				// LDA ($10,X)
+	{ "indirect_y", { 0xB1, 0x20 }, 2 },				// LDA ($20),Y
+	{ "store", { 0x8D, 0x00, 0x03 }, 3 },				// STA $0300
+	{ "read_modify_write", { 0xEE, 0x00, 0x03 }, 3 },	// INC $0300
+	{ "branch_taken", { 0xD0, 0x00 }, 2 },				// BNE to the next instruction
+	{ "branch_not_taken", { 0xF0, 0x00 }, 2 },			// BEQ to the next instruction
+	{ "stack", { 0x48, 0x68 }, 2 },						// PHA, PLA
+	{ "jsr_rts", { 0x20, 0xF0, 0xBF }, 3 },				// JSR to an RTS
+};
+
+// Regions of the address space timed by the memory benchmarks, as a base and a mask of the addresses used from it.
+// Writes to the PPU registers go to $2005-$2008 ($2000), which leaves out PPUSTATUS, since writing it is an error
+struct MemoryRegion {
+	const char* name;
+	uint16_t read_base;
+	uint16_t read_mask;
+	uint16_t write_base;
+	uint16_t write_mask;
+};
+
+static const struct MemoryRegion memoryRegions[] = {
+	{ "ram", 0x0000, 0x07FF, 0x0000, 0x07FF },
+	{ "ram_mirror", 0x0800, 0x0FFF, 0x0800, 0x0FFF },
+	{ "ppu_registers", 0x2000, 0x0007, 0x2005, 0x0003 },
+	{ "prg_ram", 0x6000, 0x1FFF, 0x6000, 0x1FFF },
+	{ "prg_rom", 0x8000, 0x7FFF, 0x8000, 0x7FFF },		// Writes here go to the mapper
+};
+
+struct Bench {
+	uint8_t* rom;
+	struct Cartridge* cart;
+	struct NES_Console* console;
+	struct NF_Frame* frame;
+	uint16_t base;
+	uint16_t mask;
+	uint8_t sink;						// Keeps reads from being optimized away
+};
+
+static void closeBench(struct Bench* bench) {
+	NF_freeConsole(bench->console);
+	NF_freeCartridge(bench->cart);
+	free(bench->rom);
+	free(bench->frame);
+	memset(bench, 0, sizeof(*bench));
+}
+
+static bool openBench(struct Bench* bench, const struct CPUPattern* pattern) {
+	memset(bench, 0, sizeof(*bench));
+	size_t size = INES_HEADER_SIZE + BENCH_PRG_SIZE + BENCH_CHR_SIZE;
+	bench->rom = calloc(1, size);
+	if (bench->rom == NULL) {
+		printf("Error: Could not allocate benchmark ROM. Out of memory?\n");
+		return false;
+	}
+	memcpy(bench->rom, "NES\x1A", 4);
+	bench->rom[4] = BENCH_PRG_SIZE / 0x4000;
+	bench->rom[5] = BENCH_CHR_SIZE / 0x2000;
+	uint8_t* prg = bench->rom + INES_HEADER_SIZE;
+	int offset = 0;
+	for (; pattern != NULL && offset + pattern->length <= BENCH_CODE_END; offset += pattern->length) { memcpy(prg + offset, pattern->bytes, pattern->length); }
+	const uint8_t jump[3] = { 0x4C, 0x00, 0x80 };		// JMP $8000
+	memcpy(prg + offset, jump, sizeof(jump));
+	prg[BENCH_SUBROUTINE] = 0x60;
+	prg[BENCH_INTERRUPT] = 0x40;
+	const uint8_t vectors[6] = { 0xF1, 0xBF, 0x00, 0x80, 0xF1, 0xBF };
+	memcpy(prg + BENCH_VECTORS, vectors, sizeof(vectors));
+
+	bench->cart = NF_createCartridgeFromBuffer(bench->rom, size);
+	bench->console = (bench->cart != NULL) ? NF_initConsole() : NULL;
+	if (bench->console == NULL || NF_insertCartridge(bench->console, bench->cart) != 0) {
+		closeBench(bench);
+		return false;
+	}
+	struct Processor* cpu = bench->console->ConnectedProcessor;
+	cpu->X = 1;
+	cpu->Y = 1;
+	cpu->SP = 0xFD;
+	cpu->P = FLAG_U | FLAG_I;
+	memset(bench->console->Memory, 0x02, 0x100);
+	return true;
+}
+
+static void runInstructions(void* context, uint64_t iterations) {
+	struct Processor* cpu = ((struct Bench*)context)->console->ConnectedProcessor;
+	for (uint64_t i = 0; i < iterations; i++) {
+		do { NF_6502_tickClock(cpu); } while (cpu->cycles != 0);
+	}
+}
+
+static void readMemory(void* context, uint64_t iterations) {
+	struct Bench* bench = (struct Bench*)context;
+	uint8_t sum = 0;
+	for (uint64_t i = 0; i < iterations; i++) { sum += NF_readMemory(bench->console, (uint16_t)(bench->base + (i & bench->mask))); }
+	bench->sink = sum;
+}
+
+static void writeMemory(void* context, uint64_t iterations) {
+	struct Bench* bench = (struct Bench*)context;
+	for (uint64_t i = 0; i < iterations; i++) { NF_writeMemory(bench->console, (uint16_t)(bench->base + (i & bench->mask)), (uint8_t)i); }
+}
+
+static void tickPPU(void* context, uint64_t iterations) {
+	struct PictureProcessingUnit* ppu = ((struct Bench*)context)->console->ConnectedPPU;
+	for (uint64_t i = 0; i < iterations; i++) { NF_PPU_tickClock(ppu); }
+}
+
+static void runFrames(void* context, uint64_t iterations) {
+	struct NES_Console* console = ((struct Bench*)context)->console;
+	for (uint64_t i = 0; i < iterations; i++) { NF_runFrame(console); }
+}
+
+static double timeRun(NF_BenchmarkFunction function, void* context, uint64_t iterations) {
+	uint64_t start = NF_getTicks();
+	function(context, iterations);
+	return (double)(NF_getTicks() - start) * 1e9 / (double)NF_getTickFrequency();
+}
+
+static int compareDoubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+void NF_Benchmark_measure(const char* name, const char* unit, NF_BenchmarkFunction function, void* context, int sample_count,
+	struct NF_BenchmarkResult* result) {
+	memset(result, 0, sizeof(*result));
+	snprintf(result->name, sizeof(result->name), "%s", name);
+	result->unit = unit;
+	if (sample_count < 1) { sample_count = 1; }
+	if (sample_count > NF_BENCHMARK_MAX_SAMPLES) { sample_count = NF_BENCHMARK_MAX_SAMPLES; }
+
+	// Grow the iteration count by how far the last try was from a sample's time, until it takes that long
+	double target = NF_BENCHMARK_SAMPLE_MS * 1e6;
+	uint64_t iterations = 1;
+	while (iterations < MAX_ITERATIONS) {
+		double ns = timeRun(function, context, iterations);
+		if (ns >= target) { break; }
+		double scale = (ns > 0) ? target * 1.2 / ns : 100.0;
+		if (scale > 100.0) { scale = 100.0; }
+		if (scale < 2.0) { scale = 2.0; }
+		iterations = (uint64_t)((double)iterations * scale);
+	}
+	function(context, iterations);
+
+	double sum = 0.0;
+	for (int i = 0; i < sample_count; i++) {
+		result->samples[i] = timeRun(function, context, iterations) / (double)iterations;
+		sum += result->samples[i];
+	}
+	result->iterations = iterations;
+	result->sample_count = sample_count;
+	result->mean = sum / sample_count;
+
+	double sorted[NF_BENCHMARK_MAX_SAMPLES];
+	memcpy(sorted, result->samples, sample_count * sizeof(double));
+	qsort(sorted, sample_count, sizeof(double), compareDoubles);
+	result->min = sorted[0];
+	result->median = (sample_count & 1) ? sorted[sample_count / 2] : (sorted[sample_count / 2 - 1] + sorted[sample_count / 2]) / 2.0;
+	double squares = 0.0;
+	for (int i = 0; i < sample_count; i++) { squares += (result->samples[i] - result->mean) * (result->samples[i] - result->mean); }
+	result->stddev = (sample_count > 1) ? sqrt(squares / (sample_count - 1)) : 0.0;
+
+	printf("%-36s %12.2f ns/%-12s +-%5.1f%%  (%d samples of %llu)\n", result->name, result->median, unit,
+		result->mean > 0 ? result->stddev * 100.0 / result->mean : 0.0, sample_count, (unsigned long long)iterations);
+}
+
+static void writeJSONString(FILE* file, const char* text) {
+	fputc('"', file);
+	for (; *text != '\0'; text++) {
+		unsigned char c = (unsigned char)*text;
+		if (c == '"' || c == '\\') { fprintf(file, "\\%c", c); }
+		else if (c < 0x20) { fprintf(file, "\\u%04x", c); }
+		else { fputc(c, file); }
+	}
+	fputc('"', file);
+}
+
+static bool writeJSON(FILE* file, const struct NF_BenchmarkResult* results, int count, int sample_count) {
+	fprintf(file, "{\n  \"processors\": %d,\n  \"samples\": %d,\n  \"benchmarks\": [\n", NF_getProcessorCount(), sample_count);
+	for (int i = 0; i < count; i++) {
+		const struct NF_BenchmarkResult* result = &results[i];
+		fprintf(file, "    { \"name\": ");
+		writeJSONString(file, result->name);
+		fprintf(file, ", \"unit\": ");
+		writeJSONString(file, result->unit);
+		fprintf(file, ", \"iterations\": %llu, \"mean_ns\": %.4f, \"median_ns\": %.4f, \"min_ns\": %.4f, \"stddev_ns\": %.4f, \"samples_ns\": [",
+			(unsigned long long)result->iterations, result->mean, result->median, result->min, result->stddev);
+		for (int j = 0; j < result->sample_count; j++) { fprintf(file, "%s%.4f", (j > 0) ? ", " : "", result->samples[j]); }
+		fprintf(file, "] }%s\n", (i + 1 < count) ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	return !ferror(file);
+}
+
+bool NF_Benchmark_runSuite(const char* const* rom_paths, int rom_count, int sample_count, FILE* json) {
+	if (sample_count < 1) { sample_count = 1; }
+	if (sample_count > NF_BENCHMARK_MAX_SAMPLES) { sample_count = NF_BENCHMARK_MAX_SAMPLES; }
+
+	// Timings of frames are only worth having if the SIMD code behind them draws the same lines as the plain code
+	if (!NF_checkCompositor()) { return false; }
+
+	int pattern_count = (int)(sizeof(cpuPatterns) / sizeof(cpuPatterns[0]));
+	int region_count = (int)(sizeof(memoryRegions) / sizeof(memoryRegions[0]));
+	int capacity = pattern_count + region_count * 2 + 2 + rom_count;
+	struct NF_BenchmarkResult* results = calloc(capacity, sizeof(struct NF_BenchmarkResult));
+	if (results == NULL) {
+		printf("Error: Could not allocate benchmark results. Out of memory?\n");
+		return false;
+	}
+	int count = 0;
+	bool ok = true;
+	char name[96];
+	struct Bench bench;
+
+	for (int i = 0; ok && i < pattern_count; i++) {
+		ok = openBench(&bench, &cpuPatterns[i]);
+		if (!ok) { break; }
+		snprintf(name, sizeof(name), "cpu/%s", cpuPatterns[i].name);
+		NF_Benchmark_measure(name, "instruction", runInstructions, &bench, sample_count, &results[count++]);
+		closeBench(&bench);
+	}
+
+	for (int i = 0; ok && i < region_count; i++) {
+		ok = openBench(&bench, NULL);
+		if (!ok) { break; }
+		bench.base = memoryRegions[i].read_base;
+		bench.mask = memoryRegions[i].read_mask;
+		snprintf(name, sizeof(name), "read/%s", memoryRegions[i].name);
+		NF_Benchmark_measure(name, "read", readMemory, &bench, sample_count, &results[count++]);
+		bench.base = memoryRegions[i].write_base;
+		bench.mask = memoryRegions[i].write_mask;
+		snprintf(name, sizeof(name), "write/%s", memoryRegions[i].name);
+		NF_Benchmark_measure(name, "write", writeMemory, &bench, sample_count, &results[count++]);
+		closeBench(&bench);
+	}
+
+	// The PPU runs on its own here, so NMIs are left off
+	for (int rendering = 0; ok && rendering < 2; rendering++) {
+		ok = openBench(&bench, NULL);
+		if (!ok) { break; }
+		if (rendering) {
+			bench.frame = calloc(1, sizeof(struct NF_Frame));
+			if (bench.frame == NULL) {
+				printf("Error: Could not allocate benchmark frame. Out of memory?\n");
+				closeBench(&bench);
+				ok = false;
+				break;
+			}
+			bench.console->frame_output = bench.frame;
+			NF_writeMemory(bench.console, 0x2001, 0x1E);
+		}
+		NF_Benchmark_measure(rendering ? "ppu/rendering" : "ppu/idle", "dot", tickPPU, &bench, sample_count, &results[count++]);
+		closeBench(&bench);
+	}
+
+	for (int i = 0; ok && i < rom_count; i++) {
+		memset(&bench, 0, sizeof(bench));
+		bench.cart = NF_loadCartridgeWithoutSave(rom_paths[i]);
+		bench.console = (bench.cart != NULL) ? NF_initConsole() : NULL;
+		bench.frame = calloc(1, sizeof(struct NF_Frame));
+		ok = bench.console != NULL && bench.frame != NULL && NF_insertCartridge(bench.console, bench.cart) == 0;
+		if (ok) {
+			const char* file_name = rom_paths[i];
+			for (const char* c = rom_paths[i]; *c != '\0'; c++) { if (*c == '/' || *c == '\\') { file_name = c + 1; } }
+			bench.console->frame_output = bench.frame;
+			snprintf(name, sizeof(name), "frame/%s", file_name);
+			NF_Benchmark_measure(name, "frame", runFrames, &bench, sample_count, &results[count++]);
+		}
+		else { printf("Error: Could not set up the frame benchmark for %s.\n", rom_paths[i]); }
+		closeBench(&bench);
+	}
+
+	if (ok && json != NULL && !writeJSON(json, results, count, sample_count)) {
+		printf("Error: Could not write the benchmark results.\n");
+		ok = false;
+	}
+	free(results);
+	return ok;
+}
+
+static uint8_t scriptButtons(uint32_t frame) {
+	static const uint8_t directions[8] = { 0, NF_BUTTON_RIGHT, NF_BUTTON_LEFT, NF_BUTTON_UP, NF_BUTTON_DOWN,
+		NF_BUTTON_RIGHT | NF_BUTTON_UP, NF_BUTTON_LEFT | NF_BUTTON_DOWN, NF_BUTTON_RIGHT };
+	if (frame < SCRIPT_FIRST_FRAME) { return 0; }
+	uint32_t played = frame - SCRIPT_FIRST_FRAME;
+	if (played % SCRIPT_START_INTERVAL < SCRIPT_START_FRAMES) { return NF_BUTTON_START; }
+	// Scramble the step number, so that the buttons do not simply go round in a cycle
+	uint32_t step = (played / SCRIPT_STEP_FRAMES) * 2654435761u;
+	return directions[step >> 29] | ((step >> 20) & (NF_BUTTON_A | NF_BUTTON_B));
+}
+
+// The file name of a path, and the length of the part of it before the extension
+static const char* fileName(const char* path, size_t* stem_length) {
+	const char* name = path;
+	for (const char* c = path; *c != '\0'; c++) { if (*c == '/' || *c == '\\') { name = c + 1; } }
+	const char* dot = strrchr(name, '.');
+	*stem_length = (dot != NULL && dot != name) ? (size_t)(dot - name) : strlen(name);
+	return name;
+}
+
+bool NF_Benchmark_runTitle(const char* rom_path, uint32_t frame_count, struct NF_CorpusResult* result) {
+	memset(result, 0, sizeof(*result));
+	size_t stem_length;
+	const char* name = fileName(rom_path, &stem_length);
+	snprintf(result->title, sizeof(result->title), "%.*s", (int)stem_length, name);
+	NF_resetPeakMemory();
+
+	struct Bench bench;
+	memset(&bench, 0, sizeof(bench));
+	bench.cart = NF_loadCartridgeWithoutSave(rom_path);
+	bench.console = (bench.cart != NULL) ? NF_initConsole() : NULL;
+	bench.frame = calloc(1, sizeof(struct NF_Frame));
+	if (bench.console == NULL || bench.frame == NULL || NF_insertCartridge(bench.console, bench.cart) != 0) {
+		printf("Error: Could not set up %s for the corpus benchmark.\n", rom_path);
+		closeBench(&bench);
+		return false;
+	}
+	bench.console->frame_output = bench.frame;
+
+	char movie_path[1024];
+	struct NF_FileInfo info;
+	struct NF_Movie* movie = NULL;
+	snprintf(movie_path, sizeof(movie_path), "%.*s%s", (int)(name - rom_path + stem_length), rom_path, NF_CORPUS_MOVIE_EXTENSION);
+	if (NF_getFileInfo(movie_path, &info)) {
+		movie = NF_Movie_open(movie_path);
+		if (movie == NULL || !NF_Movie_seek(movie, bench.console, 0)) {
+			printf("Error: Could not play %s for the corpus benchmark.\n", movie_path);
+			NF_Movie_free(movie);
+			closeBench(&bench);
+			return false;
+		}
+		result->movie = true;
+	}
+
+	// The line hashes are cheap enough to hash every frame, and change whenever a pixel does
+	uint64_t first_cycle = bench.console->cpu_cycle;
+	uint32_t hash = 0;
+	uint64_t start = NF_getTicks();
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		if (movie == NULL || !NF_Movie_playFrame(movie, bench.console)) {
+			NF_setControllerButtons(bench.console, 0, scriptButtons(frame));
+			for (int port = 1; port < NF_CONTROLLER_PORTS; port++) { NF_setControllerButtons(bench.console, port, 0); }
+			NF_runFrame(bench.console);
+		}
+		hash = NF_crc32(hash, (const uint8_t*)bench.frame->line_hashes, sizeof(bench.frame->line_hashes));
+	}
+	uint64_t ticks = NF_getTicks() - start;
+
+	result->frames = frame_count;
+	result->cycles = bench.console->cpu_cycle - first_cycle;
+	result->seconds = (double)ticks / (double)NF_getTickFrequency();
+	result->frames_per_second = (result->seconds > 0) ? frame_count / result->seconds : 0.0;
+	result->ns_per_cycle = (result->cycles > 0) ? result->seconds * 1e9 / (double)result->cycles : 0.0;
+	result->peak_memory = NF_getPeakMemory();
+	result->frame_hash = hash;
+	NF_Movie_free(movie);
+	closeBench(&bench);
+	return true;
+}
+
+// Run a title and add it to the results. Titles that cannot be run are left out
+static void runCorpusTitle(const char* rom_path, uint32_t frame_count, FILE* json, int* count) {
+	struct NF_CorpusResult result;
+	if (!NF_Benchmark_runTitle(rom_path, frame_count, &result)) { return; }
+	printf("%-36s %8.1f frames/s %7.3f ns/cycle %8.1f MB peak  %08X  (%s)\n", result.title, result.frames_per_second,
+		result.ns_per_cycle, result.peak_memory / (1024.0 * 1024.0), result.frame_hash, result.movie ? "movie" : "script");
+	if (json != NULL) {
+		fprintf(json, "%s    { \"title\": ", (*count > 0) ? ",\n" : "");
+		writeJSONString(json, result.title);
+		fprintf(json, ", \"path\": ");
+		writeJSONString(json, rom_path);
+		fprintf(json, ", \"input\": \"%s\", \"frames\": %u, \"cycles\": %llu, \"seconds\": %.6f, \"frames_per_second\": %.3f, "
+			"\"ns_per_cycle\": %.4f, \"peak_memory_bytes\": %llu, \"frame_hash\": \"%08X\" }", result.movie ? "movie" : "script",
+			result.frames, (unsigned long long)result.cycles, result.seconds, result.frames_per_second, result.ns_per_cycle,
+			(unsigned long long)result.peak_memory, result.frame_hash);
+	}
+	(*count)++;
+}
+
+bool NF_Benchmark_runCorpus(const char* const* rom_paths, int rom_count, const char* corpus_directory, uint32_t frame_count, FILE* json) {
+	// Whether the peak can be reset is only known by trying
+	bool resets = NF_resetPeakMemory();
+	if (json != NULL) { fprintf(json, "{\n  \"frames\": %u,\n  \"peak_memory_resets\": %s,\n  \"titles\": [\n", frame_count, resets ? "true" : "false"); }
+	int count = 0;
+	int attempted = rom_count;
+	for (int i = 0; i < rom_count; i++) { runCorpusTitle(rom_paths[i], frame_count, json, &count); }
+
+	if (corpus_directory != NULL) {
+		char catalog_path[1024];
+		char rom_path[2048];
+		snprintf(catalog_path, sizeof(catalog_path), "%s/%s", corpus_directory, NF_CORPUS_CATALOG_NAME);
+		// Cataloging is over before the first title runs, so hashing the ROMs on every processor does not skew the timings
+		struct NF_ThreadPool* pool = NF_createThreadPool(0);
+		struct NF_RomCatalog* catalog = NF_RomCatalog_scan(corpus_directory, catalog_path, pool, NULL);
+		NF_freeThreadPool(pool);
+		if (catalog == NULL) { printf("Error: Could not catalog the ROMs in %s.\n", corpus_directory); }
+		for (uint32_t i = 0; catalog != NULL && i < NF_RomCatalog_count(catalog); i++) {
+			const struct NF_RomCatalogEntry* entry = &catalog->entries[i];
+			if (!entry->valid) { continue; }
+			attempted++;
+			snprintf(rom_path, sizeof(rom_path), "%s/%s", corpus_directory, NF_RomCatalog_path(catalog, entry));
+			runCorpusTitle(rom_path, frame_count, json, &count);
+		}
+		NF_RomCatalog_close(catalog);
+	}
+
+	if (json != NULL) { fprintf(json, "%s  ]\n}\n", (count > 0) ? "\n" : ""); }
+	if (count < attempted) { printf("Skipped %d of %d titles that could not be run.\n", attempted - count, attempted); }
+	if (count == 0) {
+		printf("Error: No title could be run.\n");
+		return false;
+	}
+	if (json != NULL && ferror(json)) {
+		printf("Error: Could not write the corpus benchmark results.\n");
+		return false;
+	}
+	return true;
+}
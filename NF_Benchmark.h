@@ -0,0 +1,92 @@
+#ifndef NF_H_BENCHMARK
+#define NF_H_BENCHMARK
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Microbenchmarks of the hot paths of the core, for seeing what a change does to them. Each benchmark times one
+// small piece of work (an instruction, a bus read, a PPU dot, a frame) on its own:
+//
+// cpu/<class>			NF_6502_tickClock running an instruction of one kind over and over, without the PPU
+// read/<region>		NF_readMemory from one region of the address space
+// write/<region>		NF_writeMemory to one region of the address space
+// ppu/<state>			NF_PPU_tickClock for one dot, with rendering off or on
+// frame/<rom>			NF_runFrame of a real ROM, drawing into a frame
+//
+// Everything but the frames runs on a small made up NROM cartridge built in memory, so that the numbers do not
+// depend on which ROMs are around. Each benchmark is first sized so that one sample takes about
+// NF_BENCHMARK_SAMPLE_MS, then run once to warm up and then sample_count times. The time of each sample is kept, so
+// that runs on different commits can be compared with their variance, not just their averages.
+
+#define NF_BENCHMARK_SAMPLE_MS 20
+#define NF_BENCHMARK_DEFAULT_SAMPLES 10
+#define NF_BENCHMARK_MAX_SAMPLES 100
+
+// The work being timed: do the benchmark's piece of work iterations times
+typedef void (*NF_BenchmarkFunction)(void* context, uint64_t iterations);
+
+struct NF_BenchmarkResult {
+	char name[96];
+	const char* unit;				// What one iteration is
+	uint64_t iterations;			// Per sample
+	int sample_count;
+	double samples[NF_BENCHMARK_MAX_SAMPLES];	// Nanoseconds per iteration
+	double mean;
+	double median;
+	double min;
+	double stddev;
+};
+
+// Time one benchmark. sample_count is clamped to NF_BENCHMARK_MAX_SAMPLES
+void NF_Benchmark_measure(const char* name, const char* unit, NF_BenchmarkFunction function, void* context, int sample_count,
+	struct NF_BenchmarkResult* result);
+
+// Run every benchmark, with a frame benchmark for each ROM, printing a line for each as it finishes. The results are
+// written to json (if it is not NULL) as:
+// { "processors": n, "samples": n, "benchmarks": [ { "name", "unit", "iterations", "mean_ns", "median_ns", "min_ns",
+//   "stddev_ns", "samples_ns": [...] }, ... ] }
+// Checks the compositor (NF_checkCompositor) before timing anything. Returns false (and prints why) if the check fails,
+// a benchmark could not be set up or the JSON could not be written
+bool NF_Benchmark_runSuite(const char* const* rom_paths, int rom_count, int sample_count, FILE* json);
+
+// The corpus benchmark: whole games, run without a window for a fixed number of frames, for seeing what a change does
+// to real play rather than to one piece of work. Every ROM given is run, followed by every ROM under the corpus
+// directory, if there is one (found with a ROM catalog, kept in the directory as NF_CORPUS_CATALOG_NAME).
+//
+// Each title plays the movie next to it (the ROM's path with NF_CORPUS_MOVIE_EXTENSION in place of .nes) if there is
+// one, and a fixed input script otherwise or once the movie ends. Either way, a title gets the same input every run,
+// so the hash of the frames it drew only changes when the emulation does. For each title it reports:
+//
+// frames per second		Of the whole run, drawing every frame
+// ns per CPU cycle			The same time, spread over the CPU cycles run
+// peak memory				Resident, in bytes. Where the peak cannot be reset (see NF_resetPeakMemory), this is the
+//							peak of the whole process up to the end of the title
+// frame hash				CRC32 of the line hashes of every frame, in order
+
+#define NF_CORPUS_DEFAULT_FRAMES 3600		// A minute
+#define NF_CORPUS_MOVIE_EXTENSION ".movie"
+#define NF_CORPUS_CATALOG_NAME "corpus.catalog"
+
+struct NF_CorpusResult {
+	char title[96];
+	bool movie;						// Whether the input came from a movie, for at least the first frame
+	uint32_t frames;
+	uint64_t cycles;				// CPU cycles
+	double seconds;
+	double frames_per_second;
+	double ns_per_cycle;
+	uint64_t peak_memory;
+	uint32_t frame_hash;
+};
+
+// Run one title. Returns false (and prints why) if it cannot be loaded, or its movie is broken or for another ROM
+bool NF_Benchmark_runTitle(const char* rom_path, uint32_t frame_count, struct NF_CorpusResult* result);
+
+// Run the ROMs and the corpus (corpus_directory may be NULL), printing a line for each title as it finishes. Titles
+// that cannot be run are skipped. The results are written to json (if it is not NULL) as:
+// { "frames": n, "peak_memory_resets": true/false, "titles": [ { "title", "path", "input": "movie"/"script", "frames",
+//   "cycles", "seconds", "frames_per_second", "ns_per_cycle", "peak_memory_bytes", "frame_hash" }, ... ] }
+// Returns false (and prints why) if no title could be run, or the JSON could not be written
+bool NF_Benchmark_runCorpus(const char* const* rom_paths, int rom_count, const char* corpus_directory, uint32_t frame_count, FILE* json);
+
+#endif
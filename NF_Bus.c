@@ -1,12 +1,15 @@
 #include "NF_Bus.h"
 #include "NF_6502.h"
 #include "NF_PPU.h"
+#include "NF_Probes.h"
+#include "NF_RenderThread.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Constructor
 struct NES_Console* NF_initConsole() {
-	struct NES_Console* console = malloc(sizeof(struct NES_Console));
+	struct NES_Console* console = calloc(1, sizeof(struct NES_Console));
 	if (console == NULL) {
 		printf("Error: Could not create NES Console object. Out of memory?\n");
 		return 0;
@@ -20,7 +23,26 @@ struct NES_Console* NF_initConsole() {
 	if (console->ConnectedPPU == NULL) { return 0; }
 	console->ConnectedPPU->bus = console;
 
+	console->ConnectedAPU = NF_initAPU();
+	if (console->ConnectedAPU == NULL) { return 0; }
+	console->ConnectedAPU->bus = console;
+
 	memset(console->Memory, 0, 0x10000);
+	memset(console->controllers, 0, sizeof(console->controllers));
+	console->ConnectedCartridge = NULL;
+	console->frame_output = NULL;
+	console->render_thread = NULL;
+	console->ppu_journal = NULL;
+	memset(console->line_hashes, 0, sizeof(console->line_hashes));
+	console->cpu_cycle = 0;
+	console->irq_lines = 0;
+	console->frame_count = 0;
+	for (int i = 0; i < NF_EVENT_COUNT; i++) { console->event_cycles[i] = NF_EVENT_NEVER; }
+	console->next_event_cycle = NF_EVENT_NEVER;
+	console->code_data_log = NULL;
+	console->log_access = NF_CDL_DATA;
+	NF_APU_runUntil(console->ConnectedAPU, 0);		// Puts the frame counter on the schedule
+	NF_Stats_reset(console);
 	return console;
 }
 
@@ -31,11 +53,21 @@ int NF_insertCartridge(struct NES_Console *console, struct Cartridge *cart) {
 		return 1;
 	}
 	console->ConnectedCartridge = cart; 
+	NF_PPU_scheduleScanlineCounter(console->ConnectedPPU);
 	console->ConnectedProcessor->PC = (NF_readMemory(console, NF_6502_RESET_VECTOR + 1) << 8) | NF_readMemory(console, NF_6502_RESET_VECTOR);
-	console->ConnectedProcessor->PC = 0xC000; // For testing with nestest.nes, comment out otherwise
+	return 0;
+}
+
+void NF_freeConsole(struct NES_Console* console) {
+	if (console == NULL) { return; }
+	free(console->ConnectedProcessor);
+	free(console->ConnectedPPU);
+	free(console->ConnectedAPU);
+	free(console);
 }
 
 void NF_writeMemory(struct NES_Console* console, uint16_t address, uint8_t value) {
+	console->counters.writes[NF_busRegions[address >> 13]]++;
 
 	// Addresses in the 2KB internal RAM should be mirrored onto [0x0000 - 0x07FF] if they are outside of that range
 	if (address <= 0x1FFF) { console->Memory[address % 0x800] = value; }
@@ -45,13 +77,42 @@ void NF_writeMemory(struct NES_Console* console, uint16_t address, uint8_t value
 		NF_PPU_writeRegister(console->ConnectedPPU, (PPU_REGISTER)(address % 0x08), value);
 	}
 
-	// Reading PRG Rom from the cartridge
-	else if (address >= NF_6502_ROM_LOCATION) { /* Cannot do anything to ROM */ }
+	// OAM DMA copies a page of memory into OAM, halting the CPU while it does. It takes an extra cycle to line up
+	// with the right CPU cycle if it starts on an odd one
+	else if (address == 0x4014) {
+		uint8_t page[PPU_OAM_MEMORY_SIZE];
+		for (int i = 0; i < PPU_OAM_MEMORY_SIZE; i++) { page[i] = NF_readMemory(console, (uint16_t)(value << 8) | i); }
+		NF_PPU_writeOAM(console->ConnectedPPU, page);
+		console->ConnectedProcessor->stall_cycles += NF_OAM_DMA_CYCLES + (console->cpu_cycle & 0x01);
+	}
+
+	// Both controllers share the strobe line on $4016
+	else if (address == 0x4016) {
+		for (int i = 0; i < NF_CONTROLLER_PORTS; i++) { NF_Controller_writeStrobe(&console->controllers[i], value); }
+	}
+
+	// APU registers. $4014 (OAM DMA) and $4016 (controllers) sit in the middle, and are not part of the APU
+	else if (address >= 0x4000 && address <= 0x4017 && address != 0x4014 && address != 0x4016) {
+		NF_APU_writeRegister(console->ConnectedAPU, address, value, console->cpu_cycle);
+	}
+
+	// Cartridge RAM, which may be battery backed
+	else if (address >= NF_6502_PRG_RAM_LOCATION && address < NF_6502_ROM_LOCATION && console->ConnectedCartridge != NULL) {
+		NF_writeCartPRG_RAM(console->ConnectedCartridge, address, value);
+	}
+
+	// Writes to the ROM area go to the mapper registers. The mapper may have changed the IRQ line as a result
+	else if (address >= NF_6502_ROM_LOCATION) {
+		if (console->ConnectedCartridge == NULL) { return; }
+		NF_writeCartRegister(console->ConnectedCartridge, address, value);
+		NF_setIRQLine(console, NF_IRQ_MAPPER, console->ConnectedCartridge->irq_asserted);
+	}
 
 	else { console->Memory[address] = value; }
 }
 
 uint8_t NF_readMemory(struct NES_Console* console, uint16_t address) {
+	console->counters.reads[NF_busRegions[address >> 13]]++;
 
 	if (address < 0x0000 || address > 0xFFFF) {
 		printf("Error: Address range for memory reads must be between 0x0000 and 0xFFFF.\n");
@@ -66,24 +127,158 @@ uint8_t NF_readMemory(struct NES_Console* console, uint16_t address) {
 		return NF_PPU_readRegister(console->ConnectedPPU, (PPU_REGISTER)(address % 0x08));
 	}
 
+	// The APU status is the only APU register that can be read
+	else if (address == 0x4015) { return NF_APU_readStatus(console->ConnectedAPU, console->cpu_cycle); }
+
+	// Controller ports
+	else if (address == 0x4016 || address == 0x4017) { return NF_Controller_read(&console->controllers[address - 0x4016]); }
+
+	else if (address >= NF_6502_PRG_RAM_LOCATION && address < NF_6502_ROM_LOCATION && console->ConnectedCartridge != NULL) {
+		return NF_readCartPRG_RAM(console->ConnectedCartridge, address);
+	}
+
 	// Reading PRG Rom from the cartridge
 	else if (address >= NF_6502_ROM_LOCATION) {
-		return NF_readCartPRG_ROM(console->ConnectedCartridge, address);
+		return NF_readCartPRG_ROM(console->ConnectedCartridge, address, console->log_access);
 	}
 
 	else { return console->Memory[address]; }
 }
 
+uint8_t NF_peekMemory(struct NES_Console* console, uint16_t address) {
+	if (address <= 0x1FFF) { return console->Memory[address % 0x800]; }
+	else if (address <= 0x3FFF) { return NF_PPU_peekRegister(console->ConnectedPPU, (PPU_REGISTER)(address % 0x08)); }
+	else if (address == 0x4015) { return NF_APU_peekStatus(console->ConnectedAPU); }
+	else if (address == 0x4016 || address == 0x4017) { return NF_Controller_peek(&console->controllers[address - 0x4016]); }
+	else if (address >= NF_6502_PRG_RAM_LOCATION && console->ConnectedCartridge != NULL) { return NF_peekCart(console->ConnectedCartridge, address); }
+	else { return console->Memory[address]; }
+}
+
 // Calls the NMI function of the connected Processor. 
 // This exists so that the PPU can trigger the NMI by passing up a signal through the bus that it is on (VBlank)
 void NF_emitNMI(struct NES_Console* console) {
 	NF_6502_nmi(console->ConnectedProcessor);
 }
 
-// The NES uses a single master clock, and for every 3 ticks of the PPU, the CPU has one tick
-void NF_busTickMasterClock(struct NES_Console* console, bool r) {
+// The PPU has finished drawing the visible part of a frame. Work that should happen once per frame, rather than in
+// the middle of emulation, is done here
+void NF_frameEnded(struct NES_Console* console) {
+	console->frame_count++;
+	if (console->frame_output != NULL) { console->frame_output->number = console->frame_count; }
+	if (console->render_thread != NULL) { console->ppu_journal = NF_RenderThread_submit(console->render_thread, console->frame_count); }
+	NF_APU_endFrame(console->ConnectedAPU, console->cpu_cycle);
+	if (console->ConnectedCartridge != NULL) { NF_flushCartridgeSave(console->ConnectedCartridge, false); }
+}
+
+void NF_setIRQLine(struct NES_Console* console, NF_IRQ_SOURCE source, bool asserted) {
+	if (asserted) { console->irq_lines |= source; }
+	else { console->irq_lines &= ~source; }
+}
+
+static void updateNextEvent(struct NES_Console* console) {
+	console->next_event_cycle = NF_EVENT_NEVER;
+	for (int i = 0; i < NF_EVENT_COUNT; i++) {
+		if (console->event_cycles[i] < console->next_event_cycle) { console->next_event_cycle = console->event_cycles[i]; }
+	}
+}
+
+void NF_scheduleEvent(struct NES_Console* console, NF_EVENT event, uint64_t cycle) {
+	console->event_cycles[event] = cycle;
+	updateNextEvent(console);
+}
+
+void NF_cancelEvent(struct NES_Console* console, NF_EVENT event) {
+	console->event_cycles[event] = NF_EVENT_NEVER;
+	updateNextEvent(console);
+}
+
+// Run every event that is due. Handlers are free to schedule themselves again
+static void runEvents(struct NES_Console* console) {
+	for (int i = 0; i < NF_EVENT_COUNT; i++) {
+		if (console->event_cycles[i] > console->cpu_cycle) { continue; }
+		console->event_cycles[i] = NF_EVENT_NEVER;
+		switch ((NF_EVENT)i) {
+		case NF_EVENT_APU:
+			NF_APU_runEvent(console->ConnectedAPU, console->cpu_cycle);
+			break;
+		case NF_EVENT_MAPPER_A12:
+			console->ConnectedCartridge->mapper_impl->ppuA12Rise(console->ConnectedCartridge);
+			NF_setIRQLine(console, NF_IRQ_MAPPER, console->ConnectedCartridge->irq_asserted);
+			NF_PPU_scheduleScanlineCounter(console->ConnectedPPU);
+			break;
+		default:
+			break;
+		}
+	}
+	updateNextEvent(console);
+}
+
+// A master clock tick with the CPU and the PPU timed on their own, see NF_Stats.h
+static void tickTimed(struct NES_Console* console) {
+	uint64_t start = NF_getTicks();
 	NF_6502_tickClock(console->ConnectedProcessor);
+	uint64_t middle = NF_getTicks();
 	NF_PPU_tickClock(console->ConnectedPPU);
 	NF_PPU_tickClock(console->ConnectedPPU);
 	NF_PPU_tickClock(console->ConnectedPPU);
+	console->counters.cpu_sample_ticks += middle - start;
+	console->counters.ppu_sample_ticks += NF_getTicks() - middle;
+	console->counters.timing_countdown = NF_STATS_TIMING_INTERVAL;
 }
+
+// The NES uses a single master clock, and for every 3 ticks of the PPU, the CPU has one tick
+void NF_busTickMasterClock(struct NES_Console* console, bool r) {
+	if (--console->counters.timing_countdown == 0) { tickTimed(console); }
+	else {
+		NF_6502_tickClock(console->ConnectedProcessor);
+		NF_PPU_tickClock(console->ConnectedPPU);
+		NF_PPU_tickClock(console->ConnectedPPU);
+		NF_PPU_tickClock(console->ConnectedPPU);
+	}
+	console->cpu_cycle++;
+	if (console->cpu_cycle >= console->next_event_cycle) { runEvents(console); }
+}
+
+
+void NF_runFrame(struct NES_Console* console) {
+	uint64_t frame = console->frame_count;
+	NF_PROBE2(frame_start, frame, console->cpu_cycle);
+	uint64_t start = NF_getTicks();
+	while (console->frame_count == frame) { NF_busTickMasterClock(console, true); }
+	console->counters.frame_ticks += NF_getTicks() - start;
+	NF_PROBE2(frame_end, console->frame_count, console->cpu_cycle);
+	if (console->stats_dump.file != NULL) { NF_Stats_frameFinished(console); }
+}
+
+void NF_setControllerButtons(struct NES_Console* console, int port, uint8_t buttons) {
+	if (port < 0 || port >= NF_CONTROLLER_PORTS) { return; }
+	console->controllers[port].buttons = buttons;
+	if (console->controllers[port].strobe) { console->controllers[port].shift_register = buttons; }
+}
+
+// CHR ROM is logged by whichever thread draws the lines: the render thread when there is one, and the console's own
+// thread otherwise. PRG ROM is always logged here
+static void routeCodeDataLog(struct NES_Console* console) {
+	struct NF_CodeDataLog* log = console->code_data_log;
+	if (console->render_thread != NULL) { NF_RenderThread_setCodeDataLog(console->render_thread, log); }
+	if (console->ConnectedCartridge == NULL) { return; }
+	uint8_t* chr_flags = (log != NULL && console->render_thread == NULL) ? log->chr : NULL;
+	NF_setCartCodeDataLog(console->ConnectedCartridge, (log != NULL) ? log->prg : NULL, chr_flags);
+}
+
+void NF_setRenderThread(struct NES_Console* console, struct NF_RenderThread* render_thread) {
+	// The thread being detached hands back the CHR it was logging
+	if (console->render_thread != NULL) { NF_RenderThread_setCodeDataLog(console->render_thread, NULL); }
+	console->render_thread = render_thread;
+	console->ppu_journal = (render_thread != NULL) ? NF_RenderThread_journal(render_thread) : NULL;
+	routeCodeDataLog(console);
+}
+
+void NF_setTracer(struct NES_Console* console, struct NF_Tracer* tracer) { console->tracer = tracer; }
+
+void NF_setProfiler(struct NES_Console* console, struct NF_Profiler* profiler) { console->profiler = profiler; }
+
+void NF_setCodeDataLog(struct NES_Console* console, struct NF_CodeDataLog* log) {
+	console->code_data_log = log;
+	routeCodeDataLog(console);
+}
\ No newline at end of file
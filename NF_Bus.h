@@ -1,7 +1,11 @@
 #ifndef NF_H_BUS
 #define NF_H_BUS
+#include "NF_APU.h"
 #include "NF_Cartridge.h"
+#include "NF_Controller.h"
+#include "NF_Frame.h"
 #include "NF_Palette.h"
+#include "NF_Stats.h"
 #include <stdint.h>
 
 // Representation of the memory. This maps in the following way:
@@ -20,10 +24,29 @@
 // $FFFE-FFFF: IRQ Vector
 
 #define NF_6502_STACK_LOCATION (uint16_t)0x0100
+#define NF_6502_PRG_RAM_LOCATION (uint16_t)0x6000
 #define NF_6502_ROM_LOCATION (uint16_t)0x8000
 #define NF_6502_NMI_VECTOR (uint16_t)0xFFFA
 #define NF_6502_RESET_VECTOR (uint16_t)0xFFFC
 #define NF_6502_IRQ_VECTOR (uint16_t)0xFFFE
+#define NF_OAM_DMA_CYCLES 513
+
+// Events that the bus can schedule on the CPU cycle timeline. Anything that needs to happen at a known time in
+// the future (rather than being checked on every clock tick) goes here
+typedef enum {
+	NF_EVENT_MAPPER_A12,		// Rendering has reached dot 260 of a scanline, which is when PPU A12 rises
+	NF_EVENT_APU,				// The APU may need to raise an IRQ (frame counter step, or the end of a DMC sample)
+	NF_EVENT_COUNT
+} NF_EVENT;
+
+#define NF_EVENT_NEVER UINT64_MAX
+
+// Sources that can hold the CPU's IRQ line low. The line is asserted as long as any of these bits is set
+typedef enum {
+	NF_IRQ_MAPPER = 0b00000001,
+	NF_IRQ_APU_FRAME = 0b00000010,
+	NF_IRQ_APU_DMC = 0b00000100
+} NF_IRQ_SOURCE;
 
 // This structure represents the console itself. It bundles objects making up the physical parts of the
 // console, and acts as a bus, allowing them to communicate with one another
@@ -32,7 +55,31 @@ struct NES_Console {
 	struct Cartridge* ConnectedCartridge;
 	struct Processor* ConnectedProcessor;
 	struct PictureProcessingUnit* ConnectedPPU;
-	void (*imageOutFunc)(struct NF_Pixel);
+	struct NF_APU* ConnectedAPU;
+	struct NF_Controller controllers[NF_CONTROLLER_PORTS];
+	struct NF_Frame* frame_output;		// Where the PPU draws. NULL to skip drawing (the PPU still runs)
+	struct NF_RenderThread* render_thread;	// Draws frames from a journal instead, when not NULL
+	struct NF_PPUJournal* ppu_journal;
+	uint64_t line_hashes[NF_FRAME_HEIGHT];	// Of the last frame drawn, to mark which lines of the next one changed
+	struct NF_Tracer* tracer;			// Records every instruction, when not NULL
+	struct NF_Profiler* profiler;		// Charges every CPU cycle to the game's code, when not NULL
+	struct NF_CodeDataLog* code_data_log;	// Flags how the game uses its ROM, when not NULL
+	uint8_t log_access;					// What the CPU is reading for, as the NF_CDL flags to set on PRG ROM
+
+	// Scheduler. Times are measured in CPU cycles since power on
+	uint64_t cpu_cycle;
+	uint64_t next_event_cycle;
+	uint64_t event_cycles[NF_EVENT_COUNT];
+
+	// Level of the IRQ line, as a set of NF_IRQ_SOURCE bits
+	uint8_t irq_lines;
+
+	// Frames finished since power on. A frame ends when the PPU enters VBlank
+	uint64_t frame_count;
+
+	// What the console has done and how long it took, see NF_Stats.h
+	struct NF_Counters counters;
+	struct NF_StatsDump stats_dump;
 };
 
 // Must be called once to create the Console object
@@ -41,16 +88,55 @@ struct NES_Console* NF_initConsole();
 // Connect a cartridge to the console. This function also places the Program Counter at the Reset vector
 int NF_insertCartridge(struct NES_Console* console, struct Cartridge* cart);
 
+// Destroy a console. The cartridge is not freed with it, see NF_freeCartridge
+void NF_freeConsole(struct NES_Console* console);
+
 // Send out one clock tick. This will advance both the CPU and the PPU appropriately
 void NF_busTickMasterClock(struct NES_Console* console, bool r);
 
+// Keep sending out clock ticks until the current frame has ended
+void NF_runFrame(struct NES_Console* console);
+
+// Set the buttons held on a controller port, as NF_BUTTON bits. Takes effect the next time the game strobes $4016
+void NF_setControllerButtons(struct NES_Console* console, int port, uint8_t buttons);
+
+// Hand drawing over to a render thread (see NF_RenderThread.h), or take it back with NULL. Only call between frames
+void NF_setRenderThread(struct NES_Console* console, struct NF_RenderThread* render_thread);
+
+// Start tracing instructions into a tracer (see NF_Trace.h), or stop with NULL. Can be called at any time
+void NF_setTracer(struct NES_Console* console, struct NF_Tracer* tracer);
+
+// Start profiling the game's code with a profiler (see NF_Profiler.h), or stop with NULL. Can be called at any time
+void NF_setProfiler(struct NES_Console* console, struct NF_Profiler* profiler);
+
+// Start logging how the inserted cartridge's ROM is used into a log made for it (see NF_CodeDataLog.h), or stop with
+// NULL. Only call between frames. With a render thread, this waits for it to finish logging the frame it is drawing
+void NF_setCodeDataLog(struct NES_Console* console, struct NF_CodeDataLog* log);
+
 // Call the NMI function from the processor (this exists so that the PPU can send a signal to trigger it without being exposed to the CPU directly)
 void NF_emitNMI(struct NES_Console* console);
 
+// Called by the PPU when it enters VBlank, once per frame
+void NF_frameEnded(struct NES_Console* console);
+
+// Assert or release one of the sources of the CPU's IRQ line
+void NF_setIRQLine(struct NES_Console* console, NF_IRQ_SOURCE source, bool asserted);
+
+// Schedule an event to happen at a given CPU cycle, replacing any previously scheduled time for that event
+void NF_scheduleEvent(struct NES_Console* console, NF_EVENT event, uint64_t cycle);
+
+// Remove an event from the schedule
+void NF_cancelEvent(struct NES_Console* console, NF_EVENT event);
+
 // Write to the CPU memory address
 void NF_writeMemory(struct NES_Console* console, uint16_t address, uint8_t value);
 
 // Read from the CPU memory address
 uint8_t NF_readMemory(struct NES_Console* console, uint16_t address);
 
+// Read a CPU memory address the way a debugger sees it: the value a read would return, without any of the side effects
+// a read has on the PPU, APU, controllers or cartridge. Anything that looks at memory without being the CPU (the
+// debugger, the tracer, tools) reads through this, so that looking does not change how the game runs
+uint8_t NF_peekMemory(struct NES_Console* console, uint16_t address);
+
 #endif
\ No newline at end of file
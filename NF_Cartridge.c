@@ -1,110 +1,405 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "NF_Cartridge.h"
+#include "NF_Platform.h"
+#include "NF_RomDB.h"
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include <malloc.h>
 
 #define PRG_ROM_BLOCK_SIZE 16384
 #define CHR_ROM_BLOCK_SIZE 8192
 #define TRAINER_BLOCK_SIZE 512
+#define PRG_RAM_BLOCK_SIZE 8192
 
-// Take byte data stored in a character array, and parse the ROM into a Cartridge structure
-struct Cartridge * NF_createCartridgeFromBuffer(char* rom_data) {
+// The smallest banks the mappers switch. A board needs at least one of each to have anything to map
+#define PRG_MIN_SIZE 0x2000
+#define CHR_MIN_SIZE 0x0400
 
-	struct Cartridge *Cart = malloc(sizeof(struct Cartridge));
+// ROM files that are currently mapped, shared by every cartridge (and every console) running the same file
+struct NF_RomImage {
+	struct NF_FileInfo info;
+	struct NF_FileMapping mapping;
+	int refcount;
+	struct NF_RomImage* next;
+};
 
-	if (Cart == NULL) {
-		printf("Error: Could not create cartridge object. Out of memory?\n");
-		return NULL;
+static struct NF_RomImage* loadedImages = NULL;
+static NF_Mutex loadedImagesLock = NF_MUTEX_INITIALIZER;
+
+static struct NF_RomDB* cartridgeDatabase = NULL;
+static const struct NF_RomCatalog* cartridgeCatalog = NULL;
+static const char* cartridgeCatalogRoot = NULL;
+
+// NES 2.0 ROM sizes are either a plain count of blocks, or (if the hi-nibble is $F) written in exponent-multiplier
+// notation in the lo-byte. Returns false if the size does not fit in 32 bits
+static bool decodeRomSize(uint8_t lo, uint8_t hi_nibble, uint32_t block_size, uint32_t* size) {
+	if (hi_nibble == 0x0F) {
+		uint8_t exponent = lo >> 2;
+		uint8_t multiplier = (lo & 0x03) * 2 + 1;
+		if (exponent > 28) { return false; }
+		*size = (1u << exponent) * multiplier;
+		return true;
 	}
+	*size = (((uint32_t)hi_nibble << 8) | lo) * block_size;
+	return true;
+}
+
+// NES 2.0 RAM sizes are a shift count, where 0 means there is no RAM at all
+static uint32_t decodeRamSize(uint8_t shift) {
+	return (shift == 0) ? 0 : (64u << shift);
+}
+
+// Describe why a ROM was rejected in error, which holds error_size bytes. Always returns false
+static bool reject(char* error, size_t error_size, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	vsnprintf(error, error_size, format, args);
+	va_end(args);
+	return false;
+}
+
+bool NF_parseCartridgeHeader(const uint8_t* rom_data, struct NF_CartridgeHeader* header, char* error, size_t error_size) {
+
+	memset(header, 0, sizeof(*header));
 
 	// On a valid NES rom with a header, the first four bytes will be [0x43, 0x45, 0x53, 0x1A], which spell out "NES<EOF>"
 	if (rom_data[0] != 0x4E || rom_data[1] != 0x45 || rom_data[2] != 0x53 || rom_data[3] != 0x1A) {
-		printf("Error: The ROM has an invalid header, is not a valid NES rom, or is corrupted.\n");
-		free(Cart);
-		return NULL;
+		return reject(error, error_size, "The ROM has an invalid header, is not a valid NES rom, or is corrupted.");
 	}
 
-	Cart->prg_rom_blocks = rom_data[4];
-	Cart->chr_rom_blocks = rom_data[5];
-	Cart->flag_6 = rom_data[6];
-	Cart->nametable_mirroring = (rom_data[6] & 0b00000001) ? VERTICAL_MAPPING : HORIZONTAL_MAPPING;
-	Cart->flag_7 = rom_data[7];
-	Cart->has_battery = ((rom_data[6] & 0b00000010) != 0);
-	Cart->has_trainer = ((rom_data[6] & 0b00000100) != 0);
-	Cart->mapper = (rom_data[6] >> 4) | (rom_data[7] & 0xF0);
+	header->mirroring = (rom_data[6] & 0b00001000) ? FOUR_SCREEN_MAPPING : (rom_data[6] & 0b00000001) ? VERTICAL_MAPPING : HORIZONTAL_MAPPING;
+	header->has_battery = ((rom_data[6] & 0b00000010) != 0);
+	header->has_trainer = ((rom_data[6] & 0b00000100) != 0);
+	header->mapper = (rom_data[6] >> 4) | (rom_data[7] & 0xF0);
+	header->console_type = (CONSOLE_TYPE)(rom_data[7] & 0x03);
 
 	// Check if the header is NES 2.0
 	if ((rom_data[7] & 0x0C) == 0x08) {
-		Cart->header_type = HEADER_NES_2;
-		// TO DO: Implement NES 2.0 Header support
+		header->header_type = HEADER_NES_2;
+		header->mapper |= (uint16_t)(rom_data[8] & 0x0F) << 8;
+		header->submapper = rom_data[8] >> 4;
+		if (!decodeRomSize(rom_data[4], rom_data[9] & 0x0F, PRG_ROM_BLOCK_SIZE, &header->prg_rom_size) ||
+			!decodeRomSize(rom_data[5], rom_data[9] >> 4, CHR_ROM_BLOCK_SIZE, &header->chr_rom_size)) {
+			return reject(error, error_size, "The ROM header describes a ROM too large to be loaded.");
+		}
+		header->prg_ram_size = decodeRamSize(rom_data[10] & 0x0F);
+		header->prg_nvram_size = decodeRamSize(rom_data[10] >> 4);
+		header->chr_ram_size = decodeRamSize(rom_data[11] & 0x0F);
+		header->chr_nvram_size = decodeRamSize(rom_data[11] >> 4);
+		header->timing = (CPU_PPU_TIMING)(rom_data[12] & 0x03);
+		if (header->console_type == CONSOLE_VS_SYSTEM) {
+			header->vs_ppu_type = rom_data[13] & 0x0F;
+			header->vs_hardware_type = rom_data[13] >> 4;
+		}
+		else if (header->console_type == CONSOLE_EXTENDED) {
+			header->extended_console_type = rom_data[13] & 0x0F;
+		}
+		header->misc_roms = rom_data[14] & 0x03;
+		header->expansion_device = rom_data[15] & 0x3F;
 	}
 
 	// Check if the header is iNES, or is invalid
 	else if ((rom_data[7] & 0x0C ) == 0x00) {
 		if (rom_data[12] != 0 || rom_data[13] != 0 || rom_data[14] != 0 || rom_data[15] != 0) {
-			printf("Error: Rom Header is not in iNES or NES 2.0 format, or is corrupted.\n");
-			free(Cart);
-			return NULL;
+			return reject(error, error_size, "Rom Header is not in iNES or NES 2.0 format, or is corrupted.");
 		}
-		Cart->header_type = HEADER_INES;
-		Cart->prg_ram_blocks = rom_data[8];
+		header->header_type = HEADER_INES;
+		header->prg_rom_size = rom_data[4] * PRG_ROM_BLOCK_SIZE;
+		header->chr_rom_size = rom_data[5] * CHR_ROM_BLOCK_SIZE;
+
+		// iNES can't tell volatile and battery backed RAM apart, and a size of 0 means 8KB for compatibility
+		uint32_t prg_ram = (rom_data[8] == 0 ? 1 : rom_data[8]) * PRG_RAM_BLOCK_SIZE;
+		if (header->has_battery) { header->prg_nvram_size = prg_ram; }
+		else { header->prg_ram_size = prg_ram; }
+		header->chr_ram_size = (header->chr_rom_size == 0) ? CHR_ROM_BLOCK_SIZE : 0;
+		header->timing = (rom_data[9] & 0x01) ? TIMING_PAL : TIMING_NTSC;
 	}
 
-	// If trainer code exists, store it, otherwise just zero out that block
-	if (Cart->has_trainer) { memcpy(Cart->trainer, rom_data+16, TRAINER_BLOCK_SIZE); }
-	else { memset(Cart->trainer, 0, TRAINER_BLOCK_SIZE); }
+	else {
+		return reject(error, error_size, "Rom Header is not in iNES or NES 2.0 format, or is corrupted.");
+	}
 
-	// Make buffers to store the PRG ROM and CHR ROM blocks, aborting if there is not enough memory to do so
-	Cart->prg_rom = malloc(PRG_ROM_BLOCK_SIZE * Cart->prg_rom_blocks);
-	if (Cart->prg_rom == NULL) {
-		printf("Error: Could not create cartridge object. Could not create PRG ROM buffer. Out of memory?\n");
-		free(Cart);
-		return 0;
+	if (header->prg_rom_size == 0) {
+		return reject(error, error_size, "The ROM header describes a cartridge with no PRG ROM.");
 	}
-	Cart->chr_rom = malloc(CHR_ROM_BLOCK_SIZE * Cart->chr_rom_blocks);
-	if (Cart->chr_rom == NULL) {
-		printf("Error: Could not create cartridge object. Could not create PRG ROM buffer. Out of memory?\n");
-		free(Cart->prg_rom);
+	return true;
+}
+
+// Take byte data stored in a character array, and parse the ROM into a Cartridge structure.
+// The cartridge points directly into rom_data, so the buffer must outlive the cartridge.
+struct Cartridge * NF_createCartridgeFromBuffer(const uint8_t* rom_data, size_t size) {
+	return NF_createCartridgeWithHeader(rom_data, size, rom_data);
+}
+
+bool NF_validateCartridge(const uint8_t* rom_data, size_t size, const uint8_t* header_data, struct NF_CartridgeHeader* header, char* error, size_t error_size) {
+	if (rom_data == NULL || size < INES_HEADER_SIZE) {
+		return reject(error, error_size, "The ROM is too small to contain a header.");
+	}
+	if (!NF_parseCartridgeHeader(header_data, header, error, error_size)) { return false; }
+
+	// NES 2.0 sizes can describe less ROM than one bank, which the mappers would have nothing to point at
+	if (header->prg_rom_size < PRG_MIN_SIZE || (header->chr_rom_size > 0 && header->chr_rom_size < CHR_MIN_SIZE)) {
+		return reject(error, error_size, "The ROM header describes %u bytes of PRG ROM and %u bytes of CHR ROM, but boards need at least 8KB of PRG ROM and 1KB of any CHR ROM.",
+			(unsigned)header->prg_rom_size, (unsigned)header->chr_rom_size);
+	}
+
+	// Make sure the file actually holds everything the header says it does
+	size_t prg_offset = INES_HEADER_SIZE + (header->has_trainer ? TRAINER_BLOCK_SIZE : 0);
+	if (prg_offset + (size_t)header->prg_rom_size + header->chr_rom_size > size) {
+		return reject(error, error_size, "The ROM header describes %u bytes of PRG ROM and %u bytes of CHR ROM, but the file is only %u bytes.",
+			(unsigned)header->prg_rom_size, (unsigned)header->chr_rom_size, (unsigned)size);
+	}
+	return true;
+}
+
+struct Cartridge* NF_createCartridgeWithHeader(const uint8_t* rom_data, size_t size, const uint8_t* header_data) {
+
+	struct Cartridge *Cart = calloc(1, sizeof(struct Cartridge));
+
+	if (Cart == NULL) {
+		printf("Error: Could not create cartridge object. Out of memory?\n");
+		return NULL;
+	}
+
+	char error[NF_CARTRIDGE_ERROR_SIZE];
+	if (!NF_validateCartridge(rom_data, size, header_data, &Cart->header, error, sizeof(error))) {
+		printf("Error: %s\n", error);
 		free(Cart);
-		return 0;
+		return NULL;
 	}
+	struct NF_CartridgeHeader* header = &Cart->header;
+	size_t prg_offset = INES_HEADER_SIZE + (header->has_trainer ? TRAINER_BLOCK_SIZE : 0);
+	size_t chr_offset = prg_offset + header->prg_rom_size;
+
+	// If trainer code exists, store it, otherwise just zero out that block
+	if (header->has_trainer) { memcpy(Cart->trainer, rom_data + INES_HEADER_SIZE, TRAINER_BLOCK_SIZE); }
+	else { memset(Cart->trainer, 0, TRAINER_BLOCK_SIZE); }
 
-	// Copy the PRG ROM and CHR ROM blocks to the cartridge object
-	memcpy(Cart->prg_rom, &rom_data[16 + (Cart->has_trainer ? TRAINER_BLOCK_SIZE : 0)], PRG_ROM_BLOCK_SIZE * Cart->prg_rom_blocks);
-	memcpy(Cart->chr_rom, &rom_data[16 + (Cart->has_trainer ? TRAINER_BLOCK_SIZE : 0) + PRG_ROM_BLOCK_SIZE * Cart->prg_rom_blocks], CHR_ROM_BLOCK_SIZE * Cart->chr_rom_blocks);
+	// PRG ROM and CHR ROM are used in place. Boards without CHR ROM have CHR RAM instead (8KB unless the header
+	// says otherwise, and never less than a bank), which is the only part of the cartridge that needs memory of its own
+	Cart->prg_rom = (uint8_t*)rom_data + prg_offset;
+	Cart->prg_size = header->prg_rom_size;
+	Cart->chr_is_ram = (header->chr_rom_size == 0);
+	if (Cart->chr_is_ram) {
+		Cart->chr_size = header->chr_ram_size + header->chr_nvram_size;
+		if (Cart->chr_size < CHR_MIN_SIZE) { Cart->chr_size = CHR_ROM_BLOCK_SIZE; }
+		Cart->chr_ram = calloc(Cart->chr_size, 1);
+		if (Cart->chr_ram == NULL) {
+			printf("Error: Could not create cartridge object. Could not create CHR RAM buffer. Out of memory?\n");
+			free(Cart);
+			return NULL;
+		}
+		Cart->chr_rom = Cart->chr_ram;
+	}
+	else {
+		Cart->chr_size = header->chr_rom_size;
+		Cart->chr_rom = (uint8_t*)rom_data + chr_offset;
+	}
 	
 	// TO DO: Mapper 355 and 086 use Misc. ROM area following CHR ROM.
 
+	// Nothing is logged until a log is attached
+	Cart->prg_log = Cart->log_sink;
+	Cart->chr_log = Cart->log_sink;
+	Cart->prg_log_mask = 0;
+	Cart->chr_log_mask = 0;
+
+	// Hook up the mapper, which also fills in the bank pointer tables
+	Cart->mapper_impl = NF_getMapper(header->mapper);
+	if (Cart->mapper_impl == NULL) {
+		printf("Error: Mapper %d is not supported.\n", header->mapper);
+		free(Cart->chr_ram);
+		free(Cart);
+		return NULL;
+	}
+	Cart->irq_asserted = false;
+
+	// Volatile and battery backed RAM share the one window. Only the first 8KB is reachable without RAM banking
+	Cart->prg_ram_size = header->prg_ram_size + header->prg_nvram_size;
+	if (Cart->prg_ram_size > 0) {
+		Cart->prg_ram = calloc(Cart->prg_ram_size, 1);
+		if (Cart->prg_ram == NULL) {
+			printf("Error: Could not create cartridge object. Could not create PRG RAM buffer. Out of memory?\n");
+			free(Cart->chr_ram);
+			free(Cart);
+			return NULL;
+		}
+		uint32_t window = PRG_RAM_BLOCK_SIZE;
+		while (window > Cart->prg_ram_size) { window >>= 1; }
+		Cart->prg_ram_mask = (uint16_t)(window - 1);
+	}
+
+	NF_setCartMirroring(Cart, header->mirroring);
+	Cart->mapper_impl->reset(Cart);
+
 	return Cart;
 }
 
-// Helper function, read contents of ROM file into character array
-uint8_t * NF_readROMtoBuffer(const char* filename) {
-	FILE* fileptr;
-	char* buffer;
-	long filelen;
-	fileptr = fopen(filename, "rb");
-	fseek(fileptr, 0, SEEK_END);
-	filelen = ftell(fileptr);
+void NF_setCartridgeDatabase(struct NF_RomDB* db, const struct NF_RomCatalog* catalog, const char* root) {
+	cartridgeDatabase = db;
+	cartridgeCatalog = (root != NULL) ? catalog : NULL;
+	cartridgeCatalogRoot = root;
+}
+
+// Map a ROM file and create a cartridge that reads straight out of the mapping. If the same file is already
+// loaded (by this console or any other in the process), the existing mapping is shared
+static struct Cartridge* loadCartridge(const char* filename, bool attach_save) {
+	struct NF_FileInfo info;
+	if (!NF_getFileInfo(filename, &info)) {
+		printf("Error: Could not find ROM file %s.\n", filename);
+		return NULL;
+	}
+
+	NF_lockMutex(&loadedImagesLock);
+
+	struct NF_RomImage* image = loadedImages;
+	while (image != NULL && !(image->info.device == info.device && image->info.id == info.id &&
+		image->info.size == info.size && image->info.mtime == info.mtime)) {
+		image = image->next;
+	}
+
+	if (image == NULL) {
+		image = calloc(1, sizeof(struct NF_RomImage));
+		if (image == NULL || !NF_mapFileReadOnly(filename, &image->mapping)) {
+			free(image);
+			NF_unlockMutex(&loadedImagesLock);
+			return NULL;
+		}
+		image->info = info;
+		image->next = loadedImages;
+		loadedImages = image;
+	}
+	image->refcount++;
+
+	NF_unlockMutex(&loadedImagesLock);
+
+	// Look the ROM up in the database, and use its header instead of the one in the file if it has one
+	const uint8_t* header_data = image->mapping.data;
+	if (cartridgeDatabase != NULL && image->mapping.size > INES_HEADER_SIZE) {
+		const struct NF_RomCatalogEntry* known = (cartridgeCatalog != NULL) ? NF_RomCatalog_findFile(cartridgeCatalog, cartridgeCatalogRoot, filename, &info) : NULL;
+		const struct NF_RomDBEntry* entry = (known != NULL) ?
+			NF_RomDB_lookup(cartridgeDatabase, known->crc32, (uint32_t)(known->file_size - INES_HEADER_SIZE), known->sha1) :
+			NF_RomDB_lookupRom(cartridgeDatabase, image->mapping.data, image->mapping.size);
+		if (entry != NULL) { header_data = entry->header; }
+	}
+
+	struct Cartridge* cart = NF_createCartridgeWithHeader(image->mapping.data, image->mapping.size, header_data);
+	if (cart == NULL) {
+		NF_releaseRomImage(image);
+		return NULL;
+	}
+	cart->image = image;
+
+	// Saves go next to the ROM, with the extension swapped for .sav
+	if (attach_save && cart->header.has_battery && cart->prg_ram != NULL) {
+		char save_path[1024];
+		snprintf(save_path, sizeof(save_path), "%s", filename);
+		char* dot = strrchr(save_path, '.');
+		char* slash = strrchr(save_path, '/');
+		char* backslash = strrchr(save_path, '\\');
+		if (dot == NULL || (slash != NULL && dot < slash) || (backslash != NULL && dot < backslash)) { dot = save_path + strlen(save_path); }
+		snprintf(dot, sizeof(save_path) - (dot - save_path), ".sav");
+		NF_attachSaveFile(cart, save_path);
+	}
+	return cart;
+}
+
+struct Cartridge* NF_loadCartridge(const char* filename) { return loadCartridge(filename, true); }
+
+struct Cartridge* NF_loadCartridgeWithoutSave(const char* filename) { return loadCartridge(filename, false); }
+
+bool NF_attachSaveFile(struct Cartridge* c, const char* path) {
+	if (c->prg_ram == NULL || c->save_file.data != NULL) { return false; }
+	if (!NF_mapFileReadWrite(path, c->prg_ram_size, &c->save_file)) {
+		printf("Error: Could not use save file %s. Saves will be lost when the emulator exits.\n", path);
+		return false;
+	}
+	free(c->prg_ram);
+	c->prg_ram = c->save_file.data;
+	c->prg_ram_dirty = false;
+	return true;
+}
+
+void NF_flushCartridgeSave(struct Cartridge* c, bool wait) {
+	if (!c->prg_ram_dirty) { return; }
+	c->prg_ram_dirty = false;
+	if (c->save_file.data != NULL) { NF_flushFileMapping(&c->save_file, wait); }
+}
+
+// Drop one reference to a mapped ROM, unmapping it when nobody is using it anymore
+void NF_releaseRomImage(struct NF_RomImage* image) {
+	if (image == NULL) { return; }
+	NF_lockMutex(&loadedImagesLock);
+	if (--image->refcount == 0) {
+		struct NF_RomImage** link = &loadedImages;
+		while (*link != image) { link = &(*link)->next; }
+		*link = image->next;
+		NF_unmapFile(&image->mapping);
+		free(image);
+	}
+	NF_unlockMutex(&loadedImagesLock);
+}
+
+void NF_freeCartridge(struct Cartridge* c) {
+	if (c == NULL) { return; }
+	NF_releaseRomImage(c->image);
+	if (c->save_file.data != NULL) {
+		c->prg_ram_dirty = true;
+		NF_flushCartridgeSave(c, true);
+		NF_unmapFile(&c->save_file);
+	}
+	else { free(c->prg_ram); }
+	free(c->chr_ram);
+	free(c);
+}
+
+// Helper function, read contents of ROM file into a buffer. The caller owns the buffer, and must keep it alive
+// for as long as any cartridge created from it
+uint8_t * NF_readROMtoBuffer(const char* filename, size_t* size) {
+	FILE* fileptr = fopen(filename, "rb");
+	if (fileptr == NULL) {
+		printf("Error: Could not open ROM file %s.\n", filename);
+		return NULL;
+	}
+	long filelen = -1;
+	if (fseek(fileptr, 0, SEEK_END) == 0) { filelen = ftell(fileptr); }
+	if (filelen <= 0) {
+		printf("Error: Could not read the size of ROM file %s.\n", filename);
+		fclose(fileptr);
+		return NULL;
+	}
 	rewind(fileptr);
-	buffer = (uint8_t*)malloc(filelen * sizeof(uint8_t));
-	fread(buffer, filelen, 1, fileptr);
+	uint8_t* buffer = malloc(filelen);
+	if (buffer == NULL) {
+		printf("Error: Could not create ROM buffer. Out of memory?\n");
+		fclose(fileptr);
+		return NULL;
+	}
+	if (fread(buffer, filelen, 1, fileptr) != 1) {
+		printf("Error: Could not read ROM file %s.\n", filename);
+		free(buffer);
+		fclose(fileptr);
+		return NULL;
+	}
 	fclose(fileptr);
+	*size = (size_t)filelen;
 	return buffer;
 }
 
-uint8_t NF_readCartPRG_ROM(struct Cartridge *c, uint16_t address) {
+uint8_t NF_readCartPRG_ROM(struct Cartridge *c, uint16_t address, uint8_t log_flags) {
 
 	if (c == NULL) {
 		printf("Error: There is no cartridge connected to the bus, or no cartridge was passed to read PRG ROM function.\n");
 		return 0;
 	}
 
-	// Mapper 0
-	// If there's 32 KB of prg_rom, it uses the whole address space. Otherwise, if there's 16KB, it's mirrored
-	if (c->prg_rom_blocks == 2) { return c->prg_rom[address - 0x8000]; }
-	else { return c->prg_rom[address - 0xC000]; }
+	// The mapper keeps the pointer tables up to date, so this is the same for every board
+#if NF_CDL_ENABLED
+	c->prg_log_map[(address >> 13) & 0x03][address & 0x1FFF] |= log_flags | (((address >> 13) & 0x03) << NF_CDL_WINDOW_SHIFT);
+#endif
+	return c->prg_map[(address >> 13) & 0x03][address & 0x1FFF];
 }
 
 uint8_t NF_readCartCHR_ROM(struct Cartridge* c, uint16_t address) {
@@ -114,6 +409,61 @@ uint8_t NF_readCartCHR_ROM(struct Cartridge* c, uint16_t address) {
 		return 0;
 	}
 
-	// Mapper 0
-	return c->chr_rom[address];
-}
\ No newline at end of file
+#if NF_CDL_ENABLED
+	c->chr_log_map[(address >> 10) & 0x07][address & 0x03FF] |= NF_CDL_READ;
+#endif
+	return c->chr_map[(address >> 10) & 0x07][address & 0x03FF];
+}
+
+// With no RAM there is nothing driving the data bus, and the value left on it is usually the high byte of the address
+uint8_t NF_readCartPRG_RAM(struct Cartridge* c, uint16_t address) {
+	if (c->prg_ram == NULL) { return address >> 8; }
+	return c->prg_ram[address & c->prg_ram_mask];
+}
+
+uint8_t NF_peekCart(struct Cartridge* c, uint16_t address) {
+	if (address >= 0x8000) { return c->prg_map[(address >> 13) & 0x03][address & 0x1FFF]; }
+	return NF_readCartPRG_RAM(c, address);
+}
+
+// Only real changes mark the RAM dirty, so games that rewrite the same values every frame do not cause flushes
+void NF_writeCartPRG_RAM(struct Cartridge* c, uint16_t address, uint8_t value) {
+	if (c->prg_ram == NULL) { return; }
+	uint8_t* cell = &c->prg_ram[address & c->prg_ram_mask];
+	if (*cell != value) {
+		*cell = value;
+		c->prg_ram_dirty = true;
+	}
+}
+
+void NF_writeCartRegister(struct Cartridge* c, uint16_t address, uint8_t value) {
+	c->mapper_impl->writeRegister(c, address, value);
+}
+
+void NF_writeCartCHR_RAM(struct Cartridge* c, uint16_t address, uint8_t value) {
+	if (c->chr_is_ram) { c->chr_map[(address >> 10) & 0x07][address & 0x03FF] = value; }
+}
+
+// The log tables are rebuilt from the bank tables, which always point somewhere in the ROM
+void NF_setCartCodeDataLog(struct Cartridge* c, uint8_t* prg_flags, uint8_t* chr_flags) {
+	c->prg_log = (prg_flags != NULL) ? prg_flags : c->log_sink;
+	c->prg_log_mask = (prg_flags != NULL) ? UINT32_MAX : 0;
+	c->chr_log = (chr_flags != NULL) ? chr_flags : c->log_sink;
+	c->chr_log_mask = (chr_flags != NULL) ? UINT32_MAX : 0;
+	for (int i = 0; i < 4; i++) { c->prg_log_map[i] = c->prg_log + ((uint32_t)(c->prg_map[i] - c->prg_rom) & c->prg_log_mask); }
+	for (int i = 0; i < 8; i++) { c->chr_log_map[i] = c->chr_log + ((uint32_t)(c->chr_map[i] - c->chr_rom) & c->chr_log_mask); }
+}
+
+// The PPU has 2KB of nametable memory (4KB if the cartridge supplies the extra two nametables), which is
+// divided between the four logical nametables at $2000, $2400, $2800, $2C00
+void NF_setCartMirroring(struct Cartridge* c, SCROLL_MAPPING_TYPE mirroring) {
+	static const uint16_t maps[5][4] = {
+		{ 0x000, 0x000, 0x400, 0x400 },	// Horizontal
+		{ 0x000, 0x400, 0x000, 0x400 },	// Vertical
+		{ 0x000, 0x000, 0x000, 0x000 },	// Single screen, lower bank
+		{ 0x400, 0x400, 0x400, 0x400 },	// Single screen, upper bank
+		{ 0x000, 0x400, 0x800, 0xC00 }	// Four screen
+	};
+	c->nametable_mirroring = mirroring;
+	memcpy(c->nametable_map, maps[mirroring], sizeof(c->nametable_map));
+}
@@ -1,8 +1,19 @@
 #ifndef NF_H_CARTRIDGE
 #define NF_H_CARTRIDGE
+#include "NF_CodeDataLog.h"
+#include "NF_Mapper.h"
+#include "NF_Platform.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct NF_RomImage;
+
+#define INES_HEADER_SIZE 16
+
+// Room for any reason NF_validateCartridge gives for rejecting a ROM
+#define NF_CARTRIDGE_ERROR_SIZE 192
+
 // Two types of headers are supported by this emulator, iNES and NES 2.0
 typedef enum {
 	HEADER_INES,
@@ -11,9 +22,26 @@ typedef enum {
 
 typedef enum {
 	HORIZONTAL_MAPPING,
-	VERTICAL_MAPPING
+	VERTICAL_MAPPING,
+	SINGLE_SCREEN_LOWER_MAPPING,
+	SINGLE_SCREEN_UPPER_MAPPING,
+	FOUR_SCREEN_MAPPING
 } SCROLL_MAPPING_TYPE;
 
+typedef enum {
+	TIMING_NTSC,					// RP2C02
+	TIMING_PAL,						// RP2C07
+	TIMING_MULTI_REGION,
+	TIMING_DENDY					// UA6538
+} CPU_PPU_TIMING;
+
+typedef enum {
+	CONSOLE_NES,
+	CONSOLE_VS_SYSTEM,
+	CONSOLE_PLAYCHOICE_10,
+	CONSOLE_EXTENDED
+} CONSOLE_TYPE;
+
 // iNES and NES 2.0 Header Format for the first seven bytes
 // 0-3:  			Identification String. Must be "NES<EOF>"
 // 4:				Number of blocks of 16KB PRG ROM
@@ -30,34 +58,164 @@ typedef enum {
 // iNES Format
 // 8:              PRG RAM size, in 8kb blocks
 // 9:              Bit 0 is 0 if NTSC, and 1 if PAL. All other bits are set to zero. Most emulators ignore this entirely
-struct Cartridge {
-	uint8_t prg_rom_blocks;		// Blocks of 16kb
-	uint8_t chr_rom_blocks;     // Blocks of 8kb, 0 means the board uses CHR RAM
-	uint8_t prg_ram_blocks;		// Blocks of 8kb
+//
+// NES 2.0 Format
+// 8:				Bit 0-3: Bits 8-11 of mapper number
+//					Bit 4-7: Submapper number
+// 9:				Bit 0-3: Hi-nibble of the PRG ROM size
+//					Bit 4-7: Hi-nibble of the CHR ROM size
+//					If a nibble is $F, the matching size byte is instead EEEEEEMM, meaning 2^E * (MM * 2 + 1) bytes
+// 10:				Bit 0-3: PRG RAM (volatile) shift count, size is 64 << shift bytes, or none if shift is 0
+//					Bit 4-7: PRG NVRAM/EEPROM (battery backed) shift count
+// 11:				Bit 0-3: CHR RAM (volatile) shift count
+//					Bit 4-7: CHR NVRAM (battery backed) shift count
+// 12:				Bit 0-1: CPU/PPU timing (0 for NTSC, 1 for PAL, 2 for Multiple-region, 3 for Dendy)
+// 13:				Vs. System: Bit 0-3 is the PPU type, Bit 4-7 is the hardware type
+//					Extended Console Type: Bit 0-3 is the extended console type
+// 14:				Bit 0-1: Number of miscellaneous ROMs present
+// 15:				Bit 0-5: Default expansion device
+//
+// Both formats are parsed into the same structure. Sizes are always in bytes.
+struct NF_CartridgeHeader {
 	HEADER_TYPE header_type;
+	uint16_t mapper;
+	uint8_t submapper;
+	uint32_t prg_rom_size;
+	uint32_t chr_rom_size;			// 0 means the board uses CHR RAM
+	uint32_t prg_ram_size;
+	uint32_t prg_nvram_size;		// Battery backed PRG RAM
+	uint32_t chr_ram_size;
+	uint32_t chr_nvram_size;
+	SCROLL_MAPPING_TYPE mirroring;	// Hard-wired mirroring, which the mapper may override
 	bool has_battery;
 	bool has_trainer;
+	CONSOLE_TYPE console_type;
+	CPU_PPU_TIMING timing;
+	uint8_t vs_ppu_type;
+	uint8_t vs_hardware_type;
+	uint8_t extended_console_type;
+	uint8_t misc_roms;
+	uint8_t expansion_device;
+};
+
+struct Cartridge {
+	struct NF_CartridgeHeader header;
 	uint8_t trainer[512];
-	uint8_t* prg_rom;
-	uint8_t* chr_rom;
-	uint16_t mapper;
-	uint8_t flag_6;
-	uint8_t flag_7;
+	uint8_t* prg_rom;				// Points into the ROM file (or buffer) the cartridge was made from. Never written
+	uint8_t* chr_rom;				// Same as prg_rom, or points at chr_ram if the board has no CHR ROM
+	uint8_t* chr_ram;
+	struct NF_RomImage* image;		// The shared file mapping backing the ROM, NULL if the cartridge was made from a buffer
 	SCROLL_MAPPING_TYPE nametable_mirroring;
+
+	// Mapper hardware. The pointer tables are what the CPU and PPU actually read through, and they are only
+	// updated when the mapper switches banks
+	const struct NF_Mapper* mapper_impl;
+	union NF_MapperState mapper_state;
+	uint8_t* prg_map[4];			// 8KB windows at $8000, $A000, $C000, $E000
+	uint8_t* chr_map[8];			// 1KB windows at $0000 - $1FFF of the PPU address space
+	uint16_t nametable_map[4];		// Offset into the PPU nametable memory for each of the four logical nametables
+	uint32_t prg_size;
+	uint32_t chr_size;
+	bool chr_is_ram;
+	bool irq_asserted;
+
+	// PRG RAM at $6000-$7FFF. On boards with a battery it lives in a locked mapping of the save file, so no other
+	// console or process can share it. The emulation thread never writes the file itself: at frame boundaries it only
+	// asks the operating system to start writing the changed pages out, and NF_freeCartridge waits for them
+	uint8_t* prg_ram;				// NULL if the board has no PRG RAM
+	uint32_t prg_ram_size;
+	uint16_t prg_ram_mask;			// RAM smaller than 8KB is mirrored across the window
+	struct NF_FileMapping save_file;	// Unmapped (data is NULL) unless the RAM is backed by a save file
+	bool prg_ram_dirty;				// The RAM changed since the last flush
+
+	// Code/data logging (see NF_CodeDataLog.h). The log tables point at the flags of the bytes in each window, and
+	// the mapper keeps them in step with the bank tables. With nothing to log into the masks are 0, so that every
+	// window's flags are log_sink, which only the emulation thread writes
+	uint8_t* prg_log;				// Flags of all of PRG ROM, or log_sink
+	uint8_t* chr_log;				// Flags of all of CHR ROM, or log_sink (also while a render thread logs CHR)
+	uint32_t prg_log_mask;			// Applied to the offset of a bank before adding it to prg_log
+	uint32_t chr_log_mask;
+	uint8_t* prg_log_map[4];
+	uint8_t* chr_log_map[8];
+	uint8_t log_sink[NF_CDL_SINK_SIZE];
 };
 
 
 
-// Load all of the bytes of a file into an array
-uint8_t * NF_readROMtoBuffer(const char* filename);
+// Parse an iNES or NES 2.0 header. Returns false if the header is not valid, with the reason written to error, which
+// holds error_size bytes. Neither function prints anything, so both are safe to call from worker threads
+bool NF_parseCartridgeHeader(const uint8_t* header_data, struct NF_CartridgeHeader* header, char* error, size_t error_size);
 
-// Take the buffer returned by NF_reqadROMtoBuffer and turn it into a Cartridge object
-struct Cartridge * NF_createCartridgeFromBuffer(char* rom_data);
+// Check that a ROM file is usable: the header (taken from header_data, which is normally the start of rom_data) parses
+// and the file is big enough to hold the ROM it describes. Fills in header and returns false (with the reason in error) if not
+bool NF_validateCartridge(const uint8_t* rom_data, size_t size, const uint8_t* header_data, struct NF_CartridgeHeader* header, char* error, size_t error_size);
 
-// Read PRG ROM from a cartridge
-uint8_t NF_readCartPRG_ROM(struct Cartridge* c, uint16_t address);
+// Load all of the bytes of a file into an array, storing the number of bytes read in size
+uint8_t * NF_readROMtoBuffer(const char* filename, size_t* size);
 
-// Read CHR ROM from a cartridge
+// Take the buffer returned by NF_readROMtoBuffer and turn it into a Cartridge object. No copy of the ROM is made,
+// so the buffer has to stay alive for as long as the cartridge does
+struct Cartridge * NF_createCartridgeFromBuffer(const uint8_t* rom_data, size_t size);
+
+// Same as NF_createCartridgeFromBuffer, but the board is described by header_data instead of the header in the file.
+// This is how corrected headers from the ROM database are applied
+struct Cartridge* NF_createCartridgeWithHeader(const uint8_t* rom_data, size_t size, const uint8_t* header_data);
+
+// Map a ROM file read-only and turn it into a Cartridge object. Cartridges loaded from the same file share one mapping.
+// If a ROM database has been set with NF_setCartridgeDatabase, headers it knows to be wrong are corrected
+struct Cartridge* NF_loadCartridge(const char* filename);
+
+// Same as NF_loadCartridge, but battery backed RAM starts out zero and is never saved. For runs that must be the same
+// every time, whatever the player has saved, and must not change the save (benchmarks, for one)
+struct Cartridge* NF_loadCartridgeWithoutSave(const char* filename);
+
+// Use a ROM database to correct headers of cartridges loaded with NF_loadCartridge. Pass NULL to stop using one.
+// ROMs are looked up by the hashes in a catalog (see NF_RomCatalog.h) of the directory root, so loading them does not
+// hash them again. Only ROMs the catalog does not have, or that changed since it was made, are hashed as they load.
+// catalog and root may be NULL, for hashing every ROM
+struct NF_RomDB;
+struct NF_RomCatalog;
+void NF_setCartridgeDatabase(struct NF_RomDB* db, const struct NF_RomCatalog* catalog, const char* root);
+
+// Drop one reference to a shared ROM mapping
+void NF_releaseRomImage(struct NF_RomImage* image);
+
+// Destroy a cartridge, releasing its ROM mapping and any memory it owns. Battery backed RAM is flushed to disk first
+void NF_freeCartridge(struct Cartridge* c);
+
+// Read PRG ROM from a cartridge, setting log_flags (NF_CDL flags) on the byte in the code/data log
+uint8_t NF_readCartPRG_ROM(struct Cartridge* c, uint16_t address, uint8_t log_flags);
+
+// Read and write PRG RAM ($6000-$7FFF)
+uint8_t NF_readCartPRG_RAM(struct Cartridge* c, uint16_t address);
+void NF_writeCartPRG_RAM(struct Cartridge* c, uint16_t address, uint8_t value);
+
+// Back the PRG RAM of a battery backed board with a save file, creating the file if it does not exist yet.
+// NF_loadCartridge does this on its own, using the ROM's file name with a .sav extension. Returns false (and prints
+// why) if the file cannot be used, or is in use by another console or process. The RAM is then not saved at all
+bool NF_attachSaveFile(struct Cartridge* c, const char* path);
+
+// Write battery backed RAM to disk if it changed since the last flush. With wait false the write is only started
+// (msync with MS_ASYNC, or FlushViewOfFile), which is cheap enough to do every frame
+void NF_flushCartridgeSave(struct Cartridge* c, bool wait);
+
+// Read the CPU side of a cartridge ($6000-$FFFF) without any side effects on the board. None of the supported boards
+// react to reads, but ones that do (MMC2's CHR latches, MMC5) must leave that out of here
+uint8_t NF_peekCart(struct Cartridge* c, uint16_t address);
+
+// Read CHR ROM from a cartridge, for the CPU (through PPUDATA). The byte is logged as read
 uint8_t NF_readCartCHR_ROM(struct Cartridge* c, uint16_t address);
 
+// Write to the cartridge from the CPU side ($8000-$FFFF). These are the mapper registers
+void NF_writeCartRegister(struct Cartridge* c, uint16_t address, uint8_t value);
+
+// Write to CHR memory from the PPU side. Only has an effect if the board uses CHR RAM
+void NF_writeCartCHR_RAM(struct Cartridge* c, uint16_t address, uint8_t value);
+
+// Start logging into the PRG ROM and CHR ROM flags of a code/data log, or stop with NULL. Either can be NULL on its own
+void NF_setCartCodeDataLog(struct Cartridge* c, uint8_t* prg_flags, uint8_t* chr_flags);
+
+// Change the nametable mirroring, updating the nametable map used by the PPU
+void NF_setCartMirroring(struct Cartridge* c, SCROLL_MAPPING_TYPE mirroring);
+
 #endif
\ No newline at end of file
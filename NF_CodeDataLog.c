@@ -0,0 +1,103 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_CodeDataLog.h"
+#include "NF_Cartridge.h"
+#include "NF_Platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PRG_BANK_SIZE 0x2000
+#define CHR_BANK_SIZE 0x0400
+
+struct NF_CodeDataLog* NF_CodeDataLog_create(struct Cartridge* cart) {
+	struct NF_CodeDataLog* log = calloc(1, sizeof(struct NF_CodeDataLog));
+	if (log == NULL) {
+		printf("Error: Could not create code/data log. Out of memory?\n");
+		return NULL;
+	}
+	log->prg_size = cart->prg_size;
+	log->chr_size = cart->chr_is_ram ? 0 : cart->chr_size;
+	log->prg = calloc(log->prg_size + log->chr_size, 1);
+	if (log->prg == NULL) {
+		printf("Error: Could not create code/data log. Out of memory?\n");
+		free(log);
+		return NULL;
+	}
+	log->chr = (log->chr_size > 0) ? log->prg + log->prg_size : NULL;
+	return log;
+}
+
+void NF_CodeDataLog_free(struct NF_CodeDataLog* log) {
+	if (log == NULL) { return; }
+	free(log->prg);
+	free(log);
+}
+
+bool NF_CodeDataLog_load(struct NF_CodeDataLog* log, const char* path) {
+	size_t size = (size_t)log->prg_size + log->chr_size;
+	struct NF_FileInfo info;
+	if (!NF_getFileInfo(path, &info) || info.size != size) {
+		printf("Error: %s is not a code/data log of this ROM (%zu bytes expected).\n", path, size);
+		return false;
+	}
+	FILE* file = fopen(path, "rb");
+	uint8_t* flags = malloc(size);
+	bool ok = file != NULL && flags != NULL && fread(flags, 1, size, file) == size;
+	if (file != NULL) { fclose(file); }
+	if (ok) {
+		for (size_t i = 0; i < size; i++) { log->prg[i] |= flags[i]; }
+	}
+	else { printf("Error: Could not read code/data log %s.\n", path); }
+	free(flags);
+	return ok;
+}
+
+bool NF_CodeDataLog_save(const struct NF_CodeDataLog* log, const char* path) {
+	char tmp_path[1024];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	FILE* file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		printf("Error: Could not open %s for writing.\n", tmp_path);
+		return false;
+	}
+	size_t size = (size_t)log->prg_size + log->chr_size;
+	bool ok = fwrite(log->prg, 1, size, file) == size;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok || !NF_replaceFile(tmp_path, path)) {
+		printf("Error: Could not write code/data log %s.\n", path);
+		remove(tmp_path);
+		return false;
+	}
+	return true;
+}
+
+bool NF_CodeDataLog_writeSummary(const struct NF_CodeDataLog* log, FILE* file) {
+	fprintf(file, "PRG bank      code  instructions      data    unused\n");
+	for (uint32_t start = 0; start < log->prg_size; start += PRG_BANK_SIZE) {
+		uint32_t code = 0, instructions = 0, data = 0, unused = 0;
+		uint32_t end = (start + PRG_BANK_SIZE < log->prg_size) ? start + PRG_BANK_SIZE : log->prg_size;
+		for (uint32_t i = start; i < end; i++) {
+			uint8_t flags = log->prg[i];
+			if (flags & NF_CDL_CODE) { code++; }
+			if (flags & NF_CDL_OPCODE) { instructions++; }
+			if (flags & (NF_CDL_DATA | NF_CDL_PCM)) { data++; }
+			if (flags == 0) { unused++; }
+		}
+		fprintf(file, "%8X  %8u  %12u  %8u  %8u\n", start / PRG_BANK_SIZE, code, instructions, data, unused);
+	}
+
+	if (log->chr_size > 0) { fprintf(file, "\nCHR bank  rendered      read    unused\n"); }
+	for (uint32_t start = 0; start < log->chr_size; start += CHR_BANK_SIZE) {
+		uint32_t rendered = 0, read = 0, unused = 0;
+		uint32_t end = (start + CHR_BANK_SIZE < log->chr_size) ? start + CHR_BANK_SIZE : log->chr_size;
+		for (uint32_t i = start; i < end; i++) {
+			uint8_t flags = log->chr[i];
+			if (flags & NF_CDL_RENDERED) { rendered++; }
+			if (flags & NF_CDL_READ) { read++; }
+			if (flags == 0) { unused++; }
+		}
+		fprintf(file, "%8X  %8u  %8u  %8u\n", start / CHR_BANK_SIZE, rendered, read, unused);
+	}
+	return !ferror(file);
+}
@@ -0,0 +1,88 @@
+#ifndef NF_H_CODEDATALOG
+#define NF_H_CODEDATALOG
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A code/data logger: flags for every byte of PRG ROM and CHR ROM saying how the game has used it, for static
+// disassembly and for finding code and graphics that never get used. While a log is attached to a console (see
+// NF_setCodeDataLog), every read of PRG ROM by the CPU and every byte of CHR ROM the PPU draws from sets flags.
+//
+// The cartridge keeps a table of where the flags of each of its windows are, next to the bank table, and the mapper
+// keeps both up to date. Marking a byte is an OR through that table, with no check of whether a log is attached:
+// without one, the table points every window at a small scratch array on the cartridge that nothing reads. Building
+// with NF_CDL_ENABLED defined as 0 takes the marking out altogether.
+//
+// The flags of CHR ROM are only ever set by one thread, the one that draws the lines. With a render thread that is the
+// render thread, which is also handed the PPUDATA reads in the journal, and the emulation thread's CHR windows point
+// at the scratch array. A console that draws nothing (headless, with no frame output) logs no CHR as drawn, since
+// working out sprite 0 hit and overflow is not drawing.
+//
+// The file is the .cdl layout of FCEUX: a byte of flags for every byte of PRG ROM, in ROM order, followed by one for
+// every byte of CHR ROM (none if the board has CHR RAM). The flags of a PRG ROM byte are:
+//
+// Bit 0:			Run as code (an opcode or an operand)
+// Bit 1:			Read as data
+// Bit 2-3:			Which 8KB window of the CPU ($8000, $A000, $C000, $E000) the byte was read through
+// Bit 4:			Not logged (code reached through JMP ($nnnn))
+// Bit 5:			Not logged (data read through a pointer)
+// Bit 6:			Read by the DMC as sample data
+// Bit 7:			The first byte of an instruction. FCEUX leaves this bit unused, and ignores it
+//
+// And of a CHR ROM byte:
+//
+// Bit 0:			Drawn by the PPU
+// Bit 1:			Read by the CPU through PPUDATA
+
+#ifndef NF_CDL_ENABLED
+#define NF_CDL_ENABLED 1
+#endif
+
+#define NF_CDL_CODE 0x01
+#define NF_CDL_DATA 0x02
+#define NF_CDL_WINDOW_SHIFT 2
+#define NF_CDL_PCM 0x40
+#define NF_CDL_OPCODE 0x80
+
+#define NF_CDL_RENDERED 0x01
+#define NF_CDL_READ 0x02
+
+// What the CPU reads a byte for, as PRG ROM flags
+#define NF_CDL_FETCH_OPCODE (NF_CDL_CODE | NF_CDL_OPCODE)
+#define NF_CDL_FETCH_OPERAND NF_CDL_CODE
+
+// Enough for the largest window, an 8KB one of PRG ROM
+#define NF_CDL_SINK_SIZE 0x2000
+
+// Set what the CPU's reads are for, until it is set again
+#if NF_CDL_ENABLED
+#define NF_CDL_SET_ACCESS(console, flags) ((console)->log_access = (flags))
+#else
+#define NF_CDL_SET_ACCESS(console, flags) ((void)0)
+#endif
+
+struct Cartridge;
+
+struct NF_CodeDataLog {
+	uint8_t* prg;					// Flags of every byte of PRG ROM
+	uint32_t prg_size;
+	uint8_t* chr;					// And of CHR ROM. NULL if the board has CHR RAM
+	uint32_t chr_size;
+};
+
+// Create an empty log for a cartridge. Returns NULL (and prints why) if there is no memory for it
+struct NF_CodeDataLog* NF_CodeDataLog_create(struct Cartridge* cart);
+void NF_CodeDataLog_free(struct NF_CodeDataLog* log);
+
+// Add the flags in a .cdl file to a log, so that logging can carry on over several runs. Returns false (and prints
+// why) if the file cannot be read or is for a ROM of another size
+bool NF_CodeDataLog_load(struct NF_CodeDataLog* log, const char* path);
+
+// Write a log out as a .cdl file. Returns false (and prints why) if the file cannot be written
+bool NF_CodeDataLog_save(const struct NF_CodeDataLog* log, const char* path);
+
+// Write a line for each 8KB bank of PRG ROM with how many of its bytes were run as code (and how many instructions
+// start in it), read as data, or never used, and the same for each 1KB bank of CHR ROM
+bool NF_CodeDataLog_writeSummary(const struct NF_CodeDataLog* log, FILE* file);
+
+#endif
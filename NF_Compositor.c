@@ -0,0 +1,186 @@
+#include "NF_Compositor.h"
+#include "NF_Frame.h"
+#include "NF_Platform.h"
+#include <stdio.h>
+
+#ifdef NF_X86
+#include <immintrin.h>
+#endif
+
+// PPUMASK bits that show each layer in the leftmost 8 pixels
+#define SHOW_BACKGROUND_LEFT 0x02
+#define SHOW_SPRITES_LEFT 0x04
+
+#ifdef NF_X86
+
+// Each block works out, for every pixel at once, whether the sprite wins, and whether it is a sprite 0 hit. Hidden
+// left columns are handled by clearing the first 8 bytes of the first block. The hit search stops at the first block
+// that has one, and the last pixel of the line is left out of it
+static int compositeSSE2(const uint8_t* background, const uint8_t* sprites, uint8_t mask, uint8_t* out) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i index_bits = _mm_set1_epi8(NF_SPRITE_PIXEL_INDEX);
+	const __m128i zero_bit = _mm_set1_epi8(NF_SPRITE_PIXEL_ZERO);
+	const __m128i behind_bit = _mm_set1_epi8((char)NF_SPRITE_PIXEL_BEHIND);
+	const __m128i all = _mm_set1_epi8(-1);
+	const __m128i left = _mm_set_epi32(-1, -1, 0, 0);
+	__m128i background_left = (mask & SHOW_BACKGROUND_LEFT) ? all : left;
+	__m128i sprites_left = (mask & SHOW_SPRITES_LEFT) ? all : left;
+	int hit = -1;
+
+	for (int x = 0; x < NF_FRAME_WIDTH; x += 16) {
+		__m128i bg = _mm_loadu_si128((const __m128i*)(background + x));
+		__m128i sp = _mm_loadu_si128((const __m128i*)(sprites + x));
+		if (x == 0) {
+			bg = _mm_and_si128(bg, background_left);
+			sp = _mm_and_si128(sp, sprites_left);
+		}
+		__m128i color = _mm_and_si128(sp, index_bits);
+		__m128i bg_clear = _mm_cmpeq_epi8(bg, zero);
+		__m128i sp_clear = _mm_cmpeq_epi8(color, zero);
+		__m128i in_front = _mm_cmpeq_epi8(_mm_and_si128(sp, behind_bit), zero);
+		__m128i sprite_wins = _mm_andnot_si128(sp_clear, _mm_or_si128(bg_clear, in_front));
+		_mm_storeu_si128((__m128i*)(out + x), _mm_or_si128(_mm_and_si128(sprite_wins, color), _mm_andnot_si128(sprite_wins, bg)));
+
+		if (hit < 0) {
+			__m128i from_zero = _mm_cmpeq_epi8(_mm_and_si128(sp, zero_bit), zero_bit);
+			uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_andnot_si128(_mm_or_si128(bg_clear, sp_clear), from_zero));
+			if (x == NF_FRAME_WIDTH - 16) { hits &= 0x7FFF; }
+			if (hits != 0) { hit = x + NF_lowestSetBit(hits); }
+		}
+	}
+	return hit;
+}
+
+NF_TARGET("avx2")
+static int compositeAVX2(const uint8_t* background, const uint8_t* sprites, uint8_t mask, uint8_t* out) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i index_bits = _mm256_set1_epi8(NF_SPRITE_PIXEL_INDEX);
+	const __m256i zero_bit = _mm256_set1_epi8(NF_SPRITE_PIXEL_ZERO);
+	const __m256i behind_bit = _mm256_set1_epi8((char)NF_SPRITE_PIXEL_BEHIND);
+	const __m256i all = _mm256_set1_epi8(-1);
+	const __m256i left = _mm256_set_epi64x(-1, -1, -1, 0);
+	__m256i background_left = (mask & SHOW_BACKGROUND_LEFT) ? all : left;
+	__m256i sprites_left = (mask & SHOW_SPRITES_LEFT) ? all : left;
+	int hit = -1;
+
+	for (int x = 0; x < NF_FRAME_WIDTH; x += 32) {
+		__m256i bg = _mm256_loadu_si256((const __m256i*)(background + x));
+		__m256i sp = _mm256_loadu_si256((const __m256i*)(sprites + x));
+		if (x == 0) {
+			bg = _mm256_and_si256(bg, background_left);
+			sp = _mm256_and_si256(sp, sprites_left);
+		}
+		__m256i color = _mm256_and_si256(sp, index_bits);
+		__m256i bg_clear = _mm256_cmpeq_epi8(bg, zero);
+		__m256i sp_clear = _mm256_cmpeq_epi8(color, zero);
+		__m256i in_front = _mm256_cmpeq_epi8(_mm256_and_si256(sp, behind_bit), zero);
+		__m256i sprite_wins = _mm256_andnot_si256(sp_clear, _mm256_or_si256(bg_clear, in_front));
+		_mm256_storeu_si256((__m256i*)(out + x), _mm256_blendv_epi8(bg, color, sprite_wins));
+
+		if (hit < 0) {
+			__m256i from_zero = _mm256_cmpeq_epi8(_mm256_and_si256(sp, zero_bit), zero_bit);
+			uint32_t hits = (uint32_t)_mm256_movemask_epi8(_mm256_andnot_si256(_mm256_or_si256(bg_clear, sp_clear), from_zero));
+			if (x == NF_FRAME_WIDTH - 32) { hits &= 0x7FFFFFFF; }
+			if (hits != 0) { hit = x + NF_lowestSetBit(hits); }
+		}
+	}
+	return hit;
+}
+
+#endif
+
+// The reference the SIMD versions are checked against, and what runs where they cannot
+static int compositeScalar(const uint8_t* background, const uint8_t* sprites, uint8_t mask, uint8_t* out) {
+	int hit = -1;
+	for (int x = 0; x < NF_FRAME_WIDTH; x++) {
+		uint8_t bg = background[x];
+		uint8_t sp = sprites[x];
+		if (x < 8 && !(mask & SHOW_BACKGROUND_LEFT)) { bg = 0; }
+		if (x < 8 && !(mask & SHOW_SPRITES_LEFT)) { sp = 0; }
+		uint8_t color = sp & NF_SPRITE_PIXEL_INDEX;
+		if (hit < 0 && bg != 0 && color != 0 && (sp & NF_SPRITE_PIXEL_ZERO) && x != NF_FRAME_WIDTH - 1) { hit = x; }
+		out[x] = (color != 0 && (bg == 0 || !(sp & NF_SPRITE_PIXEL_BEHIND))) ? color : bg;
+	}
+	return hit;
+}
+
+typedef int (*CompositeFunction)(const uint8_t* background, const uint8_t* sprites, uint8_t mask, uint8_t* out);
+
+struct CompositeVersion {
+	const char* name;
+	CompositeFunction function;
+	int feature;					// The NF_CPU_FEATURE it needs, or -1 if it runs on any processor it is built for
+};
+
+// Fastest first. SSE2 is part of the x86 baseline, so it needs no check
+static const struct CompositeVersion compositeVersions[] = {
+#ifdef NF_X86
+	{ "AVX2", compositeAVX2, NF_CPU_AVX2 },
+	{ "SSE2", compositeSSE2, -1 },
+#endif
+	{ "scalar", compositeScalar, -1 }
+};
+
+#define COMPOSITE_VERSION_COUNT (int)(sizeof(compositeVersions) / sizeof(compositeVersions[0]))
+
+static bool canRun(const struct CompositeVersion* version) {
+	return version->feature < 0 || NF_cpuHasFeature((NF_CPU_FEATURE)version->feature);
+}
+
+// The version in use is picked once, whichever of the emulation and render threads draws first
+static NF_Once compositeSetup = NF_ONCE_INIT;
+static CompositeFunction composite;
+
+static void pickComposite(void) {
+	int i = 0;
+	while (!canRun(&compositeVersions[i])) { i++; }
+	composite = compositeVersions[i].function;
+}
+
+int NF_compositeLine(const uint8_t* background, const uint8_t* sprites, uint8_t mask, uint8_t* out) {
+	NF_callOnce(&compositeSetup, pickComposite);
+	return composite(background, sprites, mask, out);
+}
+
+// Lines for NF_checkCompositor, with every combination of the left column bits
+#define CHECK_LINES 4096
+
+static uint32_t nextRandom(uint32_t* seed) {
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed >> 8;
+}
+
+// Random layers, about half transparent, with sprite 0 pixels only from a random x on, so that hits turn up all over
+// the line (the leftmost 8 pixels and the last pixel included) as well as not at all
+bool NF_checkCompositor(void) {
+	uint8_t background[NF_FRAME_WIDTH], sprites[NF_FRAME_WIDTH], expected[NF_FRAME_WIDTH], out[NF_FRAME_WIDTH];
+	uint32_t seed = 1;
+	bool ok = true;
+	for (int line = 0; line < CHECK_LINES; line++) {
+		uint8_t mask = (uint8_t)(line & (SHOW_BACKGROUND_LEFT | SHOW_SPRITES_LEFT));
+		uint32_t zero_start = nextRandom(&seed) % (NF_FRAME_WIDTH + 16);
+		for (int x = 0; x < NF_FRAME_WIDTH; x++) {
+			uint32_t r = nextRandom(&seed);
+			background[x] = (r & 1) ? (uint8_t)((r >> 1) & 0x0F) : 0;
+			sprites[x] = (r & 6) ? 0 : (uint8_t)(0x10 | ((r >> 5) & 0x0F));
+			if (r & 0x200) { sprites[x] |= NF_SPRITE_PIXEL_BEHIND; }
+			if ((uint32_t)x >= zero_start && (r & 0x400)) { sprites[x] |= NF_SPRITE_PIXEL_ZERO; }
+		}
+		int expected_hit = compositeScalar(background, sprites, mask, expected);
+
+		for (int i = 0; i < COMPOSITE_VERSION_COUNT - 1; i++) {
+			if (!canRun(&compositeVersions[i])) { continue; }
+			int hit = compositeVersions[i].function(background, sprites, mask, out);
+			int x = 0;
+			while (x < NF_FRAME_WIDTH && out[x] == expected[x]) { x++; }
+			if (hit != expected_hit || x < NF_FRAME_WIDTH) {
+				printf("Error: The %s compositor differs from the scalar one on line %d: ", compositeVersions[i].name, line);
+				if (x < NF_FRAME_WIDTH) { printf("pixel %d is %02X, not %02X.\n", x, out[x], expected[x]); }
+				else { printf("sprite 0 hit at %d, not %d.\n", hit, expected_hit); }
+				ok = false;
+			}
+		}
+		if (!ok) { break; }
+	}
+	return ok;
+}
@@ -0,0 +1,30 @@
+#ifndef NF_H_COMPOSITOR
+#define NF_H_COMPOSITOR
+#include <stdbool.h>
+#include <stdint.h>
+
+// Combines the background and sprite layers of a scanline into palette RAM indices, 16 or 32 pixels at a time with
+// SSE2 or AVX2 where the processor has them, and one pixel at a time where it has neither. Both layers are arrays of
+// NF_FRAME_WIDTH bytes:
+//
+// Background:	Palette RAM index (palette * 4 + color), 0 where transparent
+// Sprites:		Bits 0-4: Palette RAM index (16 + palette * 4 + color), 0 where transparent
+//				Bit 6: The pixel came from sprite 0
+//				Bit 7: The sprite is behind the background
+//
+// A sprite pixel wins over the background unless it is transparent, or it is behind an opaque background pixel.
+
+#define NF_SPRITE_PIXEL_INDEX 0x1F
+#define NF_SPRITE_PIXEL_ZERO 0x40
+#define NF_SPRITE_PIXEL_BEHIND 0x80
+
+// Composite one scanline into out, hiding the leftmost 8 pixels of each layer as bits 1 and 2 of PPUMASK say. Pixels
+// where both layers are transparent come out as 0, the backdrop. Returns the x of the first sprite 0 hit (an opaque
+// sprite 0 pixel over an opaque background pixel, never at x = 255), or -1 if there is none
+int NF_compositeLine(const uint8_t* background, const uint8_t* sprites, uint8_t mask, uint8_t* out);
+
+// Run random scanlines through every version of the compositor this processor can run, and compare each with the
+// one pixel at a time version. Returns false (and prints the first difference) if any of them disagree
+bool NF_checkCompositor(void);
+
+#endif
@@ -0,0 +1,42 @@
+#include "NF_Controller.h"
+#include <string.h>
+
+// The upper bits of a controller read are whatever was last on the data bus, which is the high byte of the address
+#define CONTROLLER_OPEN_BUS 0x40
+
+void NF_Controller_writeStrobe(struct NF_Controller* controller, uint8_t value) {
+	controller->strobe = (value & 0x01) != 0;
+	if (controller->strobe) { controller->shift_register = controller->buttons; }
+}
+
+uint8_t NF_Controller_peek(const struct NF_Controller* controller) {
+	// While the strobe is held, the register keeps reloading, so every read returns the A button
+	if (controller->strobe) { return CONTROLLER_OPEN_BUS | (controller->buttons & 0x01); }
+	return CONTROLLER_OPEN_BUS | (controller->shift_register & 0x01);
+}
+
+uint8_t NF_Controller_read(struct NF_Controller* controller) {
+	uint8_t value = NF_Controller_peek(controller);
+	if (!controller->strobe) { controller->shift_register = (controller->shift_register >> 1) | 0x80; }
+	return value;
+}
+
+void NF_InputQueue_init(struct NF_InputQueue* queue) { memset(queue, 0, sizeof(struct NF_InputQueue)); }
+
+bool NF_InputQueue_push(struct NF_InputQueue* queue, uint8_t port, uint8_t buttons) {
+	uint32_t write = queue->write_index;
+	if (write - NF_atomicLoadAcquire(&queue->read_index) >= NF_INPUT_QUEUE_SIZE) { return false; }
+	queue->entries[write % NF_INPUT_QUEUE_SIZE] = (uint16_t)((port << 8) | buttons);
+	NF_atomicStoreRelease(&queue->write_index, write + 1);
+	return true;
+}
+
+bool NF_InputQueue_pop(struct NF_InputQueue* queue, uint8_t* port, uint8_t* buttons) {
+	uint32_t read = queue->read_index;
+	if (NF_atomicLoadAcquire(&queue->write_index) == read) { return false; }
+	uint16_t entry = queue->entries[read % NF_INPUT_QUEUE_SIZE];
+	*port = (uint8_t)(entry >> 8);
+	*buttons = (uint8_t)entry;
+	NF_atomicStoreRelease(&queue->read_index, read + 1);
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef NF_H_CONTROLLER
+#define NF_H_CONTROLLER
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// The standard controller is an 8 bit shift register. Writing 1 to bit 0 of $4016 (the strobe) keeps reloading it
+// from the buttons, and once the strobe goes back to 0 every read of $4016 (port 1) or $4017 (port 2) returns the
+// next button in bit 0, in this order: A, B, Select, Start, Up, Down, Left, Right. After all eight, reads return 1.
+//
+// Buttons are passed around as a mask with one bit per button, in the same order as they are shifted out
+
+typedef enum {
+	NF_BUTTON_A = 0b00000001,
+	NF_BUTTON_B = 0b00000010,
+	NF_BUTTON_SELECT = 0b00000100,
+	NF_BUTTON_START = 0b00001000,
+	NF_BUTTON_UP = 0b00010000,
+	NF_BUTTON_DOWN = 0b00100000,
+	NF_BUTTON_LEFT = 0b01000000,
+	NF_BUTTON_RIGHT = 0b10000000
+} NF_BUTTON;
+
+#define NF_CONTROLLER_PORTS 2
+
+struct NF_Controller {
+	uint8_t buttons;				// Buttons held right now, as NF_BUTTON bits
+	uint8_t shift_register;			// Buttons latched by the strobe, shifted out one per read
+	bool strobe;
+};
+
+// Write to $4016. Both ports share the strobe line
+void NF_Controller_writeStrobe(struct NF_Controller* controller, uint8_t value);
+
+// Read from $4016 or $4017. Only bit 0 comes from the controller, the rest is open bus
+uint8_t NF_Controller_read(struct NF_Controller* controller);
+
+// What a read would return, without shifting the next button in
+uint8_t NF_Controller_peek(const struct NF_Controller* controller);
+
+// Carries button changes from the thread reading the keyboard to the thread running the console. Single producer,
+// single consumer: only one thread may push and only one may pop, and neither ever waits on the other. Each entry is
+// the full state of one port, so the consumer only needs the last entry for each port
+#define NF_INPUT_QUEUE_SIZE 64
+
+struct NF_InputQueue {
+	uint16_t entries[NF_INPUT_QUEUE_SIZE];	// Port in the high byte, buttons in the low byte
+	volatile uint32_t write_index;			// Only written by the producer. Counts up forever, wrapping at 2^32
+	uint8_t pad0[NF_CACHE_LINE_SIZE - sizeof(uint32_t)];
+	volatile uint32_t read_index;			// Only written by the consumer
+	uint8_t pad1[NF_CACHE_LINE_SIZE - sizeof(uint32_t)];
+};
+
+void NF_InputQueue_init(struct NF_InputQueue* queue);
+
+// Producer side. Returns false if the queue is full, in which case the change is lost
+bool NF_InputQueue_push(struct NF_InputQueue* queue, uint8_t port, uint8_t buttons);
+
+// Consumer side. Returns false if the queue is empty
+bool NF_InputQueue_pop(struct NF_InputQueue* queue, uint8_t* port, uint8_t* buttons);
+
+#endif
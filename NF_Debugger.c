@@ -1,4 +1,4 @@
-#include "NF_6502.h"
+#include "NF_Debugger.h"
 #include "NF_PPU.h"
 #include <stdio.h>
 #include <stdint.h>
@@ -23,93 +23,75 @@ const char* opcodeToString(OPCODE_6502 value) {
 };
 
 
-char builtStringBuffer[50];
-
-// Build strings for debugging such that they match the format output by nestest.nes
-const char* buildFetchString(struct Processor *CPU) {
-
-
-	ADDRESS_MODE_6502 addr_mode = charToAddressModeArray[NF_readMemory(CPU->bus, CPU->last_pc)];
-	OPCODE_6502 opcode = charToOpcodeArray[NF_readMemory(CPU->bus, CPU->last_pc)];
-	//printf("last_pc: %02X, AM_MODE: %d\n", CPU->last_pc, addr_mode);
-	uint16_t lo;
-	uint16_t hi;
+// Build the operand part of a line such that it matches the format output by nestest.nes
+static void buildOperandString(const struct NF_TraceRecord* record, char* buffer, size_t size) {
+	ADDRESS_MODE_6502 addr_mode = charToAddressModeArray[record->bytes[0]];
+	OPCODE_6502 opcode = charToOpcodeArray[record->bytes[0]];
+	uint8_t lo = record->bytes[1];
+	uint8_t hi = record->bytes[2];
 	switch (addr_mode) {
 	case AM_ABS:
-		if (opcode == OP_JSR || opcode == OP_JMP) { sprintf(builtStringBuffer, "$%02X%02X                      ", NF_readMemory(CPU->bus, CPU->last_pc + 2), NF_readMemory(CPU->bus, CPU->last_pc + 1)); }
-		else { 
-			hi = NF_readMemory(CPU->bus, CPU->last_pc + 2);
-			lo  = NF_readMemory(CPU->bus, CPU->last_pc + 1);
-			if (opcode == OP_STX || opcode == OP_STY || opcode == OP_STA) { sprintf(builtStringBuffer, "$%02X%02X = %02X                 ", hi, lo, NF_readMemory(CPU->bus, (hi << 8) | lo)); }
-			else { sprintf(builtStringBuffer, "$%02X%02X = %02X                 ", hi, lo, NF_readMemory(CPU->bus, (hi << 8) | lo)); }
-		}
+		if (opcode == OP_JSR || opcode == OP_JMP) { snprintf(buffer, size, "$%02X%02X                      ", hi, lo); }
+		else { snprintf(buffer, size, "$%02X%02X = %02X                 ", hi, lo, record->value); }
 		break;
 	case AM_IND:
-		sprintf(builtStringBuffer, "($%02X%02X) = %04X             ", NF_readMemory(CPU->bus, CPU->last_pc + 2), NF_readMemory(CPU->bus, CPU->last_pc + 1), CPU->fetched_address);
+		snprintf(buffer, size, "($%02X%02X) = %04X             ", hi, lo, record->address);
 		break;
 	case AM_IMM:
-		sprintf(builtStringBuffer, "#$%02X                       ", NF_readMemory(CPU->bus, CPU->last_pc + 1));
+		snprintf(buffer, size, "#$%02X                       ", lo);
 		break;
 	case AM_ZPG:
-		sprintf(builtStringBuffer, "$%02X = %02X                   ", NF_readMemory(CPU->bus, CPU->last_pc + 1), CPU->fetched);
+		snprintf(buffer, size, "$%02X = %02X                   ", lo, record->value);
 		break;
 	case AM_ZPX:
-		sprintf(builtStringBuffer, "$%02X,X @ %02X = %02X            ", NF_readMemory(CPU->bus, CPU->last_pc + 1), (uint8_t)((uint8_t)CPU->X + (uint8_t)NF_readMemory(CPU->bus, CPU->last_pc + 1)), CPU->fetched);
+		snprintf(buffer, size, "$%02X,X @ %02X = %02X            ", lo, (uint8_t)(record->x + lo), record->value);
 		break;
 	case AM_ZPY:
-		sprintf(builtStringBuffer, "$%02X,Y @ %02X = %02X            ", NF_readMemory(CPU->bus, CPU->last_pc + 1), (uint8_t)((uint8_t)CPU->Y + (uint8_t)NF_readMemory(CPU->bus, CPU->last_pc + 1)), CPU->fetched);
+		snprintf(buffer, size, "$%02X,Y @ %02X = %02X            ", lo, (uint8_t)(record->y + lo), record->value);
 		break;
 	case AM_INX:
-		sprintf(builtStringBuffer, "($%02X,X) @ %02X = %04X = %02X   ", NF_readMemory(CPU->bus, CPU->last_pc + 1), (uint8_t)(CPU->X + NF_readMemory(CPU->bus, CPU->last_pc + 1)), CPU->fetched_address, CPU->fetched);
+		snprintf(buffer, size, "($%02X,X) @ %02X = %04X = %02X   ", lo, (uint8_t)(record->x + lo), record->address, record->value);
 		break;
 	case AM_INY:
-		sprintf(builtStringBuffer, "($%02X),Y = %04X @ %04X = %02X ", NF_readMemory(CPU->bus, CPU->last_pc + 1), (uint16_t)(CPU->fetched_address - CPU->Y), CPU->fetched_address, CPU->fetched);
+		snprintf(buffer, size, "($%02X),Y = %04X @ %04X = %02X ", lo, (uint16_t)(record->address - record->y), record->address, record->value);
 		break;
 	case AM_REL:
-		sprintf(builtStringBuffer, "$%04X                      ", CPU->fetched_address);
+		snprintf(buffer, size, "$%04X                      ", record->address);
 		break;
 	case AM_ABY:
-		sprintf(builtStringBuffer, "$%04X,Y @ %04X = %02X        ", (uint16_t)(CPU->fetched_address - CPU->Y), CPU->fetched_address, CPU->fetched);
+		snprintf(buffer, size, "$%04X,Y @ %04X = %02X        ", (uint16_t)(record->address - record->y), record->address, record->value);
 		break;
 	case AM_ABX:
-		sprintf(builtStringBuffer, "$%04X,X @ %04X = %02X        ", (uint16_t)(CPU->fetched_address - CPU->X), CPU->fetched_address, CPU->fetched);
+		snprintf(buffer, size, "$%04X,X @ %04X = %02X        ", (uint16_t)(record->address - record->x), record->address, record->value);
 		break;
 	case AM_ACC:
-		sprintf(builtStringBuffer, "A                          ");
-		break;
-	case AM_IMP:
-		sprintf(builtStringBuffer, "                           ");
+		snprintf(buffer, size, "A                          ");
 		break;
 	default:
-		sprintf(builtStringBuffer, "                           ");
+		snprintf(buffer, size, "                           ");
 		break;
 	}
-	return builtStringBuffer;
 }
 
-// Print a line showing the debug information of the Processor and PPU in format:
+// Format a line showing the debug information of the Processor and PPU in format:
 //
-// C000  4C F5 C5  JMP $C5F5                       A : 00 X : 00 Y : 00 P : 24 SP : FD PPU : 0, 21 CYC : 7
-// C5F5  A2 00     LDX #$00                        A : 00 X : 00 Y : 00 P : 24 SP : FD PPU : 0, 30 CYC : 10
-// C5F7  86 00     STX $00 = 00                    A : 00 X : 00 Y : 00 P : 26 SP : FD PPU : 0, 36 CYC : 12
-// C5F9  86 10     STX $10 = 00                    A : 00 X : 00 Y : 00 P : 26 SP : FD PPU : 0, 45 CYC : 15
-// C5FB  86 11     STX $11 = 00                    A : 00 X : 00 Y : 00 P : 26 SP : FD PPU : 0, 54 CYC : 18
+// C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+// C5F5  A2 00     LDX #$00                        A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 30 CYC:10
+// C5F7  86 00     STX $00 = 00                    A:00 X:00 Y:00 P:26 SP:FD PPU:  0, 36 CYC:12
+// C5F9  86 10     STX $10 = 00                    A:00 X:00 Y:00 P:26 SP:FD PPU:  0, 45 CYC:15
+// C5FB  86 11     STX $11 = 00                    A:00 X:00 Y:00 P:26 SP:FD PPU:  0, 54 CYC:18
 // etc.
 //
-void printToDebugFile(FILE* log, struct Processor* CPU) {
-	int bytecount = getAddressModeToByteCount(CPU->addr_mode);
-	if (bytecount == 1) {
-		fprintf(log, "%04X  %02X        %s %s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:", CPU->last_pc, NF_readMemory(CPU->bus, CPU->last_pc),
-			opcodeToString(CPU->opcode), buildFetchString(CPU), CPU->A, CPU->X, CPU->Y, CPU->P, CPU->SP, CPU->bus->ConnectedPPU->scanline, CPU->bus->ConnectedPPU->cycle);
-	}
-	else if (bytecount == 2) {
-		fprintf(log, "%04X  %02X %02X     %s %s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:", CPU->last_pc, NF_readMemory(CPU->bus, CPU->last_pc),
-			NF_readMemory(CPU->bus, CPU->last_pc + 1), opcodeToString(CPU->opcode), buildFetchString(CPU), CPU->A, CPU->X, CPU->Y, CPU->P,
-			CPU->SP, CPU->bus->ConnectedPPU->scanline, CPU->bus->ConnectedPPU->cycle);
-	}
-	else if (bytecount == 3) {
-		fprintf(log, "%04X  %02X %02X %02X  %s %s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:", CPU->last_pc, NF_readMemory(CPU->bus, CPU->last_pc),
-			NF_readMemory(CPU->bus, CPU->last_pc + 1), NF_readMemory(CPU->bus, CPU->last_pc + 2), opcodeToString(CPU->opcode), buildFetchString(CPU), CPU->A,
-			CPU->X, CPU->Y, CPU->P, CPU->SP, CPU->bus->ConnectedPPU->scanline, CPU->bus->ConnectedPPU->cycle);
-	}
+// Instructions that are not supported are shown with only their opcode byte
+void NF_formatTraceRecord(const struct NF_TraceRecord* record, char* buffer, size_t size) {
+	char bytes[16];
+	char operand[48];
+	int bytecount = getAddressModeToByteCount(charToAddressModeArray[record->bytes[0]]);
+	if (bytecount == 3) { snprintf(bytes, sizeof(bytes), "%02X %02X %02X", record->bytes[0], record->bytes[1], record->bytes[2]); }
+	else if (bytecount == 2) { snprintf(bytes, sizeof(bytes), "%02X %02X", record->bytes[0], record->bytes[1]); }
+	else { snprintf(bytes, sizeof(bytes), "%02X", record->bytes[0]); }
+	buildOperandString(record, operand, sizeof(operand));
+	snprintf(buffer, size, "%04X  %-8s  %s %s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu", record->pc, bytes,
+		opcodeToString(charToOpcodeArray[record->bytes[0]]), operand, record->a, record->x, record->y, record->p, record->sp,
+		record->scanline, record->dot, (unsigned long long)record->cycle);
 }
\ No newline at end of file
@@ -3,14 +3,17 @@
 
 #include <stdlib.h>
 
-#define DEBUG_ENABLED 1
-
 #include "NF_6502.h"
+#include "NF_Trace.h"
 #include <stdlib.h>
 
+// Longest line of the nestest log, with room to spare
+#define NF_TRACE_LINE_SIZE 128
+
 uint8_t getAddressModeToByteCount(ADDRESS_MODE_6502 value);
 const char* opcodeToString(OPCODE_6502 value);
-const char* buildFetchString(struct Processor* CPU);
-void printToDebugFile(FILE* log, struct Processor* CPU);
+
+// Format a trace record (see NF_Trace.h) as a line of the nestest log, without the newline
+void NF_formatTraceRecord(const struct NF_TraceRecord* record, char* buffer, size_t size);
 
 #endif
\ No newline at end of file
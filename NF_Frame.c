@@ -0,0 +1,103 @@
+#include "NF_Frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lines are hashed as 4 interleaved chains of multiplies, so that they do not wait on each other, then mixed together
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+#define HASH_MIX 0xFF51AFD7ED558CCDull
+
+static uint64_t rotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+uint64_t NF_Frame_hashLine(const uint16_t* pixels) {
+	uint64_t lanes[4] = { 1, 2, 3, 4 };
+	for (int x = 0; x < NF_FRAME_WIDTH; x += 16) {
+		for (int lane = 0; lane < 4; lane++) {
+			uint64_t word;
+			memcpy(&word, pixels + x + lane * 4, sizeof(word));
+			lanes[lane] = (lanes[lane] ^ word) * HASH_MULTIPLIER;
+		}
+	}
+	uint64_t hash = lanes[0] ^ rotateLeft(lanes[1], 16) ^ rotateLeft(lanes[2], 32) ^ rotateLeft(lanes[3], 48);
+	hash ^= hash >> 33;
+	hash *= HASH_MIX;
+	return hash ^ (hash >> 33);
+}
+
+void NF_Frame_finishLine(struct NF_Frame* frame, int line, uint64_t* previous) {
+	if (line == 0) { memset(frame->dirty, 0, sizeof(frame->dirty)); }
+	uint64_t hash = NF_Frame_hashLine(frame->pixels[line]);
+	frame->line_hashes[line] = hash;
+	if (hash != previous[line]) {
+		NF_Frame_markDirty(frame->dirty, line);
+		previous[line] = hash;
+	}
+}
+
+int NF_Frame_delta(const struct NF_Frame* frame, uint64_t* hashes, uint32_t* dirty) {
+	int count = 0;
+	memset(dirty, 0, NF_FRAME_DIRTY_WORDS * sizeof(uint32_t));
+	for (int line = 0; line < NF_FRAME_HEIGHT; line++) {
+		if (frame->line_hashes[line] == hashes[line]) { continue; }
+		NF_Frame_markDirty(dirty, line);
+		hashes[line] = frame->line_hashes[line];
+		count++;
+	}
+	return count;
+}
+
+bool NF_Frame_nextDirtyRun(const uint32_t* dirty, int* line, int* count) {
+	int first = *line;
+	while (first < NF_FRAME_HEIGHT && !NF_Frame_isDirty(dirty, first)) {
+		// Skip clean words whole
+		if ((first % 32) == 0 && dirty[first / 32] == 0) { first += 32; }
+		else { first++; }
+	}
+	if (first >= NF_FRAME_HEIGHT) { return false; }
+	int last = first + 1;
+	while (last < NF_FRAME_HEIGHT && NF_Frame_isDirty(dirty, last)) { last++; }
+	*line = first;
+	*count = last - first;
+	return true;
+}
+
+struct NF_TripleBuffer* NF_TripleBuffer_create() {
+	struct NF_TripleBuffer* buffer = calloc(1, sizeof(struct NF_TripleBuffer));
+	if (buffer == NULL) {
+		printf("Error: Could not create triple buffer. Out of memory?\n");
+		return NULL;
+	}
+	for (int i = 0; i < 3; i++) {
+		buffer->frames[i] = calloc(1, sizeof(struct NF_Frame));
+		if (buffer->frames[i] == NULL) {
+			printf("Error: Could not create triple buffer. Out of memory?\n");
+			NF_TripleBuffer_free(buffer);
+			return NULL;
+		}
+	}
+	buffer->back = 0;
+	buffer->ready = 1;
+	buffer->front = 2;
+	return buffer;
+}
+
+void NF_TripleBuffer_free(struct NF_TripleBuffer* buffer) {
+	if (buffer == NULL) { return; }
+	for (int i = 0; i < 3; i++) { free(buffer->frames[i]); }
+	free(buffer);
+}
+
+struct NF_Frame* NF_TripleBuffer_back(struct NF_TripleBuffer* buffer) { return buffer->frames[buffer->back]; }
+
+struct NF_Frame* NF_TripleBuffer_publish(struct NF_TripleBuffer* buffer) {
+	uint32_t previous = NF_atomicExchange(&buffer->ready, buffer->back | NF_TRIPLE_BUFFER_FRESH);
+	buffer->back = previous & 0x03;
+	return buffer->frames[buffer->back];
+}
+
+struct NF_Frame* NF_TripleBuffer_acquire(struct NF_TripleBuffer* buffer) {
+	if ((NF_atomicLoadAcquire(&buffer->ready) & NF_TRIPLE_BUFFER_FRESH) == 0) { return NULL; }
+	uint32_t previous = NF_atomicExchange(&buffer->ready, buffer->front);
+	buffer->front = previous & 0x03;
+	return buffer->frames[buffer->front];
+}
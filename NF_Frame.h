@@ -0,0 +1,79 @@
+#ifndef NF_H_FRAME
+#define NF_H_FRAME
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// A finished picture from the PPU. Pixels are kept as the PPU produces them rather than as RGB, so that the
+// frontend can decide how to turn them into colors:
+//
+// Bits 0-5: Color index in the NES palette
+// Bits 6-8: Color emphasis (bits 5-7 of PPUMASK: red, green, blue)
+//
+// Most frames only change a few lines from the one before, if any, so every line is hashed as it is drawn. The
+// hashes, and a bitmap of the lines that changed since the frame before, let whoever takes the frame skip the lines
+// it already has.
+
+#define NF_FRAME_WIDTH 256
+#define NF_FRAME_HEIGHT 240
+#define NF_PIXEL_COLOR_MASK 0x3F
+#define NF_PIXEL_EMPHASIS_SHIFT 6
+#define NF_FRAME_DIRTY_WORDS ((NF_FRAME_HEIGHT + 31) / 32)
+
+struct NF_Frame {
+	uint16_t pixels[NF_FRAME_HEIGHT][NF_FRAME_WIDTH];
+	uint64_t number;				// The console's frame count when the frame was finished
+	uint64_t line_hashes[NF_FRAME_HEIGHT];
+	uint32_t dirty[NF_FRAME_DIRTY_WORDS];	// Bit per line, set where the line differs from the frame finished before
+};
+
+// Hash the pixels of a line. Lines that differ in one pixel always hash differently
+uint64_t NF_Frame_hashLine(const uint16_t* pixels);
+
+// Called by whatever draws the frame once a line is finished. Hashes the line and marks it dirty if the hash is not
+// the one in previous, which holds the line hashes of the frame drawn before and is updated. Drawing line 0 starts
+// a new bitmap
+void NF_Frame_finishLine(struct NF_Frame* frame, int line, uint64_t* previous);
+
+// Delta frames, for consumers that do not take every frame (and so cannot use the frame's own bitmap): mark in dirty
+// the lines of frame that differ from hashes, the line hashes of the last frame the consumer took, and update them.
+// Returns the number of lines marked
+int NF_Frame_delta(const struct NF_Frame* frame, uint64_t* hashes, uint32_t* dirty);
+
+static inline bool NF_Frame_isDirty(const uint32_t* dirty, int line) { return (dirty[line / 32] >> (line % 32)) & 1; }
+static inline void NF_Frame_markDirty(uint32_t* dirty, int line) { dirty[line / 32] |= 1u << (line % 32); }
+
+// Find the next run of dirty lines, starting the search at *line. Sets *line to the first line of the run and *count
+// to its length, or returns false if there are no more. Go through every run with:
+//
+//	for (int line = 0, count; NF_Frame_nextDirtyRun(dirty, &line, &count); line += count) { ... }
+bool NF_Frame_nextDirtyRun(const uint32_t* dirty, int* line, int* count);
+
+// Hands frames from the emulation thread to the display without either one ever waiting. There are three frames:
+// the one being drawn (owned by the producer), the one being shown (owned by the consumer), and the newest finished
+// one, which the two swap their own frame with. If the producer gets ahead, the frames the consumer never picked up
+// are simply drawn over.
+struct NF_TripleBuffer {
+	struct NF_Frame* frames[3];
+	uint32_t back;					// Producer's frame
+	uint32_t front;					// Consumer's frame
+	uint8_t pad0[NF_CACHE_LINE_SIZE];
+	volatile uint32_t ready;		// Index of the newest finished frame, plus NF_TRIPLE_BUFFER_FRESH if it was not taken yet
+	uint8_t pad1[NF_CACHE_LINE_SIZE];
+};
+
+#define NF_TRIPLE_BUFFER_FRESH 0x04
+
+struct NF_TripleBuffer* NF_TripleBuffer_create();
+void NF_TripleBuffer_free(struct NF_TripleBuffer* buffer);
+
+// Producer side. The frame to draw into, and handing it over once it is finished. Publishing returns the next frame
+// to draw into
+struct NF_Frame* NF_TripleBuffer_back(struct NF_TripleBuffer* buffer);
+struct NF_Frame* NF_TripleBuffer_publish(struct NF_TripleBuffer* buffer);
+
+// Consumer side. Takes the newest finished frame if there is one. Returns NULL if nothing was finished since the
+// last call, in which case the previous frame is still the newest
+struct NF_Frame* NF_TripleBuffer_acquire(struct NF_TripleBuffer* buffer);
+
+#endif
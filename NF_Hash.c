@@ -0,0 +1,254 @@
+#include "NF_Hash.h"
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef NF_X86
+#include <immintrin.h>
+#endif
+
+// ------------------------------------------------------------------------------------------------------------------
+// CRC32
+// ------------------------------------------------------------------------------------------------------------------
+
+// Slice-by-8 tables for the reflected polynomial 0xEDB88320. Table 0 is the classic byte-at-a-time table, and
+// table k gives the CRC of a byte followed by k zero bytes, which lets eight bytes be folded in per step
+static uint32_t crcTable[8][256];
+
+static void buildCrcTable() {
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (int k = 0; k < 8; k++) { c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : (c >> 1); }
+		crcTable[0][i] = c;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int t = 1; t < 8; t++) { crcTable[t][i] = (crcTable[t - 1][i] >> 8) ^ crcTable[0][crcTable[t - 1][i] & 0xFF]; }
+	}
+}
+
+// Works on the inverted CRC, like all of the kernels below
+static uint32_t crc32Table(uint32_t crc, const uint8_t* data, size_t length) {
+	while (length >= 8) {
+		uint32_t lo = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+		uint32_t hi = (uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+		crc = crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF] ^ crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24] ^
+			crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF] ^ crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24];
+		data += 8;
+		length -= 8;
+	}
+	while (length--) { crc = (crc >> 8) ^ crcTable[0][(crc ^ *data++) & 0xFF]; }
+	return crc;
+}
+
+#ifdef NF_X86
+
+// Folding with carry-less multiplication, following Intel's "Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ Instruction". Four 128 bit lanes are folded forward 64 bytes at a time, then folded into one lane,
+// and finally reduced to 32 bits with a Barrett reduction. Needs at least 64 bytes, and a multiple of 16.
+NF_TARGET("pclmul,sse4.1")
+static uint32_t crc32Clmul(uint32_t crc, const uint8_t* data, size_t length) {
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	data += 64;
+	length -= 64;
+
+	while (length >= 64) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+		data += 64;
+		length -= 64;
+	}
+
+	// Fold the four lanes into one
+	__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+	while (length >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i*)data)), x5);
+		data += 16;
+		length -= 16;
+	}
+
+	// Fold 128 bits down to 64
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+	// Barrett reduction down to 32 bits
+	x2 = _mm_and_si128(x1, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+#endif
+
+// The table and the choice of code paths are set up once for the whole process. Catalog scans hash on several threads
+// at once, so this must be done before any of them reads the table
+static NF_Once hashSetup = NF_ONCE_INIT;
+#ifdef NF_X86
+static bool useClmul = false;
+static bool useSHANI = false;
+#endif
+
+static void setUpHashing() {
+	buildCrcTable();
+#ifdef NF_X86
+	useClmul = NF_cpuHasFeature(NF_CPU_PCLMUL) && NF_cpuHasFeature(NF_CPU_SSE41);
+	useSHANI = NF_cpuHasFeature(NF_CPU_SHA) && NF_cpuHasFeature(NF_CPU_SSE41);
+#endif
+}
+
+uint32_t NF_crc32(uint32_t crc, const uint8_t* data, size_t length) {
+	NF_callOnce(&hashSetup, setUpHashing);
+	crc = ~crc;
+#ifdef NF_X86
+	if (useClmul && length >= 64) {
+		size_t chunk = length & ~(size_t)15;
+		crc = crc32Clmul(crc, data, chunk);
+		data += chunk;
+		length -= chunk;
+	}
+#endif
+	return ~crc32Table(crc, data, length);
+}
+
+// ------------------------------------------------------------------------------------------------------------------
+// SHA-1
+// ------------------------------------------------------------------------------------------------------------------
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1BlocksScalar(uint32_t state[5], const uint8_t* data, size_t blocks) {
+	while (blocks--) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++) {
+			w[i] = ((uint32_t)data[i * 4] << 24) | ((uint32_t)data[i * 4 + 1] << 16) | ((uint32_t)data[i * 4 + 2] << 8) | data[i * 4 + 3];
+		}
+		for (int i = 16; i < 80; i++) { w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1); }
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+		for (int i = 0; i < 80; i++) {
+			uint32_t f, k;
+			if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+			else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+			else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+			else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+			uint32_t t = ROL32(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = ROL32(b, 30);
+			b = a;
+			a = t;
+		}
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		data += 64;
+	}
+}
+
+#ifdef NF_X86
+
+// One group of four rounds with the SHA extensions. The message schedule for later groups is computed alongside:
+// W[g+1] is finished (msg2), W[g+2] gets W[g] xored in, and W[g+3] is started (msg1). m[] rotates through the four
+// message registers, and the E value alternates between e[0] and e[1]
+#define SHA1_GROUP(g) \
+	do { \
+		if ((g) > 0) { e[(g) & 1] = _mm_sha1nexte_epu32(e[(g) & 1], m[(g) & 3]); } \
+		e[((g) + 1) & 1] = abcd; \
+		if ((g) >= 3 && (g) <= 18) { m[((g) + 1) & 3] = _mm_sha1msg2_epu32(m[((g) + 1) & 3], m[(g) & 3]); } \
+		abcd = _mm_sha1rnds4_epu32(abcd, e[(g) & 1], (g) / 5); \
+		if ((g) >= 1 && (g) <= 16) { m[((g) + 3) & 3] = _mm_sha1msg1_epu32(m[((g) + 3) & 3], m[(g) & 3]); } \
+		if ((g) >= 2 && (g) <= 17) { m[((g) + 2) & 3] = _mm_xor_si128(m[((g) + 2) & 3], m[(g) & 3]); } \
+	} while (0)
+
+NF_TARGET("sha,ssse3,sse4.1")
+static void sha1BlocksSHANI(uint32_t state[5], const uint8_t* data, size_t blocks) {
+	const __m128i byteswap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+	__m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+	while (blocks--) {
+		__m128i abcd_save = abcd;
+		__m128i e_save = e0;
+		__m128i m[4], e[2];
+		for (int i = 0; i < 4; i++) { m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), byteswap); }
+		e[0] = _mm_add_epi32(e0, m[0]);
+		e[1] = e0;
+
+		SHA1_GROUP(0); SHA1_GROUP(1); SHA1_GROUP(2); SHA1_GROUP(3); SHA1_GROUP(4);
+		SHA1_GROUP(5); SHA1_GROUP(6); SHA1_GROUP(7); SHA1_GROUP(8); SHA1_GROUP(9);
+		SHA1_GROUP(10); SHA1_GROUP(11); SHA1_GROUP(12); SHA1_GROUP(13); SHA1_GROUP(14);
+		SHA1_GROUP(15); SHA1_GROUP(16); SHA1_GROUP(17); SHA1_GROUP(18); SHA1_GROUP(19);
+
+		// After group 19, e[0] holds the value of E going into the last group
+		e0 = _mm_sha1nexte_epu32(e[0], e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+		data += 64;
+	}
+
+	_mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#endif
+
+void NF_sha1(const uint8_t* data, size_t length, uint8_t digest[20]) {
+	NF_callOnce(&hashSetup, setUpHashing);
+	void (*blocksFunc)(uint32_t*, const uint8_t*, size_t) = sha1BlocksScalar;
+#ifdef NF_X86
+	if (useSHANI) { blocksFunc = sha1BlocksSHANI; }
+#endif
+
+	uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	size_t full_blocks = length / 64;
+	blocksFunc(state, data, full_blocks);
+
+	// Pad the tail: a single 1 bit, zeros, and the message length in bits as a 64 bit big endian number
+	uint8_t tail[128] = { 0 };
+	size_t rest = length - full_blocks * 64;
+	memcpy(tail, data + full_blocks * 64, rest);
+	tail[rest] = 0x80;
+	size_t tail_blocks = (rest + 9 > 64) ? 2 : 1;
+	uint64_t bits = (uint64_t)length * 8;
+	for (int i = 0; i < 8; i++) { tail[tail_blocks * 64 - 1 - i] = (uint8_t)(bits >> (i * 8)); }
+	blocksFunc(state, tail, tail_blocks);
+
+	for (int i = 0; i < 5; i++) {
+		digest[i * 4] = (uint8_t)(state[i] >> 24);
+		digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+		digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+		digest[i * 4 + 3] = (uint8_t)state[i];
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef NF_H_HASH
+#define NF_H_HASH
+#include <stddef.h>
+#include <stdint.h>
+
+// Hashes used to identify ROMs. Both pick the fastest kernel the processor supports the first time they are
+// called: carry-less multiply folding for CRC32 and the SHA extensions for SHA-1, with portable table/scalar
+// code everywhere else.
+
+// Standard (zlib/PNG) CRC32. Pass 0 as crc for the first block, or the previous result to continue a running CRC
+uint32_t NF_crc32(uint32_t crc, const uint8_t* data, size_t length);
+
+// SHA-1 of a whole buffer
+void NF_sha1(const uint8_t* data, size_t length, uint8_t digest[20]);
+
+#endif
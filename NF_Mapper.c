@@ -0,0 +1,308 @@
+#include "NF_Mapper.h"
+#include "NF_Cartridge.h"
+#include "NF_Probes.h"
+#include <stdio.h>
+#include <string.h>
+
+#define PRG_BANK_8K 0x2000
+#define CHR_BANK_1K 0x0400
+
+// ------------------------------------------------------------------------------------------------------------------
+// Bank switching helpers
+// ------------------------------------------------------------------------------------------------------------------
+
+// Bank numbers are wrapped around the number of banks on the board. Boards only ever have a power of two amount
+// of ROM in practice, but using a modulo keeps odd sized dumps from reading out of bounds
+void NF_mapPRG8k(struct Cartridge* c, uint8_t slot, int bank) {
+	int count = c->prg_size / PRG_BANK_8K;
+	if (count == 0) { return; }
+	bank %= count;
+	if (bank < 0) { bank += count; }
+	c->prg_map[slot & 0x03] = c->prg_rom + (bank * PRG_BANK_8K);
+	c->prg_log_map[slot & 0x03] = c->prg_log + ((bank * PRG_BANK_8K) & c->prg_log_mask);
+	NF_PROBE2(prg_bank, slot & 0x03, bank);
+}
+
+void NF_mapPRG16k(struct Cartridge* c, uint8_t slot, int bank) {
+	NF_mapPRG8k(c, slot * 2, bank * 2);
+	NF_mapPRG8k(c, slot * 2 + 1, bank * 2 + 1);
+}
+
+void NF_mapPRG32k(struct Cartridge* c, int bank) {
+	for (int i = 0; i < 4; i++) { NF_mapPRG8k(c, i, bank * 4 + i); }
+}
+
+void NF_mapCHR1k(struct Cartridge* c, uint8_t slot, int bank) {
+	int count = c->chr_size / CHR_BANK_1K;
+	if (count == 0) { return; }
+	bank %= count;
+	if (bank < 0) { bank += count; }
+	c->chr_map[slot & 0x07] = c->chr_rom + (bank * CHR_BANK_1K);
+	c->chr_log_map[slot & 0x07] = c->chr_log + ((bank * CHR_BANK_1K) & c->chr_log_mask);
+	NF_PROBE2(chr_bank, slot & 0x07, bank);
+}
+
+void NF_mapCHR4k(struct Cartridge* c, uint8_t slot, int bank) {
+	for (int i = 0; i < 4; i++) { NF_mapCHR1k(c, slot * 4 + i, bank * 4 + i); }
+}
+
+void NF_mapCHR8k(struct Cartridge* c, int bank) {
+	for (int i = 0; i < 8; i++) { NF_mapCHR1k(c, i, bank * 8 + i); }
+}
+
+// UxROM and CNROM have bus conflicts: the ROM drives the data bus at the same time as the CPU, so the value that
+// actually reaches the register is the AND of both
+static uint8_t busConflict(struct Cartridge* c, uint16_t address, uint8_t value) {
+	return value & c->prg_map[(address >> 13) & 0x03][address & 0x1FFF];
+}
+
+// ------------------------------------------------------------------------------------------------------------------
+// Mapper 0: NROM
+// 16KB or 32KB of PRG ROM (16KB is mirrored into both halves), 8KB of CHR, no registers
+// ------------------------------------------------------------------------------------------------------------------
+
+static void NROM_reset(struct Cartridge* c) {
+	NF_mapPRG16k(c, 0, 0);
+	NF_mapPRG16k(c, 1, 1);
+	NF_mapCHR8k(c, 0);
+}
+
+// Cannot do anything to ROM
+static void NROM_writeRegister(struct Cartridge* c, uint16_t address, uint8_t value) {
+	(void)c;
+	(void)address;
+	(void)value;
+}
+
+static void NROM_restore(struct Cartridge* c) { NROM_reset(c); }
+
+// ------------------------------------------------------------------------------------------------------------------
+// Mapper 1: MMC1 (SxROM)
+// Registers are loaded serially, one bit per write, through a five bit shift register
+// ------------------------------------------------------------------------------------------------------------------
+
+static void MMC1_updateBanks(struct Cartridge* c) {
+	struct NF_MMC1_State* s = &c->mapper_state.mmc1;
+
+	// Mirroring: 0 is one screen (lower), 1 is one screen (upper), 2 is vertical, 3 is horizontal
+	if (c->nametable_mirroring != FOUR_SCREEN_MAPPING) {
+		static const SCROLL_MAPPING_TYPE modes[4] = { SINGLE_SCREEN_LOWER_MAPPING, SINGLE_SCREEN_UPPER_MAPPING, VERTICAL_MAPPING, HORIZONTAL_MAPPING };
+		NF_setCartMirroring(c, modes[s->control & 0x03]);
+	}
+
+	// SUROM and friends have 512KB of PRG, and use bit 4 of the CHR register to pick which 256KB half is visible
+	int outer = (c->prg_size > 0x40000) ? (s->chr_bank_0 & 0x10) : 0;
+	int prg = (s->prg_bank & 0x0F) | outer;
+	switch ((s->control >> 2) & 0x03) {
+	case 0:
+	case 1:
+		// Switch 32KB at $8000, ignoring the low bit of the bank number
+		NF_mapPRG32k(c, prg >> 1);
+		break;
+	case 2:
+		// Fix the first bank at $8000 and switch 16KB at $C000
+		NF_mapPRG16k(c, 0, outer);
+		NF_mapPRG16k(c, 1, prg);
+		break;
+	case 3:
+		// Fix the last bank at $C000 and switch 16KB at $8000
+		NF_mapPRG16k(c, 0, prg);
+		NF_mapPRG16k(c, 1, outer | 0x0F);
+		break;
+	}
+
+	// CHR is either one 8KB bank or two independent 4KB banks
+	if (s->control & 0x10) {
+		NF_mapCHR4k(c, 0, s->chr_bank_0);
+		NF_mapCHR4k(c, 1, s->chr_bank_1);
+	}
+	else { NF_mapCHR8k(c, s->chr_bank_0 >> 1); }
+}
+
+static void MMC1_reset(struct Cartridge* c) {
+	memset(&c->mapper_state, 0, sizeof(c->mapper_state));
+	c->mapper_state.mmc1.control = 0x0C;
+	MMC1_updateBanks(c);
+}
+
+static void MMC1_writeRegister(struct Cartridge* c, uint16_t address, uint8_t value) {
+	struct NF_MMC1_State* s = &c->mapper_state.mmc1;
+
+	// Writing a value with bit 7 set clears the shift register and locks the last PRG bank at $C000
+	if (value & 0x80) {
+		s->shift_register = 0;
+		s->shift_count = 0;
+		s->control |= 0x0C;
+		MMC1_updateBanks(c);
+		return;
+	}
+
+	s->shift_register |= (value & 0x01) << s->shift_count;
+	s->shift_count++;
+	if (s->shift_count < 5) { return; }
+
+	// On the fifth write, bits 13 and 14 of the address pick which register gets the value
+	switch ((address >> 13) & 0x03) {
+	case 0: s->control = s->shift_register; break;
+	case 1: s->chr_bank_0 = s->shift_register; break;
+	case 2: s->chr_bank_1 = s->shift_register; break;
+	case 3: s->prg_bank = s->shift_register; break;
+	}
+	s->shift_register = 0;
+	s->shift_count = 0;
+	MMC1_updateBanks(c);
+}
+
+static void MMC1_restore(struct Cartridge* c) { MMC1_updateBanks(c); }
+
+// ------------------------------------------------------------------------------------------------------------------
+// Mapper 2: UxROM
+// Switchable 16KB bank at $8000, last bank fixed at $C000
+// ------------------------------------------------------------------------------------------------------------------
+
+static void UxROM_reset(struct Cartridge* c) {
+	c->mapper_state.bank = 0;
+	NF_mapPRG16k(c, 0, 0);
+	NF_mapPRG16k(c, 1, -1);
+	NF_mapCHR8k(c, 0);
+}
+
+static void UxROM_writeRegister(struct Cartridge* c, uint16_t address, uint8_t value) {
+	c->mapper_state.bank = busConflict(c, address, value);
+	NF_mapPRG16k(c, 0, c->mapper_state.bank);
+}
+
+static void UxROM_restore(struct Cartridge* c) {
+	NF_mapPRG16k(c, 0, c->mapper_state.bank);
+	NF_mapPRG16k(c, 1, -1);
+	NF_mapCHR8k(c, 0);
+}
+
+// ------------------------------------------------------------------------------------------------------------------
+// Mapper 3: CNROM
+// Fixed PRG like NROM, switchable 8KB CHR bank
+// ------------------------------------------------------------------------------------------------------------------
+
+static void CNROM_reset(struct Cartridge* c) {
+	c->mapper_state.bank = 0;
+	NROM_reset(c);
+}
+
+static void CNROM_writeRegister(struct Cartridge* c, uint16_t address, uint8_t value) {
+	c->mapper_state.bank = busConflict(c, address, value);
+	NF_mapCHR8k(c, c->mapper_state.bank);
+}
+
+static void CNROM_restore(struct Cartridge* c) {
+	NROM_reset(c);
+	NF_mapCHR8k(c, c->mapper_state.bank);
+}
+
+// ------------------------------------------------------------------------------------------------------------------
+// Mapper 4: MMC3 (TxROM)
+// Eight bank registers, two PRG and CHR layouts, and a scanline counter clocked by rising edges of PPU A12
+// ------------------------------------------------------------------------------------------------------------------
+
+static void MMC3_updateBanks(struct Cartridge* c) {
+	struct NF_MMC3_State* s = &c->mapper_state.mmc3;
+	uint8_t* r = s->bank_registers;
+
+	// PRG mode 0: R6 at $8000, second to last bank at $C000. Mode 1 swaps those two
+	if (s->bank_select & 0x40) {
+		NF_mapPRG8k(c, 0, -2);
+		NF_mapPRG8k(c, 2, r[6]);
+	}
+	else {
+		NF_mapPRG8k(c, 0, r[6]);
+		NF_mapPRG8k(c, 2, -2);
+	}
+	NF_mapPRG8k(c, 1, r[7]);
+	NF_mapPRG8k(c, 3, -1);
+
+	// CHR: two 2KB banks (R0, R1) and four 1KB banks (R2-R5), with the halves swapped when A12 inversion is set
+	uint8_t invert = (s->bank_select & 0x80) ? 4 : 0;
+	NF_mapCHR1k(c, 0 ^ invert, r[0] & 0xFE);
+	NF_mapCHR1k(c, 1 ^ invert, r[0] | 0x01);
+	NF_mapCHR1k(c, 2 ^ invert, r[1] & 0xFE);
+	NF_mapCHR1k(c, 3 ^ invert, r[1] | 0x01);
+	NF_mapCHR1k(c, 4 ^ invert, r[2]);
+	NF_mapCHR1k(c, 5 ^ invert, r[3]);
+	NF_mapCHR1k(c, 6 ^ invert, r[4]);
+	NF_mapCHR1k(c, 7 ^ invert, r[5]);
+}
+
+static void MMC3_reset(struct Cartridge* c) {
+	memset(&c->mapper_state, 0, sizeof(c->mapper_state));
+	struct NF_MMC3_State* s = &c->mapper_state.mmc3;
+	static const uint8_t initial[8] = { 0, 2, 4, 5, 6, 7, 0, 1 };
+	memcpy(s->bank_registers, initial, sizeof(initial));
+	c->irq_asserted = false;
+	MMC3_updateBanks(c);
+}
+
+static void MMC3_writeRegister(struct Cartridge* c, uint16_t address, uint8_t value) {
+	struct NF_MMC3_State* s = &c->mapper_state.mmc3;
+	bool even = (address & 0x01) == 0;
+
+	switch (address & 0xE000) {
+	case 0x8000:
+		if (even) { s->bank_select = value; }
+		else { s->bank_registers[s->bank_select & 0x07] = value; }
+		MMC3_updateBanks(c);
+		break;
+	case 0xA000:
+		if (even) {
+			if (c->nametable_mirroring != FOUR_SCREEN_MAPPING) { NF_setCartMirroring(c, (value & 0x01) ? HORIZONTAL_MAPPING : VERTICAL_MAPPING); }
+		}
+		else { s->prg_ram_protect = value; }
+		break;
+	case 0xC000:
+		if (even) { s->irq_latch = value; }
+		else {
+			s->irq_counter = 0;
+			s->irq_reload = true;
+		}
+		break;
+	case 0xE000:
+		// Disabling also acknowledges any pending interrupt
+		if (even) {
+			s->irq_enabled = false;
+			c->irq_asserted = false;
+		}
+		else { s->irq_enabled = true; }
+		break;
+	}
+}
+
+// Mirroring is not part of the MMC3 state, it is restored along with the rest of the cartridge
+static void MMC3_restore(struct Cartridge* c) { MMC3_updateBanks(c); }
+
+static void MMC3_ppuA12Rise(struct Cartridge* c) {
+	struct NF_MMC3_State* s = &c->mapper_state.mmc3;
+	if (s->irq_counter == 0 || s->irq_reload) {
+		s->irq_counter = s->irq_latch;
+		s->irq_reload = false;
+	}
+	else { s->irq_counter--; }
+
+	if (s->irq_counter == 0 && s->irq_enabled) { c->irq_asserted = true; }
+}
+
+// ------------------------------------------------------------------------------------------------------------------
+// Mapper table
+// ------------------------------------------------------------------------------------------------------------------
+
+static const struct NF_Mapper supportedMappers[] = {
+	{ 0, "NROM", NROM_reset, NROM_writeRegister, NROM_restore, NULL },
+	{ 1, "MMC1", MMC1_reset, MMC1_writeRegister, MMC1_restore, NULL },
+	{ 2, "UxROM", UxROM_reset, UxROM_writeRegister, UxROM_restore, NULL },
+	{ 3, "CNROM", CNROM_reset, CNROM_writeRegister, CNROM_restore, NULL },
+	{ 4, "MMC3", MMC3_reset, MMC3_writeRegister, MMC3_restore, MMC3_ppuA12Rise },
+};
+
+const struct NF_Mapper* NF_getMapper(uint16_t number) {
+	for (size_t i = 0; i < sizeof(supportedMappers) / sizeof(supportedMappers[0]); i++) {
+		if (supportedMappers[i].number == number) { return &supportedMappers[i]; }
+	}
+	return NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef NF_H_MAPPER
+#define NF_H_MAPPER
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Cartridge;
+
+// Mappers are the circuits on the cartridge board that decide which part of the ROM is visible to the CPU and PPU
+// at any given time. Every mapper implements the same small interface:
+//
+// reset:			Put the board in its power-on state, and fill in the bank pointer tables of the cartridge
+// writeRegister:	Called for every CPU write to $8000-$FFFF. Bank switches update the pointer tables of the cartridge,
+//					so reads never have to recompute offsets
+// restore:		Rebuild the bank pointer tables from mapper_state, which has just been overwritten by a savestate
+// ppuA12Rise:		Called once per rendered scanline (PPU dot 260) by a scheduled bus event. NULL if the board does
+//					not watch the PPU address bus, in which case the event is never scheduled at all
+//
+// Boards that can raise an IRQ do so by setting cartridge->irq_asserted. Boards that control mirroring do so through
+// NF_setCartMirroring, which the PPU reads through cartridge->nametable_map.
+struct NF_Mapper {
+	uint16_t number;
+	const char* name;
+	void (*reset)(struct Cartridge* c);
+	void (*writeRegister)(struct Cartridge* c, uint16_t address, uint8_t value);
+	void (*restore)(struct Cartridge* c);
+	void (*ppuA12Rise)(struct Cartridge* c);
+};
+
+// Internal state of the supported boards. Kept as plain data so that it can be copied around freely
+struct NF_MMC1_State {
+	uint8_t shift_register;
+	uint8_t shift_count;
+	uint8_t control;
+	uint8_t chr_bank_0;
+	uint8_t chr_bank_1;
+	uint8_t prg_bank;
+};
+
+struct NF_MMC3_State {
+	uint8_t bank_select;
+	uint8_t bank_registers[8];
+	uint8_t prg_ram_protect;
+	uint8_t irq_latch;
+	uint8_t irq_counter;
+	bool irq_reload;
+	bool irq_enabled;
+};
+
+union NF_MapperState {
+	struct NF_MMC1_State mmc1;
+	struct NF_MMC3_State mmc3;
+	uint8_t bank;					// UxROM and CNROM only have a single bank register
+};
+
+// Find the implementation for a mapper number. Returns NULL if the mapper is not supported
+const struct NF_Mapper* NF_getMapper(uint16_t number);
+
+// Bank switching helpers. Bank numbers wrap around the size of the ROM, which is also what the hardware does
+// because the unused upper bits of the bank number simply are not connected
+void NF_mapPRG8k(struct Cartridge* c, uint8_t slot, int bank);
+void NF_mapPRG16k(struct Cartridge* c, uint8_t slot, int bank);
+void NF_mapPRG32k(struct Cartridge* c, int bank);
+void NF_mapCHR1k(struct Cartridge* c, uint8_t slot, int bank);
+void NF_mapCHR4k(struct Cartridge* c, uint8_t slot, int bank);
+void NF_mapCHR8k(struct Cartridge* c, int bank);
+
+#endif
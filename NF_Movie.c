@@ -0,0 +1,174 @@
+#include "NF_Movie.h"
+#include "NF_Hash.h"
+#include "NF_State.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t romChecksum(struct Cartridge* c) {
+	uint32_t crc = NF_crc32(0, c->prg_rom, c->prg_size);
+	if (!c->chr_is_ram) { crc = NF_crc32(crc, c->chr_rom, c->chr_size); }
+	return crc;
+}
+
+struct NF_Movie* NF_Movie_create(struct NES_Console* console, uint32_t keyframe_interval) {
+	size_t state_size = NF_State_size(console);
+	if (state_size == 0) { return NULL; }
+	struct NF_Movie* movie = calloc(1, sizeof(struct NF_Movie));
+	if (movie == NULL) {
+		printf("Error: Could not create movie object. Out of memory?\n");
+		return NULL;
+	}
+	movie->rom_crc32 = romChecksum(console->ConnectedCartridge);
+	movie->keyframe_interval = (keyframe_interval == 0) ? NF_MOVIE_DEFAULT_KEYFRAME_INTERVAL : keyframe_interval;
+	movie->state_size = (uint32_t)state_size;
+	return movie;
+}
+
+struct NF_Movie* NF_Movie_open(const char* path) {
+	struct NF_Movie* movie = calloc(1, sizeof(struct NF_Movie));
+	if (movie == NULL) {
+		printf("Error: Could not create movie object. Out of memory?\n");
+		return NULL;
+	}
+	if (!NF_mapFileReadOnly(path, &movie->mapping)) {
+		free(movie);
+		return NULL;
+	}
+
+	// Validate the header and that both arrays fit in the file before trusting any of it
+	struct NF_MovieFileHeader header;
+	size_t size = movie->mapping.size;
+	if (size >= sizeof(header)) { memcpy(&header, movie->mapping.data, sizeof(header)); }
+	if (size < sizeof(header) || memcmp(header.magic, NF_MOVIE_MAGIC, sizeof(header.magic)) != 0 || header.version != NF_MOVIE_VERSION ||
+		header.keyframe_interval == 0 || header.keyframe_count != (header.frame_count + header.keyframe_interval - 1) / header.keyframe_interval ||
+		sizeof(header) + (uint64_t)header.frame_count * NF_CONTROLLER_PORTS + (uint64_t)header.keyframe_count * header.state_size > size) {
+		printf("Error: %s is not a valid movie.\n", path);
+		NF_unmapFile(&movie->mapping);
+		free(movie);
+		return NULL;
+	}
+
+	movie->rom_crc32 = header.rom_crc32;
+	movie->frame_count = header.frame_count;
+	movie->keyframe_interval = header.keyframe_interval;
+	movie->keyframe_count = header.keyframe_count;
+	movie->state_size = header.state_size;
+	movie->input = movie->mapping.data + sizeof(header);
+	movie->keyframes = movie->input + (size_t)header.frame_count * NF_CONTROLLER_PORTS;
+	return movie;
+}
+
+void NF_Movie_free(struct NF_Movie* movie) {
+	if (movie == NULL) { return; }
+	if (movie->mapping.data != NULL) { NF_unmapFile(&movie->mapping); }
+	else {
+		free(movie->input);
+		free(movie->keyframes);
+	}
+	free(movie);
+}
+
+bool NF_Movie_save(struct NF_Movie* movie, const char* path) {
+	struct NF_MovieFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NF_MOVIE_MAGIC, sizeof(NF_MOVIE_MAGIC));
+	header.version = NF_MOVIE_VERSION;
+	header.rom_crc32 = movie->rom_crc32;
+	header.frame_count = movie->frame_count;
+	header.keyframe_interval = movie->keyframe_interval;
+	header.keyframe_count = movie->keyframe_count;
+	header.state_size = movie->state_size;
+
+	char tmp_path[1024];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	FILE* file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		printf("Error: Could not open %s for writing.\n", tmp_path);
+		return false;
+	}
+	size_t input_size = (size_t)movie->frame_count * NF_CONTROLLER_PORTS;
+	size_t keyframes_size = (size_t)movie->keyframe_count * movie->state_size;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(input_size == 0 || fwrite(movie->input, 1, input_size, file) == input_size) &&
+		(keyframes_size == 0 || fwrite(movie->keyframes, 1, keyframes_size, file) == keyframes_size);
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok || !NF_replaceFile(tmp_path, path)) {
+		printf("Error: Could not write movie %s.\n", path);
+		remove(tmp_path);
+		return false;
+	}
+	return true;
+}
+
+// Make room for one more element in a growing array, doubling its capacity when it is full
+static bool grow(uint8_t** array, uint32_t* capacity, uint32_t count, size_t element_size) {
+	if (count < *capacity) { return true; }
+	uint32_t new_capacity = (*capacity == 0) ? 64 : *capacity * 2;
+	uint8_t* new_array = realloc(*array, (size_t)new_capacity * element_size);
+	if (new_array == NULL) {
+		printf("Error: Could not grow movie. Out of memory?\n");
+		return false;
+	}
+	*array = new_array;
+	*capacity = new_capacity;
+	return true;
+}
+
+bool NF_Movie_recordFrame(struct NF_Movie* movie, struct NES_Console* console, const uint8_t buttons[NF_CONTROLLER_PORTS]) {
+	if (movie->mapping.data != NULL) {
+		printf("Error: A movie opened from a file cannot be recorded into.\n");
+		return false;
+	}
+
+	if (movie->frame_count % movie->keyframe_interval == 0) {
+		if (!grow(&movie->keyframes, &movie->keyframe_capacity, movie->keyframe_count, movie->state_size)) { return false; }
+		uint8_t* keyframe = movie->keyframes + (size_t)movie->keyframe_count * movie->state_size;
+		if (!NF_State_save(console, keyframe, movie->state_size)) { return false; }
+		movie->keyframe_count++;
+	}
+
+	if (!grow(&movie->input, &movie->input_capacity, movie->frame_count, NF_CONTROLLER_PORTS)) { return false; }
+	uint8_t* input = movie->input + (size_t)movie->frame_count * NF_CONTROLLER_PORTS;
+	for (int i = 0; i < NF_CONTROLLER_PORTS; i++) {
+		input[i] = buttons[i];
+		NF_setControllerButtons(console, i, buttons[i]);
+	}
+	movie->frame_count++;
+	movie->position = movie->frame_count;
+	return true;
+}
+
+bool NF_Movie_seek(struct NF_Movie* movie, struct NES_Console* console, uint32_t frame) {
+	if (movie->keyframe_count == 0) {
+		printf("Error: Movie is empty.\n");
+		return false;
+	}
+	if (frame > movie->frame_count) {
+		printf("Error: Movie only has %u frames.\n", movie->frame_count);
+		return false;
+	}
+	if (console->ConnectedCartridge == NULL || romChecksum(console->ConnectedCartridge) != movie->rom_crc32) {
+		printf("Error: Movie was recorded with a different cartridge.\n");
+		return false;
+	}
+
+	// The last frame of a movie that ends on a keyframe boundary has no keyframe of its own
+	uint32_t keyframe = frame / movie->keyframe_interval;
+	if (keyframe >= movie->keyframe_count) { keyframe = movie->keyframe_count - 1; }
+	if (!NF_State_load(console, movie->keyframes + (size_t)keyframe * movie->state_size, movie->state_size)) { return false; }
+
+	movie->position = keyframe * movie->keyframe_interval;
+	while (movie->position < frame) { NF_Movie_playFrame(movie, console); }
+	return true;
+}
+
+bool NF_Movie_playFrame(struct NF_Movie* movie, struct NES_Console* console) {
+	if (movie->position >= movie->frame_count) { return false; }
+	const uint8_t* input = movie->input + (size_t)movie->position * NF_CONTROLLER_PORTS;
+	for (int i = 0; i < NF_CONTROLLER_PORTS; i++) { NF_setControllerButtons(console, i, input[i]); }
+	NF_runFrame(console);
+	movie->position++;
+	return true;
+}
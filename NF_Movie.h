@@ -0,0 +1,73 @@
+#ifndef NF_H_MOVIE
+#define NF_H_MOVIE
+#include "NF_Bus.h"
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Input movies. The emulator is deterministic, so a run can be reproduced exactly from the state it started in and
+// the buttons held on every frame. A movie records just that: one button mask per controller port per frame, plus a
+// savestate (a keyframe) every keyframe_interval frames. Keyframe 0 is the state the recording started from.
+//
+// Any frame can be reached by loading the keyframe at or before it and replaying at most keyframe_interval - 1
+// frames of input, so seeking costs the same no matter how long the movie is. Keyframes all have the same size,
+// which puts each one at a fixed place in the file. Layout (all values little endian):
+//
+// NF_MovieFileHeader
+// uint8_t input[frame_count][NF_CONTROLLER_PORTS]		NF_BUTTON masks
+// uint8_t keyframes[keyframe_count][state_size]		Savestates, see NF_State.h
+
+#define NF_MOVIE_MAGIC "NFMOVIE"
+#define NF_MOVIE_VERSION 1
+#define NF_MOVIE_DEFAULT_KEYFRAME_INTERVAL 600		// Ten seconds
+
+struct NF_MovieFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t rom_crc32;				// CRC32 of the PRG and CHR ROM of the cartridge the movie was recorded with
+	uint32_t frame_count;
+	uint32_t keyframe_interval;
+	uint32_t keyframe_count;
+	uint32_t state_size;
+};
+
+struct NF_Movie {
+	uint32_t rom_crc32;
+	uint32_t frame_count;
+	uint32_t keyframe_interval;
+	uint32_t keyframe_count;
+	uint32_t state_size;
+	uint8_t* input;
+	uint8_t* keyframes;
+
+	// Growth of the arrays while recording. A movie opened from a file is mapped read-only, and has no capacity
+	uint32_t input_capacity;		// In frames
+	uint32_t keyframe_capacity;
+	struct NF_FileMapping mapping;
+
+	uint32_t position;				// The next frame NF_Movie_playFrame will play
+};
+
+// Start recording a movie of a console, from the state it is in now
+struct NF_Movie* NF_Movie_create(struct NES_Console* console, uint32_t keyframe_interval);
+
+// Map a movie file. Returns NULL (and prints why) if it is missing or malformed
+struct NF_Movie* NF_Movie_open(const char* path);
+
+void NF_Movie_free(struct NF_Movie* movie);
+
+// Write a recorded movie to a file
+bool NF_Movie_save(struct NF_Movie* movie, const char* path);
+
+// Recording: call at the start of every frame, before NF_runFrame, with the buttons held on each port for the frame.
+// Takes a keyframe when one is due, then sets and stores the buttons
+bool NF_Movie_recordFrame(struct NF_Movie* movie, struct NES_Console* console, const uint8_t buttons[NF_CONTROLLER_PORTS]);
+
+// Playback: put a console in the state it was in at the start of a frame (0 to frame_count). Playback continues
+// from there. The console needs the same cartridge the movie was recorded with
+bool NF_Movie_seek(struct NF_Movie* movie, struct NES_Console* console, uint32_t frame);
+
+// Playback: set the buttons of the next frame and run it. Returns false once the movie has ended
+bool NF_Movie_playFrame(struct NF_Movie* movie, struct NES_Console* console);
+
+#endif
@@ -0,0 +1,227 @@
+#include "NF_NTSC.h"
+#include "NF_Platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NF_X86
+#include <immintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLES_PER_PIXEL 8
+#define SAMPLES_PER_CYCLE 12
+#define SAMPLES_PER_GROUP (SAMPLES_PER_PIXEL * NF_NTSC_IN_GROUP)
+
+// Signal levels of the PPU, in volts, for the low and high halves of the square wave at each brightness. Black is
+// the low level of brightness 1, and white the high level of brightness 3
+static const double SIGNAL_LOW[4] = { 0.350, 0.518, 0.962, 1.550 };
+static const double SIGNAL_HIGH[4] = { 1.094, 1.506, 1.962, 1.962 };
+#define SIGNAL_BLACK 0.518
+#define SIGNAL_WHITE 1.962
+#define EMPHASIS_ATTENUATION 0.746
+
+// Decoder settings. The hue offset lines the decoded colors up with the plain palette, and the brightness keeps
+// white at the same level as the plain palette's, so turning the filter on does not change the overall colors
+#define HUE_OFFSET 4.0
+#define SATURATION 0.8
+#define BRIGHTNESS 0.925
+#define LUMA_WIDTH 12.0					// Samples. A box this wide removes the subcarrier completely
+#define CHROMA_WIDTH 24.0				// Samples, for the raised cosine the color is smoothed with
+#define KERNEL_SCALE 16.0				// Kernel units per 8 bit level
+#define ROUNDING (1 << 3)
+
+// Index of the kernel values for one color at one position in the group, into one group of output
+#define KERNEL_INDEX(burst, color, position, span) \
+	(((((size_t)(burst) * NF_NTSC_COLORS + (color)) * NF_NTSC_IN_GROUP + (position)) * NF_NTSC_KERNEL_SPAN + (span)) * NF_NTSC_KERNEL_VALUES)
+
+// Lines are padded with one group of black on each side so that the groups at the edges can be filtered like any other
+#define PADDED_WIDTH ((NF_NTSC_GROUPS + 2) * NF_NTSC_IN_GROUP)
+#define BLACK_PIXEL 0x0F
+
+static bool inColorPhase(int hue, int phase) { return (hue + phase) % SAMPLES_PER_CYCLE < 6; }
+
+// The signal for a pixel at one phase of the subcarrier, scaled so that black is 0 and white is 1
+static double signalLevel(int pixel, int phase) {
+	int hue = pixel & 0x0F;
+	int level = (pixel >> 4) & 0x03;
+	int emphasis = pixel >> NF_PIXEL_EMPHASIS_SHIFT;
+	if (hue > 13) { level = 1; }				// Columns E and F are black
+	double low = SIGNAL_LOW[level];
+	double high = SIGNAL_HIGH[level];
+	if (hue == 0) { low = high; }				// Column 0 is gray, only the high level
+	if (hue > 12) { high = low; }				// Column D is gray, only the low level
+	double signal = inColorPhase(hue, phase) ? high : low;
+
+	// Each emphasis bit darkens the signal during a third of the subcarrier cycle
+	if (hue < 0x0E && (((emphasis & 0x01) && inColorPhase(0, phase)) || ((emphasis & 0x02) && inColorPhase(4, phase)) || ((emphasis & 0x04) && inColorPhase(8, phase)))) {
+		signal *= EMPHASIS_ATTENUATION;
+	}
+	return (signal - SIGNAL_BLACK) / (SIGNAL_WHITE - SIGNAL_BLACK);
+}
+
+static double lumaFilter(double distance) { return fabs(distance) < LUMA_WIDTH / 2 ? 1.0 / LUMA_WIDTH : 0.0; }
+
+static double chromaFilter(double distance) {
+	if (fabs(distance) >= CHROMA_WIDTH / 2) { return 0.0; }
+	return (1.0 + cos(2.0 * M_PI * distance / CHROMA_WIDTH)) / CHROMA_WIDTH;
+}
+
+static int16_t toKernel(double value) { return (int16_t)lrint(value * 255.0 * BRIGHTNESS * KERNEL_SCALE); }
+
+// Decode the signal of one pixel on its own, at every output pixel it reaches
+static void buildKernel(int16_t* kernels, int burst, int color, int position) {
+	for (int span = 0; span < NF_NTSC_KERNEL_SPAN; span++) {
+		int16_t* out = kernels + KERNEL_INDEX(burst, color, position, span);
+		memset(out, 0, NF_NTSC_KERNEL_VALUES * sizeof(int16_t));
+		for (int x = 0; x < NF_NTSC_OUT_GROUP; x++) {
+			double center = (span - 1) * SAMPLES_PER_GROUP + (x + 0.5) * SAMPLES_PER_GROUP / NF_NTSC_OUT_GROUP;
+			double y = 0, i = 0, q = 0;
+			for (int s = position * SAMPLES_PER_PIXEL; s < (position + 1) * SAMPLES_PER_PIXEL; s++) {
+				int phase = (s + burst * 4) % SAMPLES_PER_CYCLE;
+				double signal = signalLevel(color, phase);
+				double distance = center - (s + 0.5);
+				double angle = M_PI * (phase + HUE_OFFSET) / 6.0;
+				y += lumaFilter(distance) * signal;
+				i += 2.0 * chromaFilter(distance) * signal * cos(angle);
+				q += 2.0 * chromaFilter(distance) * signal * sin(angle);
+			}
+			i *= SATURATION;
+			q *= SATURATION;
+			out[x * 4 + 0] = toKernel(y - 1.106 * i + 1.703 * q);
+			out[x * 4 + 1] = toKernel(y - 0.272 * i - 0.647 * q);
+			out[x * 4 + 2] = toKernel(y + 0.956 * i + 0.621 * q);
+		}
+	}
+}
+
+struct NF_NTSC* NF_NTSC_create(int threads) {
+	struct NF_NTSC* ntsc = calloc(1, sizeof(struct NF_NTSC));
+	size_t kernel_count = KERNEL_INDEX(NF_NTSC_BURST_PHASES, 0, 0, 0);
+	if (ntsc == NULL || (ntsc->kernels = malloc(kernel_count * sizeof(int16_t))) == NULL) {
+		printf("Error: Could not create NTSC filter. Out of memory?\n");
+		free(ntsc);
+		return NULL;
+	}
+	for (int burst = 0; burst < NF_NTSC_BURST_PHASES; burst++) {
+		for (int color = 0; color < NF_NTSC_COLORS; color++) {
+			for (int position = 0; position < NF_NTSC_IN_GROUP; position++) { buildKernel(ntsc->kernels, burst, color, position); }
+		}
+	}
+
+	// The calling thread takes a strip too
+	if (threads <= 0) { threads = NF_getProcessorCount(); }
+	ntsc->pool = (threads > 1) ? NF_createThreadPool(threads - 1) : NULL;
+	ntsc->strips = (ntsc->pool != NULL) ? ntsc->pool->thread_count + 1 : 1;
+	return ntsc;
+}
+
+void NF_NTSC_free(struct NF_NTSC* ntsc) {
+	if (ntsc == NULL) { return; }
+	NF_freeThreadPool(ntsc->pool);
+	free(ntsc->kernels);
+	free(ntsc);
+}
+
+// Copy a line into the middle of a black padded one, keeping the color and emphasis bits only
+static void padLine(const uint16_t* pixels, uint16_t* padded) {
+	for (int x = 0; x < PADDED_WIDTH; x++) { padded[x] = BLACK_PIXEL; }
+	for (int x = 0; x < NF_FRAME_WIDTH; x++) { padded[NF_NTSC_IN_GROUP + x] = pixels[x] & (NF_NTSC_COLORS - 1); }
+}
+
+#ifdef NF_X86
+
+// Each output group is the sum of 9 kernels: the 3 pixels of its own group and of the groups either side. Sums are
+// kept as 16 bit values, B G R A for 8 pixels across two registers, then scaled down and packed into bytes
+NF_TARGET("avx2")
+static void filterLineAVX2(const int16_t* kernels, const uint16_t* padded, uint32_t* out) {
+	const __m256i rounding = _mm256_set1_epi16(ROUNDING);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	for (int group = 0; group < NF_NTSC_GROUPS; group++) {
+		__m256i lo = rounding;
+		__m256i hi = rounding;
+		for (int span = 0; span < NF_NTSC_KERNEL_SPAN; span++) {
+			const uint16_t* source = padded + (group + 2 - span) * NF_NTSC_IN_GROUP;
+			for (int position = 0; position < NF_NTSC_IN_GROUP; position++) {
+				const int16_t* kernel = kernels + KERNEL_INDEX(0, source[position], position, span);
+				lo = _mm256_add_epi16(lo, _mm256_loadu_si256((const __m256i*)kernel));
+				hi = _mm256_add_epi16(hi, _mm256_loadu_si256((const __m256i*)(kernel + 16)));
+			}
+		}
+		__m256i packed = _mm256_packus_epi16(_mm256_srai_epi16(lo, 4), _mm256_srai_epi16(hi, 4));
+		packed = _mm256_or_si256(_mm256_permute4x64_epi64(packed, 0xD8), alpha);
+
+		// The eighth pixel is padding, and is overwritten by the next group except at the end of the line
+		if (group < NF_NTSC_GROUPS - 1) { _mm256_storeu_si256((__m256i*)(out + group * NF_NTSC_OUT_GROUP), packed); }
+		else {
+			uint32_t last[8];
+			_mm256_storeu_si256((__m256i*)last, packed);
+			memcpy(out + group * NF_NTSC_OUT_GROUP, last, NF_NTSC_OUT_GROUP * sizeof(uint32_t));
+		}
+	}
+}
+
+#endif
+
+static void filterLine(const int16_t* kernels, const uint16_t* padded, uint32_t* out) {
+	for (int group = 0; group < NF_NTSC_GROUPS; group++) {
+		int16_t sum[NF_NTSC_KERNEL_VALUES];
+		for (int v = 0; v < NF_NTSC_KERNEL_VALUES; v++) { sum[v] = ROUNDING; }
+		for (int span = 0; span < NF_NTSC_KERNEL_SPAN; span++) {
+			const uint16_t* source = padded + (group + 2 - span) * NF_NTSC_IN_GROUP;
+			for (int position = 0; position < NF_NTSC_IN_GROUP; position++) {
+				const int16_t* kernel = kernels + KERNEL_INDEX(0, source[position], position, span);
+				for (int v = 0; v < NF_NTSC_KERNEL_VALUES; v++) { sum[v] += kernel[v]; }
+			}
+		}
+		for (int x = 0; x < NF_NTSC_OUT_GROUP; x++) {
+			uint32_t pixel = 0xFF000000;
+			for (int c = 0; c < 3; c++) {
+				int value = sum[x * 4 + c] >> 4;
+				if (value < 0) { value = 0; }
+				if (value > 255) { value = 255; }
+				pixel |= (uint32_t)value << (c * 8);
+			}
+			out[group * NF_NTSC_OUT_GROUP + x] = pixel;
+		}
+	}
+}
+
+static void filterStrip(void* context, int strip) {
+	static int useAVX2 = -1;
+	struct NF_NTSC* ntsc = (struct NF_NTSC*)context;
+	int first = strip * NF_FRAME_HEIGHT / ntsc->strips;
+	int last = (strip + 1) * NF_FRAME_HEIGHT / ntsc->strips;
+#ifdef NF_X86
+	if (useAVX2 < 0) { useAVX2 = NF_cpuHasFeature(NF_CPU_AVX2); }
+#else
+	useAVX2 = 0;
+#endif
+
+	uint16_t padded[PADDED_WIDTH];
+	for (int y = first; y < last; y++) {
+		const int16_t* kernels = ntsc->kernels + KERNEL_INDEX((y + ntsc->burst_phase) % NF_NTSC_BURST_PHASES, 0, 0, 0);
+		uint32_t* out = (uint32_t*)((uint8_t*)ntsc->output + y * ntsc->pitch);
+		padLine(ntsc->frame->pixels[y], padded);
+#ifdef NF_X86
+		if (useAVX2) {
+			filterLineAVX2(kernels, padded, out);
+			continue;
+		}
+#endif
+		filterLine(kernels, padded, out);
+	}
+}
+
+void NF_NTSC_filter(struct NF_NTSC* ntsc, const struct NF_Frame* frame, uint32_t* output, size_t pitch, int burst_phase) {
+	ntsc->frame = frame;
+	ntsc->output = output;
+	ntsc->pitch = pitch;
+	ntsc->burst_phase = burst_phase % NF_NTSC_BURST_PHASES;
+	if (ntsc->pool != NULL) { NF_runTasks(ntsc->pool, ntsc->strips, filterStrip, ntsc); }
+	else { filterStrip(ntsc, 0); }
+}
@@ -0,0 +1,53 @@
+#ifndef NF_H_NTSC
+#define NF_H_NTSC
+#include "NF_Frame.h"
+#include "NF_ThreadPool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Recreates the look of the NES on a TV through composite video. The PPU does not output RGB, it outputs a signal
+// that switches between two voltages in step with the color subcarrier, and the TV separates that back into
+// brightness and color with filters that let the two bleed into each other. Here, the signal of every pixel is
+// made and decoded ahead of time, once for every palette color (with emphasis), so filtering a frame only has to
+// add up precomputed contributions.
+//
+// Every NES pixel is 8 samples of the signal and one cycle of the subcarrier is 12, so the pattern repeats every 3
+// pixels. Each group of 3 pixels becomes 7 output pixels, which gives 602 pixels per line. The subcarrier also starts
+// at one of 3 phases on each line, so there is one set of contributions for each phase.
+
+#define NF_NTSC_IN_GROUP 3				// Input pixels per group
+#define NF_NTSC_OUT_GROUP 7				// Output pixels per group
+#define NF_NTSC_GROUPS ((NF_FRAME_WIDTH + NF_NTSC_IN_GROUP - 1) / NF_NTSC_IN_GROUP)
+#define NF_NTSC_OUTPUT_WIDTH (NF_NTSC_GROUPS * NF_NTSC_OUT_GROUP)
+#define NF_NTSC_BURST_PHASES 3
+#define NF_NTSC_COLORS 512				// 64 palette colors times 8 combinations of emphasis bits
+
+// A pixel's contribution reaches the group it is in and the ones either side. For each of those, the contribution
+// to 7 output pixels as B, G, R, A, padded to 32 values so that it fills two AVX2 registers
+#define NF_NTSC_KERNEL_VALUES 32
+#define NF_NTSC_KERNEL_SPAN 3
+
+struct NF_NTSC {
+	// [burst phase][color][position in group][output group - input group + 1][value], in 1/16ths of an 8 bit level
+	int16_t* kernels;
+	struct NF_ThreadPool* pool;		// NULL when filtering on the calling thread only
+	int strips;
+
+	// The frame being filtered, for the strip tasks
+	const struct NF_Frame* frame;
+	uint32_t* output;
+	size_t pitch;
+	int burst_phase;
+};
+
+// Build the contributions. threads is how many threads split up each frame into strips of lines, with 0 meaning
+// one per processor. Returns NULL if out of memory
+struct NF_NTSC* NF_NTSC_create(int threads);
+void NF_NTSC_free(struct NF_NTSC* ntsc);
+
+// Filter a frame into NF_NTSC_OUTPUT_WIDTH x NF_FRAME_HEIGHT pixels of ARGB8888. pitch is the distance between lines
+// of output in bytes. burst_phase shifts the subcarrier phase of every line, which makes the artifacts crawl when
+// it changes between frames, like they do on the real thing
+void NF_NTSC_filter(struct NF_NTSC* ntsc, const struct NF_Frame* frame, uint32_t* output, size_t pitch, int burst_phase);
+
+#endif
@@ -0,0 +1,225 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_Nestest.h"
+#include "NF_Bus.h"
+#include "NF_6502.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How far past the last line of the log the console may run without reaching it before giving up
+#define NESTEST_SLACK_CYCLES 1000
+
+// The check takes well under a millisecond, so NF_Nestest_check runs it this many times and reports the fastest
+#define NESTEST_TIMING_RUNS 20
+
+// Registers start at this column of a line
+#define NESTEST_REGISTERS_COLUMN 48
+
+static int hexDigit(char c) { return isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10; }
+
+// Read the fields of a line of the log into a record. Lines look like:
+// C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+static bool parseLine(const char* line, struct NF_TraceRecord* record) {
+	memset(record, 0, sizeof(*record));
+	unsigned int pc, a, x, y, p, sp;
+	int scanline, dot;
+	unsigned long long cycle;
+	if (strlen(line) < NESTEST_REGISTERS_COLUMN || sscanf(line, "%4x", &pc) != 1 ||
+		sscanf(line + NESTEST_REGISTERS_COLUMN, "A:%2x X:%2x Y:%2x P:%2x SP:%2x PPU:%d,%d CYC:%llu", &a, &x, &y, &p, &sp, &scanline, &dot, &cycle) != 8) {
+		return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		const char* digits = line + 6 + 3 * i;
+		if (!isxdigit((unsigned char)digits[0]) || !isxdigit((unsigned char)digits[1])) { break; }
+		record->bytes[i] = (uint8_t)(hexDigit(digits[0]) << 4 | hexDigit(digits[1]));
+	}
+	record->pc = (uint16_t)pc;
+	record->a = (uint8_t)a;
+	record->x = (uint8_t)x;
+	record->y = (uint8_t)y;
+	record->p = (uint8_t)p;
+	record->sp = (uint8_t)sp;
+	record->scanline = (int16_t)scanline;
+	record->dot = (int16_t)dot;
+	record->cycle = cycle;
+	return true;
+}
+
+struct NF_NestestLog* NF_NestestLog_load(const char* path) {
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		printf("Error: Could not open %s.\n", path);
+		return NULL;
+	}
+	struct NF_NestestLog* log = calloc(1, sizeof(struct NF_NestestLog));
+	if (log == NULL) {
+		printf("Error: Could not create nestest log object. Out of memory?\n");
+		fclose(file);
+		return NULL;
+	}
+
+	uint64_t capacity = 0;
+	bool checking = true;
+	char line[NF_TRACE_LINE_SIZE];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		size_t length = strlen(line);
+		if (length > 0 && line[length - 1] != '\n' && !feof(file)) {
+			printf("Error: Line %llu of %s is too long.\n", (unsigned long long)log->total_lines + 1, path);
+			NF_NestestLog_free(log);
+			fclose(file);
+			return NULL;
+		}
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) { line[--length] = '\0'; }
+		log->total_lines++;
+		if (length == 0 || !checking) { continue; }
+		if (length > 15 && line[15] == '*') {
+			checking = false;
+			continue;
+		}
+
+		if (log->count == capacity) {
+			capacity = (capacity == 0) ? 8192 : capacity * 2;
+			char (*lines)[NF_TRACE_LINE_SIZE] = realloc(log->lines, (size_t)capacity * NF_TRACE_LINE_SIZE);
+			if (lines != NULL) { log->lines = lines; }
+			struct NF_TraceRecord* records = realloc(log->records, (size_t)capacity * sizeof(struct NF_TraceRecord));
+			if (records != NULL) { log->records = records; }
+			if (lines == NULL || records == NULL) {
+				printf("Error: Could not allocate nestest log. Out of memory?\n");
+				NF_NestestLog_free(log);
+				fclose(file);
+				return NULL;
+			}
+		}
+		if (!parseLine(line, &log->records[log->count])) {
+			printf("Error: Line %llu of %s is not in the nestest log format.\n", (unsigned long long)log->total_lines, path);
+			NF_NestestLog_free(log);
+			fclose(file);
+			return NULL;
+		}
+		memcpy(log->lines[log->count], line, length + 1);
+		log->count++;
+	}
+	fclose(file);
+	return log;
+}
+
+void NF_NestestLog_free(struct NF_NestestLog* log) {
+	if (log == NULL) { return; }
+	free(log->lines);
+	free(log->records);
+	free(log);
+}
+
+// Compare the fields of a record that the log shows, apart from the disassembly
+static bool sameState(const struct NF_TraceRecord* expected, const struct NF_TraceRecord* actual) {
+	return expected->pc == actual->pc && memcmp(expected->bytes, actual->bytes, sizeof(expected->bytes)) == 0 &&
+		expected->a == actual->a && expected->x == actual->x && expected->y == actual->y && expected->p == actual->p &&
+		expected->sp == actual->sp && expected->scanline == actual->scanline && expected->dot == actual->dot && expected->cycle == actual->cycle;
+}
+
+bool NF_Nestest_run(const char* rom_path, const struct NF_NestestLog* log, struct NF_NestestResult* result) {
+	memset(result, 0, sizeof(*result));
+	struct Cartridge* cart = NF_loadCartridge(rom_path);
+	struct NES_Console* console = (cart != NULL) ? NF_initConsole() : NULL;
+	if (console == NULL || NF_insertCartridge(console, cart) != 0) {
+		NF_freeConsole(console);
+		NF_freeCartridge(cart);
+		return false;
+	}
+
+	// The ring holds every instruction of the run, so that their text can be checked afterwards
+	struct NF_Tracer* tracer = NF_Tracer_createRing((uint32_t)log->count + 1);
+	if (tracer == NULL) {
+		NF_freeConsole(console);
+		NF_freeCartridge(cart);
+		return false;
+	}
+	console->ConnectedProcessor->PC = NF_NESTEST_AUTOMATION_START;
+	NF_setTracer(console, tracer);
+
+	uint64_t cycle_limit = NESTEST_SLACK_CYCLES + ((log->count > 0) ? log->records[log->count - 1].cycle : 0);
+	uint64_t checked = 0;
+	bool differs = false;
+	uint64_t start = NF_getTicks();
+	while (checked < log->count && !differs && console->cpu_cycle < cycle_limit) {
+		NF_busTickMasterClock(console, true);
+		for (; checked < tracer->count && checked < log->count; checked++) {
+			if (!sameState(&log->records[checked], NF_Tracer_get(tracer, checked))) {
+				differs = true;
+				break;
+			}
+		}
+	}
+	result->seconds = (double)(NF_getTicks() - start) / (double)NF_getTickFrequency();
+	NF_setTracer(console, NULL);
+	result->instructions = tracer->count;
+	result->cycles = console->cpu_cycle;
+
+	// A line whose text differs, showing a different value read from memory say, may come before the first one
+	// whose registers differ
+	char line[NF_TRACE_LINE_SIZE];
+	for (uint64_t i = 0; i < checked; i++) {
+		NF_formatTraceRecord(NF_Tracer_get(tracer, i), line, sizeof(line));
+		if (strcmp(line, log->lines[i]) != 0) {
+			checked = i;
+			differs = true;
+			result->text_only = true;
+			break;
+		}
+	}
+
+	result->passed = !differs && checked == log->count;
+	if (!result->passed) {
+		result->line = checked + 1;
+		result->expected = log->records[checked];
+		memcpy(result->expected_line, log->lines[checked], sizeof(result->expected_line));
+		const struct NF_TraceRecord* actual = NF_Tracer_get(tracer, checked);
+		if (actual != NULL) {
+			result->actual = *actual;
+			NF_formatTraceRecord(actual, result->actual_line, sizeof(result->actual_line));
+		}
+		else { result->actual_missing = true; }
+	}
+	NF_Tracer_free(tracer);
+	NF_freeConsole(console);
+	NF_freeCartridge(cart);
+	return true;
+}
+
+int NF_Nestest_check(const char* rom_path, const char* log_path) {
+	struct NF_NestestLog* log = NF_NestestLog_load(log_path);
+	if (log == NULL) { return 1; }
+	struct NF_NestestResult result;
+	if (!NF_Nestest_run(rom_path, log, &result)) {
+		NF_NestestLog_free(log);
+		return 1;
+	}
+	if (result.passed) {
+		printf("All %llu instructions up to the first unofficial opcode match %s.\n", (unsigned long long)log->count, log_path);
+	}
+	else {
+		printf("Line %llu of %s differs:\n", (unsigned long long)result.line, log_path);
+		printf("expected  %s\n", result.expected_line);
+		if (result.actual_missing) { printf("The console did not get that far.\n"); }
+		else {
+			printf("actual    %s\n", result.actual_line);
+			if (!result.text_only) {
+				printf("(expected/actual) ");
+				NF_printTraceDifferences(&result.expected, &result.actual, false);
+			}
+		}
+	}
+
+	double seconds = result.seconds;
+	for (int i = 1; i < NESTEST_TIMING_RUNS; i++) {
+		struct NF_NestestResult timing;
+		if (NF_Nestest_run(rom_path, log, &timing) && timing.seconds < seconds) { seconds = timing.seconds; }
+	}
+	printf("Ran %llu instructions (%llu cycles) in %.3f ms, %.2f million instructions per second (fastest of %d runs).\n",
+		(unsigned long long)result.instructions, (unsigned long long)result.cycles, seconds * 1000.0,
+		seconds > 0 ? result.instructions / seconds / 1000000.0 : 0.0, NESTEST_TIMING_RUNS);
+	NF_NestestLog_free(log);
+	return result.passed ? 0 : 2;
+}
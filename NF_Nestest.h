@@ -0,0 +1,56 @@
+#ifndef NF_H_NESTEST
+#define NF_H_NESTEST
+#include "NF_Debugger.h"
+#include "NF_Trace.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Checking the CPU against nestest.nes. Started at $C000 instead of its reset vector, nestest runs every one of its
+// tests on its own without a screen or controller ("automation mode"), and the log of a known good emulator doing
+// that (goodlog.txt) has a line for every instruction. The console runs with a tracer attached, and each instruction
+// is checked against its line of the log as it starts, so that the run stops at the first one that differs.
+//
+// Checking stops at the first unofficial opcode in the log (marked with a '*'), since the CPU does not run them.
+// Formatting records as text is slow compared to running the instructions, so while the console runs, only the PC,
+// instruction bytes, registers, PPU position and cycle count are compared. The text of the lines, which also shows the
+// values read from memory, is compared once the run is over. This keeps the run quick enough to time.
+
+#define NF_NESTEST_AUTOMATION_START 0xC000
+
+// The lines of a log, and the same lines read back into trace records. Only the fields the log shows are set
+struct NF_NestestLog {
+	char (*lines)[NF_TRACE_LINE_SIZE];
+	struct NF_TraceRecord* records;
+	uint64_t count;					// Lines checked
+	uint64_t total_lines;			// Lines in the whole log, including those after the first unofficial opcode
+};
+
+struct NF_NestestResult {
+	bool passed;
+	uint64_t instructions;			// Instructions run, including the one that differed
+	uint64_t cycles;				// CPU cycles run
+	double seconds;					// Taken to run and check them, not counting loading the ROM or checking the text
+	uint64_t line;					// Line of the log of the first difference, counting from 1, or 0 if there was none
+
+	// The line that differed and the instruction that should have matched it. Only set if there was a difference
+	char expected_line[NF_TRACE_LINE_SIZE];
+	char actual_line[NF_TRACE_LINE_SIZE];
+	struct NF_TraceRecord expected;
+	struct NF_TraceRecord actual;
+	bool actual_missing;			// The console stopped running instructions before reaching the line
+	bool text_only;					// Only the text differs (a value read from memory, say), not the registers
+};
+
+// Read a log in the nestest format. Returns NULL (and prints why) if it cannot be read or a line is malformed
+struct NF_NestestLog* NF_NestestLog_load(const char* path);
+void NF_NestestLog_free(struct NF_NestestLog* log);
+
+// Run nestest.nes in automation mode against a log. Returns false (and prints why) only if the ROM cannot be run: a
+// difference from the log is reported in result
+bool NF_Nestest_run(const char* rom_path, const struct NF_NestestLog* log, struct NF_NestestResult* result);
+
+// The whole check, as the command line tools run it: load the log, run nestest against it, print the result, and run
+// it a few more times to time it. Returns 0 if every line matched, 2 if one differs, and 1 if the check could not run
+int NF_Nestest_check(const char* rom_path, const char* log_path);
+
+#endif
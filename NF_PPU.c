@@ -1,13 +1,17 @@
 #include "NF_PPU.h"
 #include "NF_6502.h"
 #include "NF_Palette.h"
+#include "NF_Probes.h"
 #include "NF_Cartridge.h"
+#include "NF_Compositor.h"
+#include "NF_Frame.h"
+#include "NF_RenderThread.h"
 #include <stdlib.h>
 #include <stdio.h>
 
 // Constructor
 struct PictureProcessingUnit* NF_initPPU() {
-	struct PictureProcessingUnit* newppu = malloc(sizeof(struct PictureProcessingUnit));
+	struct PictureProcessingUnit* newppu = calloc(1, sizeof(struct PictureProcessingUnit));
 	if (newppu == NULL) {
 		printf("Error: Could not create PPU object. Out of memory?\n");
 		return 0;
@@ -30,30 +34,31 @@ struct PictureProcessingUnit* NF_initPPU() {
 	return newppu;
 }
 
+// Find where a nametable address ($2000-$2FFF, after mirroring $3000-$3EFF down) lives in nametable memory.
+// The cartridge decides this, either hard-wired or through its mapper
+static inline uint16_t nametableIndex(struct PictureProcessingUnit* ppu, uint16_t addr) {
+	return ppu->bus->ConnectedCartridge->nametable_map[(addr >> 10) & 0x03] + (addr & 0x03FF);
+}
+
 // Write to the PPU address space
 void NF_PPU_writeMemory(struct PictureProcessingUnit* ppu, uint16_t addr, uint8_t data) {
 	addr &= 0x3FFF;  // Mask to the PPU address space (0x0000 - 0x3FFF)
 
-	// Handle nametable memory writes
-	if (addr < 0x3F00) {
-
-		// Mirror addresses in range 0x3000 - 0x3EFF down to 0x2000 - 0x2EFF
-		if (addr >= 0x3000) {
-			addr -= 0x1000;  // Mirror 0x3000-0x3EFF to 0x2000-0x2EFF
+	// Handle cartridge CHR writes (only boards with CHR RAM will do anything with these)
+	struct NF_PPUJournal* journal = ppu->bus->ppu_journal;
+	if (addr < NAMETABLE_0_ADDRESS) {
+		struct Cartridge* cart = ppu->bus->ConnectedCartridge;
+		NF_writeCartCHR_RAM(cart, addr, data);
+		if (journal != NULL && cart->chr_is_ram) {
+			NF_PPUJournal_recordWrite(journal, NF_JOURNAL_CHR_RAM, (uint32_t)(cart->chr_map[addr >> 10] - cart->chr_rom) + (addr & 0x03FF), data);
 		}
+	}
 
-		// Nametable mirroring based on cartridge configuration (Horizontal/Vertical)
-		if (ppu->bus->ConnectedCartridge->nametable_mirroring == HORIZONTAL_MAPPING) {
-			if (addr < 0x0400 || (addr >= 0x0800 && addr < 0x0C00)) {
-				ppu->PPU_NametableMemory[addr & 0x03FF] = data;
-			}
-			else {
-				ppu->PPU_NametableMemory[(addr & 0x03FF) + 0x400] = data;
-			}
-		}
-		else if (ppu->bus->ConnectedCartridge->nametable_mirroring == VERTICAL_MAPPING) {
-			ppu->PPU_NametableMemory[addr & 0x07FF] = data;  // Vertically map
-		}
+	// Handle nametable memory writes. Addresses in range 0x3000 - 0x3EFF are mirrors of 0x2000 - 0x2EFF
+	else if (addr < 0x3F00) {
+		uint16_t index = nametableIndex(ppu, addr);
+		ppu->PPU_NametableMemory[index] = data;
+		if (journal != NULL) { NF_PPUJournal_recordWrite(journal, NF_JOURNAL_NAMETABLE, index, data); }
 	}
 
 	// Handle palette RAM writes (0x3F00-0x3FFF, including mirroring)
@@ -67,6 +72,7 @@ void NF_PPU_writeMemory(struct PictureProcessingUnit* ppu, uint16_t addr, uint8_
 		if (addr == 0x001C) { addr = 0x000C; }  // 0x3F1C is a mirror of 0x3F0C
 
 		ppu->PPU_PaletteMemory[addr] = data;
+		if (journal != NULL) { NF_PPUJournal_recordWrite(journal, NF_JOURNAL_PALETTE, addr, data); }
 	}
 
 	else {
@@ -79,28 +85,18 @@ void NF_PPU_writeMemory(struct PictureProcessingUnit* ppu, uint16_t addr, uint8_
 uint8_t NF_PPU_readMemory(struct PictureProcessingUnit* ppu, uint16_t addr) {
     addr &= 0x3FFF;  // Mask to the PPU address space (0x0000 - 0x3FFF)
 
-    // Handle cartridge CHR-ROM reads
+    // Handle cartridge CHR-ROM reads. A render thread logs CHR, so it is handed the read in the journal
     if (addr < NAMETABLE_0_ADDRESS) {
-        return NF_readCartCHR_ROM(ppu->bus->ConnectedCartridge, addr);
+        struct Cartridge* cart = ppu->bus->ConnectedCartridge;
+        if (ppu->bus->ppu_journal != NULL && !cart->chr_is_ram) {
+            NF_PPUJournal_recordCHRRead(ppu->bus->ppu_journal, (uint32_t)(cart->chr_map[addr >> 10] - cart->chr_rom) + (addr & 0x03FF));
+        }
+        return NF_readCartCHR_ROM(cart, addr);
     }
 
-    // Handle nametable memory reads
+    // Handle nametable memory reads. Addresses in range 0x3000 - 0x3EFF are mirrors of 0x2000 - 0x2EFF
     else if (addr < 0x3F00) {
-        // Mirror addresses in range 0x3000 - 0x3EFF down to 0x2000 - 0x2EFF
-        if (addr >= 0x3000) {
-            addr -= 0x1000;  // Mirror 0x3000-0x3EFF to 0x2000-0x2EFF
-        }
-
-        // Nametable mirroring based on cartridge configuration (Horizontal/Vertical)
-        if (ppu->bus->ConnectedCartridge->nametable_mirroring == HORIZONTAL_MAPPING) {
-            if (addr < 0x0400 || (addr >= 0x0800 && addr < 0x0C00)) {
-                return ppu->PPU_NametableMemory[addr & 0x03FF];
-            } else {
-                return ppu->PPU_NametableMemory[(addr & 0x03FF) + 0x400];
-            }
-        } else if (ppu->bus->ConnectedCartridge->nametable_mirroring == VERTICAL_MAPPING) {
-            return ppu->PPU_NametableMemory[addr & 0x07FF];  // Vertically map
-        }
+        return ppu->PPU_NametableMemory[nametableIndex(ppu, addr)];
     }
 
     // Handle palette RAM reads (0x3F00-0x3FFF, including mirroring)
@@ -126,6 +122,7 @@ uint8_t NF_PPU_readMemory(struct PictureProcessingUnit* ppu, uint16_t addr) {
 // "Reading any readable port(PPUSTATUS, OAMDATA, or PPUDATA) also fills the latch with the bits read.
 // Reading a nominally "write-only" register returns the latch's current value" - wiki.nesdev.com
 uint8_t NF_PPU_readRegister(struct PictureProcessingUnit *ppu, PPU_REGISTER reg) {
+	ppu->bus->counters.ppu_reads[reg]++;
 	uint8_t tmp;
 	switch (reg) {
 		case REG_PPUCTRL:
@@ -144,8 +141,7 @@ uint8_t NF_PPU_readRegister(struct PictureProcessingUnit *ppu, PPU_REGISTER reg)
 			return 0;
 			break;
 		case REG_OAMDATA:
-			return 0;
-			break;
+			return ppu->PPU_OAM[ppu->reg_OAMADDR];
 		case REG_PPUSCROLL:
 			return 0;
 			break;
@@ -166,25 +162,45 @@ uint8_t NF_PPU_readRegister(struct PictureProcessingUnit *ppu, PPU_REGISTER reg)
 	}
 }
 
+uint8_t NF_PPU_peekRegister(struct PictureProcessingUnit* ppu, PPU_REGISTER reg) {
+	switch (reg) {
+	case REG_PPUSTATUS:
+		return (ppu->reg_PPUSTATUS & 0xE0) | (ppu->delayed_buffer & 0x1F);
+	case REG_OAMDATA:
+		return ppu->PPU_OAM[ppu->reg_OAMADDR];
+	case REG_PPUDATA:
+		if (ppu->vram_addr.address >= 0x3F00) { return NF_PPU_readMemory(ppu, ppu->vram_addr.address); }
+		return ppu->delayed_buffer;
+	default:
+		return 0;
+	}
+}
+
 // Write one of the eight PPU registers
 void NF_PPU_writeRegister(struct PictureProcessingUnit* ppu, PPU_REGISTER reg, uint8_t data) {
+	ppu->bus->counters.ppu_writes[reg]++;
+	NF_PROBE2(ppu_write, (int)reg, data);
 	switch (reg) {
 	case REG_PPUCTRL:
+		// Turning NMIs on during VBlank fires one straight away
+		if (!(ppu->reg_PPUCTRL & 0x80) && (data & 0x80) && (ppu->reg_PPUSTATUS & 0x80)) { NF_emitNMI(ppu->bus); }
 		ppu->reg_PPUCTRL = data;
 		ppu->tram_addr.nametable_x = (data & 0x01);
 		ppu->tram_addr.nametable_y = (data & 0x02) >> 1;
 		break;
 	case REG_PPUMASK:
 		ppu->reg_PPUMASK = data;
+		NF_PPU_scheduleScanlineCounter(ppu);
 		break;
 	case REG_PPUSTATUS:
 		printf("Error: PPUSTATUS is a read-only PPU register.\n");
 		break;
 	case REG_OAMADDR:
-		// To Do: Flesh this out
+		ppu->reg_OAMADDR = data;
 		break;
 	case REG_OAMDATA:
-		// To Do: Flesh this out
+		if (ppu->bus->ppu_journal != NULL) { NF_PPUJournal_recordWrite(ppu->bus->ppu_journal, NF_JOURNAL_OAM, ppu->reg_OAMADDR, data); }
+		ppu->PPU_OAM[ppu->reg_OAMADDR++] = data;
 		break;
 	case REG_PPUSCROLL:
 		// Handle fine/coarse scrolling
@@ -220,6 +236,232 @@ void NF_PPU_writeRegister(struct PictureProcessingUnit* ppu, PPU_REGISTER reg, u
 	}
 }
 
+void NF_PPU_writeOAM(struct PictureProcessingUnit* ppu, const uint8_t* page) {
+	struct NF_PPUJournal* journal = ppu->bus->ppu_journal;
+	for (int i = 0; i < PPU_OAM_MEMORY_SIZE; i++) {
+		uint8_t index = (uint8_t)(ppu->reg_OAMADDR + i);
+		ppu->PPU_OAM[index] = page[i];
+		if (journal != NULL) { NF_PPUJournal_recordWrite(journal, NF_JOURNAL_OAM, index, page[i]); }
+	}
+}
+
+// Boards like the MMC3 count scanlines by watching PPU A12. With the usual setup (background from $0000, sprites
+// from $1000) it rises once per rendered scanline, at dot 260 when the sprite fetches begin. Rather than checking
+// for that on every dot, the bus is asked to raise an event at the right CPU cycle.
+void NF_PPU_scheduleScanlineCounter(struct PictureProcessingUnit* ppu) {
+	struct NES_Console* console = ppu->bus;
+	if (console->ConnectedCartridge == NULL || console->ConnectedCartridge->mapper_impl->ppuA12Rise == NULL) { return; }
+
+	// A12 only toggles while the PPU is fetching, which it only does when rendering is enabled
+	if ((ppu->reg_PPUMASK & 0x18) == 0) {
+		NF_cancelEvent(console, NF_EVENT_MAPPER_A12);
+		return;
+	}
+
+	// Find the next visible (or pre-render) scanline that has not reached dot 260 yet
+	int line = ppu->scanline;
+	int dots = 0;
+	bool rendered = (line < PPU_SCANLINE_SCREEN_MAX || line == PPU_SCANLINE_MAX);
+	if (!rendered || ppu->cycle >= PPU_A12_RISE_DOT) {
+		do {
+			line = (line + 1) % (PPU_SCANLINE_MAX + 1);
+			dots += PPU_CYCLE_MAX;
+		} while (!(line < PPU_SCANLINE_SCREEN_MAX || line == PPU_SCANLINE_MAX));
+	}
+	dots += PPU_A12_RISE_DOT - ppu->cycle;
+
+	// Three dots per CPU cycle, rounded up
+	NF_scheduleEvent(console, NF_EVENT_MAPPER_A12, console->cpu_cycle + (dots + 2) / 3);
+}
+
+// Pattern table reads go straight through the cartridge's CHR bank map
+static inline uint8_t readPattern(const struct NF_PPULineSource* src, uint16_t addr) {
+#if NF_CDL_ENABLED
+	src->chr_log[(addr >> 10) & 0x07][addr & 0x03FF] |= NF_CDL_RENDERED;
+#endif
+	return src->chr[(addr >> 10) & 0x07][addr & 0x03FF];
+}
+
+static inline uint8_t readNametable(const struct NF_PPULineSource* src, uint16_t addr) {
+	return src->nametables[(addr >> 10) & 0x03][addr & 0x03FF];
+}
+
+static inline uint8_t readPalette(const uint8_t* palette, uint8_t index) {
+	if ((index & 0x03) == 0) { index = 0; }		// Every palette's color 0 is the shared background color
+	return palette[index & 0x1F];
+}
+
+// Move vram_addr down one pixel row, wrapping into the next nametable vertically after row 29
+static void incrementY(struct PictureProcessingUnit* ppu) {
+	union LoopyRegister* v = &ppu->vram_addr;
+	if (v->fine_y < 7) {
+		v->fine_y++;
+		return;
+	}
+	v->fine_y = 0;
+	if (v->coarse_y == 29) {
+		v->coarse_y = 0;
+		v->nametable_y ^= 1;
+	}
+	else if (v->coarse_y == 31) { v->coarse_y = 0; }
+	else { v->coarse_y++; }
+}
+
+// Point a line source at the PPU's own memory and the cartridge's current banks
+static void lineSource(struct PictureProcessingUnit* ppu, struct NF_PPULineSource* src) {
+	struct Cartridge* cart = ppu->bus->ConnectedCartridge;
+	src->ctrl = ppu->reg_PPUCTRL;
+	src->mask = ppu->reg_PPUMASK;
+	src->fine_x = ppu->fine_x;
+	src->v = ppu->vram_addr;
+	for (int i = 0; i < 8; i++) { src->chr[i] = cart->chr_map[i]; }
+	for (int i = 0; i < 8; i++) { src->chr_log[i] = cart->chr_log_map[i]; }
+	for (int i = 0; i < 4; i++) { src->nametables[i] = ppu->PPU_NametableMemory + cart->nametable_map[i]; }
+	src->palette = ppu->PPU_PaletteMemory;
+	src->oam = ppu->PPU_OAM;
+}
+
+// Background pixels of one scanline, as palette RAM indices (palette * 4 + color), with 0 meaning transparent
+static void renderBackgroundLine(const struct NF_PPULineSource* src, uint8_t* out) {
+	union LoopyRegister v = src->v;
+	uint16_t table = (src->ctrl & 0x10) ? 0x1000 : 0x0000;
+	int x = -src->fine_x;
+
+	// 33 tiles, because with fine scrolling the line starts partway into the first one
+	for (int tile = 0; tile < 33; tile++, x += 8) {
+		uint16_t nametable_addr = NAMETABLE_0_ADDRESS | (v.address & 0x0FFF);
+		uint16_t attribute_addr = 0x23C0 | (v.address & 0x0C00) | ((v.coarse_y >> 2) << 3) | (v.coarse_x >> 2);
+		uint8_t tile_id = readNametable(src, nametable_addr);
+		uint8_t attribute = readNametable(src, attribute_addr);
+		uint8_t palette = (attribute >> (((v.coarse_y & 0x02) << 1) | (v.coarse_x & 0x02))) & 0x03;
+		uint16_t pattern_addr = table + tile_id * 16 + v.fine_y;
+		uint8_t lo = readPattern(src, pattern_addr);
+		uint8_t hi = readPattern(src, pattern_addr + 8);
+
+		for (int bit = 0; bit < 8; bit++) {
+			int px = x + bit;
+			if (px < 0 || px >= NF_FRAME_WIDTH) { continue; }
+			uint8_t color = ((lo >> (7 - bit)) & 0x01) | (((hi >> (7 - bit)) & 0x01) << 1);
+			out[px] = color ? (palette << 2) | color : 0;
+		}
+
+		// Move to the next tile, wrapping into the next nametable horizontally
+		if (v.coarse_x == 31) {
+			v.coarse_x = 0;
+			v.nametable_x ^= 1;
+		}
+		else { v.coarse_x++; }
+	}
+}
+
+// Which row of a sprite falls on a scanline, or -1 if the sprite is not on it
+static inline int spriteRow(const struct NF_PPULineSource* src, const uint8_t* sprite, int line) {
+	int height = (src->ctrl & 0x20) ? 16 : 8;
+	int row = line - sprite[0] - 1;
+	return (row >= 0 && row < height) ? row : -1;
+}
+
+// Fetch the two pattern bytes for a row of a sprite, taking vertical flipping and 8x16 sprites into account
+static void spritePattern(const struct NF_PPULineSource* src, const uint8_t* sprite, int row, uint8_t* lo, uint8_t* hi) {
+	int height = (src->ctrl & 0x20) ? 16 : 8;
+	if (sprite[2] & 0x80) { row = height - 1 - row; }
+	uint16_t pattern_addr;
+	if (height == 16) {
+		uint8_t tile = (sprite[1] & 0xFE) + (row >= 8 ? 1 : 0);
+		pattern_addr = ((sprite[1] & 0x01) ? 0x1000 : 0x0000) + tile * 16 + (row & 0x07);
+	}
+	else { pattern_addr = ((src->ctrl & 0x08) ? 0x1000 : 0x0000) + sprite[1] * 16 + row; }
+	*lo = readPattern(src, pattern_addr);
+	*hi = readPattern(src, pattern_addr + 8);
+}
+
+// Color (0-3) of pixel bit of a sprite's row, counting from the left
+static inline uint8_t spritePixel(uint8_t attributes, uint8_t lo, uint8_t hi, int bit) {
+	int shift = (attributes & 0x40) ? bit : 7 - bit;
+	return ((lo >> shift) & 0x01) | (((hi >> shift) & 0x01) << 1);
+}
+
+// Sprite pixels of one scanline, in the layout NF_compositeLine takes. Only the first eight sprites found on the line
+// are drawn, like on the real thing. Returns true on sprite overflow
+static bool renderSpriteLine(const struct NF_PPULineSource* src, int line, uint8_t* out) {
+	int found = 0;
+
+	// Earlier sprites have priority, so a pixel is only drawn if no earlier sprite has drawn there
+	for (int i = 0; i < 64; i++) {
+		const uint8_t* sprite = src->oam + i * 4;
+		int row = spriteRow(src, sprite, line);
+		if (row < 0) { continue; }
+		if (found == PPU_SPRITES_PER_LINE) { return true; }
+		found++;
+
+		uint8_t attributes = sprite[2];
+		uint8_t lo, hi;
+		spritePattern(src, sprite, row, &lo, &hi);
+		for (int bit = 0; bit < 8; bit++) {
+			int px = sprite[3] + bit;
+			if (px >= NF_FRAME_WIDTH) { break; }
+			uint8_t color = spritePixel(attributes, lo, hi, bit);
+			if (color == 0 || out[px] != 0) { continue; }
+			out[px] = 0x10 | ((attributes & 0x03) << 2) | color;
+			if (attributes & 0x20) { out[px] |= NF_SPRITE_PIXEL_BEHIND; }
+			if (i == 0) { out[px] |= NF_SPRITE_PIXEL_ZERO; }
+		}
+	}
+	return false;
+}
+
+uint8_t NF_PPU_drawLine(const struct NF_PPULineSource* src, int line, uint16_t* out) {
+	// With rendering off, the screen shows the background color
+	if ((src->mask & 0x18) == 0) {
+		for (int x = 0; x < NF_FRAME_WIDTH; x++) { out[x] = readPalette(src->palette, 0); }
+		return 0;
+	}
+
+	uint8_t background[NF_FRAME_WIDTH] = { 0 };
+	uint8_t sprites[NF_FRAME_WIDTH] = { 0 };
+	uint8_t indices[NF_FRAME_WIDTH];
+	uint8_t status = 0;
+	if (src->mask & 0x08) { renderBackgroundLine(src, background); }
+	if ((src->mask & 0x10) && renderSpriteLine(src, line, sprites)) { status |= 0x20; }
+	if (NF_compositeLine(background, sprites, src->mask, indices) >= 0) { status |= 0x40; }
+
+	// Every pixel of the line goes through the same 32 colors, so they are looked up once
+	uint8_t color_mask = (src->mask & 0x01) ? 0x30 : NF_PIXEL_COLOR_MASK;	// Grayscale keeps only the brightness
+	uint16_t emphasis = (uint16_t)(src->mask >> 5) << NF_PIXEL_EMPHASIS_SHIFT;
+	uint16_t colors[PPU_PALETTE_RAM_SIZE];
+	for (int i = 0; i < PPU_PALETTE_RAM_SIZE; i++) { colors[i] = (readPalette(src->palette, (uint8_t)i) & color_mask) | emphasis; }
+	for (int x = 0; x < NF_FRAME_WIDTH; x++) { out[x] = colors[indices[x]]; }
+	return status;
+}
+
+// The PPUSTATUS bits of one scanline, worked out without drawing it: sprite overflow only needs the sprites counted,
+// and sprite 0 hit only needs the background when sprite 0 is on the line. Always agrees with NF_PPU_drawLine
+static uint8_t lineStatus(const struct NF_PPULineSource* src, int line) {
+	if (!(src->mask & 0x10)) { return 0; }
+	uint8_t status = 0;
+	int found = 0;
+	for (int i = 0; i < 64 && found <= PPU_SPRITES_PER_LINE; i++) {
+		if (spriteRow(src, src->oam + i * 4, line) >= 0) { found++; }
+	}
+	if (found > PPU_SPRITES_PER_LINE) { status |= 0x20; }
+
+	int row = spriteRow(src, src->oam, line);
+	if (!(src->mask & 0x08) || row < 0) { return status; }
+	uint8_t background[NF_FRAME_WIDTH] = { 0 };
+	renderBackgroundLine(src, background);
+	uint8_t lo, hi;
+	spritePattern(src, src->oam, row, &lo, &hi);
+
+	// Neither layer shows in the leftmost 8 pixels unless both are allowed to
+	int left = ((src->mask & 0x06) == 0x06) ? 0 : 8;
+	for (int bit = 0; bit < 8; bit++) {
+		int px = src->oam[3] + bit;
+		if (px >= NF_FRAME_WIDTH - 1) { break; }
+		if (px >= left && background[px] != 0 && spritePixel(src->oam[2], lo, hi, bit) != 0) { return status | 0x40; }
+	}
+	return status;
+}
+
 // Every time the PPU clock ticks, a pixel will be rendered to the screen, and the (virtual) scanline-beam will be adjusted if necessary
 // Additionally, a NMI will be emitted if necessary, and the PPU registers will be updated accordingly
 void NF_PPU_tickClock(struct PictureProcessingUnit* ppu) {
@@ -232,20 +474,46 @@ void NF_PPU_tickClock(struct PictureProcessingUnit* ppu) {
         // Enter VBlank
         if (ppu->scanline == PPU_SCANLINE_SCREEN_MAX + 1) {
             ppu->reg_PPUSTATUS |= 0x80;
+            NF_frameEnded(ppu->bus);
             if (ppu->reg_PPUCTRL & 0x80) { NF_emitNMI(ppu->bus); }
         }
 
-        // Exit VBlank
-        if (ppu->scanline > PPU_SCANLINE_MAX) {
-            ppu->scanline = 0;
-            ppu->reg_PPUSTATUS &= ~0x80;
-        }
+        if (ppu->scanline > PPU_SCANLINE_MAX) { ppu->scanline = 0; }
     }
 
-    if (ppu->scanline < PPU_SCANLINE_SCREEN_MAX) {
-        if (ppu->cycle >= 1 && ppu->cycle <= PPU_CYCLE_SCREEN_MAX + 1) {
-            // Background render code here
+    // Exit VBlank at the start of the pre-render line, which also clears the sprite flags
+    if (ppu->scanline == PPU_SCANLINE_MAX && ppu->cycle == 1) { ppu->reg_PPUSTATUS &= ~0xE0; }
+
+    bool rendering = (ppu->reg_PPUMASK & 0x18) != 0;
+    bool visible = ppu->scanline < PPU_SCANLINE_SCREEN_MAX;
+    if (visible && ppu->cycle == PPU_RENDER_DOT) {
+        // Draw the line here, or leave it to the render thread and only work out the status flags. The pattern bytes
+        // are logged as drawn only where the line is drawn
+        struct NF_PPULineSource src;
+        lineSource(ppu, &src);
+        struct NF_Frame* frame = ppu->bus->frame_output;
+        if (ppu->bus->ppu_journal != NULL) { NF_PPUJournal_recordLine(ppu->bus->ppu_journal, ppu, ppu->scanline); }
+        if (frame != NULL) {
+            ppu->reg_PPUSTATUS |= NF_PPU_drawLine(&src, ppu->scanline, frame->pixels[ppu->scanline]);
+            NF_Frame_finishLine(frame, ppu->scanline, ppu->bus->line_hashes);
+        }
+        else {
+            for (int i = 0; i < 8; i++) { src.chr_log[i] = ppu->bus->ConnectedCartridge->log_sink; }
+            ppu->reg_PPUSTATUS |= lineStatus(&src, ppu->scanline);
         }
+        if (rendering) { incrementY(ppu); }
+    }
+    if (!rendering) { return; }
+
+    // Scroll bits are copied from tram_addr: horizontal ones after every line, vertical ones once per frame
+    if ((visible || ppu->scanline == PPU_SCANLINE_MAX) && ppu->cycle == PPU_RENDER_DOT + 1) {
+        ppu->vram_addr.coarse_x = ppu->tram_addr.coarse_x;
+        ppu->vram_addr.nametable_x = ppu->tram_addr.nametable_x;
+    }
+    if (ppu->scanline == PPU_SCANLINE_MAX && ppu->cycle == PPU_COPY_VERTICAL_DOT) {
+        ppu->vram_addr.coarse_y = ppu->tram_addr.coarse_y;
+        ppu->vram_addr.nametable_y = ppu->tram_addr.nametable_y;
+        ppu->vram_addr.fine_y = ppu->tram_addr.fine_y;
     }
 }
 
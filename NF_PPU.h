@@ -15,14 +15,18 @@
 // $3F00-3F1F: Palette RAM (Note:  $3F10/$3F14/$3F18/$3F1C are mirrors of $3F00/$3F04/$3F08/$3F0C )
 // $32F0-3FFF: Mirrors of 3F00-3F1F
 
-#define PPU_NAMETABLE_RAM_SIZE 0x0800
+#define PPU_NAMETABLE_RAM_SIZE 0x1000 // 2KB on the console, the other 2KB is only used by four screen cartridges
 #define PPU_PALETTE_RAM_SIZE 0x20
-#define PPU_OAM_MEMORY_SIZE 0xFF
+#define PPU_OAM_MEMORY_SIZE 0x100
+#define PPU_SPRITES_PER_LINE 8
 #define PPU_SCANLINE_PRERENDER -1
 #define PPU_SCANLINE_SCREEN_MAX 240
 #define PPU_SCANLINE_MAX 261
 #define PPU_CYCLE_MAX 341
 #define PPU_CYCLE_SCREEN_MAX 255
+#define PPU_A12_RISE_DOT 260
+#define PPU_RENDER_DOT 256			// A whole scanline is drawn when the beam reaches this dot
+#define PPU_COPY_VERTICAL_DOT 304
 #define NAMETABLE_0_ADDRESS 0x2000
 #define NAMETABLE_1_ADDRESS 0x2400
 #define NAMETABLE_2_ADDRESS 0x2800
@@ -146,10 +150,43 @@ struct PictureProcessingUnit {
 	union LoopyRegister tram_addr;
 };
 
+// Rendering is done a scanline at a time: when the beam reaches dot 256 of a visible scanline, the whole line is drawn
+// from the scroll position, nametables, pattern tables and OAM as they are at that moment, into the console's
+// frame_output if it has one. Register writes in the middle of a line take effect from the next line. Sprite 0 hit
+// and sprite overflow are worked out at the same time, and are still worked out when the line is not drawn.
+// With a render thread attached to the console, the line is written down in its journal instead (see NF_RenderThread.h)
+
+// Everything drawing a scanline reads. The PPU fills one in from its own memory, the render thread from a journal
+struct NF_PPULineSource {
+	uint8_t ctrl;
+	uint8_t mask;
+	uint8_t fine_x;
+	union LoopyRegister v;			// vram_addr at the start of the line
+	const uint8_t* chr[8];			// 1KB pattern table windows
+	uint8_t* chr_log[8];			// Where the pattern bytes drawn are logged, see NF_CodeDataLog.h
+	const uint8_t* nametables[4];	// The four logical nametables, after mirroring
+	const uint8_t* palette;
+	const uint8_t* oam;
+};
+
+// Draw one visible scanline into out, which holds NF_FRAME_WIDTH pixels. Returns the PPUSTATUS bits the line sets
+// (sprite 0 hit and sprite overflow)
+uint8_t NF_PPU_drawLine(const struct NF_PPULineSource* src, int line, uint16_t* out);
+
 uint8_t NF_PPU_readRegister(struct PictureProcessingUnit* ppu, PPU_REGISTER reg);
+
+// What reading a register would return, without reading it: PPUSTATUS keeps its VBlank flag and the address latch,
+// and PPUDATA neither refills its read buffer nor moves on the VRAM address
+uint8_t NF_PPU_peekRegister(struct PictureProcessingUnit* ppu, PPU_REGISTER reg);
 void NF_PPU_writeRegister(struct PictureProcessingUnit* ppu, PPU_REGISTER reg, uint8_t data);
 struct PictureProcessingUnit* NF_initPPU();
 void NF_PPU_tickClock(struct PictureProcessingUnit* ppu);
 
+// OAM DMA ($4014): copy a 256 byte page of CPU memory into OAM, starting at OAMADDR
+void NF_PPU_writeOAM(struct PictureProcessingUnit* ppu, const uint8_t* page);
+
+// Let the bus know when the next PPU A12 rise will happen, for mappers with a scanline counter
+void NF_PPU_scheduleScanlineCounter(struct PictureProcessingUnit* ppu);
+
 
 #endif
\ No newline at end of file
@@ -1,4 +1,9 @@
 #include "NF_Palette.h"
+#include "NF_Frame.h"
+
+// Emphasizing a color dims the other two a little. This is how much is left of a color for each emphasis bit that is
+// set on one of the others
+#define NF_EMPHASIS_ATTENUATION 0.816
 
 const uint8_t NES_Palette[64][3] = {
 	{84, 84, 84},		// 0x00
@@ -71,4 +76,19 @@ const uint8_t* NF_getNESColor(uint8_t index) {
 	if (index <= 0x3F) { return NES_Palette[index]; }
 	printf("Error: A color index outside of the NES Color Palette range was requested.\n");
 	return NES_Palette[0x3F];
+}
+
+void NF_getColorTable(uint32_t* argb) {
+	for (int emphasis = 0; emphasis < 8; emphasis++) {
+		for (int index = 0; index <= NF_PIXEL_COLOR_MASK; index++) {
+			const uint8_t* rgb = NES_Palette[index];
+			double channel[3] = { rgb[0], rgb[1], rgb[2] };
+			for (int c = 0; c < 3; c++) {
+				for (int other = 0; other < 3; other++) {
+					if (other != c && (emphasis & (1 << other))) { channel[c] *= NF_EMPHASIS_ATTENUATION; }
+				}
+			}
+			argb[(emphasis << NF_PIXEL_EMPHASIS_SHIFT) | index] = 0xFF000000 | ((uint32_t)channel[0] << 16) | ((uint32_t)channel[1] << 8) | (uint32_t)channel[2];
+		}
+	}
 }
\ No newline at end of file
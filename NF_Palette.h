@@ -17,4 +17,10 @@ struct NF_Pixel {
 // Get one of the colors used by the NES, as an array in (R, G, B) format
 const uint8_t* NF_getNESColor(uint8_t index);
 
+// Number of pixel values a frame can hold (see NF_Frame.h): 64 colors times 8 combinations of emphasis bits
+#define NF_PALETTE_COLORS 512
+
+// Fill in the ARGB value of every pixel value, which is each color under every combination of emphasis bits
+void NF_getColorTable(uint32_t* argb);
+
 #endif
\ No newline at end of file
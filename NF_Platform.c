@@ -0,0 +1,451 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(NF_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(NF_X86)
+#include <cpuid.h>
+#endif
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Threads are started through a small trampoline, since the two systems expect different thread function signatures
+struct ThreadStart {
+	NF_ThreadFunction function;
+	void* arg;
+};
+
+#ifdef _WIN32
+
+// FILETIME counts 100ns intervals since 1601
+static int64_t fileTimeToNanoseconds(const FILETIME* time) {
+	uint64_t ft = ((uint64_t)time->dwHighDateTime << 32) | time->dwLowDateTime;
+	return ((int64_t)ft - 116444736000000000LL) * 100;
+}
+
+bool NF_tryMapFileReadOnly(const char* path, struct NF_FileMapping* mapping) {
+	memset(mapping, 0, sizeof(*mapping));
+	mapping->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mapping->file == INVALID_HANDLE_VALUE) { return false; }
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mapping->file, &size) || size.QuadPart == 0) {
+		CloseHandle(mapping->file);
+		return false;
+	}
+	mapping->size = (size_t)size.QuadPart;
+	mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping->mapping == NULL) {
+		CloseHandle(mapping->file);
+		return false;
+	}
+	mapping->data = MapViewOfFile(mapping->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapping->data == NULL) {
+		CloseHandle(mapping->mapping);
+		CloseHandle(mapping->file);
+		return false;
+	}
+	return true;
+}
+
+bool NF_mapFileReadWrite(const char* path, size_t size, struct NF_FileMapping* mapping) {
+	memset(mapping, 0, sizeof(*mapping));
+	// Opening with no sharing at all is the lock
+	mapping->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mapping->file == INVALID_HANDLE_VALUE) {
+		if (GetLastError() == ERROR_SHARING_VIOLATION) { printf("Error: File %s is in use by another console or program.\n", path); }
+		else { printf("Error: Could not open or create file %s.\n", path); }
+		return false;
+	}
+	// The file grows to the size of the mapping if it is smaller. The new bytes are zero
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(mapping->file, &file_size)) { file_size.QuadPart = 0; }
+	uint64_t mapping_size = (uint64_t)file_size.QuadPart > size ? (uint64_t)file_size.QuadPart : size;
+	mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READWRITE, (DWORD)(mapping_size >> 32), (DWORD)mapping_size, NULL);
+	if (mapping->mapping == NULL) {
+		printf("Error: Could not map file %s.\n", path);
+		CloseHandle(mapping->file);
+		return false;
+	}
+	mapping->data = MapViewOfFile(mapping->mapping, FILE_MAP_WRITE, 0, 0, size);
+	if (mapping->data == NULL) {
+		printf("Error: Could not map file %s.\n", path);
+		CloseHandle(mapping->mapping);
+		CloseHandle(mapping->file);
+		return false;
+	}
+	mapping->size = size;
+	return true;
+}
+
+bool NF_flushFileMapping(struct NF_FileMapping* mapping, bool wait) {
+	if (mapping->data == NULL) { return false; }
+	if (!FlushViewOfFile(mapping->data, mapping->size)) { return false; }
+	return !wait || FlushFileBuffers(mapping->file);
+}
+
+void NF_unmapFile(struct NF_FileMapping* mapping) {
+	if (mapping->data != NULL) { UnmapViewOfFile(mapping->data); }
+	if (mapping->mapping != NULL) { CloseHandle(mapping->mapping); }
+	if (mapping->file != NULL && mapping->file != INVALID_HANDLE_VALUE) { CloseHandle(mapping->file); }
+	memset(mapping, 0, sizeof(*mapping));
+}
+
+bool NF_getFileInfo(const char* path, struct NF_FileInfo* info) {
+	HANDLE file = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (file == INVALID_HANDLE_VALUE) { return false; }
+	BY_HANDLE_FILE_INFORMATION fi;
+	bool ok = GetFileInformationByHandle(file, &fi);
+	CloseHandle(file);
+	if (!ok) { return false; }
+	info->device = fi.dwVolumeSerialNumber;
+	info->id = ((uint64_t)fi.nFileIndexHigh << 32) | fi.nFileIndexLow;
+	info->size = ((uint64_t)fi.nFileSizeHigh << 32) | fi.nFileSizeLow;
+	info->mtime = fileTimeToNanoseconds(&fi.ftLastWriteTime);
+	return true;
+}
+
+bool NF_replaceFile(const char* from, const char* to) {
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+void NF_initMutex(NF_Mutex* mutex) { InitializeSRWLock(mutex); }
+void NF_lockMutex(NF_Mutex* mutex) { AcquireSRWLockExclusive(mutex); }
+void NF_unlockMutex(NF_Mutex* mutex) { ReleaseSRWLockExclusive(mutex); }
+
+static BOOL CALLBACK runOnce(PINIT_ONCE once, PVOID function, PVOID* context) {
+	(void)once;
+	(void)context;
+	((void (*)(void))function)();
+	return TRUE;
+}
+
+void NF_callOnce(NF_Once* once, void (*function)(void)) { InitOnceExecuteOnce(once, runOnce, (PVOID)function, NULL); }
+
+void NF_initCond(NF_Cond* cond) { InitializeConditionVariable(cond); }
+void NF_waitCond(NF_Cond* cond, NF_Mutex* mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+void NF_signalCond(NF_Cond* cond) { WakeConditionVariable(cond); }
+void NF_broadcastCond(NF_Cond* cond) { WakeAllConditionVariable(cond); }
+
+static DWORD WINAPI threadEntry(LPVOID arg) {
+	struct ThreadStart start = *(struct ThreadStart*)arg;
+	free(arg);
+	start.function(start.arg);
+	return 0;
+}
+
+bool NF_startThread(NF_Thread* thread, NF_ThreadFunction function, void* arg) {
+	struct ThreadStart* start = malloc(sizeof(struct ThreadStart));
+	if (start == NULL) { return false; }
+	start->function = function;
+	start->arg = arg;
+	*thread = CreateThread(NULL, 0, threadEntry, start, 0, NULL);
+	if (*thread == NULL) {
+		free(start);
+		return false;
+	}
+	return true;
+}
+
+void NF_joinThread(NF_Thread* thread) {
+	WaitForSingleObject(*thread, INFINITE);
+	CloseHandle(*thread);
+}
+
+int NF_getProcessorCount() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+uint64_t NF_getTicks() {
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return (uint64_t)ticks.QuadPart;
+}
+
+uint64_t NF_getTickFrequency() {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (uint64_t)frequency.QuadPart;
+}
+
+uint64_t NF_getPeakMemory() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0; }
+	return (uint64_t)counters.PeakWorkingSetSize;
+}
+
+bool NF_resetPeakMemory() { return false; }
+
+bool NF_listDirectory(const char* path, NF_DirectoryCallback callback, void* context) {
+	char pattern[MAX_PATH];
+	snprintf(pattern, sizeof(pattern), "%s\\*", path);
+	WIN32_FIND_DATAA fd;
+	HANDLE find = FindFirstFileExA(pattern, FindExInfoBasic, &fd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if (find == INVALID_HANDLE_VALUE) { return false; }
+	do {
+		if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) { continue; }
+		// The listing already carries size and time, so no file has to be opened
+		struct NF_DirectoryEntry entry;
+		entry.name = fd.cFileName;
+		entry.is_directory = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size = ((uint64_t)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+		entry.mtime = fileTimeToNanoseconds(&fd.ftLastWriteTime);
+		callback(context, &entry);
+	} while (FindNextFileA(find, &fd));
+	FindClose(find);
+	return true;
+}
+
+#else
+
+// Apple names the nanosecond stat times differently from everyone else
+static int64_t statTimeToNanoseconds(const struct stat* st) {
+#ifdef __APPLE__
+	return (int64_t)st->st_mtimespec.tv_sec * 1000000000LL + st->st_mtimespec.tv_nsec;
+#else
+	return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+#endif
+}
+
+bool NF_tryMapFileReadOnly(const char* path, struct NF_FileMapping* mapping) {
+	memset(mapping, 0, sizeof(*mapping));
+	mapping->fd = open(path, O_RDONLY);
+	if (mapping->fd < 0) { return false; }
+	struct stat st;
+	if (fstat(mapping->fd, &st) != 0 || st.st_size == 0) {
+		close(mapping->fd);
+		return false;
+	}
+	mapping->size = (size_t)st.st_size;
+	void* data = mmap(NULL, mapping->size, PROT_READ, MAP_SHARED, mapping->fd, 0);
+	if (data == MAP_FAILED) {
+		close(mapping->fd);
+		return false;
+	}
+	mapping->data = data;
+	return true;
+}
+
+bool NF_mapFileReadWrite(const char* path, size_t size, struct NF_FileMapping* mapping) {
+	memset(mapping, 0, sizeof(*mapping));
+	mapping->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (mapping->fd < 0) {
+		printf("Error: Could not open or create file %s.\n", path);
+		return false;
+	}
+	// flock locks belong to the open file, not the process, so a second mapping in this process is refused as well
+	if (flock(mapping->fd, LOCK_EX | LOCK_NB) != 0) {
+		if (errno == EWOULDBLOCK) { printf("Error: File %s is in use by another console or program.\n", path); }
+		else { printf("Error: Could not lock file %s.\n", path); }
+		close(mapping->fd);
+		return false;
+	}
+	// Grow the file to the size of the mapping if it is smaller. The new bytes are zero
+	struct stat st;
+	if (fstat(mapping->fd, &st) != 0 || ((size_t)st.st_size < size && ftruncate(mapping->fd, (off_t)size) != 0)) {
+		printf("Error: Could not resize file %s.\n", path);
+		close(mapping->fd);
+		return false;
+	}
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping->fd, 0);
+	if (data == MAP_FAILED) {
+		printf("Error: Could not map file %s.\n", path);
+		close(mapping->fd);
+		return false;
+	}
+	mapping->data = data;
+	mapping->size = size;
+	return true;
+}
+
+bool NF_flushFileMapping(struct NF_FileMapping* mapping, bool wait) {
+	if (mapping->data == NULL) { return false; }
+	return msync(mapping->data, mapping->size, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+void NF_unmapFile(struct NF_FileMapping* mapping) {
+	if (mapping->data != NULL) {
+		munmap(mapping->data, mapping->size);
+		close(mapping->fd);
+	}
+	memset(mapping, 0, sizeof(*mapping));
+}
+
+bool NF_getFileInfo(const char* path, struct NF_FileInfo* info) {
+	struct stat st;
+	if (stat(path, &st) != 0) { return false; }
+	info->device = (uint64_t)st.st_dev;
+	info->id = (uint64_t)st.st_ino;
+	info->size = (uint64_t)st.st_size;
+	info->mtime = statTimeToNanoseconds(&st);
+	return true;
+}
+
+bool NF_replaceFile(const char* from, const char* to) {
+	return rename(from, to) == 0;
+}
+
+void NF_initMutex(NF_Mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void NF_lockMutex(NF_Mutex* mutex) { pthread_mutex_lock(mutex); }
+void NF_unlockMutex(NF_Mutex* mutex) { pthread_mutex_unlock(mutex); }
+void NF_callOnce(NF_Once* once, void (*function)(void)) { pthread_once(once, function); }
+
+void NF_initCond(NF_Cond* cond) { pthread_cond_init(cond, NULL); }
+void NF_waitCond(NF_Cond* cond, NF_Mutex* mutex) { pthread_cond_wait(cond, mutex); }
+void NF_signalCond(NF_Cond* cond) { pthread_cond_signal(cond); }
+void NF_broadcastCond(NF_Cond* cond) { pthread_cond_broadcast(cond); }
+
+static void* threadEntry(void* arg) {
+	struct ThreadStart start = *(struct ThreadStart*)arg;
+	free(arg);
+	start.function(start.arg);
+	return NULL;
+}
+
+bool NF_startThread(NF_Thread* thread, NF_ThreadFunction function, void* arg) {
+	struct ThreadStart* start = malloc(sizeof(struct ThreadStart));
+	if (start == NULL) { return false; }
+	start->function = function;
+	start->arg = arg;
+	if (pthread_create(thread, NULL, threadEntry, start) != 0) {
+		free(start);
+		return false;
+	}
+	return true;
+}
+
+void NF_joinThread(NF_Thread* thread) { pthread_join(*thread, NULL); }
+
+int NF_getProcessorCount() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+uint64_t NF_getTicks() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+uint64_t NF_getTickFrequency() { return 1000000000ULL; }
+
+uint64_t NF_getPeakMemory() {
+	// Linux has the peak in /proc, where it can also be reset. getrusage has it everywhere, but only since the start
+	FILE* status = fopen("/proc/self/status", "r");
+	if (status != NULL) {
+		char line[256];
+		unsigned long long kilobytes = 0;
+		bool found = false;
+		while (!found && fgets(line, sizeof(line), status) != NULL) { found = sscanf(line, "VmHWM: %llu kB", &kilobytes) == 1; }
+		fclose(status);
+		if (found) { return (uint64_t)kilobytes * 1024; }
+	}
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss;
+#else
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+bool NF_resetPeakMemory() {
+	// Writing 5 to clear_refs sets the peak back to what is resident now (Linux 4.0 and later)
+	int fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0) { return false; }
+	bool reset = write(fd, "5", 1) == 1;
+	close(fd);
+	return reset;
+}
+
+bool NF_listDirectory(const char* path, NF_DirectoryCallback callback, void* context) {
+	DIR* dir = opendir(path);
+	if (dir == NULL) { return false; }
+	struct dirent* de;
+	while ((de = readdir(dir)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) { continue; }
+		// Stat relative to the open directory, which saves the kernel from walking the whole path again
+		struct stat st;
+		if (fstatat(dirfd(dir), de->d_name, &st, 0) != 0) { continue; }
+		struct NF_DirectoryEntry entry;
+		entry.name = de->d_name;
+		entry.is_directory = S_ISDIR(st.st_mode);
+		entry.size = (uint64_t)st.st_size;
+		entry.mtime = statTimeToNanoseconds(&st);
+		callback(context, &entry);
+	}
+	closedir(dir);
+	return true;
+}
+
+#endif
+
+bool NF_mapFileReadOnly(const char* path, struct NF_FileMapping* mapping) {
+	if (!NF_tryMapFileReadOnly(path, mapping)) {
+		printf("Error: Could not open or map file %s. It may be missing, unreadable or empty.\n", path);
+		return false;
+	}
+	return true;
+}
+
+#ifdef NF_X86
+
+static void cpuid(int leaf, int subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// AVX state has to be enabled by the operating system as well as supported by the processor
+static bool osSavesAVXState() {
+	uint32_t regs[4];
+	cpuid(1, 0, regs);
+	if ((regs[2] & (1u << 27)) == 0) { return false; }
+#ifdef _MSC_VER
+	uint64_t xcr0 = _xgetbv(0);
+#else
+	uint32_t lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	uint64_t xcr0 = ((uint64_t)hi << 32) | lo;
+#endif
+	return (xcr0 & 0x06) == 0x06;
+}
+
+bool NF_cpuHasFeature(NF_CPU_FEATURE feature) {
+	uint32_t leaf1[4], leaf7[4];
+	cpuid(1, 0, leaf1);
+	cpuid(7, 0, leaf7);
+	switch (feature) {
+	case NF_CPU_SSSE3: return (leaf1[2] & (1u << 9)) != 0;
+	case NF_CPU_SSE41: return (leaf1[2] & (1u << 19)) != 0;
+	case NF_CPU_PCLMUL: return (leaf1[2] & (1u << 1)) != 0;
+	case NF_CPU_SHA: return (leaf7[1] & (1u << 29)) != 0;
+	case NF_CPU_AVX2: return (leaf7[1] & (1u << 5)) != 0 && osSavesAVXState();
+	default: return false;
+	}
+}
+
+#else
+
+bool NF_cpuHasFeature(NF_CPU_FEATURE feature) { return false; }
+
+#endif
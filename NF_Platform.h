@@ -0,0 +1,190 @@
+#ifndef NF_H_PLATFORM
+#define NF_H_PLATFORM
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// The few operating system services the emulator core needs, with one implementation for Windows and one for
+// POSIX systems. Nothing outside of NF_Platform.c should need to include windows.h or the POSIX headers directly.
+
+// A file mapped into memory. Read-only mappings of the same file share their pages with every other process
+// (and every other mapping in this process) that has the file open
+struct NF_FileMapping {
+	uint8_t* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+// Identity of a file on disk. Two paths name the same file if their device and id match
+struct NF_FileInfo {
+	uint64_t device;
+	uint64_t id;
+	uint64_t size;
+	int64_t mtime;					// Nanoseconds since the epoch
+};
+
+// Map a whole file read-only. Returns false (and prints why) if the file cannot be opened or mapped
+bool NF_mapFileReadOnly(const char* path, struct NF_FileMapping* mapping);
+
+// Same as NF_mapFileReadOnly, but prints nothing, for callers that report failures themselves
+bool NF_tryMapFileReadOnly(const char* path, struct NF_FileMapping* mapping);
+
+// Map a file read-write, creating it or growing it (with zeros) to size bytes first. Only the first size bytes are
+// mapped. The file is locked until it is unmapped, so returns false (and prints why) if another process, or another
+// mapping in this one, already has it. Writes to the mapping are written to disk by the operating system in its own
+// time, or when asked to with NF_flushFileMapping. Until then they are lost if the machine goes down
+bool NF_mapFileReadWrite(const char* path, size_t size, struct NF_FileMapping* mapping);
+
+// Start writing the changed pages of a read-write mapping to disk. If wait is true, returns only once they are written
+bool NF_flushFileMapping(struct NF_FileMapping* mapping, bool wait);
+
+// Release a mapping made by any of the NF_mapFile functions
+void NF_unmapFile(struct NF_FileMapping* mapping);
+
+// Look up the identity, size and modification time of a file
+bool NF_getFileInfo(const char* path, struct NF_FileInfo* info);
+
+// Move a file over another one in a single step, so that anyone opening the destination sees either the old file
+// or the new one and never a partial write
+bool NF_replaceFile(const char* from, const char* to);
+
+// Instruction set extensions that have optimized code paths. Checked at runtime so that one binary runs everywhere
+typedef enum {
+	NF_CPU_SSSE3,
+	NF_CPU_SSE41,
+	NF_CPU_PCLMUL,
+	NF_CPU_SHA,
+	NF_CPU_AVX2
+} NF_CPU_FEATURE;
+
+bool NF_cpuHasFeature(NF_CPU_FEATURE feature);
+
+// Compilers other than MSVC need to be told that a function may use instructions beyond the baseline
+#if defined(__GNUC__) || defined(__clang__)
+#define NF_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NF_TARGET(isa)
+#endif
+
+// True when building for x86, where the SIMD code paths exist
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NF_X86 1
+#endif
+
+// Index of the lowest set bit. value must not be 0
+#ifdef _MSC_VER
+static inline int NF_lowestSetBit(uint32_t value) {
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return (int)index;
+}
+#else
+static inline int NF_lowestSetBit(uint32_t value) { return __builtin_ctz(value); }
+#endif
+
+// A plain mutual exclusion lock. NF_MUTEX_INITIALIZER can be used for locks with static storage
+#ifdef _WIN32
+typedef SRWLOCK NF_Mutex;
+#define NF_MUTEX_INITIALIZER SRWLOCK_INIT
+#else
+typedef pthread_mutex_t NF_Mutex;
+#define NF_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#endif
+
+void NF_initMutex(NF_Mutex* mutex);
+void NF_lockMutex(NF_Mutex* mutex);
+void NF_unlockMutex(NF_Mutex* mutex);
+
+// One-time initialization. However many threads call NF_callOnce with the same NF_Once, function runs exactly once,
+// and none of them returns before it has finished. NF_ONCE_INIT initializes an NF_Once with static storage
+#ifdef _WIN32
+typedef INIT_ONCE NF_Once;
+#define NF_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+typedef pthread_once_t NF_Once;
+#define NF_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+
+void NF_callOnce(NF_Once* once, void (*function)(void));
+
+// Data written by different threads is kept this far apart, so that the threads do not fight over cache lines
+#define NF_CACHE_LINE_SIZE 64
+
+// Atomic loads and stores of 32 bit values, for handing data from one thread to another without a lock. A load
+// with acquire sees everything the other thread wrote before its store with release. Exchange returns the old value
+#ifdef _WIN32
+static inline uint32_t NF_atomicLoadAcquire(volatile uint32_t* value) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0); }
+static inline void NF_atomicStoreRelease(volatile uint32_t* value, uint32_t new_value) { InterlockedExchange((volatile LONG*)value, (LONG)new_value); }
+static inline uint32_t NF_atomicAdd(volatile uint32_t* value, uint32_t amount) { return (uint32_t)InterlockedExchangeAdd((volatile LONG*)value, (LONG)amount) + amount; }
+static inline uint32_t NF_atomicExchange(volatile uint32_t* value, uint32_t new_value) { return (uint32_t)InterlockedExchange((volatile LONG*)value, (LONG)new_value); }
+#else
+static inline uint32_t NF_atomicLoadAcquire(volatile uint32_t* value) { return __atomic_load_n(value, __ATOMIC_ACQUIRE); }
+static inline void NF_atomicStoreRelease(volatile uint32_t* value, uint32_t new_value) { __atomic_store_n(value, new_value, __ATOMIC_RELEASE); }
+static inline uint32_t NF_atomicAdd(volatile uint32_t* value, uint32_t amount) { return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST); }
+static inline uint32_t NF_atomicExchange(volatile uint32_t* value, uint32_t new_value) { return __atomic_exchange_n(value, new_value, __ATOMIC_ACQ_REL); }
+#endif
+
+// A condition variable, always used together with an NF_Mutex
+#ifdef _WIN32
+typedef CONDITION_VARIABLE NF_Cond;
+#else
+typedef pthread_cond_t NF_Cond;
+#endif
+
+void NF_initCond(NF_Cond* cond);
+void NF_waitCond(NF_Cond* cond, NF_Mutex* mutex);
+void NF_signalCond(NF_Cond* cond);
+void NF_broadcastCond(NF_Cond* cond);
+
+// Threads
+#ifdef _WIN32
+typedef HANDLE NF_Thread;
+#else
+typedef pthread_t NF_Thread;
+#endif
+
+typedef void (*NF_ThreadFunction)(void* arg);
+
+bool NF_startThread(NF_Thread* thread, NF_ThreadFunction function, void* arg);
+void NF_joinThread(NF_Thread* thread);
+
+// Number of logical processors, never less than 1
+int NF_getProcessorCount();
+
+// A steady clock for timing things, counting NF_getTickFrequency ticks a second from some arbitrary start
+uint64_t NF_getTicks();
+uint64_t NF_getTickFrequency();
+
+// Most memory the process has had resident at once, in bytes, or 0 if it cannot be told
+uint64_t NF_getPeakMemory();
+
+// Start the peak over from the memory resident now. Returns false where the system cannot do that (Windows, and
+// systems without Linux's /proc), in which case the peak keeps counting from the start of the process
+bool NF_resetPeakMemory();
+
+// One entry of a directory listing. name is only valid during the callback
+struct NF_DirectoryEntry {
+	const char* name;
+	bool is_directory;
+	uint64_t size;
+	int64_t mtime;					// Nanoseconds since the epoch
+};
+
+typedef void (*NF_DirectoryCallback)(void* context, const struct NF_DirectoryEntry* entry);
+
+// Call callback for every entry of a directory, except "." and "..". Returns false if the directory cannot be read
+bool NF_listDirectory(const char* path, NF_DirectoryCallback callback, void* context);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef NF_H_PROBES
+#define NF_H_PROBES
+
+// Static tracepoints (USDT probes) on the paths worth timing in the field, for perf and bpftrace on Linux. A probe is
+// a single nop in the code, with a note in the binary saying where it is and where its arguments can be found. It does
+// nothing until a tracer attaches to it, so the probes stay in release builds. The arguments are only ever values the
+// code has at hand anyway, so there is nothing extra to work out for them.
+//
+// The probes are there when the build finds <sys/sdt.h> (systemtap-sdt-dev on Debian and Ubuntu, systemtap-sdt-devel
+// on Fedora). Without it, on Windows, or when building with NF_NO_PROBES defined, they compile to nothing. The Makefile
+// builds the core and the headless tools with them, and make probes lists the ones in the binaries (readelf -n). All of
+// them are in the provider nf:
+//
+// frame_start			frame_count, cpu_cycle				NF_runFrame is starting a frame
+// frame_end			frame_count, cpu_cycle				NF_runFrame has finished one. frame_count is the new count
+// nmi					frame_count, cpu_cycle				The CPU is taking an NMI
+// prg_bank				slot, bank							An 8KB bank of PRG ROM was mapped into slot ($8000 + slot * 8KB)
+// chr_bank				slot, bank							A 1KB bank of CHR was mapped into slot ($0000 + slot * 1KB)
+// ppu_write			reg, data							A PPU register (0-7) was written
+// state_save_start		size
+// state_save_done		ok
+// state_load_start		size
+// state_load_done		ok
+// present				frame_number						The SDL frontend has shown a frame (see NF_Frame.number)
+//
+// The NMI of a frame comes right after the frame count goes up, so nmi and present can be matched up by frame number.
+// For example, the time of each frame and the PPU writes of a benchmark run, and the time from the NMI to the frame
+// being on screen in a frontend built with the probes:
+//
+// bpftrace -e 'usdt:build/benchmark:nf:frame_start { @start = nsecs; }
+//     usdt:build/benchmark:nf:frame_end /@start/ { @frame_us = hist((nsecs - @start) / 1000); }' -c 'build/benchmark out.json'
+// perf buildid-cache --add build/benchmark && perf record -e sdt_nf:ppu_write build/benchmark out.json game.nes
+// bpftrace -e 'usdt:./Emulator:nf:nmi { @nmi[arg0] = nsecs; }
+//     usdt:./Emulator:nf:present /@nmi[arg0]/ { @nmi_to_present_us = hist((nsecs - @nmi[arg0]) / 1000); delete(@nmi[arg0]); }'
+
+// __has_include is tested on its own first, for compilers that do not know it
+#if !defined(NF_NO_PROBES) && !defined(_WIN32) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define NF_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef NF_HAVE_PROBES
+#define NF_PROBE1(name, a) DTRACE_PROBE1(nf, name, a)
+#define NF_PROBE2(name, a, b) DTRACE_PROBE2(nf, name, a, b)
+#else
+#define NF_PROBE1(name, a) do { } while (0)
+#define NF_PROBE2(name, a, b) do { } while (0)
+#endif
+
+#endif
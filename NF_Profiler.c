@@ -0,0 +1,263 @@
+#include "NF_Profiler.h"
+#include "NF_6502.h"
+#include "NF_Bus.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_NODES 1024
+
+// CPU addresses below PRG ROM have a slot of their own
+#define ROM_SLOTS 0x8000
+
+// PRG ROM is counted in 8KB banks, the size of the smallest window any mapper switches
+#define BANK_SIZE 0x2000
+
+static uint32_t hashNode(uint32_t parent, uint32_t location, uint8_t entry) {
+	uint64_t key = ((uint64_t)parent << 34) ^ ((uint64_t)entry << 32) ^ location;
+	key *= 0x9E3779B97F4A7C15ULL;
+	return (uint32_t)(key >> 32);
+}
+
+// Make the node table twice as big, or create it
+static bool growTable(struct NF_Profiler* profiler) {
+	uint32_t size = (profiler->table_size == 0) ? INITIAL_NODES * 2 : profiler->table_size * 2;
+	uint32_t* table = calloc(size, sizeof(uint32_t));
+	if (table == NULL) { return false; }
+	for (uint32_t i = 1; i < profiler->node_count; i++) {
+		const struct NF_ProfileNode* node = &profiler->nodes[i];
+		uint32_t slot = hashNode(node->parent, node->location, node->entry) & (size - 1);
+		while (table[slot] != 0) { slot = (slot + 1) & (size - 1); }
+		table[slot] = i;
+	}
+	free(profiler->node_table);
+	profiler->node_table = table;
+	profiler->table_size = size;
+	return true;
+}
+
+// Find the child of a node, adding it if it is new. Returns 0 if the tree is full
+static uint32_t findNode(struct NF_Profiler* profiler, uint32_t parent, uint32_t location, uint8_t entry) {
+	uint32_t mask = profiler->table_size - 1;
+	uint32_t slot = hashNode(parent, location, entry) & mask;
+	for (; profiler->node_table[slot] != 0; slot = (slot + 1) & mask) {
+		const struct NF_ProfileNode* node = &profiler->nodes[profiler->node_table[slot]];
+		if (node->parent == parent && node->location == location && node->entry == entry) { return profiler->node_table[slot]; }
+	}
+	if (profiler->node_count == NF_PROFILER_MAX_NODES) { return 0; }
+
+	if (profiler->node_count == profiler->node_capacity) {
+		uint32_t capacity = profiler->node_capacity * 2;
+		struct NF_ProfileNode* nodes = realloc(profiler->nodes, capacity * sizeof(struct NF_ProfileNode));
+		if (nodes == NULL) { return 0; }
+		profiler->nodes = nodes;
+		profiler->node_capacity = capacity;
+	}
+	uint32_t index = profiler->node_count++;
+	struct NF_ProfileNode* node = &profiler->nodes[index];
+	memset(node, 0, sizeof(*node));
+	node->parent = parent;
+	node->location = location;
+	node->entry = entry;
+
+	// Keep the table at most half full
+	if (profiler->node_count * 2 > profiler->table_size) {
+		if (!growTable(profiler)) {
+			profiler->node_count--;
+			return 0;
+		}
+	}
+	else { profiler->node_table[slot] = index; }
+	return index;
+}
+
+// Where the instruction at an address is counted. Code in PRG ROM is counted by where it is in the ROM
+static uint32_t slotOf(const struct NF_Profiler* profiler, uint16_t address) {
+	if (address < NF_6502_ROM_LOCATION) { return address; }
+	const struct Cartridge* cart = profiler->console->ConnectedCartridge;
+	return ROM_SLOTS + (uint32_t)(cart->prg_map[(address - NF_6502_ROM_LOCATION) >> 13] - cart->prg_rom) + (address & (BANK_SIZE - 1));
+}
+
+static uint32_t locationOf(uint32_t slot, uint16_t address) {
+	uint32_t bank = (slot < ROM_SLOTS) ? NF_PROFILER_NO_BANK : (slot - ROM_SLOTS) / BANK_SIZE;
+	return bank << 16 | address;
+}
+
+static void formatLocation(uint32_t location, char* text, size_t size) {
+	uint32_t bank = location >> 16;
+	uint16_t address = (uint16_t)location;
+	if (bank != NF_PROFILER_NO_BANK) { snprintf(text, size, "%02X:%04X", bank, address); }
+	else if (address < 0x2000) { snprintf(text, size, "RAM:%04X", address); }
+	else if (address >= NF_6502_PRG_RAM_LOCATION) { snprintf(text, size, "WRAM:%04X", address); }
+	else { snprintf(text, size, "IO:%04X", address); }
+}
+
+// Charge the cycles since the last charge to the instruction running
+static void charge(struct NF_Profiler* profiler) {
+	uint64_t now = profiler->console->cpu_cycle;
+	uint64_t cycles = now - profiler->last_cycle;
+	profiler->last_cycle = now;
+	profiler->address_cycles[profiler->slot] += cycles;
+	profiler->nodes[profiler->charged_node].cycles += cycles;
+	profiler->total_cycles += cycles;
+}
+
+// Bring the shadow stack up to date with the instruction that just ran, which either started a frame or may have
+// popped return addresses off the stack
+static void settle(struct NF_Profiler* profiler, struct Processor* cpu) {
+	if (profiler->pending == NF_PROFILE_NONE) {
+		while (profiler->depth > 0 && cpu->SP > profiler->stack[profiler->depth - 1].return_sp) { profiler->depth--; }
+		profiler->node = (profiler->depth > 0) ? profiler->stack[profiler->depth - 1].node : 0;
+		return;
+	}
+
+	// A frame always starts below the ones under it. Frames that are not were left behind by code that threw their
+	// return addresses away, or by the stack wrapping around
+	while (profiler->depth > 0 && profiler->stack[profiler->depth - 1].return_sp <= profiler->pending_sp) { profiler->depth--; }
+	profiler->node = (profiler->depth > 0) ? profiler->stack[profiler->depth - 1].node : 0;
+
+	uint32_t node = 0;
+	if (profiler->depth < NF_PROFILER_MAX_DEPTH) {
+		node = findNode(profiler, profiler->node, locationOf(slotOf(profiler, cpu->PC), cpu->PC), profiler->pending);
+	}
+	if (node != 0) {
+		profiler->stack[profiler->depth].node = node;
+		profiler->stack[profiler->depth].return_sp = profiler->pending_sp;
+		profiler->depth++;
+		profiler->node = node;
+		profiler->nodes[node].calls++;
+	}
+	else { profiler->dropped_calls++; }
+	profiler->pending = NF_PROFILE_NONE;
+}
+
+struct NF_Profiler* NF_Profiler_create(struct NES_Console* console) {
+	struct Cartridge* cart = console->ConnectedCartridge;
+	if (cart == NULL || cart->prg_size < BANK_SIZE) {
+		printf("Error: The profiler needs a cartridge with PRG ROM.\n");
+		return NULL;
+	}
+	struct NF_Profiler* profiler = calloc(1, sizeof(struct NF_Profiler));
+	if (profiler == NULL) {
+		printf("Error: Could not create profiler object. Out of memory?\n");
+		return NULL;
+	}
+	profiler->console = console;
+	profiler->prg_size = cart->prg_size;
+	profiler->address_cycles = calloc(ROM_SLOTS + (size_t)cart->prg_size, sizeof(uint64_t));
+	profiler->bank_windows = calloc(cart->prg_size / BANK_SIZE, 1);
+	profiler->node_capacity = INITIAL_NODES;
+	profiler->nodes = calloc(profiler->node_capacity, sizeof(struct NF_ProfileNode));
+	profiler->node_count = 1;
+	if (profiler->address_cycles == NULL || profiler->bank_windows == NULL || profiler->nodes == NULL || !growTable(profiler)) {
+		printf("Error: Could not allocate profiler. Out of memory?\n");
+		NF_Profiler_free(profiler);
+		return NULL;
+	}
+	profiler->last_cycle = console->cpu_cycle;
+	profiler->slot = slotOf(profiler, console->ConnectedProcessor->PC);
+	profiler->pending = NF_PROFILE_NONE;
+	return profiler;
+}
+
+void NF_Profiler_free(struct NF_Profiler* profiler) {
+	if (profiler == NULL) { return; }
+	free(profiler->address_cycles);
+	free(profiler->bank_windows);
+	free(profiler->nodes);
+	free(profiler->node_table);
+	free(profiler);
+}
+
+void NF_Profiler_startInstruction(struct NF_Profiler* profiler, struct Processor* cpu) {
+	// The cycles of entering an interrupt go to the first instruction of the handler, once its frame has started
+	bool entered = profiler->pending == NF_PROFILE_NMI || profiler->pending == NF_PROFILE_IRQ;
+	if (!entered) { charge(profiler); }
+	settle(profiler, cpu);
+	profiler->slot = slotOf(profiler, cpu->PC);
+	profiler->charged_node = profiler->node;
+	if (entered) { charge(profiler); }
+	if (profiler->slot >= ROM_SLOTS) { profiler->bank_windows[(profiler->slot - ROM_SLOTS) / BANK_SIZE] = (uint8_t)((cpu->PC - NF_6502_ROM_LOCATION) >> 13); }
+
+	// JSR and BRK start a frame once they are done, at the address they jump to
+	uint8_t opcode = NF_peekMemory(profiler->console, cpu->PC);
+	if (charToOpcodeArray[opcode] == OP_JSR) {
+		profiler->pending = NF_PROFILE_CALL;
+		profiler->pending_sp = (uint8_t)(cpu->SP - 2);
+	}
+	else if (charToOpcodeArray[opcode] == OP_BRK) {
+		profiler->pending = NF_PROFILE_BRK;
+		profiler->pending_sp = (uint8_t)(cpu->SP - 3);
+	}
+}
+
+void NF_Profiler_interrupt(struct NF_Profiler* profiler, struct Processor* cpu, NF_PROFILE_ENTRY entry) {
+	charge(profiler);
+	settle(profiler, cpu);
+	profiler->pending = (uint8_t)entry;
+	profiler->pending_sp = (uint8_t)(cpu->SP - 3);
+}
+
+bool NF_Profiler_writeStacks(struct NF_Profiler* profiler, FILE* file) {
+	static const char* const prefixes[] = { "", "BRK ", "NMI ", "IRQ " };
+	charge(profiler);
+	uint32_t path[NF_PROFILER_MAX_DEPTH + 1];
+	char location[16];
+	for (uint32_t i = 0; i < profiler->node_count; i++) {
+		if (profiler->nodes[i].cycles == 0) { continue; }
+		int depth = 0;
+		for (uint32_t node = i; node != 0; node = profiler->nodes[node].parent) { path[depth++] = node; }
+		fputs("main", file);
+		while (depth > 0) {
+			const struct NF_ProfileNode* node = &profiler->nodes[path[--depth]];
+			formatLocation(node->location, location, sizeof(location));
+			fprintf(file, ";%s%s", prefixes[node->entry], location);
+		}
+		fprintf(file, " %llu\n", (unsigned long long)profiler->nodes[i].cycles);
+	}
+	return !ferror(file);
+}
+
+// Write one bank: its share of the cycles, and its hottest addresses. address is the CPU address of the first slot
+static void writeBank(struct NF_Profiler* profiler, FILE* file, const char* name, uint32_t first_slot, uint32_t slot_count, uint16_t address) {
+	uint64_t total = 0;
+	uint32_t hot[NF_PROFILER_HOT_ADDRESSES];
+	int hot_count = 0;
+	const uint64_t* cycles = profiler->address_cycles + first_slot;
+	for (uint32_t i = 0; i < slot_count; i++) {
+		if (cycles[i] == 0) { continue; }
+		total += cycles[i];
+
+		// Insert into the list of the hottest, which is kept sorted
+		int position = hot_count;
+		while (position > 0 && cycles[hot[position - 1]] < cycles[i]) { position--; }
+		if (position == NF_PROFILER_HOT_ADDRESSES) { continue; }
+		int last = (hot_count < NF_PROFILER_HOT_ADDRESSES) ? hot_count++ : hot_count - 1;
+		memmove(&hot[position + 1], &hot[position], (last - position) * sizeof(uint32_t));
+		hot[position] = i;
+	}
+	if (total == 0) { return; }
+
+	double scale = (profiler->total_cycles > 0) ? 100.0 / profiler->total_cycles : 0.0;
+	fprintf(file, "%-8s %14llu cycles %6.2f%%\n", name, (unsigned long long)total, total * scale);
+	for (int i = 0; i < hot_count; i++) {
+		fprintf(file, "    $%04X %14llu cycles %6.2f%%\n", (unsigned)(uint16_t)(address + hot[i]), (unsigned long long)cycles[hot[i]],
+			cycles[hot[i]] * scale);
+	}
+}
+
+bool NF_Profiler_writeHotAddresses(struct NF_Profiler* profiler, FILE* file) {
+	charge(profiler);
+	fprintf(file, "%llu cycles profiled\n", (unsigned long long)profiler->total_cycles);
+	writeBank(profiler, file, "RAM", 0x0000, 0x2000, 0x0000);
+	writeBank(profiler, file, "IO", 0x2000, 0x4000, 0x2000);
+	writeBank(profiler, file, "WRAM", NF_6502_PRG_RAM_LOCATION, 0x2000, NF_6502_PRG_RAM_LOCATION);
+
+	// Banks of PRG ROM are shown at the addresses they were last run from
+	char name[16];
+	for (uint32_t bank = 0; bank < profiler->prg_size / BANK_SIZE; bank++) {
+		snprintf(name, sizeof(name), "%02X", bank);
+		uint16_t address = (uint16_t)(NF_6502_ROM_LOCATION + profiler->bank_windows[bank] * BANK_SIZE);
+		writeBank(profiler, file, name, ROM_SLOTS + bank * BANK_SIZE, BANK_SIZE, address);
+	}
+	return !ferror(file);
+}
@@ -0,0 +1,110 @@
+#ifndef NF_H_PROFILER
+#define NF_H_PROFILER
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A profiler of the game's code, rather than of the emulator's. While a profiler is attached to a console (see
+// NF_setProfiler), every CPU cycle is charged to the instruction that took it, so the counts are exact rather than
+// sampled. Each cycle is charged twice:
+//
+// By address		Every byte of PRG ROM has its own count, so the same CPU address in two banks is told apart. Code
+//					run from anywhere else (RAM, PRG RAM) is counted by its CPU address
+// By call stack	JSR, BRK and the NMI and IRQ interrupts start a frame of a shadow call stack, which ends once the
+//					stack pointer goes back above the return address pushed for it. Going by the stack pointer rather
+//					than by RTS and RTI keeps the shadow stack right through the tricks games play with the stack, like
+//					jump tables that push an address and RTS to it, or code that throws a return address away
+//
+// The 7 cycles of entering an interrupt are charged to the handler, and OAM DMA to the instruction that started it.
+// Code is named by where it is: the 8KB bank of PRG ROM in hex and the CPU address, or RAM or WRAM and the address for
+// code run from RAM or PRG RAM. Call stacks are written in the collapsed format that flame graph tools read, a line
+// per stack with the cycles spent in its last frame, starting from the code that is not in any subroutine:
+//
+// main;02:8123;NMI 07:C0A0;07:C200 1234
+//
+// The hooks in the CPU cost a check of a pointer per instruction while no profiler is attached. Building with
+// NF_PROFILER_ENABLED defined as 0 takes them out altogether.
+
+#ifndef NF_PROFILER_ENABLED
+#define NF_PROFILER_ENABLED 1
+#endif
+
+#define NF_PROFILER_MAX_DEPTH 256
+#define NF_PROFILER_MAX_NODES (1 << 20)		// Distinct call stacks. Calls past this are charged to their caller
+#define NF_PROFILER_HOT_ADDRESSES 16		// Listed for each bank
+
+// Locations outside of PRG ROM have this in place of a bank number
+#define NF_PROFILER_NO_BANK 0xFFFF
+
+struct NES_Console;
+struct Processor;
+
+// How a frame of the call stack was entered
+typedef enum {
+	NF_PROFILE_CALL,
+	NF_PROFILE_BRK,
+	NF_PROFILE_NMI,
+	NF_PROFILE_IRQ,
+	NF_PROFILE_NONE
+} NF_PROFILE_ENTRY;
+
+// A node of the call tree, standing for one distinct call stack: its parent's stack with one more frame
+struct NF_ProfileNode {
+	uint32_t parent;
+	uint32_t location;				// Where the frame was entered: bank << 16 | CPU address
+	uint8_t entry;					// An NF_PROFILE_ENTRY
+	uint64_t cycles;				// Spent in the frame itself, not counting the frames it called
+	uint64_t calls;
+};
+
+struct NF_ProfileFrame {
+	uint32_t node;
+	uint8_t return_sp;				// The stack pointer once the return address was pushed
+};
+
+struct NF_Profiler {
+	struct NES_Console* console;
+	uint64_t* address_cycles;		// The CPU addresses below $8000, then every byte of PRG ROM
+	uint8_t* bank_windows;			// For each 8KB bank of PRG ROM, the 8KB window of the CPU it last ran in
+	uint32_t prg_size;
+	uint64_t total_cycles;
+
+	// The call tree. Node 0 is the root, for code outside of any frame. The table finds a node's children
+	struct NF_ProfileNode* nodes;
+	uint32_t node_count;
+	uint32_t node_capacity;
+	uint32_t* node_table;			// Open addressing, 0 marks an empty slot
+	uint32_t table_size;
+
+	struct NF_ProfileFrame stack[NF_PROFILER_MAX_DEPTH];
+	int depth;
+	uint32_t node;					// The node of the frame on top of the stack
+	uint64_t dropped_calls;			// Frames not started because the stack or the tree was full
+
+	// What is being charged: the instruction running, and the frame it runs in, since the cycle it started
+	uint64_t last_cycle;
+	uint32_t slot;
+	uint32_t charged_node;
+
+	// A frame that starts with the next instruction, after a JSR or BRK or once an interrupt has been entered
+	uint8_t pending;				// An NF_PROFILE_ENTRY
+	uint8_t pending_sp;
+};
+
+// Create a profiler for the cartridge in a console, starting from where the console is now. Returns NULL (and prints
+// why) if there is no cartridge or no memory for it. Attach it with NF_setProfiler
+struct NF_Profiler* NF_Profiler_create(struct NES_Console* console);
+void NF_Profiler_free(struct NF_Profiler* profiler);
+
+// Called by the CPU as it starts an instruction (before fetching it), and as it starts entering an interrupt
+void NF_Profiler_startInstruction(struct NF_Profiler* profiler, struct Processor* cpu);
+void NF_Profiler_interrupt(struct NF_Profiler* profiler, struct Processor* cpu, NF_PROFILE_ENTRY entry);
+
+// Write the cycles of every call stack in the collapsed format. Charges the cycles up to where the console is now first
+bool NF_Profiler_writeStacks(struct NF_Profiler* profiler, FILE* file);
+
+// Write the cycles of each bank, with its NF_PROFILER_HOT_ADDRESSES hottest addresses. Charges the cycles up to
+// where the console is now first
+bool NF_Profiler_writeHotAddresses(struct NF_Profiler* profiler, FILE* file);
+
+#endif
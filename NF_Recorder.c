@@ -0,0 +1,442 @@
+#include "NF_Recorder.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Most a frame can take up in the file after its header: all of its audio, and every line with a run per pixel
+#define MAX_FRAME_SIZE (NF_RECORDER_AUDIO_CAPACITY * sizeof(int16_t) + NF_FRAME_HEIGHT * (NF_FRAME_WIDTH + 1) * sizeof(uint16_t))
+
+#define PIXEL_MASK (NF_PALETTE_COLORS - 1)
+
+static bool writeBytes(struct NF_Recorder* recorder, const void* data, size_t size) {
+	if (recorder->failed) { return false; }
+	if (size > 0 && fwrite(data, 1, size, recorder->file) != size) {
+		printf("Error: Could not write to recording %s. The rest of it is lost.\n", recorder->path);
+		recorder->failed = true;
+		return false;
+	}
+	recorder->offset += size;
+	return true;
+}
+
+// Store one line as runs of the same pixel value. Returns where the next line goes
+static uint8_t* encodeLine(const uint16_t* pixels, uint8_t* out) {
+	uint8_t* count_at = out;
+	uint16_t runs = 0;
+	out += sizeof(uint16_t);
+	for (int x = 0; x < NF_FRAME_WIDTH;) {
+		uint16_t value = pixels[x] & PIXEL_MASK;
+		int length = 1;
+		while (x + length < NF_FRAME_WIDTH && length < NF_RECORDING_MAX_RUN && (pixels[x + length] & PIXEL_MASK) == value) { length++; }
+		uint16_t run = (uint16_t)(value | ((length - 1) << NF_RECORDING_RUN_SHIFT));
+		memcpy(out, &run, sizeof(run));
+		out += sizeof(run);
+		runs++;
+		x += length;
+	}
+	memcpy(count_at, &runs, sizeof(runs));
+	return out;
+}
+
+static void encodeFrame(struct NF_Recorder* recorder, const struct NF_RecorderFrame* frame) {
+	if (recorder->failed) { return; }
+	struct NF_RecordingFrameHeader header;
+	memset(&header, 0, sizeof(header));
+	header.number = frame->frame.number;
+	header.audio_count = frame->audio_count;
+
+	// The lines that changed are found from the hashes, since frames that were dropped were never stored
+	if (recorder->frames_written % NF_RECORDING_KEYFRAME_INTERVAL == 0) {
+		if (recorder->index_count == recorder->index_capacity) {
+			uint64_t capacity = (recorder->index_capacity == 0) ? 64 : recorder->index_capacity * 2;
+			struct NF_RecordingIndexEntry* index = realloc(recorder->index, (size_t)capacity * sizeof(struct NF_RecordingIndexEntry));
+			if (index == NULL) {
+				printf("Error: Could not grow recording index. Out of memory?\n");
+				recorder->failed = true;
+				return;
+			}
+			recorder->index = index;
+			recorder->index_capacity = capacity;
+		}
+		recorder->index[recorder->index_count].frame = recorder->frames_written;
+		recorder->index[recorder->index_count].offset = recorder->offset;
+		recorder->index_count++;
+
+		header.flags = NF_RECORDING_KEYFRAME;
+		for (int line = 0; line < NF_FRAME_HEIGHT; line++) { NF_Frame_markDirty(header.dirty, line); }
+		memcpy(recorder->line_hashes, frame->frame.line_hashes, sizeof(recorder->line_hashes));
+	}
+	else { NF_Frame_delta(&frame->frame, recorder->line_hashes, header.dirty); }
+
+	uint8_t* out = recorder->buffer;
+	memcpy(out, frame->audio, (size_t)frame->audio_count * sizeof(int16_t));
+	out += (size_t)frame->audio_count * sizeof(int16_t);
+	for (int line = 0, count; NF_Frame_nextDirtyRun(header.dirty, &line, &count); line += count) {
+		for (int y = line; y < line + count; y++) { out = encodeLine(frame->frame.pixels[y], out); }
+	}
+	header.size = (uint32_t)(out - recorder->buffer);
+
+	if (writeBytes(recorder, &header, sizeof(header)) && writeBytes(recorder, recorder->buffer, header.size)) { recorder->frames_written++; }
+}
+
+static bool queueEmpty(struct NF_Recorder* recorder) { return NF_atomicLoadAcquire(&recorder->write_index) == recorder->read_index; }
+
+static void encoderMain(void* arg) {
+	struct NF_Recorder* recorder = (struct NF_Recorder*)arg;
+	for (;;) {
+		NF_lockMutex(&recorder->lock);
+		while (queueEmpty(recorder) && !recorder->finishing) { NF_waitCond(&recorder->wake, &recorder->lock); }
+		bool finishing = recorder->finishing;
+		NF_unlockMutex(&recorder->lock);
+
+		// A frame only leaves the queue once it is stored, so the pool always has a frame to spare for drawing into
+		while (!queueEmpty(recorder)) {
+			struct NF_RecorderFrame* frame = recorder->queue[recorder->read_index % NF_RECORDER_QUEUE_SIZE];
+			encodeFrame(recorder, frame);
+			NF_RecorderFrame_release(frame);
+			NF_atomicStoreRelease(&recorder->read_index, recorder->read_index + 1);
+		}
+		if (finishing) { return; }
+	}
+}
+
+static void freeRecorder(struct NF_Recorder* recorder) {
+	if (recorder->file != NULL) { fclose(recorder->file); }
+	free(recorder->pool);
+	free(recorder->buffer);
+	free(recorder->index);
+	free(recorder);
+}
+
+struct NF_Recorder* NF_Recorder_create(const char* path, const uint32_t* colors, uint32_t sample_rate) {
+	struct NF_Recorder* recorder = calloc(1, sizeof(struct NF_Recorder));
+	if (recorder == NULL) {
+		printf("Error: Could not create recorder object. Out of memory?\n");
+		return NULL;
+	}
+	recorder->pool = calloc(NF_RECORDER_POOL_SIZE, sizeof(struct NF_RecorderFrame));
+	recorder->buffer = malloc(MAX_FRAME_SIZE);
+	if (recorder->pool == NULL || recorder->buffer == NULL) {
+		printf("Error: Could not create recorder object. Out of memory?\n");
+		freeRecorder(recorder);
+		return NULL;
+	}
+
+	snprintf(recorder->path, sizeof(recorder->path), "%s", path);
+	recorder->file = fopen(path, "wb");
+	if (recorder->file == NULL) {
+		printf("Error: Could not open %s for writing.\n", path);
+		freeRecorder(recorder);
+		return NULL;
+	}
+	struct NF_RecordingFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NF_RECORDING_MAGIC, sizeof(NF_RECORDING_MAGIC));
+	header.version = NF_RECORDING_VERSION;
+	header.width = NF_FRAME_WIDTH;
+	header.height = NF_FRAME_HEIGHT;
+	header.rate_numerator = NF_RECORDING_RATE_NUMERATOR;
+	header.rate_denominator = NF_RECORDING_RATE_DENOMINATOR;
+	header.sample_rate = sample_rate;
+	header.keyframe_interval = NF_RECORDING_KEYFRAME_INTERVAL;
+	memcpy(header.colors, colors, sizeof(header.colors));
+	if (!writeBytes(recorder, &header, sizeof(header))) {
+		freeRecorder(recorder);
+		return NULL;
+	}
+
+	NF_initMutex(&recorder->lock);
+	NF_initCond(&recorder->wake);
+	if (!NF_startThread(&recorder->thread, encoderMain, recorder)) {
+		printf("Error: Could not start the recording thread.\n");
+		freeRecorder(recorder);
+		return NULL;
+	}
+	return recorder;
+}
+
+bool NF_Recorder_finish(struct NF_Recorder* recorder) {
+	if (recorder == NULL) { return true; }
+	NF_lockMutex(&recorder->lock);
+	recorder->finishing = true;
+	NF_broadcastCond(&recorder->wake);
+	NF_unlockMutex(&recorder->lock);
+	NF_joinThread(&recorder->thread);
+
+	struct NF_RecordingFileTrailer trailer;
+	memset(&trailer, 0, sizeof(trailer));
+	memcpy(trailer.magic, NF_RECORDING_INDEX_MAGIC, sizeof(trailer.magic));
+	trailer.index_offset = recorder->offset;
+	trailer.frame_count = recorder->frames_written;
+	trailer.keyframe_count = recorder->index_count;
+	bool ok = writeBytes(recorder, recorder->index, (size_t)recorder->index_count * sizeof(struct NF_RecordingIndexEntry)) &&
+		writeBytes(recorder, &trailer, sizeof(trailer));
+	ok = (fclose(recorder->file) == 0) && ok;
+	recorder->file = NULL;
+	if (!ok) { printf("Error: Could not finish recording %s.\n", recorder->path); }
+	if (recorder->dropped_frames > 0 || recorder->dropped_samples > 0) {
+		printf("Recording dropped %u frames and %u audio samples.\n", recorder->dropped_frames, recorder->dropped_samples);
+	}
+	freeRecorder(recorder);
+	return ok;
+}
+
+struct NF_RecorderFrame* NF_Recorder_acquire(struct NF_Recorder* recorder) {
+	// Only this thread takes frames out of the pool, so a free frame cannot be taken by anyone else in the meantime
+	for (int i = 0; i < NF_RECORDER_POOL_SIZE; i++) {
+		struct NF_RecorderFrame* frame = &recorder->pool[i];
+		if (NF_atomicLoadAcquire(&frame->references) != 0) { continue; }
+		NF_atomicStoreRelease(&frame->references, 1);
+		frame->audio_count = 0;
+		return frame;
+	}
+	return NULL;
+}
+
+struct NF_RecorderFrame* NF_Recorder_submit(struct NF_Recorder* recorder, struct NF_RecorderFrame* frame) {
+	uint32_t write = recorder->write_index;
+	struct NF_RecorderFrame* next = NULL;
+	if (write - NF_atomicLoadAcquire(&recorder->read_index) < NF_RECORDER_QUEUE_SIZE) { next = NF_Recorder_acquire(recorder); }
+	if (next == NULL) {
+		NF_atomicAdd(&recorder->dropped_frames, 1);
+		return frame;
+	}
+
+	recorder->queue[write % NF_RECORDER_QUEUE_SIZE] = frame;
+	NF_atomicStoreRelease(&recorder->write_index, write + 1);
+
+	// The encoder only holds the lock while it checks the queue before going to sleep
+	NF_lockMutex(&recorder->lock);
+	NF_signalCond(&recorder->wake);
+	NF_unlockMutex(&recorder->lock);
+	return next;
+}
+
+void NF_Recorder_addAudio(struct NF_Recorder* recorder, struct NF_RecorderFrame* frame, const int16_t* samples, uint32_t count) {
+	uint32_t room = NF_RECORDER_AUDIO_CAPACITY - frame->audio_count;
+	if (count > room) {
+		recorder->dropped_samples += count - room;
+		count = room;
+	}
+	memcpy(frame->audio + frame->audio_count, samples, (size_t)count * sizeof(int16_t));
+	frame->audio_count += count;
+}
+
+struct NF_RecordingReader* NF_RecordingReader_open(const char* path) {
+	struct NF_RecordingReader* reader = calloc(1, sizeof(struct NF_RecordingReader));
+	if (reader == NULL) {
+		printf("Error: Could not create recording reader. Out of memory?\n");
+		return NULL;
+	}
+	if (!NF_mapFileReadOnly(path, &reader->mapping)) {
+		free(reader);
+		return NULL;
+	}
+
+	size_t size = reader->mapping.size;
+	struct NF_RecordingFileHeader* header = &reader->header;
+	if (size >= sizeof(*header)) { memcpy(header, reader->mapping.data, sizeof(*header)); }
+	if (size < sizeof(*header) || memcmp(header->magic, NF_RECORDING_MAGIC, sizeof(header->magic)) != 0 || header->version != NF_RECORDING_VERSION ||
+		header->width != NF_FRAME_WIDTH || header->height != NF_FRAME_HEIGHT || header->keyframe_interval == 0) {
+		printf("Error: %s is not a valid recording.\n", path);
+		NF_RecordingReader_free(reader);
+		return NULL;
+	}
+
+	// Use the index only if it and the trailer fit exactly between the frames and the end of the file
+	reader->frames_end = size;
+	struct NF_RecordingFileTrailer trailer;
+	if (size >= sizeof(*header) + sizeof(trailer)) {
+		memcpy(&trailer, reader->mapping.data + size - sizeof(trailer), sizeof(trailer));
+		uint64_t index_size = trailer.keyframe_count * sizeof(struct NF_RecordingIndexEntry);
+		if (memcmp(trailer.magic, NF_RECORDING_INDEX_MAGIC, sizeof(trailer.magic)) == 0 && trailer.index_offset >= sizeof(*header) &&
+			trailer.keyframe_count <= size && trailer.index_offset + index_size + sizeof(trailer) == size) {
+			reader->index = malloc(index_size > 0 ? (size_t)index_size : 1);
+			if (reader->index == NULL) {
+				printf("Error: Could not read recording index. Out of memory?\n");
+				NF_RecordingReader_free(reader);
+				return NULL;
+			}
+			memcpy(reader->index, reader->mapping.data + trailer.index_offset, (size_t)index_size);
+			reader->keyframe_count = trailer.keyframe_count;
+			reader->frames_end = trailer.index_offset;
+		}
+	}
+	if (reader->index == NULL) { printf("Warning: %s has no index, so it was not finished. Seeking will be slow.\n", path); }
+
+	reader->next_offset = sizeof(*header);
+	return reader;
+}
+
+void NF_RecordingReader_free(struct NF_RecordingReader* reader) {
+	if (reader == NULL) { return; }
+	NF_unmapFile(&reader->mapping);
+	free(reader->index);
+	free(reader);
+}
+
+static uint16_t readRun(const uint8_t* data) { return (uint16_t)(data[0] | (data[1] << 8)); }
+
+// Decode one line stored as runs. Returns where the next line starts, or NULL if the line is damaged
+static const uint8_t* decodeLine(const uint8_t* data, const uint8_t* end, uint16_t* pixels) {
+	if (end - data < 2) { return NULL; }
+	uint16_t runs = readRun(data);
+	data += 2;
+	if (end - data < (ptrdiff_t)runs * 2) { return NULL; }
+	int x = 0;
+	for (uint16_t i = 0; i < runs; i++, data += 2) {
+		uint16_t run = readRun(data);
+		int length = (run >> NF_RECORDING_RUN_SHIFT) + 1;
+		if (x + length > NF_FRAME_WIDTH) { return NULL; }
+		for (int j = 0; j < length; j++) { pixels[x + j] = run & PIXEL_MASK; }
+		x += length;
+	}
+	return (x == NF_FRAME_WIDTH) ? data : NULL;
+}
+
+bool NF_RecordingReader_next(struct NF_RecordingReader* reader) {
+	// A recording that was cut off can end partway through a frame, which is the same as ending before it
+	struct NF_RecordingFrameHeader header;
+	if (reader->next_offset + sizeof(header) > reader->frames_end) { return false; }
+	memcpy(&header, reader->mapping.data + reader->next_offset, sizeof(header));
+	uint64_t end = reader->next_offset + sizeof(header) + header.size;
+	if (end > reader->frames_end) { return false; }
+
+	const uint8_t* data = reader->mapping.data + reader->next_offset + sizeof(header);
+	const uint8_t* data_end = reader->mapping.data + end;
+	if ((uint64_t)header.audio_count * sizeof(int16_t) > header.size) {
+		printf("Error: Recording is damaged at frame %llu.\n", (unsigned long long)reader->next_frame);
+		return false;
+	}
+	reader->audio = data;
+	reader->audio_count = header.audio_count;
+	data += (size_t)header.audio_count * sizeof(int16_t);
+
+	for (int line = 0, count; NF_Frame_nextDirtyRun(header.dirty, &line, &count); line += count) {
+		for (int y = line; y < line + count && data != NULL; y++) { data = decodeLine(data, data_end, reader->frame.pixels[y]); }
+		if (data == NULL) {
+			printf("Error: Recording is damaged at frame %llu.\n", (unsigned long long)reader->next_frame);
+			return false;
+		}
+	}
+
+	reader->frame.number = header.number;
+	memcpy(reader->frame.dirty, header.dirty, sizeof(header.dirty));
+	reader->next_offset = end;
+	reader->next_frame++;
+	return true;
+}
+
+bool NF_RecordingReader_seek(struct NF_RecordingReader* reader, uint64_t frame) {
+	// Start from the keyframe at or before the frame, unless decoding on from where the reader is gets there sooner
+	uint64_t keyframe = 0;
+	uint64_t offset = sizeof(struct NF_RecordingFileHeader);
+	if (reader->index != NULL && reader->keyframe_count > 0) {
+		uint64_t slot = frame / reader->header.keyframe_interval;
+		if (slot >= reader->keyframe_count) { slot = reader->keyframe_count - 1; }
+		keyframe = reader->index[slot].frame;
+		offset = reader->index[slot].offset;
+	}
+	if (reader->next_frame > frame || reader->next_frame < keyframe) {
+		reader->next_frame = keyframe;
+		reader->next_offset = offset;
+	}
+	while (reader->next_frame < frame) {
+		if (!NF_RecordingReader_next(reader)) {
+			printf("Error: Recording only has %llu frames.\n", (unsigned long long)reader->next_frame);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Y'CbCr of each pixel value, in the studio range that YUV4MPEG2 players expect
+static void buildYCbCrTable(const uint32_t* colors, uint8_t ycbcr[NF_PALETTE_COLORS][3]) {
+	for (int i = 0; i < NF_PALETTE_COLORS; i++) {
+		int r = (colors[i] >> 16) & 0xFF;
+		int g = (colors[i] >> 8) & 0xFF;
+		int b = colors[i] & 0xFF;
+		ycbcr[i][0] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		ycbcr[i][1] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		ycbcr[i][2] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+}
+
+// The 44 byte header of a 16 bit mono WAV file
+static bool writeWavHeader(FILE* file, uint32_t sample_rate, uint64_t samples) {
+	uint32_t data_size = (samples > 0x7FFFFFF0u / 2) ? 0x7FFFFFF0u : (uint32_t)(samples * 2);
+	uint8_t header[44];
+	uint32_t fields[] = { 36 + data_size, 16, 1 | (1 << 16), sample_rate, sample_rate * 2, 2 | (16 << 16), data_size };
+	memcpy(header, "RIFF", 4);
+	memcpy(header + 4, &fields[0], 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	memcpy(header + 16, &fields[1], 20);
+	memcpy(header + 36, "data", 4);
+	memcpy(header + 40, &fields[6], 4);
+	return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+bool NF_Recording_export(const char* path, const char* y4m_path, const char* wav_path) {
+	struct NF_RecordingReader* reader = NF_RecordingReader_open(path);
+	if (reader == NULL) { return false; }
+	const size_t plane_size = (size_t)NF_FRAME_WIDTH * NF_FRAME_HEIGHT;
+	uint8_t* planes = malloc(plane_size * 3);
+	uint8_t (*ycbcr)[3] = malloc(NF_PALETTE_COLORS * 3);
+	FILE* y4m = (y4m_path != NULL) ? fopen(y4m_path, "wb") : NULL;
+	FILE* wav = (wav_path != NULL) ? fopen(wav_path, "wb") : NULL;
+	bool ok = planes != NULL && ycbcr != NULL && (y4m_path == NULL || y4m != NULL) && (wav_path == NULL || wav != NULL);
+	if (!ok) { printf("Error: Could not open the files to export %s to.\n", path); }
+
+	uint64_t frames = 0;
+	uint64_t filled = 0;
+	uint64_t samples = 0;
+	if (ok) {
+		buildYCbCrTable(reader->header.colors, ycbcr);
+		if (y4m != NULL) {
+			ok = fprintf(y4m, "YUV4MPEG2 W%d H%d F%u:%u Ip A8:7 C444\n", NF_FRAME_WIDTH, NF_FRAME_HEIGHT,
+				reader->header.rate_numerator, reader->header.rate_denominator) > 0;
+		}
+		if (wav != NULL) { ok = ok && writeWavHeader(wav, reader->header.sample_rate, 0); }
+	}
+
+	uint64_t previous = 0;
+	while (ok && NF_RecordingReader_next(reader)) {
+		if (y4m != NULL) {
+			// Repeat the picture before for every frame that was dropped
+			uint64_t repeats = (frames > 0 && reader->frame.number > previous) ? reader->frame.number - previous : 1;
+			for (uint64_t i = 1; ok && i < repeats; i++) { ok = fputs("FRAME\n", y4m) >= 0 && fwrite(planes, 1, plane_size * 3, y4m) == plane_size * 3; }
+			filled += repeats - 1;
+
+			for (int y = 0; y < NF_FRAME_HEIGHT; y++) {
+				for (int x = 0; x < NF_FRAME_WIDTH; x++) {
+					const uint8_t* color = ycbcr[reader->frame.pixels[y][x] & PIXEL_MASK];
+					size_t i = (size_t)y * NF_FRAME_WIDTH + x;
+					planes[i] = color[0];
+					planes[plane_size + i] = color[1];
+					planes[plane_size * 2 + i] = color[2];
+				}
+			}
+			ok = ok && fputs("FRAME\n", y4m) >= 0 && fwrite(planes, 1, plane_size * 3, y4m) == plane_size * 3;
+		}
+		if (wav != NULL && reader->audio_count > 0) {
+			ok = ok && fwrite(reader->audio, sizeof(int16_t), reader->audio_count, wav) == reader->audio_count;
+			samples += reader->audio_count;
+		}
+		previous = reader->frame.number;
+		frames++;
+	}
+
+	// The sizes in the WAV header are only known now
+	if (ok && wav != NULL) { ok = fseek(wav, 0, SEEK_SET) == 0 && writeWavHeader(wav, reader->header.sample_rate, samples); }
+	if (y4m != NULL) { ok = (fclose(y4m) == 0) && ok; }
+	if (wav != NULL) { ok = (fclose(wav) == 0) && ok; }
+	if (ok) {
+		printf("Exported %llu frames (%llu filled in for frames dropped while recording)", (unsigned long long)frames, (unsigned long long)filled);
+		if (wav_path != NULL && reader->header.sample_rate > 0) { printf(" and %.2f seconds of audio", (double)samples / reader->header.sample_rate); }
+		printf(".\n");
+	}
+	else { printf("Error: Could not export recording %s.\n", path); }
+	free(planes);
+	free(ycbcr);
+	NF_RecordingReader_free(reader);
+	return ok;
+}
@@ -0,0 +1,185 @@
+#ifndef NF_H_RECORDER
+#define NF_H_RECORDER
+#include "NF_Frame.h"
+#include "NF_Palette.h"
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Lossless recordings of what the console shows and plays. Encoding and writing the file happen on a thread of
+// their own, so that recording never holds up emulation. Frames are not copied on the way: the PPU draws straight
+// into a frame from the recorder's pool, which is handed to the encoder thread through a queue and goes back to the
+// pool once nothing holds a reference to it any more. If the encoder falls behind far enough that the queue is full,
+// the frame is not queued and is counted as dropped, and the console draws the next frame over it.
+//
+// Video is stored as pixel values (see NF_Frame.h) rather than RGB, which keeps it small and makes long runs of the
+// same value. Each line that differs from the frame stored before is written as runs of one value, and lines that
+// did not change are left out. Every keyframe_interval frames a keyframe has every line, so decoding can start there,
+// and an index of the keyframes at the end of the file takes seeking straight to one. Layout (all values little
+// endian):
+//
+// NF_RecordingFileHeader
+// Frames, each:
+//   NF_RecordingFrameHeader
+//   int16_t audio[audio_count]					Mono samples played during the frame
+//   For each line marked in dirty:
+//     uint16_t run_count
+//     uint16_t runs[run_count]					Bits 0-8: pixel value, bits 9-15: length of the run minus 1
+// NF_RecordingIndexEntry index[keyframe_count]
+// NF_RecordingFileTrailer
+//
+// A recording that was not finished (because the emulator crashed, say) has no index, but can still be read from
+// the start.
+
+#define NF_RECORDING_MAGIC "NFVIDEO"
+#define NF_RECORDING_INDEX_MAGIC "NFVINDEX"
+#define NF_RECORDING_VERSION 1
+#define NF_RECORDING_KEYFRAME_INTERVAL 120		// Two seconds
+#define NF_RECORDING_KEYFRAME 0x01				// NF_RecordingFrameHeader flags
+#define NF_RECORDING_RUN_SHIFT 9
+#define NF_RECORDING_MAX_RUN 128
+
+// Frame rate of an NTSC NES, as an exact fraction: the 236.25/11 MHz master clock over 357366 clocks per frame
+#define NF_RECORDING_RATE_NUMERATOR 39375000
+#define NF_RECORDING_RATE_DENOMINATOR 655171
+
+// The queue between the emulation thread and the encoder. The pool has two more frames than the queue holds, for
+// the one being drawn and the one being encoded
+#define NF_RECORDER_QUEUE_SIZE 16					// Power of two
+#define NF_RECORDER_POOL_SIZE (NF_RECORDER_QUEUE_SIZE + 2)
+
+// Audio a frame can hold. A frame that is dropped keeps its audio and has the next frame's added, so that no sound
+// is lost unless several frames in a row are dropped
+#define NF_RECORDER_AUDIO_CAPACITY 4096
+
+struct NF_RecordingFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t rate_numerator;		// Frames per second
+	uint32_t rate_denominator;
+	uint32_t sample_rate;			// 0 if there is no audio
+	uint32_t keyframe_interval;
+	uint32_t colors[NF_PALETTE_COLORS];		// ARGB of every pixel value
+};
+
+struct NF_RecordingFrameHeader {
+	uint32_t size;					// Bytes of audio and lines that follow
+	uint32_t flags;
+	uint64_t number;				// The console's frame count. A gap from the frame before means frames were dropped
+	uint32_t audio_count;
+	uint32_t dirty[NF_FRAME_DIRTY_WORDS];	// Lines stored, see NF_Frame.h
+};
+
+struct NF_RecordingIndexEntry {
+	uint64_t frame;					// Position of the keyframe among the frames stored
+	uint64_t offset;				// Of its NF_RecordingFrameHeader from the start of the file
+};
+
+struct NF_RecordingFileTrailer {
+	char magic[8];
+	uint64_t index_offset;
+	uint64_t frame_count;
+	uint64_t keyframe_count;
+};
+
+// A frame from the recorder's pool. The frame comes first, so that a pointer to it can be given to the console as its
+// frame_output
+struct NF_RecorderFrame {
+	struct NF_Frame frame;
+	int16_t audio[NF_RECORDER_AUDIO_CAPACITY];
+	uint32_t audio_count;
+	volatile uint32_t references;	// 0 while the frame is free in the pool
+};
+
+struct NF_Recorder {
+	struct NF_RecorderFrame* pool;
+
+	// Frames waiting to be encoded. The emulation thread only writes write_index and the encoder only read_index
+	struct NF_RecorderFrame* queue[NF_RECORDER_QUEUE_SIZE];
+	volatile uint32_t write_index;
+	uint8_t pad0[NF_CACHE_LINE_SIZE - sizeof(uint32_t)];
+	volatile uint32_t read_index;
+	uint8_t pad1[NF_CACHE_LINE_SIZE - sizeof(uint32_t)];
+
+	NF_Mutex lock;
+	NF_Cond wake;					// Signalled when a frame is queued, and on finishing
+	NF_Thread thread;
+	bool finishing;
+
+	// Only used by the encoder thread
+	FILE* file;
+	char path[1024];
+	uint64_t offset;				// Bytes written so far
+	uint64_t line_hashes[NF_FRAME_HEIGHT];	// Of the frame stored before
+	uint8_t* buffer;				// The frame being encoded
+	struct NF_RecordingIndexEntry* index;
+	uint64_t index_count;
+	uint64_t index_capacity;
+	uint64_t frames_written;
+	bool failed;					// A write failed, and nothing more is written
+
+	// Statistics
+	volatile uint32_t dropped_frames;		// Frames that did not fit in the queue. Only written by the emulation thread
+	uint32_t dropped_samples;				// Samples that did not fit in a frame's audio. Only written by the emulation thread
+};
+
+// Start a recording into a file. colors is the ARGB value of each of the NF_PALETTE_COLORS pixel values, and
+// sample_rate the rate of the audio that will be added to frames, or 0 for none. Returns NULL (and prints why) if the
+// file cannot be created or the encoder thread cannot be started
+struct NF_Recorder* NF_Recorder_create(const char* path, const uint32_t* colors, uint32_t sample_rate);
+
+// Wait for the encoder to store every queued frame, write the index and close the file. Returns false if any of the
+// recording could not be written. Frames still held by the caller must be released first
+bool NF_Recorder_finish(struct NF_Recorder* recorder);
+
+// Take a free frame from the pool to draw the first frame into, with one reference held by the caller and no audio.
+// Returns NULL if every frame is in use
+struct NF_RecorderFrame* NF_Recorder_acquire(struct NF_Recorder* recorder);
+
+// Queue a finished frame for encoding, handing the caller's reference to the encoder, and return a free frame to draw
+// the next one into. Never waits: if the queue is full, the frame is counted as dropped and returned to be drawn over
+struct NF_RecorderFrame* NF_Recorder_submit(struct NF_Recorder* recorder, struct NF_RecorderFrame* frame);
+
+// Add audio to a frame. Samples that do not fit are counted as dropped
+void NF_Recorder_addAudio(struct NF_Recorder* recorder, struct NF_RecorderFrame* frame, const int16_t* samples, uint32_t count);
+
+// Anything else that wants to keep looking at a frame (a window showing it, say) holds a reference of its own
+static inline void NF_RecorderFrame_retain(struct NF_RecorderFrame* frame) { NF_atomicAdd(&frame->references, 1); }
+static inline void NF_RecorderFrame_release(struct NF_RecorderFrame* frame) { NF_atomicAdd(&frame->references, (uint32_t)-1); }
+
+// Reading recordings back. The reader maps the file, and decodes one frame at a time into frame
+struct NF_RecordingReader {
+	struct NF_FileMapping mapping;
+	struct NF_RecordingFileHeader header;
+	struct NF_RecordingIndexEntry* index;	// NULL if the recording was not finished
+	uint64_t keyframe_count;
+	uint64_t frames_end;			// Offset of the end of the last frame, or of the file if there is no index
+	uint64_t next_offset;			// Of the next frame to decode
+	uint64_t next_frame;			// Its position among the frames stored
+
+	// The frame decoded last, and its audio
+	struct NF_Frame frame;
+	const uint8_t* audio;			// Samples, pointing into the mapping
+	uint32_t audio_count;
+};
+
+// Open a recording. Returns NULL (and prints why) if it is missing or malformed
+struct NF_RecordingReader* NF_RecordingReader_open(const char* path);
+void NF_RecordingReader_free(struct NF_RecordingReader* reader);
+
+// Decode the next frame. Returns false at the end of the recording, or if it is damaged
+bool NF_RecordingReader_next(struct NF_RecordingReader* reader);
+
+// Go to a frame by its position among the frames stored, so that the next call to NF_RecordingReader_next decodes
+// it. Decodes from the keyframe at or before it
+bool NF_RecordingReader_seek(struct NF_RecordingReader* reader, uint64_t frame);
+
+// Convert a recording to uncompressed video in YUV4MPEG2 (4:4:4) and audio in WAV (16 bit mono), either of which may
+// be NULL to skip it. Frames that were dropped while recording are filled in by repeating the frame before, so that
+// the video keeps time with the audio
+bool NF_Recording_export(const char* path, const char* y4m_path, const char* wav_path);
+
+#endif
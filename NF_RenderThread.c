@@ -0,0 +1,208 @@
+#include "NF_RenderThread.h"
+#include "NF_Cartridge.h"
+#include "NF_PPU.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Copy the PPU's memory into the journal. Everything written before this point is in the copy
+static void takeSnapshot(struct NF_PPUJournal* journal, struct PictureProcessingUnit* ppu) {
+	struct Cartridge* cart = ppu->bus->ConnectedCartridge;
+	memcpy(journal->nametables, ppu->PPU_NametableMemory, NF_PPU_JOURNAL_NAMETABLE_SIZE);
+	memcpy(journal->palette, ppu->PPU_PaletteMemory, NF_PPU_JOURNAL_PALETTE_SIZE);
+	memcpy(journal->oam, ppu->PPU_OAM, NF_PPU_JOURNAL_OAM_SIZE);
+	journal->chr = cart->chr_rom;
+	journal->write_count = 0;
+	if (!cart->chr_is_ram) { return; }
+
+	if (journal->chr_ram_size != cart->chr_size) {
+		free(journal->chr_ram);
+		journal->chr_ram = malloc(cart->chr_size);
+		journal->chr_ram_size = (journal->chr_ram != NULL) ? cart->chr_size : 0;
+		if (journal->chr_ram == NULL) {
+			printf("Error: Could not copy CHR RAM for the render thread. Out of memory?\n");
+			return;
+		}
+	}
+	memcpy(journal->chr_ram, cart->chr_rom, cart->chr_size);
+	journal->chr = journal->chr_ram;
+}
+
+void NF_PPUJournal_recordWrite(struct NF_PPUJournal* journal, NF_JOURNAL_TARGET target, uint32_t index, uint8_t value) {
+	// Writes outside of the visible lines are already in the copy taken at the start of the next frame
+	if (journal->line_count == 0 || journal->line_count == NF_FRAME_HEIGHT) { return; }
+	if (journal->write_count == journal->write_capacity) {
+		uint32_t capacity = journal->write_capacity ? journal->write_capacity * 2 : NF_PPU_JOURNAL_INITIAL_WRITES;
+		struct NF_PPUJournalWrite* writes = realloc(journal->writes, capacity * sizeof(struct NF_PPUJournalWrite));
+		if (writes == NULL) {
+			printf("Error: Could not grow the PPU journal. Out of memory?\n");
+			return;
+		}
+		journal->writes = writes;
+		journal->write_capacity = capacity;
+	}
+	struct NF_PPUJournalWrite* write = &journal->writes[journal->write_count++];
+	write->index = index;
+	write->target = (uint8_t)target;
+	write->value = value;
+}
+
+void NF_PPUJournal_recordCHRRead(struct NF_PPUJournal* journal, uint32_t index) {
+	if (journal->chr_read_count == journal->chr_read_capacity) {
+		uint32_t capacity = journal->chr_read_capacity ? journal->chr_read_capacity * 2 : NF_PPU_JOURNAL_INITIAL_CHR_READS;
+		uint32_t* reads = realloc(journal->chr_reads, capacity * sizeof(uint32_t));
+		if (reads == NULL) {
+			printf("Error: Could not grow the PPU journal. Out of memory?\n");
+			return;
+		}
+		journal->chr_reads = reads;
+		journal->chr_read_capacity = capacity;
+	}
+	journal->chr_reads[journal->chr_read_count++] = index;
+}
+
+void NF_PPUJournal_recordLine(struct NF_PPUJournal* journal, struct PictureProcessingUnit* ppu, int line) {
+	if (journal->line_count == NF_FRAME_HEIGHT) { return; }
+	if (journal->line_count == 0) { takeSnapshot(journal, ppu); }
+
+	struct Cartridge* cart = ppu->bus->ConnectedCartridge;
+	struct NF_PPUJournalLine* record = &journal->lines[journal->line_count++];
+	record->write_count = journal->write_count;
+	for (int i = 0; i < 8; i++) { record->chr_offset[i] = (uint32_t)(cart->chr_map[i] - cart->chr_rom); }
+	for (int i = 0; i < 4; i++) { record->nametable_map[i] = cart->nametable_map[i]; }
+	record->v = ppu->vram_addr.address;
+	record->line = (uint8_t)line;
+	record->ctrl = ppu->reg_PPUCTRL;
+	record->mask = ppu->reg_PPUMASK;
+	record->fine_x = ppu->fine_x;
+}
+
+static void applyWrite(struct NF_PPUJournal* journal, const struct NF_PPUJournalWrite* write) {
+	switch (write->target) {
+	case NF_JOURNAL_NAMETABLE:
+		journal->nametables[write->index & (NF_PPU_JOURNAL_NAMETABLE_SIZE - 1)] = write->value;
+		break;
+	case NF_JOURNAL_PALETTE:
+		journal->palette[write->index & (NF_PPU_JOURNAL_PALETTE_SIZE - 1)] = write->value;
+		break;
+	case NF_JOURNAL_OAM:
+		journal->oam[write->index & (NF_PPU_JOURNAL_OAM_SIZE - 1)] = write->value;
+		break;
+	case NF_JOURNAL_CHR_RAM:
+		if (write->index < journal->chr_ram_size) { journal->chr_ram[write->index] = write->value; }
+		break;
+	}
+}
+
+// Log the CHR ROM read through PPUDATA that a journal has recorded, and empty its list
+static void logCHRReads(struct NF_RenderThread* render, struct NF_PPUJournal* journal) {
+	if (render->chr_log != NULL) {
+		for (uint32_t i = 0; i < journal->chr_read_count; i++) { render->chr_log[journal->chr_reads[i]] |= NF_CDL_READ; }
+	}
+	journal->chr_read_count = 0;
+}
+
+// Replay a journal into the back frame of the output, then publish it
+static void drawJournal(struct NF_RenderThread* render, struct NF_PPUJournal* journal) {
+	logCHRReads(render, journal);
+	if (journal->line_count == 0) { return; }
+	struct NF_Frame* frame = NF_TripleBuffer_back(render->output);
+	uint32_t applied = 0;
+
+	// Lines are logged into the CHR flags through the same offsets they draw from, or all into the sink
+	uint8_t* chr_log = (render->chr_log != NULL) ? render->chr_log : render->chr_log_sink;
+	uint32_t chr_log_mask = (render->chr_log != NULL) ? UINT32_MAX : 0;
+
+	for (uint32_t i = 0; i < journal->line_count; i++) {
+		const struct NF_PPUJournalLine* record = &journal->lines[i];
+		for (; applied < record->write_count; applied++) { applyWrite(journal, &journal->writes[applied]); }
+
+		struct NF_PPULineSource src;
+		src.ctrl = record->ctrl;
+		src.mask = record->mask;
+		src.fine_x = record->fine_x;
+		src.v.address = record->v;
+		for (int j = 0; j < 8; j++) { src.chr[j] = journal->chr + record->chr_offset[j]; }
+		for (int j = 0; j < 8; j++) { src.chr_log[j] = chr_log + (record->chr_offset[j] & chr_log_mask); }
+		for (int j = 0; j < 4; j++) { src.nametables[j] = journal->nametables + record->nametable_map[j]; }
+		src.palette = journal->palette;
+		src.oam = journal->oam;
+		NF_PPU_drawLine(&src, record->line, frame->pixels[record->line]);
+		NF_Frame_finishLine(frame, record->line, render->line_hashes);
+	}
+	frame->number = journal->frame_number;
+	NF_TripleBuffer_publish(render->output);
+}
+
+static void renderMain(void* arg) {
+	struct NF_RenderThread* render = (struct NF_RenderThread*)arg;
+	NF_lockMutex(&render->lock);
+	while (true) {
+		while (!render->pending && !render->shutting_down) { NF_waitCond(&render->changed, &render->lock); }
+		if (!render->pending) { break; }
+		struct NF_PPUJournal* journal = &render->journals[render->recording ^ 1];
+		NF_unlockMutex(&render->lock);
+		drawJournal(render, journal);
+		NF_lockMutex(&render->lock);
+		render->pending = false;
+		NF_broadcastCond(&render->changed);
+	}
+	NF_unlockMutex(&render->lock);
+}
+
+struct NF_RenderThread* NF_RenderThread_create(struct NF_TripleBuffer* output) {
+	struct NF_RenderThread* render = calloc(1, sizeof(struct NF_RenderThread));
+	if (render == NULL) {
+		printf("Error: Could not create render thread. Out of memory?\n");
+		return NULL;
+	}
+	render->output = output;
+	NF_initMutex(&render->lock);
+	NF_initCond(&render->changed);
+	if (!NF_startThread(&render->thread, renderMain, render)) {
+		printf("Error: Could not start render thread.\n");
+		free(render);
+		return NULL;
+	}
+	return render;
+}
+
+void NF_RenderThread_free(struct NF_RenderThread* render) {
+	if (render == NULL) { return; }
+	NF_lockMutex(&render->lock);
+	render->shutting_down = true;
+	NF_broadcastCond(&render->changed);
+	NF_unlockMutex(&render->lock);
+	NF_joinThread(&render->thread);
+	for (int i = 0; i < 2; i++) {
+		free(render->journals[i].writes);
+		free(render->journals[i].chr_reads);
+		free(render->journals[i].chr_ram);
+	}
+	free(render);
+}
+
+struct NF_PPUJournal* NF_RenderThread_journal(struct NF_RenderThread* render) { return &render->journals[render->recording]; }
+
+struct NF_PPUJournal* NF_RenderThread_submit(struct NF_RenderThread* render, uint64_t frame_number) {
+	NF_lockMutex(&render->lock);
+	while (render->pending) { NF_waitCond(&render->changed, &render->lock); }
+	render->journals[render->recording].frame_number = frame_number;
+	render->recording ^= 1;
+	render->pending = true;
+	NF_broadcastCond(&render->changed);
+	NF_unlockMutex(&render->lock);
+
+	struct NF_PPUJournal* next = &render->journals[render->recording];
+	next->line_count = 0;
+	next->write_count = 0;
+	return next;
+}
+
+void NF_RenderThread_setCodeDataLog(struct NF_RenderThread* render, struct NF_CodeDataLog* log) {
+	NF_lockMutex(&render->lock);
+	while (render->pending) { NF_waitCond(&render->changed, &render->lock); }
+	logCHRReads(render, &render->journals[render->recording]);
+	render->chr_log = (log != NULL) ? log->chr : NULL;
+	NF_unlockMutex(&render->lock);
+}
@@ -0,0 +1,111 @@
+#ifndef NF_H_RENDERTHREAD
+#define NF_H_RENDERTHREAD
+#include "NF_CodeDataLog.h"
+#include "NF_Frame.h"
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Drawing pixels is the most expensive part of a frame, so it can be moved off the emulation thread. In this mode
+// the PPU only works out what the CPU can see (sprite 0 hit, sprite overflow, VBlank) and writes down everything
+// drawing needs into a journal: a copy of its memory taken when line 0 is reached, every change made to that memory
+// afterwards, and the registers and cartridge banks in use on each line. When the frame ends, the journal is handed
+// to the render thread, which replays it to draw the frame while the emulation thread records the next one. The
+// picture is the same as drawing inline, one frame later.
+//
+// The render thread is also the only thread that logs CHR ROM into a code/data log (see NF_CodeDataLog.h), so the
+// journal carries the bytes of CHR ROM the CPU read through PPUDATA as well.
+
+struct PictureProcessingUnit;
+
+#define NF_PPU_JOURNAL_NAMETABLE_SIZE 0x1000
+#define NF_PPU_JOURNAL_PALETTE_SIZE 0x20
+#define NF_PPU_JOURNAL_OAM_SIZE 0x100
+#define NF_PPU_JOURNAL_INITIAL_WRITES 4096
+#define NF_PPU_JOURNAL_INITIAL_CHR_READS 256
+
+// The memory a journaled write changed
+typedef enum {
+	NF_JOURNAL_NAMETABLE,			// index is an offset into the PPU's nametable memory
+	NF_JOURNAL_PALETTE,				// index is an offset into palette RAM, after mirroring
+	NF_JOURNAL_OAM,
+	NF_JOURNAL_CHR_RAM				// index is an offset into the cartridge's CHR RAM
+} NF_JOURNAL_TARGET;
+
+struct NF_PPUJournalWrite {
+	uint32_t index;
+	uint8_t target;					// NF_JOURNAL_TARGET
+	uint8_t value;
+};
+
+// Registers and banks in use when a line was drawn
+struct NF_PPUJournalLine {
+	uint32_t write_count;			// Writes that happened before this line, all applied before it is drawn
+	uint32_t chr_offset[8];			// Offset of each 1KB CHR window into the cartridge's CHR memory
+	uint16_t nametable_map[4];
+	uint16_t v;						// vram_addr at the start of the line
+	uint8_t line;
+	uint8_t ctrl;
+	uint8_t mask;
+	uint8_t fine_x;
+};
+
+struct NF_PPUJournal {
+	// Copy of PPU memory, taken when line 0 is recorded
+	uint8_t nametables[NF_PPU_JOURNAL_NAMETABLE_SIZE];
+	uint8_t palette[NF_PPU_JOURNAL_PALETTE_SIZE];
+	uint8_t oam[NF_PPU_JOURNAL_OAM_SIZE];
+	uint8_t* chr_ram;				// Copy of the cartridge's CHR RAM
+	uint32_t chr_ram_size;
+	const uint8_t* chr;				// What lines read patterns from: chr_ram, or CHR ROM in place since it never changes
+
+	struct NF_PPUJournalLine lines[NF_FRAME_HEIGHT];
+	uint32_t line_count;
+	struct NF_PPUJournalWrite* writes;
+	uint32_t write_count;
+	uint32_t write_capacity;
+	uint32_t* chr_reads;			// Offsets into CHR ROM read through PPUDATA, at any time since the last journal
+	uint32_t chr_read_count;
+	uint32_t chr_read_capacity;
+	uint64_t frame_number;
+};
+
+// Record a change to PPU memory, a read of CHR ROM, or the state a line is drawn with. Called by the PPU
+void NF_PPUJournal_recordWrite(struct NF_PPUJournal* journal, NF_JOURNAL_TARGET target, uint32_t index, uint8_t value);
+void NF_PPUJournal_recordCHRRead(struct NF_PPUJournal* journal, uint32_t index);
+void NF_PPUJournal_recordLine(struct NF_PPUJournal* journal, struct PictureProcessingUnit* ppu, int line);
+
+// The render thread keeps two journals: one being recorded by the emulation thread and one being drawn
+struct NF_RenderThread {
+	struct NF_PPUJournal journals[2];
+	uint32_t recording;				// Index of the journal being recorded
+	struct NF_TripleBuffer* output;
+	uint64_t line_hashes[NF_FRAME_HEIGHT];	// Of the last frame drawn
+	uint8_t* chr_log;				// CHR ROM flags of the code/data log, or NULL
+	uint8_t chr_log_sink[NF_CDL_SINK_SIZE];	// Where lines are logged with no log, written by this thread only
+
+	NF_Mutex lock;
+	NF_Cond changed;
+	NF_Thread thread;
+	bool pending;					// The other journal is waiting to be drawn, or being drawn
+	bool shutting_down;
+};
+
+// Start a render thread that draws into output. Attach it to a console with NF_setRenderThread
+struct NF_RenderThread* NF_RenderThread_create(struct NF_TripleBuffer* output);
+
+// Stop the thread. It must be detached from the console first
+void NF_RenderThread_free(struct NF_RenderThread* render);
+
+// The journal to record into
+struct NF_PPUJournal* NF_RenderThread_journal(struct NF_RenderThread* render);
+
+// Hand the recorded journal over to be drawn and return an empty one to record the next frame into. Waits only if
+// the thread has not finished drawing the frame before
+struct NF_PPUJournal* NF_RenderThread_submit(struct NF_RenderThread* render, uint64_t frame_number);
+
+// Log the CHR ROM the frames draw into a code/data log from now on, or stop with NULL. Waits for the frame being drawn
+// to be finished, and logs the reads in the journal being recorded into the log it had, so that none are lost. Called by NF_setCodeDataLog and NF_setRenderThread
+void NF_RenderThread_setCodeDataLog(struct NF_RenderThread* render, struct NF_CodeDataLog* log);
+
+#endif
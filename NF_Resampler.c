@@ -0,0 +1,95 @@
+#include "NF_Resampler.h"
+#include "NF_Platform.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef NF_X86
+#include <emmintrin.h>
+#endif
+
+// One kernel per phase, each a windowed sinc with its centre shifted by the phase's fraction of a sample
+static float resamplerKernel[NF_RESAMPLER_PHASES][NF_RESAMPLER_TAPS];
+static bool resamplerKernelReady = false;
+
+static void buildKernel() {
+	const double pi = 3.14159265358979323846;
+	const double cutoff = 0.45;
+	for (int phase = 0; phase < NF_RESAMPLER_PHASES; phase++) {
+		double taps[NF_RESAMPLER_TAPS];
+		double sum = 0;
+		for (int i = 0; i < NF_RESAMPLER_TAPS; i++) {
+			double x = i - (NF_RESAMPLER_TAPS / 2 - 1) - (double)phase / NF_RESAMPLER_PHASES;
+			double sinc = (x == 0) ? 2 * cutoff : sin(2 * pi * cutoff * x) / (pi * x);
+			double window = 0.42 + 0.5 * cos(2 * pi * x / NF_RESAMPLER_TAPS) + 0.08 * cos(4 * pi * x / NF_RESAMPLER_TAPS);
+			taps[i] = sinc * window;
+			sum += taps[i];
+		}
+		for (int i = 0; i < NF_RESAMPLER_TAPS; i++) { resamplerKernel[phase][i] = (float)(taps[i] / sum); }
+	}
+	resamplerKernelReady = true;
+}
+
+void NF_Resampler_init(struct NF_Resampler* resampler) {
+	if (!resamplerKernelReady) { buildKernel(); }
+	memset(resampler, 0, sizeof(*resampler));
+}
+
+uint32_t NF_Resampler_write(struct NF_Resampler* resampler, const int16_t* samples, uint32_t count) {
+	uint32_t space = NF_RESAMPLER_BUFFER_SIZE - resampler->input_count;
+	if (count > space) { count = space; }
+	float* out = resampler->input + resampler->input_count;
+	for (uint32_t i = 0; i < count; i++) { out[i] = samples[i]; }
+	resampler->input_count += count;
+	return count;
+}
+
+uint32_t NF_Resampler_inputNeeded(const struct NF_Resampler* resampler, uint32_t count, double ratio) {
+	if (count == 0) { return 0; }
+	uint32_t last = (uint32_t)(resampler->position + (count - 1) * ratio) + NF_RESAMPLER_TAPS;
+	return last > resampler->input_count ? last - resampler->input_count : 0;
+}
+
+double NF_Resampler_pending(const struct NF_Resampler* resampler) {
+	return resampler->input_count - resampler->position;
+}
+
+#ifdef NF_X86
+static float dotProduct(const float* input, const float* kernel) {
+	__m128 sum = _mm_mul_ps(_mm_loadu_ps(input), _mm_loadu_ps(kernel));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + 4), _mm_loadu_ps(kernel + 4)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + 8), _mm_loadu_ps(kernel + 8)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + 12), _mm_loadu_ps(kernel + 12)));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+#else
+static float dotProduct(const float* input, const float* kernel) {
+	float sum = 0;
+	for (int i = 0; i < NF_RESAMPLER_TAPS; i++) { sum += input[i] * kernel[i]; }
+	return sum;
+}
+#endif
+
+uint32_t NF_Resampler_read(struct NF_Resampler* resampler, int16_t* samples, uint32_t count, double ratio) {
+	double position = resampler->position;
+	uint32_t produced = 0;
+	while (produced < count) {
+		uint32_t index = (uint32_t)position;
+		if (index + NF_RESAMPLER_TAPS > resampler->input_count) { break; }
+		uint32_t phase = (uint32_t)((position - index) * NF_RESAMPLER_PHASES);
+		float sample = dotProduct(resampler->input + index, resamplerKernel[phase]);
+		if (sample > 32767.0f) { sample = 32767.0f; }
+		if (sample < -32768.0f) { sample = -32768.0f; }
+		samples[produced++] = (int16_t)sample;
+		position += ratio;
+	}
+
+	// Input before the current position is no longer needed
+	uint32_t used = (uint32_t)position;
+	if (used > resampler->input_count) { used = resampler->input_count; }
+	memmove(resampler->input, resampler->input + used, (resampler->input_count - used) * sizeof(float));
+	resampler->input_count -= used;
+	resampler->position = position - used;
+	return produced;
+}
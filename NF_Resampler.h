@@ -0,0 +1,40 @@
+#ifndef NF_H_RESAMPLER
+#define NF_H_RESAMPLER
+#include <stdint.h>
+
+// Polyphase windowed-sinc resampler for ratios close to 1. It exists so that the audio device can play the
+// emulator's samples slightly faster or slower than they were made, which is how the amount of buffered audio is
+// kept steady without ever pausing or skipping.
+//
+// Input samples are queued with NF_Resampler_write and output is pulled with NF_Resampler_read, at a ratio that may
+// change on every read. Each output sample is the dot product of NF_RESAMPLER_TAPS input samples with the kernel
+// for its sub-sample phase, which is done with SSE2 where available.
+
+#define NF_RESAMPLER_TAPS 16
+#define NF_RESAMPLER_PHASE_BITS 9
+#define NF_RESAMPLER_PHASES (1 << NF_RESAMPLER_PHASE_BITS)
+#define NF_RESAMPLER_BUFFER_SIZE 8192
+
+struct NF_Resampler {
+	float input[NF_RESAMPLER_BUFFER_SIZE];
+	uint32_t input_count;
+	double position;				// Position of the next output sample in the input, in input samples
+};
+
+void NF_Resampler_init(struct NF_Resampler* resampler);
+
+// Queue input samples. Returns how many fit
+uint32_t NF_Resampler_write(struct NF_Resampler* resampler, const int16_t* samples, uint32_t count);
+
+// Number of input samples needed to produce count outputs at a ratio (input samples per output sample), on top of
+// those already queued
+uint32_t NF_Resampler_inputNeeded(const struct NF_Resampler* resampler, uint32_t count, double ratio);
+
+// Number of queued input samples that have not been used up yet
+double NF_Resampler_pending(const struct NF_Resampler* resampler);
+
+// Produce up to count output samples, stepping ratio input samples per output. Returns how many were produced,
+// which is less than count if the queued input ran out
+uint32_t NF_Resampler_read(struct NF_Resampler* resampler, int16_t* samples, uint32_t count, double ratio);
+
+#endif
@@ -0,0 +1,380 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_RomCatalog.h"
+#include "NF_Cartridge.h"
+#include "NF_Hash.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SCAN_DEPTH 32
+#define MAX_PATH_LENGTH 1024
+
+struct NF_RomCatalog* NF_RomCatalog_open(const char* path) {
+	struct NF_RomCatalog* catalog = calloc(1, sizeof(struct NF_RomCatalog));
+	if (catalog == NULL) {
+		printf("Error: Could not create ROM catalog object. Out of memory?\n");
+		return NULL;
+	}
+	if (!NF_mapFileReadOnly(path, &catalog->mapping)) {
+		free(catalog);
+		return NULL;
+	}
+
+	// Check the header, that the tables fit in the file, and that every string offset lands inside the string table
+	const struct NF_RomCatalogFileHeader* header = (const struct NF_RomCatalogFileHeader*)catalog->mapping.data;
+	size_t size = catalog->mapping.size;
+	bool valid = size >= sizeof(*header) && memcmp(header->magic, NF_ROMCATALOG_MAGIC, sizeof(NF_ROMCATALOG_MAGIC)) == 0 &&
+		header->version == NF_ROMCATALOG_VERSION && header->string_table_size > 0 &&
+		sizeof(*header) + (uint64_t)header->entry_count * sizeof(struct NF_RomCatalogEntry) + header->string_table_size <= size;
+	if (valid) {
+		catalog->entries = (const struct NF_RomCatalogEntry*)(catalog->mapping.data + sizeof(*header));
+		catalog->strings = (const char*)(catalog->entries + header->entry_count);
+		valid = catalog->strings[header->string_table_size - 1] == '\0';
+		for (uint32_t i = 0; valid && i < header->entry_count; i++) {
+			valid = catalog->entries[i].path < header->string_table_size && catalog->entries[i].title < header->string_table_size;
+		}
+	}
+	if (!valid) {
+		printf("Error: %s is not a valid ROM catalog.\n", path);
+		NF_unmapFile(&catalog->mapping);
+		free(catalog);
+		return NULL;
+	}
+	catalog->file_header = header;
+	return catalog;
+}
+
+void NF_RomCatalog_close(struct NF_RomCatalog* catalog) {
+	if (catalog == NULL) { return; }
+	NF_unmapFile(&catalog->mapping);
+	free(catalog);
+}
+
+uint32_t NF_RomCatalog_count(const struct NF_RomCatalog* catalog) { return catalog->file_header->entry_count; }
+
+const char* NF_RomCatalog_path(const struct NF_RomCatalog* catalog, const struct NF_RomCatalogEntry* entry) {
+	return catalog->strings + entry->path;
+}
+
+const char* NF_RomCatalog_title(const struct NF_RomCatalog* catalog, const struct NF_RomCatalogEntry* entry) {
+	return catalog->strings + entry->title;
+}
+
+const struct NF_RomCatalogEntry* NF_RomCatalog_find(const struct NF_RomCatalog* catalog, const char* path) {
+	uint32_t lo = 0, hi = catalog->file_header->entry_count;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(catalog->strings + catalog->entries[mid].path, path);
+		if (cmp == 0) { return &catalog->entries[mid]; }
+		if (cmp < 0) { lo = mid + 1; }
+		else { hi = mid; }
+	}
+	return NULL;
+}
+
+const struct NF_RomCatalogEntry* NF_RomCatalog_findFile(const struct NF_RomCatalog* catalog, const char* root, const char* path,
+	const struct NF_FileInfo* info) {
+	size_t root_length = strlen(root);
+	while (root_length > 0 && (root[root_length - 1] == '/' || root[root_length - 1] == '\\')) { root_length--; }
+	if (strncmp(path, root, root_length) != 0 || (path[root_length] != '/' && path[root_length] != '\\')) { return NULL; }
+
+	// The catalog always separates directories with forward slashes
+	char relative[MAX_PATH_LENGTH];
+	const char* rest = path + root_length;
+	while (*rest == '/' || *rest == '\\') { rest++; }
+	if (strlen(rest) >= sizeof(relative)) { return NULL; }
+	size_t i = 0;
+	for (; rest[i] != '\0'; i++) { relative[i] = (rest[i] == '\\') ? '/' : rest[i]; }
+	relative[i] = '\0';
+
+	const struct NF_RomCatalogEntry* entry = NF_RomCatalog_find(catalog, relative);
+	if (entry == NULL || !entry->valid || entry->file_size != info->size || entry->mtime != info->mtime) { return NULL; }
+	return entry;
+}
+
+// A file found by the directory walk. name starts out as an offset into the name buffer, and becomes a pointer once
+// the walk is over and the buffer has stopped moving
+struct ScanFile {
+	union {
+		size_t offset;
+		const char* pointer;
+	} name;
+	uint64_t size;
+	int64_t mtime;
+};
+
+struct Scan {
+	const char* root;
+	char relative[MAX_PATH_LENGTH];		// Directory being walked, relative to root, with a trailing slash
+	size_t relative_length;
+	int depth;
+
+	char* names;
+	size_t names_size;
+	size_t names_capacity;
+	struct ScanFile* files;
+	uint32_t file_count;
+	uint32_t file_capacity;
+	bool out_of_memory;
+
+	struct NF_RomCatalogEntry* entries;	// One per file, in the same order
+	uint32_t* pending;					// Files that have to be hashed
+	char (*errors)[NF_CARTRIDGE_ERROR_SIZE];	// One per pending file: why it was rejected, or empty if it was not
+};
+
+static bool hasNesExtension(const char* name) {
+	size_t length = strlen(name);
+	if (length < 4) { return false; }
+	const char* ext = name + length - 4;
+	return ext[0] == '.' && tolower((unsigned char)ext[1]) == 'n' && tolower((unsigned char)ext[2]) == 'e' && tolower((unsigned char)ext[3]) == 's';
+}
+
+static void addFile(struct Scan* scan, const char* name, uint64_t size, int64_t mtime) {
+	size_t length = scan->relative_length + strlen(name) + 1;
+	if (scan->names_size + length > scan->names_capacity) {
+		size_t capacity = scan->names_capacity ? scan->names_capacity * 2 : 65536;
+		while (capacity < scan->names_size + length) { capacity *= 2; }
+		char* names = realloc(scan->names, capacity);
+		if (names == NULL) { scan->out_of_memory = true; return; }
+		scan->names = names;
+		scan->names_capacity = capacity;
+	}
+	if (scan->file_count == scan->file_capacity) {
+		uint32_t capacity = scan->file_capacity ? scan->file_capacity * 2 : 1024;
+		struct ScanFile* files = realloc(scan->files, capacity * sizeof(struct ScanFile));
+		if (files == NULL) { scan->out_of_memory = true; return; }
+		scan->files = files;
+		scan->file_capacity = capacity;
+	}
+	struct ScanFile* file = &scan->files[scan->file_count++];
+	file->name.offset = scan->names_size;
+	file->size = size;
+	file->mtime = mtime;
+	memcpy(scan->names + scan->names_size, scan->relative, scan->relative_length);
+	strcpy(scan->names + scan->names_size + scan->relative_length, name);
+	scan->names_size += length;
+}
+
+static void walkDirectory(struct Scan* scan);
+
+static void walkEntry(void* context, const struct NF_DirectoryEntry* entry) {
+	struct Scan* scan = (struct Scan*)context;
+	size_t name_length = strlen(entry->name);
+	if (scan->relative_length + name_length + 2 > MAX_PATH_LENGTH) { return; }
+
+	if (entry->is_directory) {
+		if (scan->depth >= MAX_SCAN_DEPTH) { return; }
+		size_t parent_length = scan->relative_length;
+		memcpy(scan->relative + parent_length, entry->name, name_length);
+		scan->relative[parent_length + name_length] = '/';
+		scan->relative_length = parent_length + name_length + 1;
+		scan->depth++;
+		walkDirectory(scan);
+		scan->depth--;
+		scan->relative_length = parent_length;
+	}
+	else if (hasNesExtension(entry->name)) {
+		addFile(scan, entry->name, entry->size, entry->mtime);
+	}
+}
+
+static void walkDirectory(struct Scan* scan) {
+	char path[MAX_PATH_LENGTH * 2];
+	if (scan->relative_length == 0) { snprintf(path, sizeof(path), "%s", scan->root); }
+	else { snprintf(path, sizeof(path), "%s/%.*s", scan->root, (int)(scan->relative_length - 1), scan->relative); }
+	NF_listDirectory(path, walkEntry, scan);
+}
+
+static int compareScanFiles(const void* a, const void* b) {
+	return strcmp(((const struct ScanFile*)a)->name.pointer, ((const struct ScanFile*)b)->name.pointer);
+}
+
+// Read one new or changed file, validate its header the same way loading it would, and hash it. This runs on pool
+// workers, so rather than printing, problems are left in errors for the calling thread to report
+static void hashFile(void* context, int index) {
+	struct Scan* scan = (struct Scan*)context;
+	uint32_t file_index = scan->pending[index];
+	struct NF_RomCatalogEntry* entry = &scan->entries[file_index];
+
+	char path[MAX_PATH_LENGTH * 2];
+	snprintf(path, sizeof(path), "%s/%s", scan->root, scan->files[file_index].name.pointer);
+	struct NF_FileMapping mapping;
+	if (!NF_tryMapFileReadOnly(path, &mapping)) {
+		snprintf(scan->errors[index], NF_CARTRIDGE_ERROR_SIZE, "The file could not be opened, or is empty.");
+		return;
+	}
+
+	struct NF_CartridgeHeader header;
+	if (NF_validateCartridge(mapping.data, mapping.size, mapping.data, &header, scan->errors[index], NF_CARTRIDGE_ERROR_SIZE)) {
+		const uint8_t* body = mapping.data + INES_HEADER_SIZE;
+		size_t body_size = mapping.size - INES_HEADER_SIZE;
+		entry->crc32 = NF_crc32(0, body, body_size);
+		NF_sha1(body, body_size, entry->sha1);
+		entry->prg_rom_size = header.prg_rom_size;
+		entry->chr_rom_size = header.chr_rom_size;
+		entry->prg_ram_size = header.prg_ram_size + header.prg_nvram_size;
+		entry->chr_ram_size = header.chr_ram_size + header.chr_nvram_size;
+		entry->mapper = header.mapper;
+		entry->submapper = header.submapper;
+		entry->mirroring = (uint8_t)header.mirroring;
+		entry->header_type = (uint8_t)header.header_type;
+		entry->has_battery = header.has_battery;
+		entry->valid = 1;
+	}
+	NF_unmapFile(&mapping);
+}
+
+// Append a string to the string table being built, returning its offset
+static uint32_t addString(char** table, size_t* size, size_t* capacity, const char* string, size_t length) {
+	if (*size + length + 1 > *capacity) {
+		size_t new_capacity = *capacity ? *capacity * 2 : 65536;
+		while (new_capacity < *size + length + 1) { new_capacity *= 2; }
+		char* new_table = realloc(*table, new_capacity);
+		if (new_table == NULL) { return UINT32_MAX; }
+		*table = new_table;
+		*capacity = new_capacity;
+	}
+	uint32_t offset = (uint32_t)*size;
+	memcpy(*table + offset, string, length);
+	(*table)[offset + length] = '\0';
+	*size += length + 1;
+	return offset;
+}
+
+static bool writeCatalog(struct Scan* scan, const char* catalog_path) {
+	char* strings = NULL;
+	size_t strings_size = 0, strings_capacity = 0;
+	bool ok = true;
+
+	// The entries already point at their files in sorted order, so only the string offsets need filling in
+	for (uint32_t i = 0; ok && i < scan->file_count; i++) {
+		const char* path = scan->files[i].name.pointer;
+		const char* slash = strrchr(path, '/');
+		const char* title = slash ? slash + 1 : path;
+		scan->entries[i].path = addString(&strings, &strings_size, &strings_capacity, path, strlen(path));
+		scan->entries[i].title = addString(&strings, &strings_size, &strings_capacity, title, strlen(title) - 4);
+		ok = scan->entries[i].path != UINT32_MAX && scan->entries[i].title != UINT32_MAX;
+	}
+	if (ok && strings_size == 0) { ok = addString(&strings, &strings_size, &strings_capacity, "", 0) != UINT32_MAX; }
+	if (!ok) {
+		printf("Error: Could not build ROM catalog string table. Out of memory?\n");
+		free(strings);
+		return false;
+	}
+
+	struct NF_RomCatalogFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NF_ROMCATALOG_MAGIC, sizeof(NF_ROMCATALOG_MAGIC));
+	header.version = NF_ROMCATALOG_VERSION;
+	header.entry_count = scan->file_count;
+	header.string_table_size = (uint32_t)strings_size;
+
+	char tmp_path[MAX_PATH_LENGTH * 2];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", catalog_path);
+	FILE* file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		printf("Error: Could not open %s for writing.\n", tmp_path);
+		free(strings);
+		return false;
+	}
+	ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(scan->file_count == 0 || fwrite(scan->entries, sizeof(struct NF_RomCatalogEntry), scan->file_count, file) == scan->file_count) &&
+		fwrite(strings, 1, strings_size, file) == strings_size;
+	ok = (fclose(file) == 0) && ok;
+	free(strings);
+
+	if (!ok || !NF_replaceFile(tmp_path, catalog_path)) {
+		printf("Error: Could not write ROM catalog %s.\n", catalog_path);
+		remove(tmp_path);
+		return false;
+	}
+	return true;
+}
+
+// Bring the catalog up to date from a finished directory walk. Takes ownership of previous
+static struct NF_RomCatalog* updateCatalog(struct Scan* scan, struct NF_RomCatalog* previous, const char* catalog_path, struct NF_ThreadPool* pool, struct NF_RomScanStats* stats) {
+	for (uint32_t i = 0; i < scan->file_count; i++) { scan->files[i].name.pointer = scan->names + scan->files[i].name.offset; }
+	qsort(scan->files, scan->file_count, sizeof(struct ScanFile), compareScanFiles);
+
+	scan->entries = calloc(scan->file_count ? scan->file_count : 1, sizeof(struct NF_RomCatalogEntry));
+	scan->pending = calloc(scan->file_count ? scan->file_count : 1, sizeof(uint32_t));
+	if (scan->entries == NULL || scan->pending == NULL) {
+		printf("Error: Could not create ROM catalog entries. Out of memory?\n");
+		NF_RomCatalog_close(previous);
+		return NULL;
+	}
+
+	// Files with the same size and time as last time keep their old entry. Everything else is queued for hashing
+	uint32_t pending_count = 0;
+	for (uint32_t i = 0; i < scan->file_count; i++) {
+		const struct ScanFile* file = &scan->files[i];
+		const struct NF_RomCatalogEntry* old = previous ? NF_RomCatalog_find(previous, file->name.pointer) : NULL;
+		if (old != NULL && old->file_size == file->size && old->mtime == file->mtime) {
+			scan->entries[i] = *old;
+			stats->reused++;
+		}
+		else {
+			scan->entries[i].file_size = file->size;
+			scan->entries[i].mtime = file->mtime;
+			scan->pending[pending_count++] = i;
+		}
+	}
+	stats->files = scan->file_count;
+	stats->hashed = pending_count;
+
+	// Every file was found in the old catalog and there are as many as before, so it is still accurate
+	if (previous != NULL && pending_count == 0 && scan->file_count == NF_RomCatalog_count(previous)) {
+		for (uint32_t i = 0; i < scan->file_count; i++) { if (!scan->entries[i].valid) { stats->invalid++; } }
+		return previous;
+	}
+
+	// The old mapping has to go before the file is replaced, since Windows will not replace a file that is mapped
+	NF_RomCatalog_close(previous);
+
+	scan->errors = calloc(pending_count ? pending_count : 1, NF_CARTRIDGE_ERROR_SIZE);
+	if (scan->errors == NULL) {
+		printf("Error: Could not create ROM catalog entries. Out of memory?\n");
+		return NULL;
+	}
+	if (pool != NULL) { NF_runTasks(pool, (int)pending_count, hashFile, scan); }
+	else { for (uint32_t i = 0; i < pending_count; i++) { hashFile(scan, (int)i); } }
+	for (uint32_t i = 0; i < pending_count; i++) {
+		if (scan->errors[i][0] != '\0') { printf("Error: %s/%s: %s\n", scan->root, scan->files[scan->pending[i]].name.pointer, scan->errors[i]); }
+	}
+	for (uint32_t i = 0; i < scan->file_count; i++) { if (!scan->entries[i].valid) { stats->invalid++; } }
+
+	if (!writeCatalog(scan, catalog_path)) { return NULL; }
+	return NF_RomCatalog_open(catalog_path);
+}
+
+struct NF_RomCatalog* NF_RomCatalog_scan(const char* root, const char* catalog_path, struct NF_ThreadPool* pool, struct NF_RomScanStats* stats) {
+	struct NF_RomScanStats local_stats;
+	if (stats == NULL) { stats = &local_stats; }
+	memset(stats, 0, sizeof(*stats));
+
+	// The previous catalog, if there is one, says which files can be skipped
+	struct NF_FileInfo info;
+	struct NF_RomCatalog* previous = NULL;
+	if (NF_getFileInfo(catalog_path, &info)) { previous = NF_RomCatalog_open(catalog_path); }
+
+	struct Scan scan;
+	memset(&scan, 0, sizeof(scan));
+	scan.root = root;
+	walkDirectory(&scan);
+
+	struct NF_RomCatalog* result = NULL;
+	if (scan.out_of_memory) {
+		printf("Error: Ran out of memory while listing %s.\n", root);
+		NF_RomCatalog_close(previous);
+	}
+	else { result = updateCatalog(&scan, previous, catalog_path, pool, stats); }
+
+	free(scan.names);
+	free(scan.files);
+	free(scan.entries);
+	free(scan.pending);
+	free(scan.errors);
+	return result;
+}
@@ -0,0 +1,85 @@
+#ifndef NF_H_ROMCATALOG
+#define NF_H_ROMCATALOG
+#include "NF_Platform.h"
+#include "NF_ThreadPool.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// A catalog of every ROM under a directory: where it is, what board it needs, and its hashes. Building one means
+// reading and hashing every file, so the catalog is saved to disk and rescans only look at files whose size or
+// modification time changed since the last scan. When nothing changed, a rescan is just a directory walk.
+//
+// Like the ROM database, the catalog file is mapped into memory as-is. Layout (all values little endian):
+//
+// NF_RomCatalogFileHeader
+// NF_RomCatalogEntry entries[entry_count]		Sorted by path
+// char strings[string_table_size]				NUL terminated paths and titles, referenced by offset from the entries
+
+#define NF_ROMCATALOG_MAGIC "NFCATLG"
+#define NF_ROMCATALOG_VERSION 2
+
+struct NF_RomCatalogFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t string_table_size;
+	uint32_t reserved;
+};
+
+struct NF_RomCatalogEntry {
+	uint32_t path;				// Offset in the string table of the path, relative to the scanned directory
+	uint32_t title;				// Offset in the string table of the title (the file name without its extension)
+	uint64_t file_size;
+	int64_t mtime;				// Nanoseconds since the epoch, so that rewrites within the same second are still noticed
+	uint32_t crc32;				// CRC32 of everything after the 16 byte header, the same key the ROM database uses
+	uint8_t sha1[20];
+	uint32_t prg_rom_size;
+	uint32_t chr_rom_size;
+	uint32_t prg_ram_size;		// Volatile and battery backed PRG RAM together
+	uint32_t chr_ram_size;		// Volatile and battery backed CHR RAM together
+	uint16_t mapper;
+	uint8_t submapper;
+	uint8_t mirroring;			// A SCROLL_MAPPING_TYPE
+	uint8_t header_type;		// A HEADER_TYPE
+	uint8_t has_battery;
+	uint8_t valid;				// 0 if the header is broken or the file is too small for it. Only size and time are set then
+	uint8_t reserved;
+};
+
+struct NF_RomCatalog {
+	struct NF_FileMapping mapping;
+	const struct NF_RomCatalogFileHeader* file_header;
+	const struct NF_RomCatalogEntry* entries;
+	const char* strings;
+};
+
+// What a scan did, for the curious
+struct NF_RomScanStats {
+	uint32_t files;				// ROM files found
+	uint32_t reused;			// Files unchanged since the last scan, which were not read
+	uint32_t hashed;			// Files that were new or changed, and were read and hashed
+	uint32_t invalid;			// Files whose header did not validate
+};
+
+// Map a catalog file. Returns NULL (and prints why) if it is missing or malformed
+struct NF_RomCatalog* NF_RomCatalog_open(const char* path);
+void NF_RomCatalog_close(struct NF_RomCatalog* catalog);
+
+// Walk root for .nes files and bring the catalog at catalog_path up to date, then open it. pool may be NULL, in which
+// case the files are hashed on the calling thread. stats may be NULL
+struct NF_RomCatalog* NF_RomCatalog_scan(const char* root, const char* catalog_path, struct NF_ThreadPool* pool, struct NF_RomScanStats* stats);
+
+uint32_t NF_RomCatalog_count(const struct NF_RomCatalog* catalog);
+const char* NF_RomCatalog_path(const struct NF_RomCatalog* catalog, const struct NF_RomCatalogEntry* entry);
+const char* NF_RomCatalog_title(const struct NF_RomCatalog* catalog, const struct NF_RomCatalogEntry* entry);
+
+// Find the entry for a path relative to the scanned directory, or NULL
+const struct NF_RomCatalogEntry* NF_RomCatalog_find(const struct NF_RomCatalog* catalog, const char* path);
+
+// Find the entry for a file, given by a path that starts with the scanned directory (root), so that its hashes can be
+// used without reading it. Returns NULL if the file is not under root, is not in the catalog, did not validate, or
+// has a different size or modification time (info, from NF_getFileInfo) than when it was hashed
+const struct NF_RomCatalogEntry* NF_RomCatalog_findFile(const struct NF_RomCatalog* catalog, const char* root, const char* path,
+	const struct NF_FileInfo* info);
+
+#endif
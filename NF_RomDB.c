@@ -0,0 +1,243 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_RomDB.h"
+#include "NF_Cartridge.h"
+#include "NF_Hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct NF_RomDB* NF_RomDB_open(const char* path) {
+	struct NF_RomDB* db = calloc(1, sizeof(struct NF_RomDB));
+	if (db == NULL) {
+		printf("Error: Could not create ROM database object. Out of memory?\n");
+		return NULL;
+	}
+	if (!NF_mapFileReadOnly(path, &db->mapping)) {
+		free(db);
+		return NULL;
+	}
+
+	// Validate the header and that the tables fit in the file before trusting any of it
+	const struct NF_RomDBFileHeader* header = (const struct NF_RomDBFileHeader*)db->mapping.data;
+	size_t size = db->mapping.size;
+	if (size < sizeof(*header) || memcmp(header->magic, NF_ROMDB_MAGIC, sizeof(NF_ROMDB_MAGIC)) != 0 || header->version != NF_ROMDB_VERSION ||
+		header->bucket_count == 0 || (header->bucket_count & (header->bucket_count - 1)) != 0 || header->entry_count >= header->bucket_count ||
+		sizeof(*header) + (uint64_t)header->bucket_count * 4 + (uint64_t)header->entry_count * sizeof(struct NF_RomDBEntry) > size) {
+		printf("Error: %s is not a valid ROM database.\n", path);
+		NF_unmapFile(&db->mapping);
+		free(db);
+		return NULL;
+	}
+
+	// Lookups follow the buckets without checking them, so a bucket past the entries, or a table without an empty
+	// bucket to stop at, would send them off the end of the file or around forever
+	db->file_header = header;
+	db->buckets = (const uint32_t*)(db->mapping.data + sizeof(*header));
+	db->entries = (const struct NF_RomDBEntry*)(db->buckets + header->bucket_count);
+	uint32_t empty = 0;
+	for (uint32_t i = 0; i < header->bucket_count; i++) {
+		if (db->buckets[i] == 0) { empty++; }
+		else if (db->buckets[i] > header->entry_count) { empty = 0; break; }
+	}
+	if (empty == 0) {
+		printf("Error: %s is not a valid ROM database.\n", path);
+		NF_unmapFile(&db->mapping);
+		free(db);
+		return NULL;
+	}
+	return db;
+}
+
+void NF_RomDB_close(struct NF_RomDB* db) {
+	if (db == NULL) { return; }
+	NF_unmapFile(&db->mapping);
+	free(db);
+}
+
+// Walk the probe sequence for a CRC. Sets *ambiguous if more than one entry matches the CRC and size, in which case
+// the SHA-1 is needed to pick one
+static const struct NF_RomDBEntry* findEntry(const struct NF_RomDB* db, uint32_t crc32, uint32_t rom_size, const uint8_t* sha1, bool* ambiguous) {
+	uint32_t mask = db->file_header->bucket_count - 1;
+	const struct NF_RomDBEntry* found = NULL;
+	*ambiguous = false;
+	for (uint32_t slot = crc32 & mask; db->buckets[slot] != 0; slot = (slot + 1) & mask) {
+		const struct NF_RomDBEntry* entry = &db->entries[db->buckets[slot] - 1];
+		if (entry->crc32 != crc32 || entry->rom_size != rom_size) { continue; }
+		if (sha1 != NULL) {
+			if (memcmp(entry->sha1, sha1, 20) == 0) { return entry; }
+			continue;
+		}
+		if (found != NULL) { *ambiguous = true; }
+		found = entry;
+	}
+	return found;
+}
+
+const struct NF_RomDBEntry* NF_RomDB_lookup(const struct NF_RomDB* db, uint32_t crc32, uint32_t rom_size, const uint8_t* sha1) {
+	bool ambiguous;
+	const struct NF_RomDBEntry* entry = findEntry(db, crc32, rom_size, sha1, &ambiguous);
+	return ambiguous ? NULL : entry;
+}
+
+const struct NF_RomDBEntry* NF_RomDB_lookupRom(const struct NF_RomDB* db, const uint8_t* rom_data, size_t size) {
+	if (db == NULL || size <= INES_HEADER_SIZE) { return NULL; }
+	const uint8_t* body = rom_data + INES_HEADER_SIZE;
+	uint32_t body_size = (uint32_t)(size - INES_HEADER_SIZE);
+	uint32_t crc = NF_crc32(0, body, body_size);
+
+	bool ambiguous;
+	const struct NF_RomDBEntry* entry = findEntry(db, crc, body_size, NULL, &ambiguous);
+	if (!ambiguous) { return entry; }
+
+	uint8_t sha1[20];
+	NF_sha1(body, body_size, sha1);
+	return findEntry(db, crc, body_size, sha1, &ambiguous);
+}
+
+struct NF_RomDBBuilder* NF_RomDB_createBuilder() {
+	struct NF_RomDBBuilder* builder = calloc(1, sizeof(struct NF_RomDBBuilder));
+	if (builder == NULL) { printf("Error: Could not create ROM database builder. Out of memory?\n"); }
+	return builder;
+}
+
+void NF_RomDB_freeBuilder(struct NF_RomDBBuilder* builder) {
+	if (builder == NULL) { return; }
+	free(builder->entries);
+	free(builder->buckets);
+	free(builder);
+}
+
+// Put every entry into a hash table of bucket_count buckets, which must be a power of two larger than the entry count
+static void fillBuckets(uint32_t* buckets, uint32_t bucket_count, const struct NF_RomDBEntry* entries, uint32_t count) {
+	uint32_t mask = bucket_count - 1;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t slot = entries[i].crc32 & mask;
+		while (buckets[slot] != 0) { slot = (slot + 1) & mask; }
+		buckets[slot] = i + 1;
+	}
+}
+
+bool NF_RomDB_addEntry(struct NF_RomDBBuilder* builder, const struct NF_RomDBEntry* entry) {
+	uint32_t mask = builder->bucket_count - 1;
+	for (uint32_t slot = entry->crc32 & mask; builder->bucket_count > 0 && builder->buckets[slot] != 0; slot = (slot + 1) & mask) {
+		struct NF_RomDBEntry* existing = &builder->entries[builder->buckets[slot] - 1];
+		if (existing->crc32 == entry->crc32 && existing->rom_size == entry->rom_size && memcmp(existing->sha1, entry->sha1, 20) == 0) {
+			*existing = *entry;
+			return true;
+		}
+	}
+
+	// Keep the table at most half full, rebuilding it twice as big when it gets there
+	if ((builder->count + 1) * 2 > builder->bucket_count) {
+		uint32_t bucket_count = builder->bucket_count ? builder->bucket_count * 2 : 512;
+		uint32_t* buckets = calloc(bucket_count, sizeof(uint32_t));
+		if (buckets == NULL) {
+			printf("Error: Could not grow ROM database. Out of memory?\n");
+			return false;
+		}
+		fillBuckets(buckets, bucket_count, builder->entries, builder->count);
+		free(builder->buckets);
+		builder->buckets = buckets;
+		builder->bucket_count = bucket_count;
+	}
+	if (builder->count == builder->capacity) {
+		uint32_t capacity = builder->capacity ? builder->capacity * 2 : 256;
+		struct NF_RomDBEntry* entries = realloc(builder->entries, capacity * sizeof(struct NF_RomDBEntry));
+		if (entries == NULL) {
+			printf("Error: Could not grow ROM database. Out of memory?\n");
+			return false;
+		}
+		builder->entries = entries;
+		builder->capacity = capacity;
+	}
+	builder->entries[builder->count] = *entry;
+	mask = builder->bucket_count - 1;
+	uint32_t slot = entry->crc32 & mask;
+	while (builder->buckets[slot] != 0) { slot = (slot + 1) & mask; }
+	builder->buckets[slot] = ++builder->count;
+	return true;
+}
+
+bool NF_RomDB_addRom(struct NF_RomDBBuilder* builder, const uint8_t* rom_data, size_t size, const uint8_t* corrected_header) {
+	if (size <= INES_HEADER_SIZE) {
+		printf("Error: The ROM is too small to be added to the database.\n");
+		return false;
+	}
+	struct NF_RomDBEntry entry;
+	entry.rom_size = (uint32_t)(size - INES_HEADER_SIZE);
+	entry.crc32 = NF_crc32(0, rom_data + INES_HEADER_SIZE, entry.rom_size);
+	NF_sha1(rom_data + INES_HEADER_SIZE, entry.rom_size, entry.sha1);
+	memcpy(entry.header, corrected_header != NULL ? corrected_header : rom_data, INES_HEADER_SIZE);
+	return NF_RomDB_addEntry(builder, &entry);
+}
+
+bool NF_RomDB_addCatalog(struct NF_RomDBBuilder* builder, const struct NF_RomCatalog* catalog, const char* root) {
+	for (uint32_t i = 0; i < NF_RomCatalog_count(catalog); i++) {
+		char path[2048];
+		snprintf(path, sizeof(path), "%s/%s", root, NF_RomCatalog_path(catalog, &catalog->entries[i]));
+		struct NF_FileInfo info;
+		if (!NF_getFileInfo(path, &info) || NF_RomCatalog_findFile(catalog, root, path, &info) == NULL) { continue; }
+
+		struct NF_RomDBEntry entry;
+		const struct NF_RomCatalogEntry* known = &catalog->entries[i];
+		entry.crc32 = known->crc32;
+		entry.rom_size = (uint32_t)(known->file_size - INES_HEADER_SIZE);
+		memcpy(entry.sha1, known->sha1, sizeof(entry.sha1));
+		FILE* file = fopen(path, "rb");
+		bool read = file != NULL && fread(entry.header, 1, INES_HEADER_SIZE, file) == INES_HEADER_SIZE;
+		if (file != NULL) { fclose(file); }
+		if (!read) {
+			printf("Error: Could not read the header of %s.\n", path);
+			continue;
+		}
+		if (!NF_RomDB_addEntry(builder, &entry)) { return false; }
+	}
+	return true;
+}
+
+bool NF_RomDB_addAll(struct NF_RomDBBuilder* builder, const struct NF_RomDB* db) {
+	for (uint32_t i = 0; i < db->file_header->entry_count; i++) {
+		if (!NF_RomDB_addEntry(builder, &db->entries[i])) { return false; }
+	}
+	return true;
+}
+
+bool NF_RomDB_write(const struct NF_RomDBBuilder* builder, const char* path) {
+	// Keep the table at most half full so that probe sequences stay short
+	struct NF_RomDBFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NF_ROMDB_MAGIC, sizeof(NF_ROMDB_MAGIC));
+	header.version = NF_ROMDB_VERSION;
+	header.entry_count = builder->count;
+	header.bucket_count = 16;
+	while (header.bucket_count < builder->count * 2) { header.bucket_count *= 2; }
+
+	uint32_t* buckets = calloc(header.bucket_count, sizeof(uint32_t));
+	if (buckets == NULL) {
+		printf("Error: Could not create ROM database hash table. Out of memory?\n");
+		return false;
+	}
+	fillBuckets(buckets, header.bucket_count, builder->entries, builder->count);
+
+	char tmp_path[1024];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	FILE* file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		printf("Error: Could not open %s for writing.\n", tmp_path);
+		free(buckets);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(buckets, sizeof(uint32_t), header.bucket_count, file) == header.bucket_count &&
+		(builder->count == 0 || fwrite(builder->entries, sizeof(struct NF_RomDBEntry), builder->count, file) == builder->count);
+	ok = (fclose(file) == 0) && ok;
+	free(buckets);
+
+	if (!ok || !NF_replaceFile(tmp_path, path)) {
+		printf("Error: Could not write ROM database %s.\n", path);
+		remove(tmp_path);
+		return false;
+	}
+	return true;
+}
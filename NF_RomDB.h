@@ -0,0 +1,85 @@
+#ifndef NF_H_ROMDB
+#define NF_H_ROMDB
+#include "NF_Platform.h"
+#include "NF_RomCatalog.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A ROM database maps the hash of a ROM's contents to a corrected NES 2.0 header. Many dumps in the wild have
+// missing or wrong headers (iNES headers with garbage in the padding, wrong mirroring, no PRG RAM size), so the
+// database is the source of truth for any ROM it knows about.
+//
+// The database is a single file that is mapped into memory as-is. Opening it only reads through the hash table, to
+// make sure that every bucket points at an entry and that every probe sequence ends. Layout (all values little endian):
+//
+// NF_RomDBFileHeader
+// uint32_t buckets[bucket_count]		Open addressing hash table keyed by CRC32. Holds entry index + 1, or 0 if empty.
+//										At least one bucket is always empty
+// NF_RomDBEntry entries[entry_count]
+
+#define NF_ROMDB_MAGIC "NFROMDB"
+#define NF_ROMDB_VERSION 1
+
+struct NF_RomDBFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t bucket_count;		// Always a power of two
+	uint32_t reserved;
+};
+
+struct NF_RomDBEntry {
+	uint32_t crc32;				// CRC32 of everything after the 16 byte header
+	uint32_t rom_size;			// Number of bytes after the 16 byte header
+	uint8_t sha1[20];			// SHA-1 of the same bytes, used to tell apart ROMs with colliding CRCs
+	uint8_t header[16];			// The corrected header
+};
+
+struct NF_RomDB {
+	struct NF_FileMapping mapping;
+	const struct NF_RomDBFileHeader* file_header;
+	const uint32_t* buckets;
+	const struct NF_RomDBEntry* entries;
+};
+
+// Map a database file. Returns NULL (and prints why) if it is missing or malformed
+struct NF_RomDB* NF_RomDB_open(const char* path);
+void NF_RomDB_close(struct NF_RomDB* db);
+
+// Find the entry for a ROM by its hashes. sha1 may be NULL, in which case it is only needed (and only computed
+// by NF_RomDB_lookupRom) when two entries share a CRC and size
+const struct NF_RomDBEntry* NF_RomDB_lookup(const struct NF_RomDB* db, uint32_t crc32, uint32_t rom_size, const uint8_t* sha1);
+
+// Hash a whole ROM file (header included, the header is skipped) and look it up
+const struct NF_RomDBEntry* NF_RomDB_lookupRom(const struct NF_RomDB* db, const uint8_t* rom_data, size_t size);
+
+// Databases are built in memory and then written out in one go
+struct NF_RomDBBuilder {
+	struct NF_RomDBEntry* entries;
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t* buckets;			// The same kind of table as in the file, for finding entries that are added again
+	uint32_t bucket_count;
+};
+
+struct NF_RomDBBuilder* NF_RomDB_createBuilder();
+void NF_RomDB_freeBuilder(struct NF_RomDBBuilder* builder);
+
+// Add (or replace) an entry
+bool NF_RomDB_addEntry(struct NF_RomDBBuilder* builder, const struct NF_RomDBEntry* entry);
+
+// Hash a ROM file and add it. If corrected_header is NULL, the header already in the file is stored
+bool NF_RomDB_addRom(struct NF_RomDBBuilder* builder, const uint8_t* rom_data, size_t size, const uint8_t* corrected_header);
+
+// Add every ROM of a catalog of the directory root, with the header in its file. The hashes come from the catalog, so
+// only the headers are read. ROMs that did not validate, or changed since the catalog was made, are skipped
+bool NF_RomDB_addCatalog(struct NF_RomDBBuilder* builder, const struct NF_RomCatalog* catalog, const char* root);
+
+// Copy every entry of an existing database into a builder, so that it can be extended
+bool NF_RomDB_addAll(struct NF_RomDBBuilder* builder, const struct NF_RomDB* db);
+
+// Write the database to a file. The file is replaced atomically, so readers never see a half written database
+bool NF_RomDB_write(const struct NF_RomDBBuilder* builder, const char* path);
+
+#endif
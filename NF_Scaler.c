@@ -0,0 +1,741 @@
+#include "NF_Scaler.h"
+#include "NF_Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NF_X86
+#include <immintrin.h>
+#endif
+
+#define SOURCE_STRIDE (NF_FRAME_WIDTH + NF_SCALER_BORDER * 2)
+#define SOURCE_LINES (NF_FRAME_HEIGHT + NF_SCALER_BORDER * 2)
+#define DOUBLED_WIDTH (NF_FRAME_WIDTH * 2)
+#define DOUBLED_HEIGHT (NF_FRAME_HEIGHT * 2)
+#define DOUBLED_STRIDE (DOUBLED_WIDTH + NF_SCALER_BORDER * 2)
+#define DOUBLED_LINES (DOUBLED_HEIGHT + NF_SCALER_BORDER * 2)
+
+// Corner rules. Each pixel gets a decision made of one byte per corner: the rule in bits 0-2, and in bits 3-4 which
+// neighbour's color the corner is blended towards
+#define RULE_NONE 0
+#define RULE_SOFT 1						// A lighter blend over the diagonal shape
+#define RULE_DIAGONAL 2
+#define RULE_SHALLOW 3					// The edge runs along the bottom (or top) of the pixel
+#define RULE_STEEP 4					// The edge runs along the side of the pixel
+#define RULE_BOTH 5
+#define RULE_MASK 0x07
+#define CHOICE_SHIFT 3
+#define CHOICE_HORIZONTAL 0				// The neighbour beside the corner
+#define CHOICE_VERTICAL 1				// The neighbour above or below the corner
+#define CHOICE_DIAGONAL 2				// The neighbour across the corner
+#define CHOICE_AVERAGE 3				// Halfway between the horizontal and vertical neighbours
+
+// Corners are numbered bottom right, bottom left, top right, top left. Everything is worked out for the bottom right
+// corner, and mirrored for the others: offsets to neighbours are multiplied by these
+#define CORNER_X(corner) (((corner) & 1) ? -1 : 1)
+#define CORNER_Y(corner) (((corner) & 2) ? -1 : 1)
+
+// Samples per side of an output pixel when measuring how much of it a rule's shape covers
+#define COVERAGE_SAMPLES 16
+#define WEIGHT_ONE 128
+
+// YUV bytes are Y, U, V and 0. The color distance of XBR weighs differences in them by these (as in xBR), and HQ
+// counts two colors as different when any difference is above these (as in hqx)
+#define YUV_WEIGHTS 0x00060730			// 48, 7, 6
+#define HQ_THRESHOLDS 0x00060730		// 48, 7, 6
+#define XBR_SAME_THRESHOLD 155			// Distances below this count as the same color
+
+// HQ looks up rules with 8 bits for the neighbours that differ from the pixel (in the order of NEIGHBOUR_X and
+// NEIGHBOUR_Y), and for each corner, 1 bit for whether its horizontal and vertical neighbours differ from each other
+#define HQ_PAIR_SHIFT 8
+#define HQ_KEYS (1 << 12)
+static const int NEIGHBOUR_X[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int NEIGHBOUR_Y[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+static const char* SCALER_NAMES[NF_SCALER_TYPES] = { "scale", "hq", "xbr" };
+
+const char* NF_Scaler_name(NF_SCALER_TYPE type) { return (type >= 0 && type < NF_SCALER_TYPES) ? SCALER_NAMES[type] : "unknown"; }
+
+static bool useAVX2() {
+	static int avx2 = -1;
+#ifdef NF_X86
+	if (avx2 < 0) { avx2 = NF_cpuHasFeature(NF_CPU_AVX2); }
+#else
+	avx2 = 0;
+#endif
+	return avx2 != 0;
+}
+
+static uint32_t toYUV(uint32_t argb) {
+	int r = (argb >> 16) & 0xFF;
+	int g = (argb >> 8) & 0xFF;
+	int b = argb & 0xFF;
+	int yuv[3] = { (299 * r + 587 * g + 114 * b) / 1000, 128 + (-169 * r - 331 * g + 500 * b) / 1000, 128 + (500 * r - 419 * g - 81 * b) / 1000 };
+	uint32_t packed = 0;
+	for (int c = 0; c < 3; c++) {
+		if (yuv[c] < 0) { yuv[c] = 0; }
+		if (yuv[c] > 255) { yuv[c] = 255; }
+		packed |= (uint32_t)yuv[c] << (c * 8);
+	}
+	return packed;
+}
+
+static int yuvDifference(uint32_t a, uint32_t b, int channel) {
+	int difference = (int)((a >> (channel * 8)) & 0xFF) - (int)((b >> (channel * 8)) & 0xFF);
+	return difference < 0 ? -difference : difference;
+}
+
+static int xbrDistance(uint32_t a, uint32_t b) {
+	int distance = 0;
+	for (int c = 0; c < 3; c++) { distance += yuvDifference(a, b, c) * (int)((YUV_WEIGHTS >> (c * 8)) & 0xFF); }
+	return distance;
+}
+
+static bool hqDiffers(uint32_t a, uint32_t b) {
+	for (int c = 0; c < 3; c++) {
+		if (yuvDifference(a, b, c) > (int)((HQ_THRESHOLDS >> (c * 8)) & 0xFF)) { return true; }
+	}
+	return false;
+}
+
+// Whether a point of a pixel, from (0, 0) at the top left to (1, 1) at the bottom right, is inside the shape the
+// bottom right corner is blended over
+static bool insideRule(int rule, double u, double v) {
+	bool shallow = v >= 1.0 - u / 2;
+	bool steep = u >= 1.0 - v / 2;
+	switch (rule) {
+	case RULE_SOFT:
+	case RULE_DIAGONAL: return u + v >= 1.5;
+	case RULE_SHALLOW: return shallow;
+	case RULE_STEEP: return steep;
+	case RULE_BOTH: return shallow || steep;
+	default: return false;
+	}
+}
+
+// Work out how much of each output pixel every rule's shape covers, at every corner
+static void buildWeights(struct NF_Scaler* scaler) {
+	memset(scaler->weights, 0, sizeof(scaler->weights));
+	int factor = scaler->factor;
+	for (int rule = RULE_SOFT; rule < NF_SCALER_RULES; rule++) {
+		for (int corner = 0; corner < 4; corner++) {
+			for (int line = 0; line < factor; line++) {
+				for (int pixel = 0; pixel < factor; pixel++) {
+					int inside = 0;
+					for (int sy = 0; sy < COVERAGE_SAMPLES; sy++) {
+						for (int sx = 0; sx < COVERAGE_SAMPLES; sx++) {
+							double u = (pixel + (sx + 0.5) / COVERAGE_SAMPLES) / factor;
+							double v = (line + (sy + 0.5) / COVERAGE_SAMPLES) / factor;
+							if (CORNER_X(corner) < 0) { u = 1.0 - u; }
+							if (CORNER_Y(corner) < 0) { v = 1.0 - v; }
+							if (insideRule(rule, u, v)) { inside++; }
+						}
+					}
+					int samples = COVERAGE_SAMPLES * COVERAGE_SAMPLES;
+					int weight = (inside * WEIGHT_ONE + samples / 2) / samples;
+					if (rule == RULE_SOFT) { weight /= 2; }
+					for (int c = 0; c < 4; c++) { scaler->weights[rule][corner][line * 4 + pixel][c] = (int16_t)weight; }
+				}
+			}
+		}
+	}
+}
+
+static int neighbourBit(int dx, int dy) {
+	for (int n = 0; n < 8; n++) {
+		if (NEIGHBOUR_X[n] == dx && NEIGHBOUR_Y[n] == dy) { return n; }
+	}
+	return 0;
+}
+
+// The rule for one corner of an HQ pixel. When the horizontal and vertical neighbours both differ from the pixel but
+// not from each other, the corner is on an edge and is rounded off towards them, following the edge along the side
+// or the bottom if it carries on that way. Where the pixel carries on across the corner, it is a thin line, and only
+// rounded a little. A corner where only the diagonal neighbour differs is blended towards it a little
+static uint32_t hqCornerRule(uint32_t key, int corner) {
+	int mx = CORNER_X(corner);
+	int my = CORNER_Y(corner);
+	bool horizontal = (key >> neighbourBit(mx, 0)) & 1;
+	bool vertical = (key >> neighbourBit(0, my)) & 1;
+	bool diagonal = (key >> neighbourBit(mx, my)) & 1;
+	bool before = (key >> neighbourBit(-mx, my)) & 1;
+	bool above = (key >> neighbourBit(mx, -my)) & 1;
+	bool pair_differs = (key >> (HQ_PAIR_SHIFT + corner)) & 1;
+
+	if (horizontal && vertical && !pair_differs) {
+		uint32_t rule = RULE_DIAGONAL;
+		if (!diagonal) { rule = RULE_SOFT; }
+		else if (before && !above) { rule = RULE_SHALLOW; }
+		else if (above && !before) { rule = RULE_STEEP; }
+		return rule | (CHOICE_AVERAGE << CHOICE_SHIFT);
+	}
+	if (diagonal && !horizontal && !vertical) { return RULE_SOFT | (CHOICE_DIAGONAL << CHOICE_SHIFT); }
+	return RULE_NONE;
+}
+
+struct NF_Scaler* NF_Scaler_create(NF_SCALER_TYPE type, int factor, const uint32_t* colors, int threads) {
+	if (type < 0 || type >= NF_SCALER_TYPES || factor < NF_SCALER_MIN_FACTOR || factor > NF_SCALER_MAX_FACTOR) {
+		printf("Error: There is no %s%dx scaler.\n", NF_Scaler_name(type), factor);
+		return NULL;
+	}
+	struct NF_Scaler* scaler = calloc(1, sizeof(struct NF_Scaler));
+	if (scaler == NULL) {
+		printf("Error: Could not create scaler. Out of memory?\n");
+		return NULL;
+	}
+	scaler->type = type;
+	scaler->factor = factor;
+	scaler->source = malloc((size_t)SOURCE_STRIDE * SOURCE_LINES * sizeof(uint16_t));
+	bool ok = scaler->source != NULL;
+	if (type == NF_SCALER_SCALE && factor == 4) {
+		scaler->doubled = malloc((size_t)DOUBLED_STRIDE * DOUBLED_LINES * sizeof(uint16_t));
+		ok = ok && scaler->doubled != NULL;
+	}
+	if (type != NF_SCALER_SCALE) {
+		scaler->source_yuv = malloc((size_t)SOURCE_STRIDE * SOURCE_LINES * sizeof(uint32_t));
+		ok = ok && scaler->source_yuv != NULL;
+	}
+	if (type == NF_SCALER_HQ) {
+		scaler->hq_rules = malloc(HQ_KEYS * sizeof(uint32_t));
+		ok = ok && scaler->hq_rules != NULL;
+	}
+	if (!ok) {
+		printf("Error: Could not create scaler. Out of memory?\n");
+		NF_Scaler_free(scaler);
+		return NULL;
+	}
+
+	for (int color = 0; color < NF_SCALER_COLORS; color++) {
+		scaler->colors[color] = colors[color];
+		scaler->yuv[color] = toYUV(colors[color]);
+	}
+	if (scaler->hq_rules != NULL) {
+		for (uint32_t key = 0; key < HQ_KEYS; key++) {
+			uint32_t decision = 0;
+			for (int corner = 0; corner < 4; corner++) { decision |= hqCornerRule(key, corner) << (corner * 8); }
+			scaler->hq_rules[key] = decision;
+		}
+	}
+	buildWeights(scaler);
+
+	// The calling thread takes a band too
+	if (threads <= 0) { threads = NF_getProcessorCount(); }
+	scaler->pool = (threads > 1) ? NF_createThreadPool(threads - 1) : NULL;
+	scaler->bands = (scaler->pool != NULL) ? scaler->pool->thread_count + 1 : 1;
+	return scaler;
+}
+
+void NF_Scaler_free(struct NF_Scaler* scaler) {
+	if (scaler == NULL) { return; }
+	NF_freeThreadPool(scaler->pool);
+	free(scaler->hq_rules);
+	free(scaler->source);
+	free(scaler->source_yuv);
+	free(scaler->doubled);
+	free(scaler);
+}
+
+// Repeat the first and last pixels of a line into its border
+static void fillLineBorder(uint16_t* line, int width) {
+	for (int b = 1; b <= NF_SCALER_BORDER; b++) {
+		line[-b] = line[0];
+		line[width - 1 + b] = line[width - 1];
+	}
+}
+
+// Repeat the first and last lines of a buffer (borders included) into the border above and below
+static void fillTopBorder(void* first, size_t line_bytes, ptrdiff_t stride_bytes) {
+	for (int b = 1; b <= NF_SCALER_BORDER; b++) { memcpy((uint8_t*)first - b * stride_bytes, first, line_bytes); }
+}
+
+static void fillBottomBorder(void* last, size_t line_bytes, ptrdiff_t stride_bytes) {
+	for (int b = 1; b <= NF_SCALER_BORDER; b++) { memcpy((uint8_t*)last + b * stride_bytes, last, line_bytes); }
+}
+
+static int bandStart(const struct NF_Scaler* scaler, int band, int lines) { return band * lines / scaler->bands; }
+
+static uint16_t* sourceLine(const struct NF_Scaler* scaler, int y) { return scaler->source + (size_t)(y + NF_SCALER_BORDER) * SOURCE_STRIDE + NF_SCALER_BORDER; }
+static uint32_t* yuvLine(const struct NF_Scaler* scaler, int y) { return scaler->source_yuv + (size_t)(y + NF_SCALER_BORDER) * SOURCE_STRIDE + NF_SCALER_BORDER; }
+static uint16_t* doubledLine(const struct NF_Scaler* scaler, int y) { return scaler->doubled + (size_t)(y + NF_SCALER_BORDER) * DOUBLED_STRIDE + NF_SCALER_BORDER; }
+static uint32_t* outputLine(const struct NF_Scaler* scaler, int y) { return (uint32_t*)((uint8_t*)scaler->output + (size_t)y * scaler->pitch); }
+
+// Copy a band of the frame into the bordered buffers
+static void prepareBand(void* context, int band) {
+	struct NF_Scaler* scaler = (struct NF_Scaler*)context;
+	int first = bandStart(scaler, band, NF_FRAME_HEIGHT);
+	int last = bandStart(scaler, band + 1, NF_FRAME_HEIGHT);
+	for (int y = first; y < last; y++) {
+		uint16_t* line = sourceLine(scaler, y);
+		for (int x = 0; x < NF_FRAME_WIDTH; x++) { line[x] = scaler->frame->pixels[y][x] & (NF_SCALER_COLORS - 1); }
+		fillLineBorder(line, NF_FRAME_WIDTH);
+		if (scaler->source_yuv != NULL) {
+			uint32_t* yuv = yuvLine(scaler, y);
+			for (int x = -NF_SCALER_BORDER; x < NF_FRAME_WIDTH + NF_SCALER_BORDER; x++) { yuv[x] = scaler->yuv[line[x]]; }
+		}
+	}
+	if (first == 0) {
+		fillTopBorder(sourceLine(scaler, 0) - NF_SCALER_BORDER, SOURCE_STRIDE * sizeof(uint16_t), SOURCE_STRIDE * sizeof(uint16_t));
+		if (scaler->source_yuv != NULL) { fillTopBorder(yuvLine(scaler, 0) - NF_SCALER_BORDER, SOURCE_STRIDE * sizeof(uint32_t), SOURCE_STRIDE * sizeof(uint32_t)); }
+	}
+	if (last == NF_FRAME_HEIGHT) {
+		fillBottomBorder(sourceLine(scaler, NF_FRAME_HEIGHT - 1) - NF_SCALER_BORDER, SOURCE_STRIDE * sizeof(uint16_t), SOURCE_STRIDE * sizeof(uint16_t));
+		if (scaler->source_yuv != NULL) { fillBottomBorder(yuvLine(scaler, NF_FRAME_HEIGHT - 1) - NF_SCALER_BORDER, SOURCE_STRIDE * sizeof(uint32_t), SOURCE_STRIDE * sizeof(uint32_t)); }
+	}
+}
+
+// Scale2x and Scale3x. Where the neighbours above and below differ, and so do the ones either side, a corner takes
+// the color of the two neighbours next to it if they are the same. Scale3x fills the middle of each side from the
+// corners on either side of it, unless that would cut into a diagonal line
+static void scale2LineScalar(const uint16_t* line, ptrdiff_t stride, int width, uint16_t* out0, uint16_t* out1) {
+	for (int x = 0; x < width; x++) {
+		const uint16_t* p = line + x;
+		uint16_t B = p[-stride], D = p[-1], E = p[0], F = p[1], H = p[stride];
+		bool corners = B != H && D != F;
+		out0[x * 2] = (corners && D == B) ? D : E;
+		out0[x * 2 + 1] = (corners && B == F) ? F : E;
+		out1[x * 2] = (corners && D == H) ? D : E;
+		out1[x * 2 + 1] = (corners && H == F) ? F : E;
+	}
+}
+
+static void scale3LineScalar(const uint16_t* line, ptrdiff_t stride, int width, uint16_t* out0, uint16_t* out1, uint16_t* out2) {
+	for (int x = 0; x < width; x++) {
+		const uint16_t* p = line + x;
+		uint16_t A = p[-stride - 1], B = p[-stride], C = p[-stride + 1];
+		uint16_t D = p[-1], E = p[0], F = p[1];
+		uint16_t G = p[stride - 1], H = p[stride], I = p[stride + 1];
+		bool corners = B != H && D != F;
+		out0[x * 3] = (corners && D == B) ? D : E;
+		out0[x * 3 + 1] = (corners && ((D == B && E != C) || (B == F && E != A))) ? B : E;
+		out0[x * 3 + 2] = (corners && B == F) ? F : E;
+		out1[x * 3] = (corners && ((D == B && E != G) || (D == H && E != A))) ? D : E;
+		out1[x * 3 + 1] = E;
+		out1[x * 3 + 2] = (corners && ((B == F && E != I) || (H == F && E != C))) ? F : E;
+		out2[x * 3] = (corners && D == H) ? D : E;
+		out2[x * 3 + 1] = (corners && ((D == H && E != I) || (H == F && E != G))) ? H : E;
+		out2[x * 3 + 2] = (corners && H == F) ? F : E;
+	}
+}
+
+static void lookupColorsScalar(const uint32_t* colors, const uint16_t* pixels, int count, uint32_t* out) {
+	for (int x = 0; x < count; x++) { out[x] = colors[pixels[x]]; }
+}
+
+// The XBR rule for the bottom right corner of the pixel p points at, mirrored by mx and my. The corner is on an edge
+// when the colors change less along the diagonal through its neighbours than along the one through the pixel, and
+// the other neighbours do not make it a checkerboard or a single pixel. How the colors change next to the edge then
+// says whether it is shallow or steep. The corner takes the color of whichever neighbour is closer to the pixel
+static uint32_t xbrCornerRule(const uint32_t* p, ptrdiff_t stride, int mx, int my) {
+#define AT(dx, dy) p[(dy) * my * stride + (dx) * mx]
+	uint32_t E = AT(0, 0), F = AT(1, 0), H = AT(0, 1), I = AT(1, 1), B = AT(0, -1), D = AT(-1, 0), C = AT(1, -1), G = AT(-1, 1);
+	uint32_t F4 = AT(2, 0), H5 = AT(0, 2), I4 = AT(2, 1), I5 = AT(1, 2);
+#undef AT
+	if (E == F || E == H) { return RULE_NONE; }
+	int e = xbrDistance(E, C) + xbrDistance(E, G) + xbrDistance(I, F4) + xbrDistance(I, H5) + 4 * xbrDistance(H, F);
+	int i = xbrDistance(H, D) + xbrDistance(H, I5) + xbrDistance(F, I4) + xbrDistance(F, B) + 4 * xbrDistance(E, I);
+#define SAME(a, b) (xbrDistance(a, b) < XBR_SAME_THRESHOLD)
+	bool edge = e < i && ((!SAME(F, B) && !SAME(H, D)) || (SAME(E, I) && !SAME(F, I4) && !SAME(H, I5)) || SAME(E, G) || SAME(E, C));
+#undef SAME
+	uint32_t rule;
+	if (edge) {
+		int ke = xbrDistance(F, G);
+		int ki = xbrDistance(H, C);
+		bool shallow = 2 * ke <= ki && E != G && D != G;
+		bool steep = ke >= 2 * ki && E != C && B != C;
+		rule = RULE_DIAGONAL + (shallow ? 1 : 0) + (steep ? 2 : 0);
+	}
+	else if (e <= i) { rule = RULE_SOFT; }
+	else { return RULE_NONE; }
+	uint32_t choice = (xbrDistance(E, F) <= xbrDistance(E, H)) ? CHOICE_HORIZONTAL : CHOICE_VERTICAL;
+	return rule | (choice << CHOICE_SHIFT);
+}
+
+static void xbrDecisionsScalar(const uint32_t* line, uint32_t* decisions) {
+	for (int x = 0; x < NF_FRAME_WIDTH; x++) {
+		uint32_t decision = 0;
+		for (int corner = 0; corner < 4; corner++) { decision |= xbrCornerRule(line + x, SOURCE_STRIDE, CORNER_X(corner), CORNER_Y(corner)) << (corner * 8); }
+		decisions[x] = decision;
+	}
+}
+
+static void hqDecisionsScalar(const uint32_t* rules, const uint32_t* line, uint32_t* decisions) {
+	for (int x = 0; x < NF_FRAME_WIDTH; x++) {
+		const uint32_t* p = line + x;
+		uint32_t key = 0;
+		for (int n = 0; n < 8; n++) {
+			if (hqDiffers(p[0], p[NEIGHBOUR_Y[n] * SOURCE_STRIDE + NEIGHBOUR_X[n]])) { key |= 1u << n; }
+		}
+		for (int corner = 0; corner < 4; corner++) {
+			if (hqDiffers(p[CORNER_X(corner)], p[CORNER_Y(corner) * SOURCE_STRIDE])) { key |= 1u << (HQ_PAIR_SHIFT + corner); }
+		}
+		decisions[x] = rules[key];
+	}
+}
+
+#ifdef NF_X86
+
+NF_TARGET("avx2")
+static void scale2LineAVX2(const uint16_t* line, ptrdiff_t stride, int width, uint16_t* out0, uint16_t* out1) {
+	for (int x = 0; x < width; x += 16) {
+		const uint16_t* p = line + x;
+		__m256i B = _mm256_loadu_si256((const __m256i*)(p - stride));
+		__m256i D = _mm256_loadu_si256((const __m256i*)(p - 1));
+		__m256i E = _mm256_loadu_si256((const __m256i*)p);
+		__m256i F = _mm256_loadu_si256((const __m256i*)(p + 1));
+		__m256i H = _mm256_loadu_si256((const __m256i*)(p + stride));
+		__m256i corners = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi16(B, H), _mm256_cmpeq_epi16(D, F)), _mm256_set1_epi16(-1));
+		__m256i e0 = _mm256_blendv_epi8(E, D, _mm256_and_si256(corners, _mm256_cmpeq_epi16(D, B)));
+		__m256i e1 = _mm256_blendv_epi8(E, F, _mm256_and_si256(corners, _mm256_cmpeq_epi16(B, F)));
+		__m256i e2 = _mm256_blendv_epi8(E, D, _mm256_and_si256(corners, _mm256_cmpeq_epi16(D, H)));
+		__m256i e3 = _mm256_blendv_epi8(E, F, _mm256_and_si256(corners, _mm256_cmpeq_epi16(H, F)));
+
+		// Interleaving works within each half of the registers, so the halves are put back in order afterwards
+		__m256i low = _mm256_unpacklo_epi16(e0, e1);
+		__m256i high = _mm256_unpackhi_epi16(e0, e1);
+		_mm256_storeu_si256((__m256i*)(out0 + x * 2), _mm256_permute2x128_si256(low, high, 0x20));
+		_mm256_storeu_si256((__m256i*)(out0 + x * 2 + 16), _mm256_permute2x128_si256(low, high, 0x31));
+		low = _mm256_unpacklo_epi16(e2, e3);
+		high = _mm256_unpackhi_epi16(e2, e3);
+		_mm256_storeu_si256((__m256i*)(out1 + x * 2), _mm256_permute2x128_si256(low, high, 0x20));
+		_mm256_storeu_si256((__m256i*)(out1 + x * 2 + 16), _mm256_permute2x128_si256(low, high, 0x31));
+	}
+}
+
+// The 9 output pixels are worked out for 16 pixels at once, then interleaved one by one
+NF_TARGET("avx2")
+static void scale3LineAVX2(const uint16_t* line, ptrdiff_t stride, int width, uint16_t* out0, uint16_t* out1, uint16_t* out2) {
+	uint16_t results[9][16];
+	for (int x = 0; x < width; x += 16) {
+		const uint16_t* p = line + x;
+		__m256i A = _mm256_loadu_si256((const __m256i*)(p - stride - 1));
+		__m256i B = _mm256_loadu_si256((const __m256i*)(p - stride));
+		__m256i C = _mm256_loadu_si256((const __m256i*)(p - stride + 1));
+		__m256i D = _mm256_loadu_si256((const __m256i*)(p - 1));
+		__m256i E = _mm256_loadu_si256((const __m256i*)p);
+		__m256i F = _mm256_loadu_si256((const __m256i*)(p + 1));
+		__m256i G = _mm256_loadu_si256((const __m256i*)(p + stride - 1));
+		__m256i H = _mm256_loadu_si256((const __m256i*)(p + stride));
+		__m256i I = _mm256_loadu_si256((const __m256i*)(p + stride + 1));
+		__m256i corners = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi16(B, H), _mm256_cmpeq_epi16(D, F)), _mm256_set1_epi16(-1));
+		__m256i db = _mm256_and_si256(corners, _mm256_cmpeq_epi16(D, B));
+		__m256i bf = _mm256_and_si256(corners, _mm256_cmpeq_epi16(B, F));
+		__m256i dh = _mm256_and_si256(corners, _mm256_cmpeq_epi16(D, H));
+		__m256i hf = _mm256_and_si256(corners, _mm256_cmpeq_epi16(H, F));
+		__m256i ea = _mm256_cmpeq_epi16(E, A);
+		__m256i ec = _mm256_cmpeq_epi16(E, C);
+		__m256i eg = _mm256_cmpeq_epi16(E, G);
+		__m256i ei = _mm256_cmpeq_epi16(E, I);
+
+		__m256i out[9];
+		out[0] = _mm256_blendv_epi8(E, D, db);
+		out[1] = _mm256_blendv_epi8(E, B, _mm256_or_si256(_mm256_andnot_si256(ec, db), _mm256_andnot_si256(ea, bf)));
+		out[2] = _mm256_blendv_epi8(E, F, bf);
+		out[3] = _mm256_blendv_epi8(E, D, _mm256_or_si256(_mm256_andnot_si256(eg, db), _mm256_andnot_si256(ea, dh)));
+		out[4] = E;
+		out[5] = _mm256_blendv_epi8(E, F, _mm256_or_si256(_mm256_andnot_si256(ei, bf), _mm256_andnot_si256(ec, hf)));
+		out[6] = _mm256_blendv_epi8(E, D, dh);
+		out[7] = _mm256_blendv_epi8(E, H, _mm256_or_si256(_mm256_andnot_si256(ei, dh), _mm256_andnot_si256(eg, hf)));
+		out[8] = _mm256_blendv_epi8(E, F, hf);
+		for (int r = 0; r < 9; r++) { _mm256_storeu_si256((__m256i*)results[r], out[r]); }
+
+		uint16_t* row0 = out0 + x * 3;
+		uint16_t* row1 = out1 + x * 3;
+		uint16_t* row2 = out2 + x * 3;
+		for (int i = 0; i < 16; i++) {
+			row0[i * 3] = results[0][i];
+			row0[i * 3 + 1] = results[1][i];
+			row0[i * 3 + 2] = results[2][i];
+			row1[i * 3] = results[3][i];
+			row1[i * 3 + 1] = results[4][i];
+			row1[i * 3 + 2] = results[5][i];
+			row2[i * 3] = results[6][i];
+			row2[i * 3 + 1] = results[7][i];
+			row2[i * 3 + 2] = results[8][i];
+		}
+	}
+}
+
+NF_TARGET("avx2")
+static void lookupColorsAVX2(const uint32_t* colors, const uint16_t* pixels, int count, uint32_t* out) {
+	for (int x = 0; x < count; x += 8) {
+		__m256i indices = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pixels + x)));
+		_mm256_storeu_si256((__m256i*)(out + x), _mm256_i32gather_epi32((const int*)colors, indices, 4));
+	}
+}
+
+NF_TARGET("avx2")
+static __m256i absoluteDifference(__m256i a, __m256i b) { return _mm256_sub_epi8(_mm256_max_epu8(a, b), _mm256_min_epu8(a, b)); }
+
+// The XBR color distance of 8 pairs of pixels: the weighted differences of the bytes, added up within each pixel
+NF_TARGET("avx2")
+static __m256i xbrDistanceAVX2(__m256i a, __m256i b) {
+	__m256i pairs = _mm256_maddubs_epi16(absoluteDifference(a, b), _mm256_set1_epi32(YUV_WEIGHTS));
+	return _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+}
+
+// xbrCornerRule for 8 pixels at once
+NF_TARGET("avx2")
+static __m256i xbrCornerRuleAVX2(const uint32_t* p, ptrdiff_t stride, int mx, int my) {
+#define AT(dx, dy) _mm256_loadu_si256((const __m256i*)(p + (dy) * my * stride + (dx) * mx))
+	__m256i E = AT(0, 0), F = AT(1, 0), H = AT(0, 1), I = AT(1, 1), B = AT(0, -1), D = AT(-1, 0), C = AT(1, -1), G = AT(-1, 1);
+	__m256i F4 = AT(2, 0), H5 = AT(0, 2), I4 = AT(2, 1), I5 = AT(1, 2);
+#undef AT
+	const __m256i all = _mm256_set1_epi32(-1);
+	const __m256i same_threshold = _mm256_set1_epi32(XBR_SAME_THRESHOLD);
+#define SAME(a, b) _mm256_cmpgt_epi32(same_threshold, xbrDistanceAVX2(a, b))
+#define NOT(a) _mm256_xor_si256(a, all)
+	__m256i differs = NOT(_mm256_or_si256(_mm256_cmpeq_epi32(E, F), _mm256_cmpeq_epi32(E, H)));
+	__m256i e = _mm256_add_epi32(_mm256_add_epi32(xbrDistanceAVX2(E, C), xbrDistanceAVX2(E, G)), _mm256_add_epi32(xbrDistanceAVX2(I, F4), xbrDistanceAVX2(I, H5)));
+	e = _mm256_add_epi32(e, _mm256_slli_epi32(xbrDistanceAVX2(H, F), 2));
+	__m256i i = _mm256_add_epi32(_mm256_add_epi32(xbrDistanceAVX2(H, D), xbrDistanceAVX2(H, I5)), _mm256_add_epi32(xbrDistanceAVX2(F, I4), xbrDistanceAVX2(F, B)));
+	i = _mm256_add_epi32(i, _mm256_slli_epi32(xbrDistanceAVX2(E, I), 2));
+
+	__m256i condition = _mm256_andnot_si256(SAME(F, B), NOT(SAME(H, D)));
+	condition = _mm256_or_si256(condition, _mm256_andnot_si256(_mm256_or_si256(SAME(F, I4), SAME(H, I5)), SAME(E, I)));
+	condition = _mm256_or_si256(condition, _mm256_or_si256(SAME(E, G), SAME(E, C)));
+	__m256i edge = _mm256_and_si256(_mm256_and_si256(differs, _mm256_cmpgt_epi32(i, e)), condition);
+	__m256i soft = _mm256_andnot_si256(_mm256_or_si256(edge, _mm256_cmpgt_epi32(e, i)), differs);
+#undef SAME
+
+	__m256i ke = xbrDistanceAVX2(F, G);
+	__m256i ki = xbrDistanceAVX2(H, C);
+	__m256i shallow = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(_mm256_slli_epi32(ke, 1), ki), _mm256_or_si256(_mm256_cmpeq_epi32(E, G), _mm256_cmpeq_epi32(D, G))), all);
+	__m256i steep = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(_mm256_slli_epi32(ki, 1), ke), _mm256_or_si256(_mm256_cmpeq_epi32(E, C), _mm256_cmpeq_epi32(B, C))), all);
+#undef NOT
+	__m256i edge_rule = _mm256_add_epi32(_mm256_set1_epi32(RULE_DIAGONAL), _mm256_add_epi32(_mm256_and_si256(shallow, _mm256_set1_epi32(1)), _mm256_and_si256(steep, _mm256_set1_epi32(2))));
+	__m256i rule = _mm256_or_si256(_mm256_and_si256(edge, edge_rule), _mm256_and_si256(soft, _mm256_set1_epi32(RULE_SOFT)));
+	__m256i vertical = _mm256_cmpgt_epi32(xbrDistanceAVX2(E, F), xbrDistanceAVX2(E, H));
+	__m256i choice = _mm256_and_si256(_mm256_and_si256(vertical, _mm256_or_si256(edge, soft)), _mm256_set1_epi32(CHOICE_VERTICAL << CHOICE_SHIFT));
+	return _mm256_or_si256(rule, choice);
+}
+
+NF_TARGET("avx2")
+static void xbrDecisionsAVX2(const uint32_t* line, uint32_t* decisions) {
+	for (int x = 0; x < NF_FRAME_WIDTH; x += 8) {
+		__m256i decision = _mm256_setzero_si256();
+		for (int corner = 0; corner < 4; corner++) {
+			__m256i rule = xbrCornerRuleAVX2(line + x, SOURCE_STRIDE, CORNER_X(corner), CORNER_Y(corner));
+			decision = _mm256_or_si256(decision, _mm256_sllv_epi32(rule, _mm256_set1_epi32(corner * 8)));
+		}
+		_mm256_storeu_si256((__m256i*)(decisions + x), decision);
+	}
+}
+
+NF_TARGET("avx2")
+static __m256i hqDiffersAVX2(__m256i a, __m256i b) {
+	__m256i over = _mm256_subs_epu8(absoluteDifference(a, b), _mm256_set1_epi32(HQ_THRESHOLDS));
+	return _mm256_xor_si256(_mm256_cmpeq_epi32(over, _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+}
+
+// The rule table key of 8 pixels at once, with one bit per comparison
+NF_TARGET("avx2")
+static void hqDecisionsAVX2(const uint32_t* rules, const uint32_t* line, uint32_t* decisions) {
+	uint32_t keys[8];
+	for (int x = 0; x < NF_FRAME_WIDTH; x += 8) {
+		const uint32_t* p = line + x;
+		__m256i E = _mm256_loadu_si256((const __m256i*)p);
+		__m256i key = _mm256_setzero_si256();
+		for (int n = 0; n < 8; n++) {
+			__m256i neighbour = _mm256_loadu_si256((const __m256i*)(p + NEIGHBOUR_Y[n] * SOURCE_STRIDE + NEIGHBOUR_X[n]));
+			key = _mm256_or_si256(key, _mm256_and_si256(hqDiffersAVX2(E, neighbour), _mm256_set1_epi32(1 << n)));
+		}
+		for (int corner = 0; corner < 4; corner++) {
+			__m256i horizontal = _mm256_loadu_si256((const __m256i*)(p + CORNER_X(corner)));
+			__m256i vertical = _mm256_loadu_si256((const __m256i*)(p + CORNER_Y(corner) * SOURCE_STRIDE));
+			key = _mm256_or_si256(key, _mm256_and_si256(hqDiffersAVX2(horizontal, vertical), _mm256_set1_epi32(1 << (HQ_PAIR_SHIFT + corner))));
+		}
+		_mm256_storeu_si256((__m256i*)keys, key);
+		for (int i = 0; i < 8; i++) { decisions[x + i] = rules[keys[i]]; }
+	}
+}
+
+// Blend each pixel of a block towards color by its weight, 4 channels of 2 pixels at a time
+static void blendBlock(uint32_t* block, int factor, uint32_t color, const int16_t (*weights)[4]) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i target = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+	for (int line = 0; line < factor; line++) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(block + line * 4));
+		__m128i low = _mm_unpacklo_epi8(pixels, zero);
+		__m128i high = _mm_unpackhi_epi8(pixels, zero);
+		__m128i low_weights = _mm_loadu_si128((const __m128i*)weights[line * 4]);
+		__m128i high_weights = _mm_loadu_si128((const __m128i*)weights[line * 4 + 2]);
+		low = _mm_add_epi16(low, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(target, low), low_weights), 7));
+		high = _mm_add_epi16(high, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(target, high), high_weights), 7));
+		_mm_storeu_si128((__m128i*)(block + line * 4), _mm_packus_epi16(low, high));
+	}
+}
+
+#else
+
+static void blendBlock(uint32_t* block, int factor, uint32_t color, const int16_t (*weights)[4]) {
+	for (int line = 0; line < factor; line++) {
+		for (int pixel = 0; pixel < 4; pixel++) {
+			uint32_t* out = block + line * 4 + pixel;
+			uint32_t blended = 0;
+			for (int c = 0; c < 4; c++) {
+				int from = (*out >> (c * 8)) & 0xFF;
+				int to = (color >> (c * 8)) & 0xFF;
+				blended |= (uint32_t)(from + (((to - from) * weights[line * 4 + pixel][c]) >> 7)) << (c * 8);
+			}
+			*out = blended;
+		}
+	}
+}
+
+#endif
+
+static void scale2Line(const uint16_t* line, ptrdiff_t stride, int width, uint16_t* out0, uint16_t* out1) {
+#ifdef NF_X86
+	if (useAVX2()) {
+		scale2LineAVX2(line, stride, width, out0, out1);
+		return;
+	}
+#endif
+	scale2LineScalar(line, stride, width, out0, out1);
+}
+
+static void scale3Line(const uint16_t* line, ptrdiff_t stride, int width, uint16_t* out0, uint16_t* out1, uint16_t* out2) {
+#ifdef NF_X86
+	if (useAVX2()) {
+		scale3LineAVX2(line, stride, width, out0, out1, out2);
+		return;
+	}
+#endif
+	scale3LineScalar(line, stride, width, out0, out1, out2);
+}
+
+static void lookupColors(const uint32_t* colors, const uint16_t* pixels, int count, uint32_t* out) {
+#ifdef NF_X86
+	if (useAVX2()) {
+		lookupColorsAVX2(colors, pixels, count, out);
+		return;
+	}
+#endif
+	lookupColorsScalar(colors, pixels, count, out);
+}
+
+// The neighbour a corner is blended towards
+static uint32_t cornerColor(const struct NF_Scaler* scaler, const uint16_t* p, int corner, uint32_t choice) {
+	uint32_t horizontal = scaler->colors[p[CORNER_X(corner)]];
+	uint32_t vertical = scaler->colors[p[CORNER_Y(corner) * SOURCE_STRIDE]];
+	switch (choice) {
+	case CHOICE_HORIZONTAL: return horizontal;
+	case CHOICE_VERTICAL: return vertical;
+	case CHOICE_DIAGONAL: return scaler->colors[p[CORNER_Y(corner) * SOURCE_STRIDE + CORNER_X(corner)]];
+	default: return (((horizontal & 0xFEFEFEFE) >> 1) + ((vertical & 0xFEFEFEFE) >> 1)) | 0xFF000000;
+	}
+}
+
+// Draw one line of the frame as blocks of factor x factor pixels. Each block starts as the pixel's color, and every
+// corner with a rule is blended over it in turn
+static void drawBlocks(const struct NF_Scaler* scaler, int y, const uint32_t* decisions) {
+	int factor = scaler->factor;
+	const uint16_t* line = sourceLine(scaler, y);
+	uint32_t* out[NF_SCALER_MAX_FACTOR];
+	for (int l = 0; l < factor; l++) { out[l] = outputLine(scaler, y * factor + l); }
+
+	for (int x = 0; x < NF_FRAME_WIDTH; x++) {
+		uint32_t color = scaler->colors[line[x]];
+		uint32_t decision = decisions[x];
+		if (decision == 0) {
+			for (int l = 0; l < factor; l++) {
+				for (int i = 0; i < factor; i++) { out[l][x * factor + i] = color; }
+			}
+			continue;
+		}
+		uint32_t block[16];
+		for (int i = 0; i < 16; i++) { block[i] = color; }
+		for (int corner = 0; corner < 4; corner++) {
+			uint32_t code = (decision >> (corner * 8)) & 0xFF;
+			uint32_t rule = code & RULE_MASK;
+			if (rule == RULE_NONE) { continue; }
+			blendBlock(block, factor, cornerColor(scaler, line + x, corner, code >> CHOICE_SHIFT), scaler->weights[rule][corner]);
+		}
+		for (int l = 0; l < factor; l++) { memcpy(out[l] + x * factor, block + l * 4, factor * sizeof(uint32_t)); }
+	}
+}
+
+// Scale4x: the first pass doubles a band of the frame into the doubled buffer, filling in its border
+static void doubleBand(void* context, int band) {
+	struct NF_Scaler* scaler = (struct NF_Scaler*)context;
+	int first = bandStart(scaler, band, NF_FRAME_HEIGHT);
+	int last = bandStart(scaler, band + 1, NF_FRAME_HEIGHT);
+	for (int y = first; y < last; y++) {
+		uint16_t* out0 = doubledLine(scaler, y * 2);
+		uint16_t* out1 = doubledLine(scaler, y * 2 + 1);
+		scale2Line(sourceLine(scaler, y), SOURCE_STRIDE, NF_FRAME_WIDTH, out0, out1);
+		fillLineBorder(out0, DOUBLED_WIDTH);
+		fillLineBorder(out1, DOUBLED_WIDTH);
+	}
+	if (first == 0) { fillTopBorder(doubledLine(scaler, 0) - NF_SCALER_BORDER, DOUBLED_STRIDE * sizeof(uint16_t), DOUBLED_STRIDE * sizeof(uint16_t)); }
+	if (last == NF_FRAME_HEIGHT) { fillBottomBorder(doubledLine(scaler, DOUBLED_HEIGHT - 1) - NF_SCALER_BORDER, DOUBLED_STRIDE * sizeof(uint16_t), DOUBLED_STRIDE * sizeof(uint16_t)); }
+}
+
+static void scaleBand(void* context, int band) {
+	struct NF_Scaler* scaler = (struct NF_Scaler*)context;
+	uint16_t pixels[3][DOUBLED_WIDTH * 2];
+
+	if (scaler->type == NF_SCALER_SCALE) {
+		// Scale4x doubles the doubled frame, so its bands are of the doubled lines
+		bool doubled = scaler->factor == 4;
+		int lines = doubled ? DOUBLED_HEIGHT : NF_FRAME_HEIGHT;
+		int width = doubled ? DOUBLED_WIDTH : NF_FRAME_WIDTH;
+		int first = bandStart(scaler, band, lines);
+		int last = bandStart(scaler, band + 1, lines);
+		int rows = (scaler->factor == 3) ? 3 : 2;
+		for (int y = first; y < last; y++) {
+			if (!NF_Frame_isDirty(scaler->lines, doubled ? y / 2 : y)) { continue; }
+			if (rows == 3) { scale3Line(sourceLine(scaler, y), SOURCE_STRIDE, width, pixels[0], pixels[1], pixels[2]); }
+			else if (doubled) { scale2Line(doubledLine(scaler, y), DOUBLED_STRIDE, width, pixels[0], pixels[1]); }
+			else { scale2Line(sourceLine(scaler, y), SOURCE_STRIDE, width, pixels[0], pixels[1]); }
+			for (int r = 0; r < rows; r++) { lookupColors(scaler->colors, pixels[r], width * rows, outputLine(scaler, y * rows + r)); }
+		}
+		return;
+	}
+
+	uint32_t decisions[NF_FRAME_WIDTH];
+	int first = bandStart(scaler, band, NF_FRAME_HEIGHT);
+	int last = bandStart(scaler, band + 1, NF_FRAME_HEIGHT);
+	for (int y = first; y < last; y++) {
+		if (!NF_Frame_isDirty(scaler->lines, y)) { continue; }
+		const uint32_t* yuv = yuvLine(scaler, y);
+#ifdef NF_X86
+		if (useAVX2()) {
+			if (scaler->type == NF_SCALER_XBR) { xbrDecisionsAVX2(yuv, decisions); }
+			else { hqDecisionsAVX2(scaler->hq_rules, yuv, decisions); }
+			drawBlocks(scaler, y, decisions);
+			continue;
+		}
+#endif
+		if (scaler->type == NF_SCALER_XBR) { xbrDecisionsScalar(yuv, decisions); }
+		else { hqDecisionsScalar(scaler->hq_rules, yuv, decisions); }
+		drawBlocks(scaler, y, decisions);
+	}
+}
+
+static void runBands(struct NF_Scaler* scaler, NF_TaskFunction task) {
+	if (scaler->pool != NULL) { NF_runTasks(scaler->pool, scaler->bands, task, scaler); }
+	else { task(scaler, 0); }
+}
+
+void NF_Scaler_scale(struct NF_Scaler* scaler, const struct NF_Frame* frame, uint32_t* dirty, uint32_t* output, size_t pitch) {
+	scaler->frame = frame;
+	scaler->output = output;
+	scaler->pitch = pitch;
+
+	// No scaler looks further from a line than the border, so that is how far a change can reach
+	memset(scaler->lines, 0, sizeof(scaler->lines));
+	for (int y = 0; y < NF_FRAME_HEIGHT; y++) {
+		bool changed = dirty == NULL;
+		for (int near = y - NF_SCALER_BORDER; near <= y + NF_SCALER_BORDER && !changed; near++) {
+			changed = near >= 0 && near < NF_FRAME_HEIGHT && NF_Frame_isDirty(dirty, near);
+		}
+		if (changed) { NF_Frame_markDirty(scaler->lines, y); }
+	}
+	if (dirty != NULL) { memcpy(dirty, scaler->lines, sizeof(scaler->lines)); }
+
+	// Bands read the lines either side of their own, so each pass has to be finished everywhere before the next
+	runBands(scaler, prepareBand);
+	if (scaler->doubled != NULL) { runBands(scaler, doubleBand); }
+	runBands(scaler, scaleBand);
+}
@@ -0,0 +1,83 @@
+#ifndef NF_H_SCALER
+#define NF_H_SCALER
+#include "NF_Frame.h"
+#include "NF_ThreadPool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Pixel art upscalers, for showing frames at 2, 3 or 4 times their size on displays where stretching them with the
+// renderer looks blurry or makes some pixels wider than others. All of them look at each pixel's neighbours to tell
+// edges from flat areas, and fill in the extra pixels so that diagonal edges come out smooth instead of as steps:
+//
+// Scale:	Scale2x/Scale3x (and Scale4x, which is Scale2x done twice). Only copies neighbouring pixels, so the output
+//			has no colors that were not in the frame
+// HQ:		hqx style. Which neighbours differ from the pixel (by brightness and color, with the hqx thresholds) is
+//			looked up in a table of rules that blend the pixel's corners towards them
+// XBR:		xBR. Weighs up the color distances along both diagonals of each corner to decide which one is an edge,
+//			and how shallow or steep it is, then blends the corner towards the other side of the edge
+//
+// Frames are split into bands of lines that are scaled on different threads. Finding edges works on 8 or 16 pixels
+// at once with AVX2 where the processor has it, and blending works on 4 pixels at once with SSE2.
+
+typedef enum {
+	NF_SCALER_SCALE,
+	NF_SCALER_HQ,
+	NF_SCALER_XBR,
+	NF_SCALER_TYPES
+} NF_SCALER_TYPE;
+
+#define NF_SCALER_MIN_FACTOR 2
+#define NF_SCALER_MAX_FACTOR 4
+#define NF_SCALER_COLORS 512			// 64 palette colors times 8 combinations of emphasis bits
+
+// Frames are copied into buffers with this many pixels of border all around, repeating the edge pixels, so that
+// every pixel has neighbours to look at
+#define NF_SCALER_BORDER 2
+
+// What blending a corner of a pixel needs. The corner is blended over a shape that depends on the rule: a corner cut
+// off at 45 degrees, one that reaches along the bottom or the side of the pixel for shallow and steep edges, or both
+#define NF_SCALER_RULES 6
+
+struct NF_Scaler {
+	NF_SCALER_TYPE type;
+	int factor;
+	uint32_t colors[NF_SCALER_COLORS];		// ARGB of every pixel value
+	uint32_t yuv[NF_SCALER_COLORS];			// The same colors as Y, U and V bytes, for measuring differences
+	uint32_t* hq_rules;						// HQ: corner rules for every combination of differing neighbours
+
+	// [rule][corner][line * 4 + pixel][channel] weight of the corner's color in each pixel of the output block, in
+	// 1/128ths. Each weight is repeated for the 4 channels so that a whole pixel can be blended at once
+	int16_t weights[NF_SCALER_RULES][4][16][4];
+
+	// The frame with a border, as pixel values, and as YUV for HQ and XBR. Scale4x also has the frame at twice the
+	// size, with a border, between its two passes
+	uint16_t* source;
+	uint32_t* source_yuv;
+	uint16_t* doubled;
+
+	struct NF_ThreadPool* pool;				// NULL when scaling on the calling thread only
+	int bands;
+
+	// The frame being scaled, for the band tasks, and the lines of it to output
+	const struct NF_Frame* frame;
+	uint32_t lines[NF_FRAME_DIRTY_WORDS];
+	uint32_t* output;
+	size_t pitch;
+};
+
+// Short name of each type, as used for choosing one: "scale", "hq" or "xbr"
+const char* NF_Scaler_name(NF_SCALER_TYPE type);
+
+// Set up a scaler that makes frames factor times bigger. colors is the ARGB value of each of the NF_SCALER_COLORS
+// pixel values. threads is how many threads split up each frame into bands of lines, with 0 meaning one per
+// processor. Returns NULL if the factor is not supported or out of memory
+struct NF_Scaler* NF_Scaler_create(NF_SCALER_TYPE type, int factor, const uint32_t* colors, int threads);
+void NF_Scaler_free(struct NF_Scaler* scaler);
+
+// Scale a frame into (NF_FRAME_WIDTH * factor) x (NF_FRAME_HEIGHT * factor) pixels of ARGB8888. pitch is the
+// distance between lines of output in bytes. dirty is NULL to output every line, or a bitmap of the lines that
+// changed since the output was last drawn (see NF_Frame.h). Then only the lines that changed or are close enough to
+// one that changed to look at it are output, and dirty is widened to mark all of them
+void NF_Scaler_scale(struct NF_Scaler* scaler, const struct NF_Frame* frame, uint32_t* dirty, uint32_t* output, size_t pitch);
+
+#endif
@@ -0,0 +1,161 @@
+#include "NF_State.h"
+#include "NF_6502.h"
+#include "NF_APU.h"
+#include "NF_PPU.h"
+#include "NF_Probes.h"
+#include <stdio.h>
+#include <string.h>
+
+// The APU's emulation state is the start of the structure, up to where the synthesis buffers begin
+#define APU_STATE_SIZE offsetof(struct NF_APU, output)
+
+struct ConsoleState {
+	uint8_t ram[0x800];
+	uint64_t cpu_cycle;
+	uint64_t event_cycles[NF_EVENT_COUNT];
+	uint64_t frame_count;
+	struct NF_Controller controllers[NF_CONTROLLER_PORTS];
+	uint8_t irq_lines;
+};
+
+struct CartridgeState {
+	union NF_MapperState mapper_state;
+	uint32_t mirroring;
+	uint8_t irq_asserted;
+};
+
+static uint32_t chrRAMSize(struct Cartridge* c) { return c->chr_is_ram ? c->chr_size : 0; }
+
+size_t NF_State_size(struct NES_Console* console) {
+	struct Cartridge* c = console->ConnectedCartridge;
+	if (c == NULL) {
+		printf("Error: A savestate needs a cartridge to be inserted.\n");
+		return 0;
+	}
+	return sizeof(struct NF_StateHeader) + sizeof(struct ConsoleState) + sizeof(struct Processor) + sizeof(struct PictureProcessingUnit) +
+		APU_STATE_SIZE + sizeof(struct CartridgeState) + c->prg_ram_size + chrRAMSize(c);
+}
+
+static uint8_t* put(uint8_t* out, const void* data, size_t size) {
+	memcpy(out, data, size);
+	return out + size;
+}
+
+static const uint8_t* get(const uint8_t* in, void* data, size_t size) {
+	memcpy(data, in, size);
+	return in + size;
+}
+
+static bool saveState(struct NES_Console* console, void* buffer, size_t size) {
+	size_t needed = NF_State_size(console);
+	if (needed == 0) { return false; }
+	if (size < needed) {
+		printf("Error: Savestate buffer is too small (%zu bytes, %zu needed).\n", size, needed);
+		return false;
+	}
+	struct Cartridge* c = console->ConnectedCartridge;
+	memset(buffer, 0, needed);
+
+	struct NF_StateHeader header = { NF_STATE_MAGIC, NF_STATE_VERSION, (uint32_t)needed, c->header.mapper, c->prg_ram_size, chrRAMSize(c), 0 };
+	uint8_t* out = put(buffer, &header, sizeof(header));
+
+	struct ConsoleState state;
+	memset(&state, 0, sizeof(state));
+	memcpy(state.ram, console->Memory, sizeof(state.ram));
+	state.cpu_cycle = console->cpu_cycle;
+	memcpy(state.event_cycles, console->event_cycles, sizeof(state.event_cycles));
+	state.frame_count = console->frame_count;
+	memcpy(state.controllers, console->controllers, sizeof(state.controllers));
+	state.irq_lines = console->irq_lines;
+	out = put(out, &state, sizeof(state));
+
+	// The components are copied whole, with the pointer back to the bus cleared so that identical states are
+	// identical byte for byte
+	uint8_t* cpu = out;
+	out = put(out, console->ConnectedProcessor, sizeof(struct Processor));
+	memset(cpu + offsetof(struct Processor, bus), 0, sizeof(struct NES_Console*));
+	uint8_t* ppu = out;
+	out = put(out, console->ConnectedPPU, sizeof(struct PictureProcessingUnit));
+	memset(ppu + offsetof(struct PictureProcessingUnit, bus), 0, sizeof(struct NES_Console*));
+	uint8_t* apu = out;
+	out = put(out, console->ConnectedAPU, APU_STATE_SIZE);
+	memset(apu + offsetof(struct NF_APU, bus), 0, sizeof(struct NES_Console*));
+
+	struct CartridgeState cart;
+	memset(&cart, 0, sizeof(cart));
+	cart.mapper_state = c->mapper_state;
+	cart.mirroring = c->nametable_mirroring;
+	cart.irq_asserted = c->irq_asserted;
+	out = put(out, &cart, sizeof(cart));
+	if (c->prg_ram_size > 0) { out = put(out, c->prg_ram, c->prg_ram_size); }
+	if (chrRAMSize(c) > 0) { out = put(out, c->chr_ram, chrRAMSize(c)); }
+	return true;
+}
+
+static bool loadState(struct NES_Console* console, const void* buffer, size_t size) {
+	size_t needed = NF_State_size(console);
+	if (needed == 0) { return false; }
+	struct Cartridge* c = console->ConnectedCartridge;
+
+	struct NF_StateHeader header;
+	if (size < sizeof(header)) {
+		printf("Error: Savestate is too small.\n");
+		return false;
+	}
+	const uint8_t* in = get(buffer, &header, sizeof(header));
+	if (memcmp(header.magic, NF_STATE_MAGIC, sizeof(header.magic)) != 0 || header.version != NF_STATE_VERSION) {
+		printf("Error: Savestate was not made by this version of the emulator.\n");
+		return false;
+	}
+	if (header.size != needed || size < needed || header.mapper != c->header.mapper ||
+		header.prg_ram_size != c->prg_ram_size || header.chr_ram_size != chrRAMSize(c)) {
+		printf("Error: Savestate was made with a different cartridge.\n");
+		return false;
+	}
+
+	struct ConsoleState state;
+	in = get(in, &state, sizeof(state));
+	memcpy(console->Memory, state.ram, sizeof(state.ram));
+	NF_Stats_moveConsole(console, state.cpu_cycle, state.frame_count);
+	console->cpu_cycle = state.cpu_cycle;
+	for (int i = 0; i < NF_EVENT_COUNT; i++) { NF_scheduleEvent(console, (NF_EVENT)i, state.event_cycles[i]); }
+	console->frame_count = state.frame_count;
+	memcpy(console->controllers, state.controllers, sizeof(state.controllers));
+	console->irq_lines = state.irq_lines;
+
+	in = get(in, console->ConnectedProcessor, sizeof(struct Processor));
+	console->ConnectedProcessor->bus = console;
+	in = get(in, console->ConnectedPPU, sizeof(struct PictureProcessingUnit));
+	console->ConnectedPPU->bus = console;
+	in = get(in, console->ConnectedAPU, APU_STATE_SIZE);
+	console->ConnectedAPU->bus = console;
+	NF_APU_setOutput(console->ConnectedAPU, console->ConnectedAPU->output, console->ConnectedAPU->sample_rate);
+
+	// Mirroring goes first, because some mappers decide it themselves when their banks are rebuilt
+	struct CartridgeState cart;
+	in = get(in, &cart, sizeof(cart));
+	c->mapper_state = cart.mapper_state;
+	c->irq_asserted = cart.irq_asserted;
+	NF_setCartMirroring(c, (SCROLL_MAPPING_TYPE)cart.mirroring);
+	c->mapper_impl->restore(c);
+	if (c->prg_ram_size > 0) {
+		in = get(in, c->prg_ram, c->prg_ram_size);
+		c->prg_ram_dirty = true;
+	}
+	if (chrRAMSize(c) > 0) { in = get(in, c->chr_ram, chrRAMSize(c)); }
+	return true;
+}
+
+bool NF_State_save(struct NES_Console* console, void* buffer, size_t size) {
+	NF_PROBE1(state_save_start, size);
+	bool ok = saveState(console, buffer, size);
+	NF_PROBE1(state_save_done, ok);
+	return ok;
+}
+
+bool NF_State_load(struct NES_Console* console, const void* buffer, size_t size) {
+	NF_PROBE1(state_load_start, size);
+	bool ok = loadState(console, buffer, size);
+	NF_PROBE1(state_load_done, ok);
+	return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef NF_H_STATE
+#define NF_H_STATE
+#include "NF_Bus.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Savestates: a snapshot of everything that makes up a running console, so that emulation can later pick up from
+// exactly the same point. The ROM itself is not part of a state, so a state can only be loaded into a console with
+// the same cartridge inserted. Layout:
+//
+// NF_StateHeader
+// Console: internal RAM, scheduler, IRQ lines, frame count, controllers
+// CPU, PPU and APU registers, copied as they are in memory with their bus pointers cleared
+// Cartridge: mapper state, mirroring, IRQ line, PRG RAM, and CHR RAM if the board has it
+//
+// States are only meant to be loaded by the same build that saved them. The version is bumped whenever the layout
+// of any of the structures above changes.
+
+#define NF_STATE_MAGIC "NFSTATE"
+#define NF_STATE_VERSION 2
+
+struct NF_StateHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t size;					// Size of the whole state, header included
+	uint32_t mapper;
+	uint32_t prg_ram_size;
+	uint32_t chr_ram_size;			// 0 if the board has CHR ROM
+	uint32_t reserved;
+};
+
+// Number of bytes needed to hold a state of a console. This only depends on the cartridge inserted in it.
+// Returns 0 (and prints why) if there is no cartridge
+size_t NF_State_size(struct NES_Console* console);
+
+// Write the state of a console into a buffer of at least NF_State_size bytes
+bool NF_State_save(struct NES_Console* console, void* buffer, size_t size);
+
+// Put a console back into a saved state. Returns false (and prints why) if the state does not fit the cartridge
+bool NF_State_load(struct NES_Console* console, const void* buffer, size_t size);
+
+#endif
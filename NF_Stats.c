@@ -0,0 +1,109 @@
+#include "NF_Stats.h"
+#include "NF_Bus.h"
+#include "NF_Platform.h"
+#include <string.h>
+
+const uint8_t NF_busRegions[8] = { NF_REGION_RAM, NF_REGION_PPU, NF_REGION_IO, NF_REGION_PRG_RAM,
+	NF_REGION_PRG_ROM, NF_REGION_PRG_ROM, NF_REGION_PRG_ROM, NF_REGION_PRG_ROM };
+
+static const char* const regionNames[NF_REGION_COUNT] = { "RAM", "PPU", "IO", "PRG RAM", "PRG ROM" };
+
+static uint64_t ticksToNanoseconds(uint64_t ticks) {
+	uint64_t frequency = NF_getTickFrequency();
+	return ticks / frequency * 1000000000ULL + ticks % frequency * 1000000000ULL / frequency;
+}
+
+void NF_Stats_snapshot(const struct NES_Console* console, struct NF_Stats* stats) {
+	const struct NF_Counters* counters = &console->counters;
+	stats->frames = console->frame_count - counters->first_frame;
+	stats->cpu_cycles = console->cpu_cycle - counters->first_cycle;
+	stats->instructions = counters->instructions;
+	memcpy(stats->reads, counters->reads, sizeof(stats->reads));
+	memcpy(stats->writes, counters->writes, sizeof(stats->writes));
+	memcpy(stats->ppu_reads, counters->ppu_reads, sizeof(stats->ppu_reads));
+	memcpy(stats->ppu_writes, counters->ppu_writes, sizeof(stats->ppu_writes));
+	stats->nmis = counters->nmis;
+	stats->irqs = counters->irqs;
+
+	// Split the time of the frames the way the timed ticks split
+	uint64_t frame_ns = ticksToNanoseconds(counters->frame_ticks);
+	uint64_t sampled = counters->cpu_sample_ticks + counters->ppu_sample_ticks;
+	stats->cpu_ns = (sampled > 0) ? (uint64_t)((double)frame_ns * counters->cpu_sample_ticks / sampled) : 0;
+	stats->ppu_ns = frame_ns - stats->cpu_ns;
+	stats->presentation_ns = counters->presentation_ns;
+}
+
+void NF_Stats_reset(struct NES_Console* console) {
+	memset(&console->counters, 0, sizeof(console->counters));
+	console->counters.timing_countdown = NF_STATS_TIMING_INTERVAL;
+	console->counters.first_cycle = console->cpu_cycle;
+	console->counters.first_frame = console->frame_count;
+	if (console->stats_dump.file != NULL) {
+		NF_Stats_snapshot(console, &console->stats_dump.last);
+		console->stats_dump.next_frame = console->frame_count + console->stats_dump.interval;
+	}
+}
+
+void NF_Stats_subtract(const struct NF_Stats* later, const struct NF_Stats* earlier, struct NF_Stats* difference) {
+	difference->frames = later->frames - earlier->frames;
+	difference->cpu_cycles = later->cpu_cycles - earlier->cpu_cycles;
+	difference->instructions = later->instructions - earlier->instructions;
+	for (int i = 0; i < NF_REGION_COUNT; i++) {
+		difference->reads[i] = later->reads[i] - earlier->reads[i];
+		difference->writes[i] = later->writes[i] - earlier->writes[i];
+	}
+	for (int i = 0; i < NF_STATS_PPU_REGISTERS; i++) {
+		difference->ppu_reads[i] = later->ppu_reads[i] - earlier->ppu_reads[i];
+		difference->ppu_writes[i] = later->ppu_writes[i] - earlier->ppu_writes[i];
+	}
+	difference->nmis = later->nmis - earlier->nmis;
+	difference->irqs = later->irqs - earlier->irqs;
+	difference->cpu_ns = later->cpu_ns - earlier->cpu_ns;
+	difference->ppu_ns = later->ppu_ns - earlier->ppu_ns;
+	difference->presentation_ns = later->presentation_ns - earlier->presentation_ns;
+}
+
+void NF_Stats_addPresentation(struct NES_Console* console, uint64_t nanoseconds) { console->counters.presentation_ns += nanoseconds; }
+
+void NF_Stats_print(const struct NF_Stats* stats, FILE* file) {
+	double frames = (stats->frames > 0) ? (double)stats->frames : 1.0;
+	fprintf(file, "%llu frames, %llu CPU cycles, %llu instructions, %llu NMIs, %llu IRQs\n", (unsigned long long)stats->frames,
+		(unsigned long long)stats->cpu_cycles, (unsigned long long)stats->instructions, (unsigned long long)stats->nmis,
+		(unsigned long long)stats->irqs);
+	fprintf(file, "Host time per frame: CPU %.3f ms, PPU %.3f ms, presentation %.3f ms\n", stats->cpu_ns / frames / 1e6,
+		stats->ppu_ns / frames / 1e6, stats->presentation_ns / frames / 1e6);
+	fprintf(file, "Reads: ");
+	for (int i = 0; i < NF_REGION_COUNT; i++) { fprintf(file, " %s %llu", regionNames[i], (unsigned long long)stats->reads[i]); }
+	fprintf(file, "\nWrites:");
+	for (int i = 0; i < NF_REGION_COUNT; i++) { fprintf(file, " %s %llu", regionNames[i], (unsigned long long)stats->writes[i]); }
+	fprintf(file, "\nPPU registers (reads/writes):");
+	for (int i = 0; i < NF_STATS_PPU_REGISTERS; i++) {
+		fprintf(file, " $%04X %llu/%llu", 0x2000 + i, (unsigned long long)stats->ppu_reads[i], (unsigned long long)stats->ppu_writes[i]);
+	}
+	fprintf(file, "\n");
+}
+
+void NF_Stats_setDump(struct NES_Console* console, FILE* file, uint32_t interval_frames) {
+	console->stats_dump.file = file;
+	console->stats_dump.interval = (interval_frames > 0) ? interval_frames : 1;
+	console->stats_dump.next_frame = console->frame_count + console->stats_dump.interval;
+	NF_Stats_snapshot(console, &console->stats_dump.last);
+}
+
+void NF_Stats_moveConsole(struct NES_Console* console, uint64_t cpu_cycle, uint64_t frame_count) {
+	console->counters.first_cycle += cpu_cycle - console->cpu_cycle;
+	console->counters.first_frame += frame_count - console->frame_count;
+	console->stats_dump.next_frame += frame_count - console->frame_count;
+}
+
+void NF_Stats_frameFinished(struct NES_Console* console) {
+	struct NF_StatsDump* dump = &console->stats_dump;
+	if (console->frame_count < dump->next_frame) { return; }
+	struct NF_Stats now, difference;
+	NF_Stats_snapshot(console, &now);
+	NF_Stats_subtract(&now, &dump->last, &difference);
+	NF_Stats_print(&difference, dump->file);
+	fflush(dump->file);
+	dump->last = now;
+	dump->next_frame = console->frame_count + dump->interval;
+}
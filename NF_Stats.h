@@ -0,0 +1,109 @@
+#ifndef NF_H_STATS
+#define NF_H_STATS
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Counters of what the console does and how long the host takes to do it, kept all the time so that a running
+// emulator can be watched without attaching a profiler. Counting is a few increments of memory the console already has
+// in cache. The CPU cycles and frames are not counted separately at all: they are read off the console's own counts.
+//
+// The host time of each frame is measured around NF_runFrame. The CPU and PPU run interleaved a cycle at a time, far
+// too finely to time on their own, so one master clock tick in NF_STATS_TIMING_INTERVAL is timed in two halves (the
+// CPU, then the PPU), and the time of the frames is split between them in the same proportion. Presentation happens
+// outside of the core, so whoever shows the frames reports the time it takes with NF_Stats_addPresentation.
+//
+// Take a snapshot (NF_Stats_snapshot) to read the counters. Two snapshots can be subtracted to get the counts of the
+// time in between, which is how the periodic dump (NF_Stats_setDump) works.
+
+#define NF_STATS_TIMING_INTERVAL 1024
+
+struct NES_Console;
+
+// Parts of the CPU address space, by 8KB page
+typedef enum {
+	NF_REGION_RAM,					// $0000-$1FFF
+	NF_REGION_PPU,					// $2000-$3FFF, the PPU registers
+	NF_REGION_IO,					// $4000-$5FFF, the APU, controllers and the cartridge's expansion area
+	NF_REGION_PRG_RAM,				// $6000-$7FFF
+	NF_REGION_PRG_ROM,				// $8000-$FFFF
+	NF_REGION_COUNT
+} NF_BUS_REGION;
+
+#define NF_STATS_PPU_REGISTERS 8
+
+// The live counters, kept by the console
+struct NF_Counters {
+	uint64_t instructions;
+	uint64_t reads[NF_REGION_COUNT];
+	uint64_t writes[NF_REGION_COUNT];
+	uint64_t ppu_reads[NF_STATS_PPU_REGISTERS];
+	uint64_t ppu_writes[NF_STATS_PPU_REGISTERS];
+	uint64_t nmis;
+	uint64_t irqs;
+
+	// Host time, in NF_getTicks ticks
+	uint64_t frame_ticks;			// Spent in NF_runFrame
+	uint64_t cpu_sample_ticks;		// Spent in the timed ticks, on the CPU and on the PPU
+	uint64_t ppu_sample_ticks;
+	uint64_t presentation_ns;
+	uint32_t timing_countdown;		// Master clock ticks until the next timed one
+
+	// The console's counts when the counters were last reset
+	uint64_t first_cycle;
+	uint64_t first_frame;
+};
+
+// Counts since the counters were last reset, or between two snapshots
+struct NF_Stats {
+	uint64_t frames;
+	uint64_t cpu_cycles;
+	uint64_t instructions;
+	uint64_t reads[NF_REGION_COUNT];
+	uint64_t writes[NF_REGION_COUNT];
+	uint64_t ppu_reads[NF_STATS_PPU_REGISTERS];
+	uint64_t ppu_writes[NF_STATS_PPU_REGISTERS];
+	uint64_t nmis;
+	uint64_t irqs;
+	uint64_t cpu_ns;				// Host time spent emulating the CPU
+	uint64_t ppu_ns;				// And the PPU (with everything else the bus does)
+	uint64_t presentation_ns;
+};
+
+// Periodic printing of the counts, see NF_Stats_setDump
+struct NF_StatsDump {
+	FILE* file;						// NULL when not dumping
+	uint32_t interval;				// In frames
+	uint64_t next_frame;			// The console's frame count at the next dump
+	struct NF_Stats last;			// The snapshot taken at the last dump
+};
+
+// Where a CPU address is, for counting. Indexed by address >> 13
+extern const uint8_t NF_busRegions[8];
+
+void NF_Stats_snapshot(const struct NES_Console* console, struct NF_Stats* stats);
+
+// Start every count over from zero
+void NF_Stats_reset(struct NES_Console* console);
+
+// The counts of the time between two snapshots
+void NF_Stats_subtract(const struct NF_Stats* later, const struct NF_Stats* earlier, struct NF_Stats* difference);
+
+// Add the host time taken to show a frame. Call on the thread running the console
+void NF_Stats_addPresentation(struct NES_Console* console, uint64_t nanoseconds);
+
+// Write a snapshot or a difference out as a few lines of text, with the host times per frame
+void NF_Stats_print(const struct NF_Stats* stats, FILE* file);
+
+// Print the counts of the last interval_frames frames to file every interval_frames frames, from NF_runFrame. Pass
+// a file of NULL to stop
+void NF_Stats_setDump(struct NES_Console* console, FILE* file, uint32_t interval_frames);
+
+// Called before the console's CPU cycle and frame counts are set to other values (by loading a state), so that the
+// counts carry on from where they were instead of jumping with them
+void NF_Stats_moveConsole(struct NES_Console* console, uint64_t cpu_cycle, uint64_t frame_count);
+
+// Called by NF_runFrame at the end of every frame, to print the counts when a dump is due
+void NF_Stats_frameFinished(struct NES_Console* console);
+
+#endif
@@ -0,0 +1,84 @@
+#include "NF_ThreadPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Take tasks from the current batch until there are none left. Called with the lock held, and returns with it held
+static void runAvailableTasks(struct NF_ThreadPool* pool) {
+	while (pool->next_task < pool->task_count) {
+		int index = pool->next_task++;
+		NF_unlockMutex(&pool->lock);
+		pool->function(pool->context, index);
+		NF_lockMutex(&pool->lock);
+		pool->finished_tasks++;
+	}
+	if (pool->finished_tasks == pool->task_count) { NF_signalCond(&pool->work_done); }
+}
+
+static void workerMain(void* arg) {
+	struct NF_ThreadPool* pool = (struct NF_ThreadPool*)arg;
+	NF_lockMutex(&pool->lock);
+	unsigned int seen = pool->generation;
+	while (true) {
+		while (!pool->shutting_down && pool->generation == seen) { NF_waitCond(&pool->work_ready, &pool->lock); }
+		if (pool->shutting_down) { break; }
+		seen = pool->generation;
+		runAvailableTasks(pool);
+	}
+	NF_unlockMutex(&pool->lock);
+}
+
+struct NF_ThreadPool* NF_createThreadPool(int thread_count) {
+	if (thread_count <= 0) { thread_count = NF_getProcessorCount() - 1; }
+
+	struct NF_ThreadPool* pool = calloc(1, sizeof(struct NF_ThreadPool));
+	if (pool == NULL) {
+		printf("Error: Could not create thread pool. Out of memory?\n");
+		return NULL;
+	}
+	NF_initMutex(&pool->lock);
+	NF_initCond(&pool->work_ready);
+	NF_initCond(&pool->work_done);
+
+	pool->threads = calloc(thread_count > 0 ? thread_count : 1, sizeof(NF_Thread));
+	if (pool->threads == NULL) {
+		printf("Error: Could not create thread pool. Out of memory?\n");
+		free(pool);
+		return NULL;
+	}
+	// A pool that could not start every thread still works, the calling thread just does more of the work
+	for (int i = 0; i < thread_count; i++) {
+		if (!NF_startThread(&pool->threads[pool->thread_count], workerMain, pool)) {
+			printf("Error: Could only start %d of %d worker threads.\n", pool->thread_count, thread_count);
+			break;
+		}
+		pool->thread_count++;
+	}
+	return pool;
+}
+
+void NF_freeThreadPool(struct NF_ThreadPool* pool) {
+	if (pool == NULL) { return; }
+	NF_lockMutex(&pool->lock);
+	pool->shutting_down = true;
+	NF_broadcastCond(&pool->work_ready);
+	NF_unlockMutex(&pool->lock);
+	for (int i = 0; i < pool->thread_count; i++) { NF_joinThread(&pool->threads[i]); }
+	free(pool->threads);
+	free(pool);
+}
+
+void NF_runTasks(struct NF_ThreadPool* pool, int task_count, NF_TaskFunction function, void* context) {
+	if (task_count <= 0) { return; }
+	NF_lockMutex(&pool->lock);
+	pool->function = function;
+	pool->context = context;
+	pool->task_count = task_count;
+	pool->next_task = 0;
+	pool->finished_tasks = 0;
+	pool->generation++;
+	if (task_count > 1) { NF_broadcastCond(&pool->work_ready); }
+
+	runAvailableTasks(pool);
+	while (pool->finished_tasks < pool->task_count) { NF_waitCond(&pool->work_done, &pool->lock); }
+	NF_unlockMutex(&pool->lock);
+}
@@ -0,0 +1,36 @@
+#ifndef NF_H_THREADPOOL
+#define NF_H_THREADPOOL
+#include "NF_Platform.h"
+
+// A fixed set of worker threads that run batches of independent tasks. Starting threads is slow compared to the
+// work they are given (a band of scanlines, a chunk of a file), so the threads are created once and then sleep
+// until the next batch arrives.
+
+typedef void (*NF_TaskFunction)(void* context, int index);
+
+struct NF_ThreadPool {
+	NF_Mutex lock;
+	NF_Cond work_ready;
+	NF_Cond work_done;
+	NF_Thread* threads;
+	int thread_count;
+
+	// The batch being run
+	NF_TaskFunction function;
+	void* context;
+	int task_count;
+	int next_task;
+	int finished_tasks;
+	unsigned int generation;			// Bumped for every batch, so that sleeping workers can tell a new one arrived
+	bool shutting_down;
+};
+
+// Create a pool with thread_count workers. 0 uses one worker per processor, minus one for the calling thread
+struct NF_ThreadPool* NF_createThreadPool(int thread_count);
+void NF_freeThreadPool(struct NF_ThreadPool* pool);
+
+// Call function(context, i) for every i from 0 to task_count - 1, spread over the workers and the calling thread.
+// Returns once every task has finished. Only one thread may run batches on a pool at a time
+void NF_runTasks(struct NF_ThreadPool* pool, int task_count, NF_TaskFunction function, void* context);
+
+#endif
@@ -0,0 +1,169 @@
+#include "NF_Trace.h"
+#include "NF_6502.h"
+#include "NF_Debugger.h"
+#include "NF_PPU.h"
+#include <stdlib.h>
+#include <string.h>
+
+static struct NF_Tracer* newTracer() {
+	struct NF_Tracer* tracer = calloc(1, sizeof(struct NF_Tracer));
+	if (tracer == NULL) { printf("Error: Could not create tracer object. Out of memory?\n"); }
+	return tracer;
+}
+
+struct NF_Tracer* NF_Tracer_createRing(uint32_t capacity) {
+	struct NF_Tracer* tracer = newTracer();
+	if (tracer == NULL) { return NULL; }
+	tracer->capacity = 1;
+	while (tracer->capacity < ((capacity == 0) ? NF_TRACE_DEFAULT_RING_SIZE : capacity)) { tracer->capacity *= 2; }
+	tracer->ring = true;
+	tracer->records = malloc((size_t)tracer->capacity * sizeof(struct NF_TraceRecord));
+	if (tracer->records == NULL) {
+		printf("Error: Could not allocate trace ring. Out of memory?\n");
+		free(tracer);
+		return NULL;
+	}
+	return tracer;
+}
+
+// Map the trace file with room for capacity records, keeping the records already in it
+static bool mapTraceFile(struct NF_Tracer* tracer, uint64_t capacity) {
+	if (tracer->mapping.data != NULL) { NF_unmapFile(&tracer->mapping); }
+	if (!NF_mapFileReadWrite(tracer->path, sizeof(struct NF_TraceFileHeader) + (size_t)capacity * sizeof(struct NF_TraceRecord), &tracer->mapping)) {
+		tracer->records = NULL;
+		return false;
+	}
+	tracer->records = (struct NF_TraceRecord*)(tracer->mapping.data + sizeof(struct NF_TraceFileHeader));
+	tracer->capacity = capacity;
+	return true;
+}
+
+static void writeTraceHeader(struct NF_Tracer* tracer) {
+	struct NF_TraceFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NF_TRACE_MAGIC, sizeof(NF_TRACE_MAGIC));
+	header.version = NF_TRACE_VERSION;
+	header.record_size = sizeof(struct NF_TraceRecord);
+	header.count = tracer->count;
+	memcpy(tracer->mapping.data, &header, sizeof(header));
+}
+
+struct NF_Tracer* NF_Tracer_createFile(const char* path) {
+	struct NF_Tracer* tracer = newTracer();
+	if (tracer == NULL) { return NULL; }
+	snprintf(tracer->path, sizeof(tracer->path), "%s", path);
+
+	// Whatever was in the file before is left past the end of the records, where nothing reads it
+	if (!mapTraceFile(tracer, NF_TRACE_FILE_INITIAL_RECORDS)) {
+		free(tracer);
+		return NULL;
+	}
+	writeTraceHeader(tracer);
+	return tracer;
+}
+
+struct NF_Tracer* NF_Tracer_open(const char* path) {
+	struct NF_Tracer* tracer = newTracer();
+	if (tracer == NULL) { return NULL; }
+	if (!NF_mapFileReadOnly(path, &tracer->mapping)) {
+		free(tracer);
+		return NULL;
+	}
+	struct NF_TraceFileHeader header;
+	size_t size = tracer->mapping.size;
+	if (size >= sizeof(header)) { memcpy(&header, tracer->mapping.data, sizeof(header)); }
+	if (size < sizeof(header) || memcmp(header.magic, NF_TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != NF_TRACE_VERSION ||
+		header.record_size != sizeof(struct NF_TraceRecord) || header.count > (size - sizeof(header)) / sizeof(struct NF_TraceRecord)) {
+		printf("Error: %s is not a valid trace.\n", path);
+		NF_unmapFile(&tracer->mapping);
+		free(tracer);
+		return NULL;
+	}
+	snprintf(tracer->path, sizeof(tracer->path), "%s", path);
+	tracer->records = (struct NF_TraceRecord*)(tracer->mapping.data + sizeof(header));
+	tracer->count = header.count;
+	tracer->capacity = header.count;
+	tracer->read_only = true;
+	tracer->stopped = true;
+	return tracer;
+}
+
+void NF_Tracer_free(struct NF_Tracer* tracer) {
+	if (tracer == NULL) { return; }
+	if (tracer->ring) { free(tracer->records); }
+	else if (tracer->mapping.data != NULL) {
+		if (!tracer->read_only) {
+			writeTraceHeader(tracer);
+			NF_flushFileMapping(&tracer->mapping, false);
+		}
+		NF_unmapFile(&tracer->mapping);
+	}
+	free(tracer);
+}
+
+uint64_t NF_Tracer_first(struct NF_Tracer* tracer) { return (tracer->ring && tracer->count > tracer->capacity) ? tracer->count - tracer->capacity : 0; }
+
+const struct NF_TraceRecord* NF_Tracer_get(struct NF_Tracer* tracer, uint64_t index) {
+	if (index >= tracer->count || index < NF_Tracer_first(tracer)) { return NULL; }
+	return &tracer->records[tracer->ring ? (index & (tracer->capacity - 1)) : index];
+}
+
+void NF_Tracer_recordInstruction(struct NF_Tracer* tracer, struct Processor* CPU, uint8_t opcode) {
+	if (tracer->stopped) { return; }
+	if (!tracer->ring && tracer->count == tracer->capacity) {
+		// Keep the count in the header up to date, so that a trace cut short by a crash can still be read
+		writeTraceHeader(tracer);
+		if (!mapTraceFile(tracer, tracer->capacity * 2)) {
+			printf("Error: Could not grow trace %s. Tracing stopped after %llu instructions.\n", tracer->path, (unsigned long long)tracer->count);
+			tracer->stopped = true;
+			return;
+		}
+	}
+
+	struct NF_TraceRecord* record = &tracer->records[tracer->count & (tracer->capacity - 1)];
+	record->cycle = CPU->total_cycles;
+	record->frame = (uint32_t)CPU->bus->frame_count;
+	record->pc = CPU->last_pc;
+	record->address = CPU->fetched_address;
+	record->scanline = CPU->bus->ConnectedPPU->scanline;
+	record->dot = CPU->bus->ConnectedPPU->cycle;
+	record->bytes[0] = opcode;
+	int length = getAddressModeToByteCount(CPU->addr_mode);
+	record->bytes[1] = (length > 1) ? NF_peekMemory(CPU->bus, CPU->last_pc + 1) : 0;
+	record->bytes[2] = (length > 2) ? NF_peekMemory(CPU->bus, CPU->last_pc + 2) : 0;
+	record->value = CPU->fetched;
+	record->a = CPU->A;
+	record->x = CPU->X;
+	record->y = CPU->Y;
+	record->p = CPU->P;
+	record->sp = CPU->SP;
+	tracer->count++;
+}
+
+bool NF_Tracer_writeText(struct NF_Tracer* tracer, FILE* file, uint64_t first, uint64_t count) {
+	char line[NF_TRACE_LINE_SIZE];
+	for (uint64_t i = first; i - first < count && i < tracer->count; i++) {
+		const struct NF_TraceRecord* record = NF_Tracer_get(tracer, i);
+		if (record == NULL) { continue; }
+		NF_formatTraceRecord(record, line, sizeof(line));
+		if (fputs(line, file) < 0 || fputc('\n', file) == EOF) { return false; }
+	}
+	return true;
+}
+
+void NF_printTraceDifferences(const struct NF_TraceRecord* x, const struct NF_TraceRecord* y, bool operands) {
+	printf("Differences:");
+	if (x->pc != y->pc) { printf(" PC %04X/%04X", x->pc, y->pc); }
+	if (x->a != y->a) { printf(" A %02X/%02X", x->a, y->a); }
+	if (x->x != y->x) { printf(" X %02X/%02X", x->x, y->x); }
+	if (x->y != y->y) { printf(" Y %02X/%02X", x->y, y->y); }
+	if (x->p != y->p) { printf(" P %02X/%02X", x->p, y->p); }
+	if (x->sp != y->sp) { printf(" SP %02X/%02X", x->sp, y->sp); }
+	if (x->cycle != y->cycle) { printf(" CYC %llu/%llu", (unsigned long long)x->cycle, (unsigned long long)y->cycle); }
+	if (operands && x->frame != y->frame) { printf(" frame %u/%u", x->frame, y->frame); }
+	if (x->scanline != y->scanline || x->dot != y->dot) { printf(" PPU %d,%d/%d,%d", x->scanline, x->dot, y->scanline, y->dot); }
+	if (memcmp(x->bytes, y->bytes, sizeof(x->bytes)) != 0) { printf(" instruction"); }
+	if (operands && x->address != y->address) { printf(" address %04X/%04X", x->address, y->address); }
+	if (operands && x->value != y->value) { printf(" operand %02X/%02X", x->value, y->value); }
+	printf("\n");
+}
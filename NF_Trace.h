@@ -0,0 +1,95 @@
+#ifndef NF_H_TRACE
+#define NF_H_TRACE
+#include "NF_Platform.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Instruction traces. While a tracer is attached to a console (see NF_setTracer), every instruction the CPU starts
+// adds a fixed size binary record of where it is and the state it starts in. Nothing is formatted while tracing:
+// records are only turned into lines of the nestest log (see NF_Debugger.h) when someone asks for them, either from
+// a tracer that is running or from a trace file afterwards.
+//
+// A tracer either keeps the newest records in a ring in memory, for looking back at what led up to a problem, or
+// keeps every record in a file mapped into memory, which is made bigger as it fills up. Trace files are laid out as
+// (all values little endian):
+//
+// NF_TraceFileHeader
+// NF_TraceRecord records[count]
+//
+// The file can be longer than the records in it, since it grows ahead of them.
+
+struct Processor;
+
+#define NF_TRACE_MAGIC "NFTRACE"
+#define NF_TRACE_VERSION 1
+#define NF_TRACE_DEFAULT_RING_SIZE (1 << 20)
+#define NF_TRACE_FILE_INITIAL_RECORDS (1 << 20)		// 32MB
+
+struct NF_TraceRecord {
+	uint64_t cycle;					// CPU cycles taken by the instructions before this one, as in the nestest log
+	uint32_t frame;					// The console's frame count
+	uint16_t pc;
+	uint16_t address;				// Address the instruction reads or writes, or branches to
+	int16_t scanline;				// Where the PPU is
+	int16_t dot;
+	uint8_t bytes[3];				// The instruction. Only as many bytes as its addressing mode takes are set
+	uint8_t value;					// The operand: the value read from address, or the immediate value
+	uint8_t a;
+	uint8_t x;
+	uint8_t y;
+	uint8_t p;
+	uint8_t sp;
+	uint8_t pad[3];
+};
+
+struct NF_TraceFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t count;
+};
+
+struct NF_Tracer {
+	struct NF_TraceRecord* records;
+	uint64_t capacity;				// Records that fit. Always a power of two
+	uint64_t count;					// Records added since the tracer started. A ring holds the newest capacity of them
+	bool ring;
+	bool stopped;					// Nothing more is added: the trace was opened to be read, or the file could not grow
+
+	// Trace files only
+	struct NF_FileMapping mapping;
+	char path[1024];
+	bool read_only;
+};
+
+// Trace into a ring that keeps the newest capacity records, rounded up to a power of two. 0 uses the default size
+struct NF_Tracer* NF_Tracer_createRing(uint32_t capacity);
+
+// Trace every instruction into a file
+struct NF_Tracer* NF_Tracer_createFile(const char* path);
+
+// Open a trace file to read its records. Returns NULL (and prints why) if it is missing or malformed
+struct NF_Tracer* NF_Tracer_open(const char* path);
+
+// A trace file is finished by writing how many records it has into its header
+void NF_Tracer_free(struct NF_Tracer* tracer);
+
+// Index of the oldest record the tracer still holds. Records are numbered from 0 when the tracer started
+uint64_t NF_Tracer_first(struct NF_Tracer* tracer);
+
+// A record by its index, or NULL if the tracer does not hold it
+const struct NF_TraceRecord* NF_Tracer_get(struct NF_Tracer* tracer, uint64_t index);
+
+// Called by the CPU once it has fetched the operand of an instruction, before running it
+void NF_Tracer_recordInstruction(struct NF_Tracer* tracer, struct Processor* CPU, uint8_t opcode);
+
+// Write count records from first on as lines of the nestest log. Stops early at the newest record. Returns false if
+// the file could not be written
+bool NF_Tracer_writeText(struct NF_Tracer* tracer, FILE* file, uint64_t first, uint64_t count);
+
+// Print the fields of two trace records that differ, as first/second. The frame, address and operand are only compared
+// if operands is true, since records read back from a text log do not have them
+void NF_printTraceDifferences(const struct NF_TraceRecord* x, const struct NF_TraceRecord* y, bool operands);
+
+#endif
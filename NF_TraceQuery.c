@@ -0,0 +1,278 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "NF_TraceQuery.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PC_COUNT 65536
+
+// Records compared by each task when looking for where two traces differ (32MB of each trace)
+#define DIFF_CHUNK_RECORDS (1 << 20)
+
+// The index is built in two passes over the trace, each split into one chunk per thread. The first counts the
+// records of every PC in each chunk, and the second puts each record where its PC's records start for that chunk
+struct IndexBuild {
+	const struct NF_TraceRecord* records;
+	uint64_t count;
+	int chunk_count;
+	uint64_t* histograms;			// PC_COUNT per chunk
+	uint64_t* pc_records;
+	uint64_t* cycle_samples;
+	bool scatter;					// Second pass
+};
+
+static void buildChunk(void* context, int chunk) {
+	struct IndexBuild* build = (struct IndexBuild*)context;
+	uint64_t begin = build->count * chunk / build->chunk_count;
+	uint64_t end = build->count * (chunk + 1) / build->chunk_count;
+	uint64_t* histogram = build->histograms + (size_t)chunk * PC_COUNT;
+	if (build->scatter) {
+		for (uint64_t i = begin; i < end; i++) { build->pc_records[histogram[build->records[i].pc]++] = i; }
+		return;
+	}
+	for (uint64_t i = begin; i < end; i++) { histogram[build->records[i].pc]++; }
+	uint64_t sample = (begin + NF_TRACE_INDEX_CYCLE_STRIDE - 1) / NF_TRACE_INDEX_CYCLE_STRIDE;
+	for (; sample * NF_TRACE_INDEX_CYCLE_STRIDE < end; sample++) { build->cycle_samples[sample] = build->records[sample * NF_TRACE_INDEX_CYCLE_STRIDE].cycle; }
+}
+
+static void runBuildPass(struct IndexBuild* build, struct NF_ThreadPool* pool) {
+	if (pool != NULL) { NF_runTasks(pool, build->chunk_count, buildChunk, build); }
+	else { for (int i = 0; i < build->chunk_count; i++) { buildChunk(build, i); } }
+}
+
+// First record from low on whose frame is at least frame, or high if there is none
+static uint64_t findFrameFrom(const struct NF_TraceRecord* records, uint64_t low, uint64_t high, uint32_t frame) {
+	while (low < high) {
+		uint64_t middle = low + (high - low) / 2;
+		if (records[middle].frame < frame) { low = middle + 1; }
+		else { high = middle; }
+	}
+	return low;
+}
+
+static size_t indexSize(const struct NF_TraceIndexFileHeader* header) {
+	return sizeof(*header) + (size_t)(PC_COUNT + 1 + header->record_count + header->frame_count + header->cycle_sample_count) * sizeof(uint64_t);
+}
+
+static bool buildIndex(struct NF_Tracer* trace, struct NF_ThreadPool* pool, const char* index_path, const struct NF_FileInfo* info) {
+	const struct NF_TraceRecord* records = trace->records;
+	uint64_t count = trace->count;
+	struct NF_TraceIndexFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NF_TRACE_INDEX_MAGIC, sizeof(header.magic));
+	header.version = NF_TRACE_INDEX_VERSION;
+	header.record_size = sizeof(struct NF_TraceRecord);
+	header.record_count = count;
+	header.trace_size = info->size;
+	header.trace_mtime = info->mtime;
+	if (count > 0) {
+		header.first_frame = records[0].frame;
+		header.frame_count = records[count - 1].frame - records[0].frame + 1;
+	}
+	header.cycle_sample_count = (count + NF_TRACE_INDEX_CYCLE_STRIDE - 1) / NF_TRACE_INDEX_CYCLE_STRIDE;
+
+	struct IndexBuild build;
+	memset(&build, 0, sizeof(build));
+	build.records = records;
+	build.count = count;
+	build.chunk_count = (pool != NULL) ? pool->thread_count + 1 : 1;
+	build.histograms = calloc((size_t)build.chunk_count * PC_COUNT, sizeof(uint64_t));
+	if (build.histograms == NULL) {
+		printf("Error: Could not allocate trace index tables. Out of memory?\n");
+		return false;
+	}
+
+	// The index is built in a file of its own and then moved over the old one, so that a build that fails part way
+	// does not leave a broken index behind. Mapping a file only ever grows it, so one left over from before goes first
+	char tmp_path[sizeof(trace->path) + 16];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", index_path);
+	remove(tmp_path);
+	struct NF_FileMapping mapping;
+	if (!NF_mapFileReadWrite(tmp_path, indexSize(&header), &mapping)) {
+		free(build.histograms);
+		return false;
+	}
+	uint64_t* pc_starts = (uint64_t*)(mapping.data + sizeof(header));
+	build.pc_records = pc_starts + PC_COUNT + 1;
+	uint64_t* frame_starts = build.pc_records + count;
+	build.cycle_samples = frame_starts + header.frame_count;
+
+	runBuildPass(&build, pool);
+
+	// Turn the counts into where each chunk's records of each PC go. The chunks are in the order the trace ran, so
+	// the records of every PC stay in that order
+	uint64_t position = 0;
+	for (int pc = 0; pc < PC_COUNT; pc++) {
+		pc_starts[pc] = position;
+		for (int chunk = 0; chunk < build.chunk_count; chunk++) {
+			uint64_t* slot = &build.histograms[(size_t)chunk * PC_COUNT + pc];
+			uint64_t records_here = *slot;
+			*slot = position;
+			position += records_here;
+		}
+	}
+	pc_starts[PC_COUNT] = position;
+	build.scatter = true;
+	runBuildPass(&build, pool);
+	free(build.histograms);
+
+	uint64_t frame_start = 0;
+	for (uint32_t i = 0; i < header.frame_count; i++) {
+		frame_start = findFrameFrom(records, frame_start, count, header.first_frame + i);
+		frame_starts[i] = frame_start;
+	}
+
+	memcpy(mapping.data, &header, sizeof(header));
+	bool ok = NF_flushFileMapping(&mapping, false);
+	NF_unmapFile(&mapping);
+	ok = ok && NF_replaceFile(tmp_path, index_path);
+	if (!ok) { printf("Error: Could not write trace index %s.\n", index_path); }
+	return ok;
+}
+
+// Map an index, returning false without saying why if it is broken or does not belong to the trace as it is now
+static bool mapIndex(struct NF_TraceIndex* index, const char* index_path, const struct NF_FileInfo* info) {
+	if (!NF_mapFileReadOnly(index_path, &index->mapping)) { return false; }
+	const struct NF_TraceIndexFileHeader* header = (const struct NF_TraceIndexFileHeader*)index->mapping.data;
+
+	// The record count is checked against the file size before the size of the tables is worked out from it, which
+	// could otherwise overflow
+	bool valid = index->mapping.size >= sizeof(*header) && memcmp(header->magic, NF_TRACE_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+		header->version == NF_TRACE_INDEX_VERSION && header->record_size == sizeof(struct NF_TraceRecord) &&
+		header->record_count == index->trace->count && header->trace_size == info->size && header->trace_mtime == info->mtime &&
+		header->cycle_sample_count == (header->record_count + NF_TRACE_INDEX_CYCLE_STRIDE - 1) / NF_TRACE_INDEX_CYCLE_STRIDE &&
+		header->record_count <= index->mapping.size / sizeof(uint64_t) && indexSize(header) <= index->mapping.size;
+	if (!valid) {
+		NF_unmapFile(&index->mapping);
+		return false;
+	}
+	index->header = header;
+	index->pc_starts = (const uint64_t*)(index->mapping.data + sizeof(*header));
+	index->pc_records = index->pc_starts + PC_COUNT + 1;
+	index->frame_starts = index->pc_records + header->record_count;
+	index->cycle_samples = index->frame_starts + header->frame_count;
+	return true;
+}
+
+struct NF_TraceIndex* NF_TraceIndex_open(struct NF_Tracer* trace, struct NF_ThreadPool* pool) {
+	if (trace->ring) {
+		printf("Error: Only trace files can be indexed.\n");
+		return NULL;
+	}
+	struct NF_FileInfo info;
+	if (!NF_getFileInfo(trace->path, &info)) {
+		printf("Error: Could not look up %s.\n", trace->path);
+		return NULL;
+	}
+	struct NF_TraceIndex* index = calloc(1, sizeof(struct NF_TraceIndex));
+	if (index == NULL) {
+		printf("Error: Could not create trace index object. Out of memory?\n");
+		return NULL;
+	}
+	index->trace = trace;
+
+	char index_path[sizeof(trace->path) + 8];
+	snprintf(index_path, sizeof(index_path), "%s.idx", trace->path);
+	struct NF_FileInfo index_info;
+	if (NF_getFileInfo(index_path, &index_info) && mapIndex(index, index_path, &info)) { return index; }
+	if (!buildIndex(trace, pool, index_path, &info)) {
+		free(index);
+		return NULL;
+	}
+	if (!mapIndex(index, index_path, &info)) {
+		printf("Error: %s is not a valid trace index.\n", index_path);
+		free(index);
+		return NULL;
+	}
+	return index;
+}
+
+void NF_TraceIndex_close(struct NF_TraceIndex* index) {
+	if (index == NULL) { return; }
+	NF_unmapFile(&index->mapping);
+	free(index);
+}
+
+uint64_t NF_TraceIndex_findPC(const struct NF_TraceIndex* index, uint16_t pc, const uint64_t** records) {
+	*records = index->pc_records + index->pc_starts[pc];
+	return index->pc_starts[pc + 1] - index->pc_starts[pc];
+}
+
+bool NF_TraceIndex_findCycle(const struct NF_TraceIndex* index, uint64_t cycle, uint64_t* record) {
+	const struct NF_TraceRecord* records = index->trace->records;
+	uint64_t count = index->header->record_count;
+	if (count == 0 || records[0].cycle > cycle) { return false; }
+
+	// The last sample at or before the cycle says which stretch of the trace the record is in
+	uint64_t low = 0, high = index->header->cycle_sample_count;
+	while (high - low > 1) {
+		uint64_t middle = low + (high - low) / 2;
+		if (index->cycle_samples[middle] <= cycle) { low = middle; }
+		else { high = middle; }
+	}
+	low *= NF_TRACE_INDEX_CYCLE_STRIDE;
+	high = (count - low > NF_TRACE_INDEX_CYCLE_STRIDE) ? low + NF_TRACE_INDEX_CYCLE_STRIDE : count;
+	while (high - low > 1) {
+		uint64_t middle = low + (high - low) / 2;
+		if (records[middle].cycle <= cycle) { low = middle; }
+		else { high = middle; }
+	}
+	*record = low;
+	return true;
+}
+
+bool NF_TraceIndex_findFrame(const struct NF_TraceIndex* index, uint32_t frame, uint64_t* record) {
+	if (frame < index->header->first_frame || frame - index->header->first_frame >= index->header->frame_count) { return false; }
+	*record = index->frame_starts[frame - index->header->first_frame];
+	return true;
+}
+
+// Each task compares one chunk. Chunks are handed out in order, so once a difference has been found, chunks after it
+// are skipped
+struct Divergence {
+	const struct NF_TraceRecord* a;
+	const struct NF_TraceRecord* b;
+	uint64_t count;					// Records both traces have
+	NF_Mutex lock;
+	volatile uint32_t first_chunk;	// Earliest chunk found to differ so far, UINT32_MAX if none
+	uint64_t record;				// Where in that chunk
+};
+
+static void compareChunk(void* context, int chunk) {
+	struct Divergence* divergence = (struct Divergence*)context;
+	if ((uint32_t)chunk > NF_atomicLoadAcquire(&divergence->first_chunk)) { return; }
+	uint64_t begin = (uint64_t)chunk * DIFF_CHUNK_RECORDS;
+	uint64_t end = (divergence->count - begin > DIFF_CHUNK_RECORDS) ? begin + DIFF_CHUNK_RECORDS : divergence->count;
+	for (uint64_t i = begin; i < end; i++) {
+		// Everything but the padding at the end, which is not always written
+		if (memcmp(&divergence->a[i], &divergence->b[i], offsetof(struct NF_TraceRecord, pad)) == 0) { continue; }
+		NF_lockMutex(&divergence->lock);
+		if ((uint32_t)chunk < divergence->first_chunk) {
+			divergence->record = i;
+			NF_atomicStoreRelease(&divergence->first_chunk, (uint32_t)chunk);
+		}
+		NF_unlockMutex(&divergence->lock);
+		return;
+	}
+}
+
+bool NF_Trace_findDivergence(struct NF_Tracer* a, struct NF_Tracer* b, struct NF_ThreadPool* pool, uint64_t* record) {
+	struct Divergence divergence;
+	divergence.a = a->records;
+	divergence.b = b->records;
+	divergence.count = (a->count < b->count) ? a->count : b->count;
+	NF_initMutex(&divergence.lock);
+	divergence.first_chunk = UINT32_MAX;
+	divergence.record = 0;
+
+	uint64_t chunk_count = (divergence.count + DIFF_CHUNK_RECORDS - 1) / DIFF_CHUNK_RECORDS;
+	if (pool != NULL && chunk_count > 1) { NF_runTasks(pool, (int)chunk_count, compareChunk, &divergence); }
+	else { for (uint64_t i = 0; i < chunk_count && divergence.first_chunk == UINT32_MAX; i++) { compareChunk(&divergence, (int)i); } }
+
+	if (divergence.first_chunk != UINT32_MAX) { *record = divergence.record; }
+	else if (a->count != b->count) { *record = divergence.count; }
+	else { return false; }
+	return true;
+}
@@ -0,0 +1,69 @@
+#ifndef NF_H_TRACEQUERY
+#define NF_H_TRACEQUERY
+#include "NF_Platform.h"
+#include "NF_ThreadPool.h"
+#include "NF_Trace.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Finding things in trace files (see NF_Trace.h) that are too big to read through every time. Each trace file gets an
+// index next to it, in the same file name with .idx added, which lists where every PC ran and where every frame
+// starts. The index is built the first time a trace is queried, and built again whenever the trace has changed since.
+//
+// Records are in the order they ran, so the cycle and frame only ever go up through a trace. Finding a cycle is a
+// binary search, but over a sample of every NF_TRACE_INDEX_CYCLE_STRIDE-th cycle first, so that the search only
+// touches one stretch of the trace itself. Layout (all values little endian):
+//
+// NF_TraceIndexFileHeader
+// uint64_t pc_starts[65537]					Where the records of each PC start in pc_records. The last is record_count
+// uint64_t pc_records[record_count]			Every record by its PC, and then in the order they ran
+// uint64_t frame_starts[frame_count]			First record of every frame from first_frame on
+// uint64_t cycle_samples[cycle_sample_count]	Cycle of every NF_TRACE_INDEX_CYCLE_STRIDE-th record
+
+#define NF_TRACE_INDEX_MAGIC "NFTINDEX"
+#define NF_TRACE_INDEX_VERSION 1
+#define NF_TRACE_INDEX_CYCLE_STRIDE 4096
+
+struct NF_TraceIndexFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t record_count;
+	uint64_t trace_size;			// Size and modification time of the trace, to tell when the index is out of date
+	int64_t trace_mtime;
+	uint32_t first_frame;
+	uint32_t frame_count;
+	uint64_t cycle_sample_count;
+};
+
+struct NF_TraceIndex {
+	struct NF_FileMapping mapping;
+	struct NF_Tracer* trace;
+	const struct NF_TraceIndexFileHeader* header;
+	const uint64_t* pc_starts;
+	const uint64_t* pc_records;
+	const uint64_t* frame_starts;
+	const uint64_t* cycle_samples;
+};
+
+// Open the index of a trace opened with NF_Tracer_open, building it first if it is missing or out of date. pool may be
+// NULL, in which case it is built on the calling thread. The trace must stay open while the index is used. Returns
+// NULL (and prints why) if the index cannot be built
+struct NF_TraceIndex* NF_TraceIndex_open(struct NF_Tracer* trace, struct NF_ThreadPool* pool);
+void NF_TraceIndex_close(struct NF_TraceIndex* index);
+
+// Every record where the instruction at pc ran, in the order they ran. Returns how many there are
+uint64_t NF_TraceIndex_findPC(const struct NF_TraceIndex* index, uint16_t pc, const uint64_t** records);
+
+// The record of the instruction that was running at a cycle: the last one that started at or before it. Returns false
+// if the trace starts after the cycle
+bool NF_TraceIndex_findCycle(const struct NF_TraceIndex* index, uint64_t cycle, uint64_t* record);
+
+// The first record of a frame. Returns false if the trace does not cover the frame
+bool NF_TraceIndex_findFrame(const struct NF_TraceIndex* index, uint32_t frame, uint64_t* record);
+
+// Find the first record where two trace files differ, comparing chunks of them at the same time on the pool (which
+// may be NULL). A trace that ends while it still matches the other differs at its end. Returns false if they match
+bool NF_Trace_findDivergence(struct NF_Tracer* a, struct NF_Tracer* b, struct NF_ThreadPool* pool, uint64_t* record);
+
+#endif
@@ -0,0 +1,14 @@
+#include <stdio.h>
+#include "NF_Nestest.h"
+
+// Command line: nestest [rom] [log]
+//
+// Runs nestest.nes in its automation mode and checks every instruction against a log of a known good run, the same
+// check as the emulator's --nestest, but without SDL, so that it can run as a test. Exits with 0 if the CPU matches
+// the log, 2 if it differs, and 1 if the check could not run
+
+int main(int argc, char* args[]) {
+    const char* rom_path = (argc > 1) ? args[1] : "nestest.nes";
+    const char* log_path = (argc > 2) ? args[2] : "goodlog.txt";
+    return NF_Nestest_check(rom_path, log_path);
+}
@@ -1,89 +1,679 @@
+#define _CRT_SECURE_NO_WARNINGS
+
 #include <SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "CF_Audio.h"
+#include "CF_Controller.h"
+#include "CF_Video.h"
 #include "CF_Window.h"
 #include "NF_Cartridge.h"
 #include "NF_6502.h"
+#include "NF_Benchmark.h"
 #include "NF_Bus.h"
+#include "NF_CodeDataLog.h"
+#include "NF_Compositor.h"
+#include "NF_Debugger.h"
+#include "NF_Frame.h"
+#include "NF_Hash.h"
+#include "NF_Movie.h"
+#include "NF_Nestest.h"
 #include "NF_Palette.h"
+#include "NF_Platform.h"
+#include "NF_Probes.h"
+#include "NF_Profiler.h"
+#include "NF_Recorder.h"
+#include "NF_RenderThread.h"
+#include "NF_RomCatalog.h"
+#include "NF_RomDB.h"
+#include "NF_State.h"
+#include "NF_Stats.h"
+#include "NF_ThreadPool.h"
+#include "NF_Trace.h"
+#include "NF_TraceQuery.h"
+
+// Command line: Emulator [rom] [--record movie] [--play movie] [--headless] [--record-video file] [--ntsc] [--filter name]
+//                        [--benchmark-filters] [--export-video recording video.y4m audio.wav] [--trace file]
+//                        [--trace-text trace log.txt] [--trace-diff trace trace] [--trace-pc trace address]
+//                        [--trace-cycle trace cycle] [--trace-frame trace frame] [--nestest log]
+//                        [--benchmark results.json] [--benchmark-corpus results.json] [--profile name]
+//                        [--romdb-build database] [--check-compositor] [--stats frames] [--cdl log.cdl]
+//
+// --record:	Record the buttons pressed into a movie, which is written when the window is closed
+// --play:		Play a movie back instead of reading the keyboard, then carry on with the keyboard once it ends
+// --headless:	With --play, run the movie as fast as possible without a window or sound, and print a hash of the
+//				final state. Two runs of the same movie should always print the same hash
+// --record-video:	With --headless, also record the picture and sound of the movie into a lossless recording
+// --ntsc:		Show the picture the way a TV shows composite video, with the color fringes and blending
+// --filter:	Show the picture through a filter: none, ntsc, or a pixel art scaler with its scale (scale2x, scale3x,
+//				scale4x, hq2x, hq3x, hq4x, xbr2x, xbr3x, xbr4x). The window is made the scaled size
+// --benchmark-filters:	Run the ROM for a few seconds without a window, then time every filter on the last frame
+// --export-video:	Convert a recording to YUV4MPEG2 video and WAV audio, then exit
+// --trace:		Trace every instruction into a binary trace file. With a window, F9 pauses and resumes tracing
+// --trace-text:	Write a trace file out in the text format of the nestest log, then exit
+// --trace-diff:	Find the first instruction where two trace files differ, then exit (with 2 if they do)
+// --trace-pc:	List every time the instruction at an address (in hex) ran in a trace file, then exit
+// --trace-cycle:	Show the instruction that was running at a CPU cycle in a trace file, then exit
+// --trace-frame:	Show the first instruction of a frame in a trace file, then exit
+// --nestest:	Run the ROM (nestest.nes) in its automation mode, check every instruction against a log of a known good
+//				run (goodlog.txt), and time it, then exit (with 2 if they differ)
+// --benchmark:	Run the microbenchmarks of the core, with a frame benchmark for every ROM given (or nestest.nes), write
+//				the results to a JSON file, then exit
+// --profile:	Charge every CPU cycle the game runs to its code, and when the game is closed, write the cycles of each
+//				call stack to name.folded (for flame graph tools) and the hottest addresses of each bank to name.txt
+// --stats:	Print what the console did, and the host time it took per frame, every so many frames
+// --benchmark-corpus:	Run every ROM given (or nestest.nes), and every ROM under the directory in the NF_ROM_CORPUS
+//				environment variable, for a minute of frames each with fixed input, write how fast they ran to a JSON
+//				file, then exit
+// --romdb-build:	Add every ROM of the library (see below) to a ROM database, with the header in its file, then exit
+// --check-compositor:	Check that the SIMD versions of the scanline compositor this processor can run draw the same
+//				lines as the plain version, then exit (with 1 if they do not). --benchmark does the same check first
+// --cdl:		Log which bytes of the ROM the game runs as code, reads as data or draws, carrying on from the log in the
+//				file if there is one, and when the game is closed, write the log in the .cdl format of FCEUX and print
+//				how much of each bank was used. With --headless, CHR is only logged as drawn if --record-video draws it
+//
+// Environment: with NF_ROM_DB set to a ROM database, the header of the game is taken from the database when it has the
+// ROM. With NF_ROM_LIBRARY also set to the directory of the ROM library, the library is cataloged on start (only new
+// and changed ROMs are read), and ROMs in it are looked up by their cataloged hashes instead of being hashed on load
+
+// Audio kept buffered ahead of the sound card. The emulator is paced off this
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_LATENCY_MS 40
+
+// The catalog of the ROM library, kept in the library's directory
+#define LIBRARY_CATALOG_NAME "library.catalog"
+
+// Frames per second of an NTSC NES, used to pace the emulator when there is no sound
+#define NES_FRAME_RATE 60.0988
+
+// Frames run before the filters are timed, so that there is a picture on screen, and how many times each filter runs
+#define BENCHMARK_WARMUP_FRAMES 300
+#define BENCHMARK_REPEATS 200
+
+// ROMs that can be given at once, for benchmarking
+#define MAX_ROM_ARGUMENTS 64
+
+// Instructions shown before the first one where two traces differ
+#define TRACE_DIFF_CONTEXT 5
+
+// Sound played during a frame is collected here before it is added to the frame being recorded
+#define RECORDING_AUDIO_BUFFER 4096
+
+// Drawing moves to a thread of its own when there are enough processors for it, the emulation thread and the window
+#define RENDER_THREAD_MIN_PROCESSORS 3
+
+// The console runs on a thread of its own, so that a slow frame on one side does not hold up the other. It draws
+// into a triple buffer that the window shows the newest frame from, and gets the buttons from a queue the window
+// thread fills. Nothing else is shared: the console and the movies belong to the emulation thread while it runs.
+// With a render thread, the console only records what to draw, and the render thread draws it into the triple buffer
+struct EmulationThread {
+    struct NES_Console* console;
+    struct NF_Movie* playback;
+    struct NF_Movie* recording;
+    struct NF_TripleBuffer* frames;
+    struct NF_RenderThread* render;
+    struct NF_InputQueue input;
+    uint8_t buttons[NF_CONTROLLER_PORTS];
+    struct NF_Tracer* tracer;
+    volatile uint32_t tracing;          // Set by the window thread, and picked up by the emulation thread between frames
+    volatile uint32_t presentation_us;  // Time the window thread spent showing frames, not yet added to the counters
+    volatile uint32_t running;
+};
 
 bool MAIN = true;
 SDL_Event e;
+struct EmulationThread emulation;
 
-// Change this to SDL_Renderer* for proper SDL rendering
-SDL_Renderer* screenRenderer;
+void quitFunc() { MAIN = false; }
 
-int scanline;
-int cycle;
-uint16_t startup_cycles = 0;
-bool startup_ready = false;
+// The ROM database and the catalog of the library its lookups are keyed by, see NF_setCartridgeDatabase
+struct RomLibrary {
+    struct NF_RomDB* db;
+    struct NF_RomCatalog* catalog;
+    const char* root;
+};
 
-// Create a rendering function that will plug into the emulator
-void receivePixel(struct NF_Pixel pxl) {
-    SDL_SetRenderDrawColor(screenRenderer, pxl.r, pxl.g, pxl.b, SDL_ALPHA_OPAQUE);
-    SDL_RenderDrawPoint(screenRenderer, pxl.x, pxl.y);
-    scanline = pxl.y;
-    cycle = pxl.x;
+// Bring the catalog of the ROM library up to date, reading new and changed ROMs on every processor
+static struct NF_RomCatalog* scanLibrary(const char* root) {
+    char catalog_path[1024];
+    snprintf(catalog_path, sizeof(catalog_path), "%s/%s", root, LIBRARY_CATALOG_NAME);
+    struct NF_ThreadPool* pool = NF_createThreadPool(0);
+    struct NF_RomScanStats stats;
+    struct NF_RomCatalog* catalog = NF_RomCatalog_scan(root, catalog_path, pool, &stats);
+    NF_freeThreadPool(pool);
+    if (catalog != NULL && stats.hashed > 0) { printf("Cataloged %u new or changed ROMs in %s.\n", stats.hashed, root); }
+    return catalog;
 }
 
-void quitFunc() { MAIN = false; }
+// Open the ROM database and the library named by the environment, if there are any. The game runs without them if
+// they cannot be opened
+static void openRomLibrary(struct RomLibrary* library) {
+    memset(library, 0, sizeof(*library));
+    const char* db_path = getenv("NF_ROM_DB");
+    if (db_path == NULL) { return; }
+    library->db = NF_RomDB_open(db_path);
+    if (library->db == NULL) { return; }
+    library->root = getenv("NF_ROM_LIBRARY");
+    if (library->root != NULL) { library->catalog = scanLibrary(library->root); }
+    NF_setCartridgeDatabase(library->db, library->catalog, library->catalog != NULL ? library->root : NULL);
+}
+
+static void closeRomLibrary(struct RomLibrary* library) {
+    NF_setCartridgeDatabase(NULL, NULL, NULL);
+    NF_RomCatalog_close(library->catalog);
+    NF_RomDB_close(library->db);
+}
+
+// Add every ROM of the library to a database, keeping what the database already has
+int buildRomDatabase(const char* db_path) {
+    const char* root = getenv("NF_ROM_LIBRARY");
+    if (root == NULL) {
+        printf("Error: --romdb-build needs the directory of the ROM library in NF_ROM_LIBRARY.\n");
+        return 1;
+    }
+    struct NF_RomCatalog* catalog = scanLibrary(root);
+    struct NF_RomDBBuilder* builder = NF_RomDB_createBuilder();
+    bool ok = catalog != NULL && builder != NULL;
+
+    // The old database is closed before the new one replaces it, since Windows will not replace a file that is mapped
+    struct NF_FileInfo info;
+    if (ok && NF_getFileInfo(db_path, &info)) {
+        struct NF_RomDB* existing = NF_RomDB_open(db_path);
+        ok = existing != NULL && NF_RomDB_addAll(builder, existing);
+        NF_RomDB_close(existing);
+    }
+    ok = ok && NF_RomDB_addCatalog(builder, catalog, root) && NF_RomDB_write(builder, db_path);
+    if (ok) { printf("%u ROMs in %s.\n", builder->count, db_path); }
+    NF_RomDB_freeBuilder(builder);
+    NF_RomCatalog_close(catalog);
+    return ok ? 0 : 1;
+}
+
+// Run one frame, with the buttons either coming from the movie being played or from the keyboard
+static void emulateFrame(struct EmulationThread* emu) {
+    if (emu->playback != NULL && !NF_Movie_playFrame(emu->playback, emu->console)) {
+        printf("Movie finished after %u frames.\n", emu->playback->frame_count);
+        NF_Movie_free(emu->playback);
+        emu->playback = NULL;
+    }
+    if (emu->playback == NULL) {
+        if (emu->recording != NULL) { NF_Movie_recordFrame(emu->recording, emu->console, emu->buttons); }
+        else { NF_setControllerButtons(emu->console, 0, emu->buttons[0]); }
+        NF_runFrame(emu->console);
+    }
+}
 
-int main(int arc, char* args[]) {
+static void emulationThread(void* arg) {
+    struct EmulationThread* emu = arg;
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t frame_ticks = (uint64_t)(frequency / NES_FRAME_RATE);
+    uint64_t next_frame = SDL_GetPerformanceCounter();
+
+    if (emu->render == NULL) { emu->console->frame_output = NF_TripleBuffer_back(emu->frames); }
+    while (NF_atomicLoadAcquire(&emu->running)) {
+        uint8_t port, buttons;
+        while (NF_InputQueue_pop(&emu->input, &port, &buttons)) {
+            if (port < NF_CONTROLLER_PORTS) { emu->buttons[port] = buttons; }
+        }
+
+        NF_setTracer(emu->console, NF_atomicLoadAcquire(&emu->tracing) ? emu->tracer : NULL);
+        NF_Stats_addPresentation(emu->console, (uint64_t)NF_atomicExchange(&emu->presentation_us, 0) * 1000);
+        emulateFrame(emu);
+        if (emu->render == NULL) { emu->console->frame_output = NF_TripleBuffer_publish(emu->frames); }
+
+        // Hold off until the sound card has caught up, or without sound, until the frame is due. After falling more
+        // than a frame behind, carry on from now rather than rushing to catch up
+        if (CF_waitForAudio()) { continue; }
+        next_frame += frame_ticks;
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now < next_frame) { SDL_Delay((Uint32)((next_frame - now) * 1000 / frequency)); }
+        else if (now - next_frame > frame_ticks) { next_frame = now; }
+    }
+    emu->console->frame_output = NULL;
+    NF_setTracer(emu->console, NULL);
+}
+
+// Hand the frame the console just drew to the recorder, along with the sound played during it, and return the frame
+// to draw the next one into
+static struct NF_RecorderFrame* recordFrame(struct NF_Recorder* recorder, struct NF_RecorderFrame* frame, struct NF_AudioRing* audio) {
+    int16_t samples[1024];
+    uint32_t count;
+    while ((count = NF_AudioRing_read(audio, samples, 1024)) > 0) { NF_Recorder_addAudio(recorder, frame, samples, count); }
+    return NF_Recorder_submit(recorder, frame);
+}
+
+// Play a whole movie without opening a window, recording it into video_path unless that is NULL
+int runHeadless(struct NES_Console* console, struct NF_Movie* movie, const char* video_path) {
+    struct NF_Recorder* recorder = NULL;
+    struct NF_RecorderFrame* recording_frame = NULL;
+    struct NF_AudioRing* audio = NULL;
+    if (video_path != NULL) {
+        uint32_t colors[NF_PALETTE_COLORS];
+        NF_getColorTable(colors);
+        recorder = NF_Recorder_create(video_path, colors, AUDIO_SAMPLE_RATE);
+        audio = NF_AudioRing_create(RECORDING_AUDIO_BUFFER);
+        if (recorder == NULL || audio == NULL) {
+            NF_Recorder_finish(recorder);
+            NF_AudioRing_free(audio);
+            return 1;
+        }
+        NF_APU_setOutput(console->ConnectedAPU, audio, AUDIO_SAMPLE_RATE);
+        recording_frame = NF_Recorder_acquire(recorder);
+        console->frame_output = &recording_frame->frame;
+    }
+
+    clock_t start = clock();
+    uint32_t frames = 0;
+    while (NF_Movie_playFrame(movie, console)) {
+        frames++;
+        if (recorder == NULL) { continue; }
+        recording_frame = recordFrame(recorder, recording_frame, audio);
+        console->frame_output = &recording_frame->frame;
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    if (recorder != NULL) {
+        console->frame_output = NULL;
+        NF_APU_setOutput(console->ConnectedAPU, NULL, AUDIO_SAMPLE_RATE);
+        NF_RecorderFrame_release(recording_frame);
+        bool recorded = NF_Recorder_finish(recorder);
+        NF_AudioRing_free(audio);
+        if (!recorded) { return 1; }
+    }
+
+    size_t size = NF_State_size(console);
+    uint8_t* state = malloc(size);
+    if (state == NULL || !NF_State_save(console, state, size)) {
+        free(state);
+        return 1;
+    }
+    printf("Played %u frames in %.2f seconds (%.1f frames per second)\n", frames, seconds, seconds > 0 ? frames / seconds : 0.0);
+    printf("Final state CRC32: %08X\n", NF_crc32(0, state, size));
+    free(state);
+    return 0;
+}
+
+// Run the console for a while without a window, then time the video filters on the frame it ends up drawing
+int runFilterBenchmark(struct NES_Console* console) {
+    struct NF_Frame* frame = calloc(1, sizeof(struct NF_Frame));
+    if (frame == NULL) { return 1; }
+    console->frame_output = frame;
+    for (int i = 0; i < BENCHMARK_WARMUP_FRAMES; i++) { NF_runFrame(console); }
+    console->frame_output = NULL;
+    CF_benchmarkVideoFilters(frame, BENCHMARK_REPEATS);
+    free(frame);
+    return 0;
+}
+
+// Format a whole trace file as text
+int writeTraceText(const char* trace_path, const char* text_path) {
+    struct NF_Tracer* trace = NF_Tracer_open(trace_path);
+    if (trace == NULL) { return 1; }
+    FILE* file = fopen(text_path, "w");
+    bool ok = file != NULL && NF_Tracer_writeText(trace, file, 0, trace->count);
+    if (file != NULL) { ok = (fclose(file) == 0) && ok; }
+    if (!ok) { printf("Error: Could not write %s.\n", text_path); }
+    NF_Tracer_free(trace);
+    return ok ? 0 : 1;
+}
+
+static double secondsSince(uint64_t start) { return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency(); }
+
+static void printTraceRecord(const char* prefix, struct NF_Tracer* trace, uint64_t index) {
+    char line[NF_TRACE_LINE_SIZE];
+    NF_formatTraceRecord(NF_Tracer_get(trace, index), line, sizeof(line));
+    printf("%s%12llu  %s\n", prefix, (unsigned long long)index, line);
+}
+
+// Find where two trace files first differ, and show what led up to it and what is different
+int diffTraces(const char* a_path, const char* b_path) {
+    struct NF_Tracer* a = NF_Tracer_open(a_path);
+    struct NF_Tracer* b = (a != NULL) ? NF_Tracer_open(b_path) : NULL;
+    struct NF_ThreadPool* pool = (b != NULL) ? NF_createThreadPool(0) : NULL;
+    if (pool == NULL) {
+        NF_Tracer_free(a);
+        NF_Tracer_free(b);
+        return 1;
+    }
+    uint64_t start = SDL_GetPerformanceCounter();
+    uint64_t record;
+    bool differ = NF_Trace_findDivergence(a, b, pool, &record);
+    double seconds = secondsSince(start);
+    if (!differ) { printf("The traces match for all %llu instructions (%.3f seconds).\n", (unsigned long long)a->count, seconds); }
+    else {
+        printf("The traces differ at instruction %llu (%.3f seconds):\n", (unsigned long long)record, seconds);
+        for (uint64_t i = (record > TRACE_DIFF_CONTEXT) ? record - TRACE_DIFF_CONTEXT : 0; i < record; i++) { printTraceRecord("  ", a, i); }
+        const struct NF_TraceRecord* x = NF_Tracer_get(a, record);
+        const struct NF_TraceRecord* y = NF_Tracer_get(b, record);
+        if (x != NULL) { printTraceRecord("< ", a, record); }
+        if (y != NULL) { printTraceRecord("> ", b, record); }
+        if (x == NULL || y == NULL) { printf("%s ends here.\n", (x == NULL) ? a_path : b_path); }
+        else { NF_printTraceDifferences(x, y, true); }
+    }
+    NF_freeThreadPool(pool);
+    NF_Tracer_free(a);
+    NF_Tracer_free(b);
+    return differ ? 2 : 0;
+}
+
+// Look up a PC (in hex), cycle or frame in the index of a trace file, building the index first if it needs it
+int queryTrace(const char* trace_path, const char* query, const char* value_text) {
+    struct NF_Tracer* trace = NF_Tracer_open(trace_path);
+    struct NF_ThreadPool* pool = (trace != NULL) ? NF_createThreadPool(0) : NULL;
+    uint64_t start = SDL_GetPerformanceCounter();
+    struct NF_TraceIndex* index = (pool != NULL) ? NF_TraceIndex_open(trace, pool) : NULL;
+    NF_freeThreadPool(pool);
+    if (index == NULL) {
+        NF_Tracer_free(trace);
+        return 1;
+    }
+    double index_seconds = secondsSince(start);
+
+    bool pc_query = strcmp(query, "pc") == 0;
+    uint64_t value = strtoull(value_text + (value_text[0] == '$'), NULL, pc_query ? 16 : 10);
+    start = SDL_GetPerformanceCounter();
+    bool found = true;
+    uint64_t record = 0;
+    const uint64_t* records = NULL;
+    uint64_t count = 0;
+    if (pc_query) { count = NF_TraceIndex_findPC(index, (uint16_t)value, &records); }
+    else if (strcmp(query, "cycle") == 0) { found = NF_TraceIndex_findCycle(index, value, &record); }
+    else { found = NF_TraceIndex_findFrame(index, (uint32_t)value, &record); }
+    double seconds = secondsSince(start);
+
+    printf("Opened the index of %llu instructions in %.3f seconds, and looked up %s %s in %.6f seconds.\n",
+        (unsigned long long)trace->count, index_seconds, query, value_text, seconds);
+    if (pc_query) {
+        for (uint64_t i = 0; i < count; i++) { printTraceRecord("", trace, records[i]); }
+        printf("$%04X ran %llu times.\n", (unsigned int)(value & 0xFFFF), (unsigned long long)count);
+    }
+    else if (found) { printTraceRecord("", trace, record); }
+    else { printf("The trace does not cover %s %s.\n", query, value_text); }
+    NF_TraceIndex_close(index);
+    NF_Tracer_free(trace);
+    return found ? 0 : 1;
+}
+
+// Run the microbenchmarks and save their results
+int runBenchmarks(const char* json_path, const char* const* rom_paths, int rom_count) {
+    FILE* json = fopen(json_path, "w");
+    if (json == NULL) {
+        printf("Error: Could not open %s for writing.\n", json_path);
+        return 1;
+    }
+    bool ok = NF_Benchmark_runSuite(rom_paths, rom_count, NF_BENCHMARK_DEFAULT_SAMPLES, json);
+    ok = (fclose(json) == 0) && ok;
+    if (ok) { printf("Results written to %s.\n", json_path); }
+    return ok ? 0 : 1;
+}
+
+// Write out what the profiler found
+static bool writeProfile(struct NF_Profiler* profiler, const char* name) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.folded", name);
+    FILE* stacks = fopen(path, "w");
+    bool ok = stacks != NULL && NF_Profiler_writeStacks(profiler, stacks);
+    if (stacks != NULL) { ok = (fclose(stacks) == 0) && ok; }
+    snprintf(path, sizeof(path), "%s.txt", name);
+    FILE* hot = ok ? fopen(path, "w") : NULL;
+    ok = hot != NULL && NF_Profiler_writeHotAddresses(profiler, hot);
+    if (hot != NULL) { ok = (fclose(hot) == 0) && ok; }
+    if (ok) { printf("Profile written to %s.folded and %s.txt.\n", name, name); }
+    else { printf("Error: Could not write the profile to %s.\n", path); }
+    return ok;
+}
+
+// Write out the code/data log, and how much of each bank the game used
+static bool writeCodeDataLog(struct NF_CodeDataLog* log, const char* path) {
+    if (!NF_CodeDataLog_save(log, path)) { return false; }
+    printf("Code/data log written to %s.\n", path);
+    return NF_CodeDataLog_writeSummary(log, stdout);
+}
+
+// Run the corpus benchmark and save its results
+int runCorpusBenchmark(const char* json_path, const char* const* rom_paths, int rom_count) {
+    FILE* json = fopen(json_path, "w");
+    if (json == NULL) {
+        printf("Error: Could not open %s for writing.\n", json_path);
+        return 1;
+    }
+    bool ok = NF_Benchmark_runCorpus(rom_paths, rom_count, getenv("NF_ROM_CORPUS"), NF_CORPUS_DEFAULT_FRAMES, json);
+    ok = (fclose(json) == 0) && ok;
+    if (ok) { printf("Results written to %s.\n", json_path); }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* args[]) {
+
+    const char* rom_path = "nestest.nes"; // Or any other legal ROM.
+    const char* record_path = NULL;
+    const char* play_path = NULL;
+    const char* video_path = NULL;
+    const char* trace_path = NULL;
+    const char* profile_name = NULL;
+    const char* cdl_path = NULL;
+    int stats_interval = 0;
+    const char* nestest_log = NULL;
+    const char* benchmark_path = NULL;
+    const char* corpus_path = NULL;
+    const char* rom_paths[MAX_ROM_ARGUMENTS];
+    int rom_count = 0;
+    bool headless = false;
+    bool benchmark_filters = false;
+    CF_VIDEO_FILTER filter = CF_FILTER_NONE;
+    int scale = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--record") == 0 && i + 1 < argc) { record_path = args[++i]; }
+        else if (strcmp(args[i], "--play") == 0 && i + 1 < argc) { play_path = args[++i]; }
+        else if (strcmp(args[i], "--headless") == 0) { headless = true; }
+        else if (strcmp(args[i], "--record-video") == 0 && i + 1 < argc) { video_path = args[++i]; }
+        else if (strcmp(args[i], "--export-video") == 0 && i + 3 < argc) {
+            bool exported = NF_Recording_export(args[i + 1], args[i + 2], args[i + 3]);
+            return exported ? 0 : 1;
+        }
+        else if (strcmp(args[i], "--trace") == 0 && i + 1 < argc) { trace_path = args[++i]; }
+        else if (strcmp(args[i], "--profile") == 0 && i + 1 < argc) { profile_name = args[++i]; }
+        else if (strcmp(args[i], "--stats") == 0 && i + 1 < argc) { stats_interval = atoi(args[++i]); }
+        else if (strcmp(args[i], "--cdl") == 0 && i + 1 < argc) { cdl_path = args[++i]; }
+        else if (strcmp(args[i], "--trace-text") == 0 && i + 2 < argc) { return writeTraceText(args[i + 1], args[i + 2]); }
+        else if (strcmp(args[i], "--trace-diff") == 0 && i + 2 < argc) { return diffTraces(args[i + 1], args[i + 2]); }
+        else if (strcmp(args[i], "--trace-pc") == 0 && i + 2 < argc) { return queryTrace(args[i + 1], "pc", args[i + 2]); }
+        else if (strcmp(args[i], "--trace-cycle") == 0 && i + 2 < argc) { return queryTrace(args[i + 1], "cycle", args[i + 2]); }
+        else if (strcmp(args[i], "--trace-frame") == 0 && i + 2 < argc) { return queryTrace(args[i + 1], "frame", args[i + 2]); }
+        else if (strcmp(args[i], "--nestest") == 0 && i + 1 < argc) { nestest_log = args[++i]; }
+        else if (strcmp(args[i], "--benchmark") == 0 && i + 1 < argc) { benchmark_path = args[++i]; }
+        else if (strcmp(args[i], "--benchmark-corpus") == 0 && i + 1 < argc) { corpus_path = args[++i]; }
+        else if (strcmp(args[i], "--ntsc") == 0) { filter = CF_FILTER_NTSC; }
+        else if (strcmp(args[i], "--filter") == 0 && i + 1 < argc) {
+            if (!CF_findVideoFilter(args[++i], &filter, &scale)) {
+                printf("Error: There is no video filter called %s.\n", args[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(args[i], "--benchmark-filters") == 0) { benchmark_filters = true; }
+        else if (strcmp(args[i], "--romdb-build") == 0 && i + 1 < argc) { return buildRomDatabase(args[i + 1]); }
+        else if (strcmp(args[i], "--check-compositor") == 0) { return NF_checkCompositor() ? 0 : 1; }
+        else {
+            rom_path = args[i];
+            if (rom_count < MAX_ROM_ARGUMENTS) { rom_paths[rom_count++] = args[i]; }
+        }
+    }
+    if (nestest_log != NULL) { return NF_Nestest_check(rom_path, nestest_log); }
+    if (benchmark_path != NULL) { return (rom_count > 0) ? runBenchmarks(benchmark_path, rom_paths, rom_count) : runBenchmarks(benchmark_path, &rom_path, 1); }
+    if (corpus_path != NULL) { return (rom_count > 0) ? runCorpusBenchmark(corpus_path, rom_paths, rom_count) : runCorpusBenchmark(corpus_path, &rom_path, 1); }
+    if (headless && play_path == NULL) {
+        printf("Error: --headless needs a movie to play with --play.\n");
+        return 1;
+    }
+    if (video_path != NULL && !headless) {
+        printf("Error: --record-video only works with --headless.\n");
+        return 1;
+    }
 
     // Initialize ROM and NES
-    uint8_t* rom_data = NF_readROMtoBuffer("nestest.nes"); // Or any other legal ROM.
-    struct Cartridge* game_cart = NF_createCartridgeFromBuffer(rom_data);
+    struct RomLibrary library;
+    openRomLibrary(&library);
+    struct Cartridge* game_cart = NF_loadCartridge(rom_path);
     struct NES_Console* console = NF_initConsole();
     
     if (console == 0) { return 1; }
 
-    console->imageOutFunc = *receivePixel;
-
     if (NF_insertCartridge(console, game_cart) == 1) { return 1; }
 
-    // Initialize SDL window and renderer
-    CF_init("NES Emulator", 256, 240);
+    if (benchmark_filters) {
+        int result = runFilterBenchmark(console);
+        NF_freeCartridge(game_cart);
+        return result;
+    }
 
-    // Correctly create the renderer
-    int v = SDL_Init(SDL_INIT_VIDEO);
-    screenRenderer = SDL_CreateRenderer(CF_getWindow(), -1, SDL_RENDERER_ACCELERATED);
-    if (screenRenderer == NULL) {
-        printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
-        return -1;
+    // A movie starts from its first keyframe rather than from power on
+    struct NF_Movie* playback = NULL;
+    struct NF_Movie* recording = NULL;
+    if (play_path != NULL) {
+        playback = NF_Movie_open(play_path);
+        if (playback == NULL || !NF_Movie_seek(playback, console, 0)) { return 1; }
+    }
+    struct NF_Tracer* tracer = NULL;
+    if (trace_path != NULL) {
+        tracer = NF_Tracer_createFile(trace_path);
+        if (tracer == NULL) { return 1; }
+    }
+    struct NF_Profiler* profiler = NULL;
+    if (profile_name != NULL) {
+        profiler = NF_Profiler_create(console);
+        if (profiler == NULL) { return 1; }
+        NF_setProfiler(console, profiler);
     }
-    if (!screenRenderer) {
-        printf("Error: SDL_Renderer could not be created! SDL Error: %s\n", SDL_GetError());
-        return -1;
+    struct NF_CodeDataLog* code_data_log = NULL;
+    if (cdl_path != NULL) {
+        struct NF_FileInfo info;
+        code_data_log = NF_CodeDataLog_create(game_cart);
+        if (code_data_log == NULL) { return 1; }
+        if (NF_getFileInfo(cdl_path, &info) && !NF_CodeDataLog_load(code_data_log, cdl_path)) { return 1; }
+        NF_setCodeDataLog(console, code_data_log);
     }
+    if (stats_interval > 0) {
+        NF_Stats_reset(console);
+        NF_Stats_setDump(console, stdout, (uint32_t)stats_interval);
+    }
+    if (headless) {
+        NF_setTracer(console, tracer);
+        int result = runHeadless(console, playback, video_path);
+        NF_setTracer(console, NULL);
+        NF_Tracer_free(tracer);
+        if (profiler != NULL && !writeProfile(profiler, profile_name)) { result = 1; }
+        NF_setProfiler(console, NULL);
+        NF_Profiler_free(profiler);
+        if (code_data_log != NULL && !writeCodeDataLog(code_data_log, cdl_path)) { result = 1; }
+        NF_setCodeDataLog(console, NULL);
+        NF_CodeDataLog_free(code_data_log);
+        NF_Movie_free(playback);
+        NF_freeCartridge(game_cart);
+        closeRomLibrary(&library);
+        return result;
+    }
+
+    // Initialize SDL window and renderer
+    int window_width, window_height;
+    CF_getVideoSize(filter, scale, &window_width, &window_height);
+    if (!CF_init("NES Emulator", window_width, window_height)) { return -1; }
+    if (!CF_initVideo(CF_getWindow(), filter, scale)) { return -1; }
+
+    // Start audio. The emulator still runs without it
+    struct NF_AudioRing* audio = CF_initAudio(AUDIO_SAMPLE_RATE, AUDIO_LATENCY_MS);
+    if (audio != NULL) { NF_APU_setOutput(console->ConnectedAPU, audio, AUDIO_SAMPLE_RATE); }
 
     // Set what happens when X is pressed on window
     CF_setXFunction(quitFunc);
 
-    while (MAIN) {
+    // Keyboard layout for the controller in port 1
+    CF_mapButton(SDL_SCANCODE_UP, CF_UP);
+    CF_mapButton(SDL_SCANCODE_RIGHT, CF_RIGHT);
+    CF_mapButton(SDL_SCANCODE_DOWN, CF_DOWN);
+    CF_mapButton(SDL_SCANCODE_LEFT, CF_LEFT);
+    CF_mapButton(SDL_SCANCODE_X, CF_A);
+    CF_mapButton(SDL_SCANCODE_Z, CF_B);
+    CF_mapButton(SDL_SCANCODE_RSHIFT, CF_SELECT);
+    CF_mapButton(SDL_SCANCODE_RETURN, CF_START);
 
-        // Look for window closing
-        while (SDL_PollEvent(&e) != NULL) { CF_handleXButtonPresses(e); }
+    // Recording starts from wherever the console is on the first frame that is recorded, so it can follow on from a
+    // movie being played
+    if (record_path != NULL) {
+        recording = NF_Movie_create(console, NF_MOVIE_DEFAULT_KEYFRAME_INTERVAL);
+        if (recording == NULL) { return 1; }
+    }
 
-        // Clear the screen at the start of each frame
-        SDL_SetRenderDrawColor(screenRenderer, 0, 0, 0, SDL_ALPHA_OPAQUE);  // Clear with black
+    emulation.console = console;
+    emulation.playback = playback;
+    emulation.recording = recording;
+    emulation.tracer = tracer;
+    emulation.tracing = (tracer != NULL);
+    emulation.frames = NF_TripleBuffer_create();
+    if (emulation.frames == NULL) { return 1; }
+    if (NF_getProcessorCount() >= RENDER_THREAD_MIN_PROCESSORS) {
+        emulation.render = NF_RenderThread_create(emulation.frames);
+        if (emulation.render != NULL) { NF_setRenderThread(console, emulation.render); }
+    }
+    NF_InputQueue_init(&emulation.input);
+    emulation.running = 1;
+    NF_Thread emulation_thread;
+    if (!NF_startThread(&emulation_thread, emulationThread, &emulation)) { return 1; }
 
-        // Handle startup cycles
-        startup_cycles++;
-        if (startup_cycles == 29658 && startup_ready == false) {
-            startup_ready = true;
-        }
+    uint8_t sent_buttons = 0;
+    while (MAIN) {
 
-        // Run the NES master clock
-        if (startup_ready) {
-            NF_busTickMasterClock(console, startup_ready);
+        // Look for window closing and key presses, and pass on any change to the buttons
+        CF_clearControllerInput();
+        while (SDL_PollEvent(&e) != NULL) {
+            CF_handleXButtonPresses(e);
+            CF_receiveControllerInput(e);
+            if (tracer != NULL && e.type == SDL_KEYDOWN && e.key.repeat == 0 && e.key.keysym.scancode == SDL_SCANCODE_F9) {
+                bool tracing = !NF_atomicLoadAcquire(&emulation.tracing);
+                NF_atomicStoreRelease(&emulation.tracing, tracing);
+                printf("Tracing %s.\n", tracing ? "resumed" : "paused");
+            }
         }
+        uint8_t buttons = CF_getControllerState();
+        if (buttons != sent_buttons && NF_InputQueue_push(&emulation.input, 0, buttons)) { sent_buttons = buttons; }
 
-        // Update the screen when the frame ends
-        if (scanline == 239 && cycle == 254) {
-            SDL_RenderPresent(screenRenderer);
+        // Show the newest frame. If the emulator has not finished one since last time, there is nothing to do yet
+        struct NF_Frame* frame = NF_TripleBuffer_acquire(emulation.frames);
+        if (frame == NULL) {
+            SDL_Delay(1);
+            continue;
         }
+        uint64_t present_start = NF_getTicks();
+        CF_drawFrame(frame);
+        CF_presentVideo();
+        NF_PROBE1(present, frame->number);
+        NF_atomicAdd(&emulation.presentation_us, (uint32_t)((NF_getTicks() - present_start) * 1000000 / NF_getTickFrequency()));
     }
 
-    // Clean up and exit
+    NF_atomicStoreRelease(&emulation.running, 0);
+    NF_joinThread(&emulation_thread);
+    NF_setRenderThread(console, NULL);
+    NF_RenderThread_free(emulation.render);
+    playback = emulation.playback;
+    NF_TripleBuffer_free(emulation.frames);
+    NF_Tracer_free(tracer);
+    if (profiler != NULL) { writeProfile(profiler, profile_name); }
+    NF_setProfiler(console, NULL);
+    NF_Profiler_free(profiler);
+    if (code_data_log != NULL) { writeCodeDataLog(code_data_log, cdl_path); }
+    NF_setCodeDataLog(console, NULL);
+    NF_CodeDataLog_free(code_data_log);
+
+    if (recording != NULL) { NF_Movie_save(recording, record_path); }
+    NF_Movie_free(recording);
+    NF_Movie_free(playback);
+
+    // Clean up and exit. Freeing the cartridge writes any battery backed RAM to disk
+    NF_freeCartridge(game_cart);
+    closeRomLibrary(&library);
+    CF_exitAudio();
+    CF_exitVideo();
     CF_exit();
 
     return 0;